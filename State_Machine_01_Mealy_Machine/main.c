@@ -50,8 +50,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
-#include "nrf_delay.h"
-#include "nrf_gpio.h"
+#include "hal.h"
 
 // LED pins
 #define LED_ONE   13
@@ -84,7 +83,7 @@ void light_state_machine(enum Event event) {
         case LIGHT_ZERO:
             switch (event) {
                 case UP:
-                    nrf_gpio_pin_clear(LED_ONE);
+                    hal_gpio_clear(LED_ONE);
                     curr_state = LIGHT_ONE;
                     break;
                 case DOWN:
@@ -95,11 +94,11 @@ void light_state_machine(enum Event event) {
         case LIGHT_ONE:
             switch (event) {
                 case UP:
-                    nrf_gpio_pin_clear(LED_TWO);
+                    hal_gpio_clear(LED_TWO);
                     curr_state = LIGHT_TWO;
                     break;
                 case DOWN:
-                    nrf_gpio_pin_set(LED_ONE);
+                    hal_gpio_set(LED_ONE);
                     curr_state = LIGHT_ZERO;
                     break;
             }
@@ -108,11 +107,11 @@ void light_state_machine(enum Event event) {
         case LIGHT_TWO:
             switch (event) {
                 case UP:
-                    nrf_gpio_pin_clear(LED_THREE);
+                    hal_gpio_clear(LED_THREE);
                     curr_state = LIGHT_THREE;
                     break;
                 case DOWN:
-                    nrf_gpio_pin_set(LED_TWO);
+                    hal_gpio_set(LED_TWO);
                     curr_state = LIGHT_ONE;
                     break;
             }
@@ -121,11 +120,11 @@ void light_state_machine(enum Event event) {
         case LIGHT_THREE:
             switch (event) {
                 case UP:
-                    nrf_gpio_pin_clear(LED_FOUR);
+                    hal_gpio_clear(LED_FOUR);
                     curr_state = LIGHT_FOUR;
                     break;
                 case DOWN:
-                    nrf_gpio_pin_set(LED_THREE);
+                    hal_gpio_set(LED_THREE);
                     curr_state = LIGHT_TWO;
                     break;
             }
@@ -136,7 +135,7 @@ void light_state_machine(enum Event event) {
                 case UP:
                     break;
                 case DOWN:
-                    nrf_gpio_pin_set(LED_FOUR);
+                    hal_gpio_set(LED_FOUR);
                     curr_state = LIGHT_THREE;
                     break;
             }
@@ -145,33 +144,33 @@ void light_state_machine(enum Event event) {
 }
 
 int main(void) {
-    nrf_gpio_cfg_output(LED_ONE);
-    nrf_gpio_pin_set(LED_ONE);
-    nrf_gpio_cfg_output(LED_TWO);
-    nrf_gpio_pin_set(LED_TWO);
-    nrf_gpio_cfg_output(LED_THREE);
-    nrf_gpio_pin_set(LED_THREE);
-    nrf_gpio_cfg_output(LED_FOUR);
-    nrf_gpio_pin_set(LED_FOUR);
-
-    nrf_gpio_cfg_input(BUTTON_UP, NRF_GPIO_PIN_PULLUP);
-    nrf_gpio_cfg_input(BUTTON_DOWN, NRF_GPIO_PIN_PULLUP);
+    hal_gpio_cfg_output(LED_ONE);
+    hal_gpio_set(LED_ONE);
+    hal_gpio_cfg_output(LED_TWO);
+    hal_gpio_set(LED_TWO);
+    hal_gpio_cfg_output(LED_THREE);
+    hal_gpio_set(LED_THREE);
+    hal_gpio_cfg_output(LED_FOUR);
+    hal_gpio_set(LED_FOUR);
+
+    hal_gpio_cfg_input_pullup(BUTTON_UP);
+    hal_gpio_cfg_input_pullup(BUTTON_DOWN);
 
     while (true) {
         enum Event event;
-        if (nrf_gpio_pin_read(BUTTON_UP) == false) 
+        if (hal_gpio_read(BUTTON_UP) == false) 
         {
             event = UP;
             light_state_machine(event);
-            while (nrf_gpio_pin_read(BUTTON_UP) == false); // Wait for button release
-            nrf_delay_ms(100); // Debounce delay
+            while (hal_gpio_read(BUTTON_UP) == false); // Wait for button release
+            hal_delay_ms(100); // Debounce delay
         } 
-        else if (nrf_gpio_pin_read(BUTTON_DOWN) == false) 
+        else if (hal_gpio_read(BUTTON_DOWN) == false) 
         {
             event = DOWN;
             light_state_machine(event);
-            while (nrf_gpio_pin_read(BUTTON_DOWN) == false); // Wait for button release
-            nrf_delay_ms(100); // Debounce delay
+            while (hal_gpio_read(BUTTON_DOWN) == false); // Wait for button release
+            hal_delay_ms(100); // Debounce delay
         }
     }
 }
@@ -50,8 +50,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
-#include "nrf_delay.h"
-#include "nrf_gpio.h"
+#include "hal.h"
 
 // LED pins
 #define LED_ONE   13
@@ -84,8 +83,8 @@ enum Event check_button_event(void) {
     static bool prev_up_state = true;
     static bool prev_down_state = true;
 
-    bool current_up_state = nrf_gpio_pin_read(BUTTON_UP);
-    bool current_down_state = nrf_gpio_pin_read(BUTTON_DOWN);
+    bool current_up_state = hal_gpio_read(BUTTON_UP);
+    bool current_down_state = hal_gpio_read(BUTTON_DOWN);
 
     if (!current_up_state && prev_up_state) {
         prev_up_state = current_up_state;
@@ -105,44 +104,44 @@ void light_state_machine(enum Event event) {
     switch (curr_state) {
         case LIGHT_ZERO:
             if (event == UP_PRESSED) {
-                nrf_gpio_pin_clear(LED_ONE);
+                hal_gpio_clear(LED_ONE);
                 curr_state = LIGHT_ONE;
             }
             break;
 
         case LIGHT_ONE:
             if (event == DOWN_PRESSED) {
-                nrf_gpio_pin_set(LED_ONE);
+                hal_gpio_set(LED_ONE);
                 curr_state = LIGHT_ZERO;
             } else if (event == UP_PRESSED) {
-                nrf_gpio_pin_clear(LED_TWO);
+                hal_gpio_clear(LED_TWO);
                 curr_state = LIGHT_TWO;
             }
             break;
 
         case LIGHT_TWO:
             if (event == DOWN_PRESSED) {
-                nrf_gpio_pin_set(LED_TWO);
+                hal_gpio_set(LED_TWO);
                 curr_state = LIGHT_ONE;
             } else if (event == UP_PRESSED) {
-                nrf_gpio_pin_clear(LED_THREE);
+                hal_gpio_clear(LED_THREE);
                 curr_state = LIGHT_THREE;
             }
             break;
 
         case LIGHT_THREE:
             if (event == DOWN_PRESSED) {
-                nrf_gpio_pin_set(LED_THREE);
+                hal_gpio_set(LED_THREE);
                 curr_state = LIGHT_TWO;
             } else if (event == UP_PRESSED) {
-                nrf_gpio_pin_clear(LED_FOUR);
+                hal_gpio_clear(LED_FOUR);
                 curr_state = LIGHT_FOUR;
             }
             break;
 
         case LIGHT_FOUR:
             if (event == DOWN_PRESSED) {
-                nrf_gpio_pin_set(LED_FOUR);
+                hal_gpio_set(LED_FOUR);
                 curr_state = LIGHT_THREE;
             }
             break;
@@ -150,22 +149,22 @@ void light_state_machine(enum Event event) {
 }
 
 int main(void) {
-    nrf_gpio_cfg_output(LED_ONE);
-    nrf_gpio_pin_set(LED_ONE);
-    nrf_gpio_cfg_output(LED_TWO);
-    nrf_gpio_pin_set(LED_TWO);
-    nrf_gpio_cfg_output(LED_THREE);
-    nrf_gpio_pin_set(LED_THREE);
-    nrf_gpio_cfg_output(LED_FOUR);
-    nrf_gpio_pin_set(LED_FOUR);
-
-    nrf_gpio_cfg_input(BUTTON_UP, NRF_GPIO_PIN_PULLUP);
-    nrf_gpio_cfg_input(BUTTON_DOWN, NRF_GPIO_PIN_PULLUP);
+    hal_gpio_cfg_output(LED_ONE);
+    hal_gpio_set(LED_ONE);
+    hal_gpio_cfg_output(LED_TWO);
+    hal_gpio_set(LED_TWO);
+    hal_gpio_cfg_output(LED_THREE);
+    hal_gpio_set(LED_THREE);
+    hal_gpio_cfg_output(LED_FOUR);
+    hal_gpio_set(LED_FOUR);
+
+    hal_gpio_cfg_input_pullup(BUTTON_UP);
+    hal_gpio_cfg_input_pullup(BUTTON_DOWN);
 
     while (true) {
         enum Event event = check_button_event();
         light_state_machine(event);
-        nrf_delay_ms(100);
+        hal_delay_ms(100);
     }
 }
 
@@ -0,0 +1,172 @@
+
+#include "button_scan.h"
+#include <string.h>
+
+
+/* Port bits -> logical bits, one 256 entry table per byte of each port.
+ * Only the bytes that carry a mapped pin are looked up, so a scan costs one
+ * port read and a handful of table loads whatever the number of buttons. */
+typedef struct
+{
+  uint16_t lut[BUTTON_SCAN_PORTS][4][256];
+  uint8_t used_bytes[BUTTON_SCAN_PORTS];   /* bit n set: byte n has mapped pins */
+}pin_lut_t;
+
+static pin_lut_t m_direct;
+#if BUTTON_MATRIX
+static pin_lut_t m_cols;
+static button_matrix_cfg_t m_matrix;
+#endif
+static button_scan_stats_t m_stats;
+
+
+static void pin_lut_build(pin_lut_t *p_lut, uint8_t const *pins, uint8_t const *bits, uint8_t count)
+{
+  memset(p_lut, 0, sizeof(*p_lut));
+
+  for(uint8_t i = 0; i < count; i++)
+  {
+    uint8_t port = pins[i] >> 5;
+    uint8_t byte = (pins[i] & 0x1F) >> 3;
+    uint8_t mask = 1 << (pins[i] & 0x07);
+    uint16_t bit = 1 << (bits ? bits[i] : i);
+
+    p_lut->used_bytes[port] |= (1 << byte);
+    for(uint16_t v = 0; v < 256; v++)
+    {
+      if(v & mask)
+      {
+        p_lut->lut[port][byte][v] |= bit;
+      }
+    }
+  }
+}
+
+/**@brief Read each used port once and translate the active (low) pins.
+ */
+static uint16_t pin_lut_read(pin_lut_t const *p_lut)
+{
+  uint16_t value = 0;
+
+  for(uint8_t port = 0; port < BUTTON_SCAN_PORTS; port++)
+  {
+    uint8_t used = p_lut->used_bytes[port];
+    if(used)
+    {
+      uint32_t in = ~hal_gpio_port_read(port); // pressed pulls the pin low
+      for(uint8_t byte = 0; byte < 4; byte++)
+      {
+        if(used & (1 << byte))
+        {
+          value |= p_lut->lut[port][byte][(in >> (byte * 8)) & 0xFF];
+        }
+      }
+    }
+  }
+  return value;
+}
+
+/**@brief Configure directly wired buttons and build their lookup table.
+ */
+void button_scan_init(button_scan_map_t const *map, uint8_t count)
+{
+  uint8_t pins[BUTTON_SCAN_MAX_DIRECT];
+  uint8_t bits[BUTTON_SCAN_MAX_DIRECT];
+
+  if(count > BUTTON_SCAN_MAX_DIRECT)
+  {
+    count = BUTTON_SCAN_MAX_DIRECT;
+  }
+  for(uint8_t i = 0; i < count; i++)
+  {
+    pins[i] = map[i].pin;
+    bits[i] = map[i].bit;
+    hal_gpio_cfg_input_pullup(map[i].pin);
+  }
+  pin_lut_build(&m_direct, pins, bits, count);
+}
+
+/**@brief Logical bitmap of the pressed direct buttons.
+ */
+uint16_t button_scan_read(void)
+{
+  m_stats.scans++;
+  return pin_lut_read(&m_direct);
+}
+
+#if BUTTON_MATRIX
+/**@brief Configure the matrix and build its column lookup table.
+ *
+ * @details Rows are S0D1 outputs, set they float. A push-pull row held high
+ *          would short to the scanned row through two keys held in one
+ *          column.
+ */
+void button_matrix_init(button_matrix_cfg_t const *cfg)
+{
+  m_matrix = *cfg;
+  if(m_matrix.rows > BUTTON_MATRIX_MAX_ROWS)
+  {
+    m_matrix.rows = BUTTON_MATRIX_MAX_ROWS;
+  }
+  if(m_matrix.cols > BUTTON_MATRIX_MAX_COLS)
+  {
+    m_matrix.cols = BUTTON_MATRIX_MAX_COLS;
+  }
+
+  for(uint8_t r = 0; r < m_matrix.rows; r++)
+  {
+    hal_gpio_set(m_matrix.row_pins[r]);
+    hal_gpio_cfg_output_od(m_matrix.row_pins[r]);
+  }
+  for(uint8_t c = 0; c < m_matrix.cols; c++)
+  {
+    hal_gpio_cfg_input_pullup(m_matrix.col_pins[c]);
+  }
+  pin_lut_build(&m_cols, m_matrix.col_pins, NULL, m_matrix.cols);
+}
+
+/**@brief Scan the key matrix, key (r, c) is bit r * cols + c of keys.
+ *
+ * @details Without diodes, three pressed corners of a rectangle make the fourth
+ *          read as pressed. Any two rows sharing more than one column are
+ *          ambiguous, the scan is dropped and keys keeps its previous value.
+ *
+ * @return false if the scan was rejected because of ghosting.
+ */
+bool button_matrix_scan(uint64_t *keys)
+{
+  uint8_t cols[BUTTON_MATRIX_MAX_ROWS];
+  uint64_t value = 0;
+
+  m_stats.scans++;
+  for(uint8_t r = 0; r < m_matrix.rows; r++)
+  {
+    hal_gpio_clear(m_matrix.row_pins[r]);
+    hal_delay_us(BUTTON_MATRIX_SETTLE_US);
+    cols[r] = (uint8_t)pin_lut_read(&m_cols);
+    hal_gpio_set(m_matrix.row_pins[r]);
+  }
+
+  for(uint8_t r = 0; r < m_matrix.rows; r++)
+  {
+    for(uint8_t k = r + 1; k < m_matrix.rows; k++)
+    {
+      uint8_t shared = cols[r] & cols[k];
+      if(shared & (shared - 1))
+      {
+        m_stats.ghost_scans++;
+        return false;
+      }
+    }
+    value |= (uint64_t)cols[r] << (r * m_matrix.cols);
+  }
+
+  *keys = value;
+  return true;
+}
+#endif
+
+button_scan_stats_t const * button_scan_stats_get(void)
+{
+  return &m_stats;
+}
@@ -0,0 +1,55 @@
+#ifndef BUTTON_SCAN_H
+#define BUTTON_SCAN_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+
+#define BUTTON_SCAN_PORTS         HAL_GPIO_PORTS
+
+/* Key matrix support, its column table costs 4 KB of RAM */
+#ifndef BUTTON_MATRIX
+#define BUTTON_MATRIX             0
+#endif
+
+#define BUTTON_SCAN_MAX_DIRECT    16   /* logical bits of a direct scan */
+#define BUTTON_MATRIX_MAX_ROWS    8
+#define BUTTON_MATRIX_MAX_COLS    8    /* 8 x 8 = 64 keys */
+#define BUTTON_MATRIX_SETTLE_US   5
+
+/* One directly wired button: GPIO pin and the logical bit it reports */
+typedef struct
+{
+  uint8_t pin;
+  uint8_t bit;
+}button_scan_map_t;
+
+/* Row/column key matrix, columns are pulled up. Rows are open drain: only
+ * the scanned row is driven low, the others float */
+typedef struct
+{
+  uint8_t const *row_pins;
+  uint8_t rows;
+  uint8_t const *col_pins;
+  uint8_t cols;
+}button_matrix_cfg_t;
+
+typedef struct
+{
+  uint32_t scans;
+  uint32_t ghost_scans;   /* matrix scans rejected as ambiguous */
+}button_scan_stats_t;
+
+
+void button_scan_init(button_scan_map_t const *map, uint8_t count);
+uint16_t button_scan_read(void);
+
+#if BUTTON_MATRIX
+void button_matrix_init(button_matrix_cfg_t const *cfg);
+bool button_matrix_scan(uint64_t *keys);
+#endif
+
+button_scan_stats_t const * button_scan_stats_get(void);
+
+
+#endif
@@ -0,0 +1,183 @@
+/* Host measurement of button_scan.c.
+ *
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DBUTTON_SCAN_BENCH -DBUTTON_MATRIX=1 -I. -I../State_Machine_Common \
+ *       button_scan_bench.c button_scan.c ../State_Machine_Common/hal_posix.c -o button_scan_bench
+ *   ./button_scan_bench [scans]
+ *
+ * Direct buttons: host time of a button_scan_read against reading pin by
+ * pin, for the four buttons of the board and for sixteen spread over both
+ * ports. Both pay the input read of the host HAL, so the difference is the
+ * lookup against the per pin loop.
+ *
+ * Key matrix: random sets of held keys, two of them in one column in every
+ * set, pressed on the matrix model of hal_posix.c. Every scan must report
+ * the held keys or reject the set as ghosting, and no scanned row may fight
+ * an idle one: hal_posix_shorts() stays 0. The same sets are scanned with
+ * the rows switched back to push-pull, as they were, for comparison.
+ */
+#if defined(BUTTON_SCAN_BENCH)
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "button_scan.h"
+
+#if !BUTTON_MATRIX
+#error "the bench scans a matrix, build it with -DBUTTON_MATRIX=1"
+#endif
+
+#define BENCH_SCANS_DEFAULT   200000
+#define BENCH_SETS            2000
+#define BENCH_ROWS            4
+#define BENCH_COLS            4
+
+static uint8_t const m_board_pins[] = {11, 12, 24, 25};
+static uint8_t const m_spread_pins[] = {2, 3, 4, 5, 11, 12, 24, 25, 28, 29, 32 + 1, 32 + 2, 32 + 3, 32 + 4,
+                                        32 + 10, 32 + 12};
+static uint8_t const m_row_pins[BENCH_ROWS] = {6, 7, 8, 26};
+static uint8_t const m_col_pins[BENCH_COLS] = {27, 30, 31, 32 + 5};
+
+HAL_TIMER_DEF(m_alive_timer_id);     /**< Keeps the host HAL from ending the run when idle. */
+static uint32_t m_rand = 0x9E3779B9;
+static volatile uint16_t m_sink;     /**< Keeps the reads from being optimised out. */
+
+
+static uint32_t bench_rand(uint32_t range)
+{
+  m_rand ^= m_rand << 13;
+  m_rand ^= m_rand >> 17;
+  m_rand ^= m_rand << 5;
+  return m_rand % range;
+}
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static void alive_timer_handler(void *p_context)
+{
+  (void)p_context;
+}
+
+/**@brief The loop the lookup replaces: one input read per button.
+ */
+static uint16_t per_pin_read(uint8_t const *pins, uint8_t count)
+{
+  uint16_t value = 0;
+
+  for(uint8_t i = 0; i < count; i++)
+  {
+    value |= hal_gpio_read(pins[i]) ? 0 : (1 << i);
+  }
+  return value;
+}
+
+static void direct_bench(char const *name, uint8_t const *pins, uint8_t count, unsigned scans)
+{
+  button_scan_map_t map[BUTTON_SCAN_MAX_DIRECT];
+  uint64_t t0;
+  uint64_t lut_ns;
+  uint64_t pin_ns;
+
+  for(uint8_t i = 0; i < count; i++)
+  {
+    map[i].pin = pins[i];
+    map[i].bit = i;
+    hal_posix_input_set(pins[i], (i & 1) != 0);
+  }
+  button_scan_init(map, count);
+  if(button_scan_read() != per_pin_read(pins, count))
+  {
+    printf("%s: lookup and per pin read differ\n", name);
+  }
+
+  t0 = host_ns();
+  for(unsigned s = 0; s < scans; s++)
+  {
+    m_sink = button_scan_read();
+  }
+  lut_ns = host_ns() - t0;
+  t0 = host_ns();
+  for(unsigned s = 0; s < scans; s++)
+  {
+    m_sink = per_pin_read(pins, count);
+  }
+  pin_ns = host_ns() - t0;
+  printf("  %-28s %8.1f %8.1f\n", name, (double)lut_ns / scans, (double)pin_ns / scans);
+}
+
+/**@brief Hold a random set of keys, two in one column, and scan it.
+ *
+ * @return keys the set holds, bit r * BENCH_COLS + c.
+ */
+static uint64_t keys_press(void)
+{
+  uint8_t col = (uint8_t)bench_rand(BENCH_COLS);
+  uint8_t row = (uint8_t)bench_rand(BENCH_ROWS);
+  uint8_t other = (uint8_t)((row + 1 + bench_rand(BENCH_ROWS - 1)) % BENCH_ROWS);
+  uint64_t keys = (1ULL << ((row * BENCH_COLS) + col)) | (1ULL << ((other * BENCH_COLS) + col));
+  uint8_t extra = (uint8_t)bench_rand(3);
+
+  for(uint8_t i = 0; i < extra; i++)
+  {
+    keys |= 1ULL << bench_rand(BENCH_ROWS * BENCH_COLS);
+  }
+  for(uint8_t k = 0; k < (BENCH_ROWS * BENCH_COLS); k++)
+  {
+    hal_posix_key_set(m_row_pins[k / BENCH_COLS], m_col_pins[k % BENCH_COLS], (keys >> k) & 1);
+  }
+  return keys;
+}
+
+static void matrix_bench(char const *name, bool push_pull)
+{
+  button_matrix_cfg_t const cfg = {m_row_pins, BENCH_ROWS, m_col_pins, BENCH_COLS};
+  uint32_t shorts = hal_posix_shorts();
+  uint32_t wrong = 0;
+  uint32_t ghosts = 0;
+  uint64_t ns = 0;
+
+  m_rand = 0x9E3779B9;
+  button_matrix_init(&cfg);
+  for(uint8_t r = 0; push_pull && (r < BENCH_ROWS); r++)
+  {
+    hal_gpio_cfg_output(m_row_pins[r]);
+  }
+  for(unsigned s = 0; s < BENCH_SETS; s++)
+  {
+    uint64_t held = keys_press();
+    uint64_t keys = 0;
+    uint64_t t0 = host_ns();
+    bool clean = button_matrix_scan(&keys);
+
+    ns += host_ns() - t0;
+    ghosts += !clean;
+    wrong += clean && (keys != held);
+  }
+  printf("  %-28s %8u %8u %8u %10.1f\n", name, hal_posix_shorts() - shorts, wrong, ghosts, (double)ns / BENCH_SETS);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned scans = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : BENCH_SCANS_DEFAULT;
+
+  hal_init();
+  hal_timer_create(&m_alive_timer_id, HAL_TIMER_REPEATED, alive_timer_handler);
+  hal_timer_start(m_alive_timer_id, 1000, NULL);
+
+  printf("direct scan, %u scans, host ns per scan\n", scans);
+  printf("  %-28s %8s %8s\n", "", "lookup", "per pin");
+  direct_bench("4 buttons, board", m_board_pins, sizeof(m_board_pins), scans);
+  direct_bench("16 buttons, both ports", m_spread_pins, sizeof(m_spread_pins), scans);
+
+  printf("%ux%u matrix, %u sets of held keys, two in one column\n", BENCH_ROWS, BENCH_COLS, BENCH_SETS);
+  printf("  %-28s %8s %8s %8s %10s\n", "rows", "shorts", "wrong", "ghosts", "ns/scan");
+  matrix_bench("open drain (S0D1)", false);
+  matrix_bench("push-pull, idle rows high", true);
+  return 0;
+}
+
+#endif /* BUTTON_SCAN_BENCH */
@@ -0,0 +1,261 @@
+/* Host benchmark of the two dispatch back-ends of state_machine.c.
+ *
+ *   for b in 0 1; do
+ *     gcc -std=gnu99 -O2 -DHAL_POSIX -DFSM_DISPATCH_BENCH_BACKEND=$b -I. -I../State_Machine_Common \
+ *         -c fsm_dispatch_bench.c -o fsm_dispatch_backend$b.o
+ *   done
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DFSM_DISPATCH_BENCH -I. -I../State_Machine_Common fsm_dispatch_bench.c \
+ *       fsm_dispatch_backend0.o fsm_dispatch_backend1.o ../State_Machine_Common/hal_posix.c -o fsm_dispatch_bench
+ *   ./fsm_dispatch_bench [events]
+ *
+ * FSM_DISPATCH_BENCH_BACKEND=n builds the real state_machine.c with
+ * FSM_DISPATCH_COMPUTED_GOTO=n, its public symbols prefixed:
+ *   - switch: a switch on active_state calls the state handler, which
+ *             switches on e->sig (FSM_DISPATCH_COMPUTED_GOTO=0)
+ *   - goto:   one indirect jump through the (state, signal) label table
+ *             (FSM_DISPATCH_COMPUTED_GOTO=1)
+ * Both get the same random signals through the dispatcher of main.c, exit
+ * and entry included. After every event the status, state, LED count and
+ * LED pins must be the same, and so must the display output and the virtual
+ * time the actions spent. Host ns per event include the actions (printf to a
+ * temporary file, the LED writes and the virtual delays), which is what an
+ * event costs; the best of BENCH_ROUNDS runs is kept for each back-end.
+ */
+#if defined(FSM_DISPATCH_BENCH_BACKEND)
+#define FSM_DISPATCH_COMPUTED_GOTO  FSM_DISPATCH_BENCH_BACKEND
+#if (FSM_DISPATCH_BENCH_BACKEND == 0)
+#define fsm_state_machine           switch_fsm_state_machine
+#define fsm_init                    switch_fsm_init
+#define LED_GROUP                   switch_LED_GROUP
+#else
+#define fsm_state_machine           goto_fsm_state_machine
+#define fsm_init                    goto_fsm_init
+#define LED_GROUP                   goto_LED_GROUP
+#endif
+#include "state_machine.c"
+
+#elif defined(FSM_DISPATCH_BENCH)
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "main.h"
+#include "hal.h"
+
+#define BENCH_EVENTS_DEFAULT  1000000UL
+#define BENCH_ROUNDS          3
+
+typedef event_status_t (*fsm_dispatch_t)(app_t *const myApp, event_t const *const e);
+
+typedef struct
+{
+  uint8_t status;
+  uint8_t state;
+  uint8_t leds;
+  uint8_t pins;       /**< LED_ONE..LED_FOUR levels, bit 0 first. */
+}bench_step_t;
+
+typedef struct
+{
+  char const *p_name;
+  fsm_dispatch_t dispatch;
+  void (*init)(app_t *myApp);
+  bench_step_t *p_steps;
+  FILE *p_output;
+  uint64_t ns;
+  uint64_t virtual_us;
+}bench_backend_t;
+
+event_status_t switch_fsm_state_machine(app_t *const myApp, event_t const *const e);
+event_status_t goto_fsm_state_machine(app_t *const myApp, event_t const *const e);
+void switch_fsm_init(app_t *myApp);
+void goto_fsm_init(app_t *myApp);
+
+static uint8_t const m_led_pins[] = {LED_ONE, LED_TWO, LED_THREE, LED_FOUR};
+static fsm_signal_t *m_signals;
+
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/**@brief The dispatcher of main.c, on either back-end.
+ */
+static event_status_t bench_dispatch(fsm_dispatch_t dispatch, app_t *const myApp, event_t const *const e)
+{
+  app_state_t source = myApp->active_state;
+  event_status_t status = dispatch(myApp, e);
+
+  if(status == EVENT_TRANSITION)
+  {
+    app_state_t target = myApp->active_state;
+    event_t ee;
+
+    ee.sig = EXIT;
+    myApp->active_state = source;
+    dispatch(myApp, &ee);
+    ee.sig = ENTRY;
+    myApp->active_state = target;
+    dispatch(myApp, &ee);
+  }
+  return status;
+}
+
+/**@brief One run of the signals, stdout sent to p_output.
+ */
+static void bench_run(bench_backend_t *p_backend, unsigned long events, FILE *p_output)
+{
+  app_t app;
+  int saved = dup(STDOUT_FILENO);
+  uint64_t us = hal_posix_time_us();
+  uint64_t t0;
+
+  fflush(stdout);
+  dup2(fileno(p_output), STDOUT_FILENO);
+  t0 = host_ns();
+  p_backend->init(&app);
+  for(unsigned long n = 0; n < events; n++)
+  {
+    event_t e = {m_signals[n]};
+    bench_step_t *p_step = &p_backend->p_steps[n];
+
+    p_step->status = (uint8_t)bench_dispatch(p_backend->dispatch, &app, &e);
+    p_step->state = (uint8_t)app.active_state;
+    p_step->leds = app.curr_leds;
+    p_step->pins = 0;
+    for(uint8_t i = 0; i < sizeof(m_led_pins); i++)
+    {
+      p_step->pins |= (uint8_t)(hal_posix_output_get(m_led_pins[i]) << i);
+    }
+  }
+  fflush(stdout);
+  t0 = host_ns() - t0;
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+  if((p_backend->ns == 0) || (t0 < p_backend->ns))
+  {
+    p_backend->ns = t0;
+  }
+  p_backend->virtual_us = hal_posix_time_us() - us;
+}
+
+/**@brief Compare the display output of both back-ends.
+ */
+static bool output_same(FILE *p_a, FILE *p_b, long *p_bytes)
+{
+  char a[4096];
+  char b[4096];
+  size_t na;
+  size_t nb;
+
+  *p_bytes = ftell(p_a);
+  if(*p_bytes != ftell(p_b))
+  {
+    return false;
+  }
+  rewind(p_a);
+  rewind(p_b);
+  do
+  {
+    na = fread(a, 1, sizeof(a), p_a);
+    nb = fread(b, 1, sizeof(b), p_b);
+    if((na != nb) || (memcmp(a, b, na) != 0))
+    {
+      return false;
+    }
+  } while(na > 0);
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long events = (argc > 1) ? strtoul(argv[1], NULL, 0) : BENCH_EVENTS_DEFAULT;
+  bench_backend_t backend[] = {
+    {"switch", switch_fsm_state_machine, switch_fsm_init},
+    {"goto", goto_fsm_state_machine, goto_fsm_init}
+  };
+  uint32_t rand = 0x9E3779B9;
+  unsigned long diverged = events;
+  long bytes;
+  bool same_output;
+  bool pass;
+
+  m_signals = malloc(events * sizeof(*m_signals));
+  backend[0].p_steps = malloc(events * sizeof(bench_step_t));
+  backend[1].p_steps = malloc(events * sizeof(bench_step_t));
+  backend[0].p_output = tmpfile();
+  backend[1].p_output = tmpfile();
+  if((m_signals == NULL) || (backend[0].p_steps == NULL) || (backend[1].p_steps == NULL) ||
+     (backend[0].p_output == NULL) || (backend[1].p_output == NULL))
+  {
+    perror("fsm_dispatch_bench");
+    return 1;
+  }
+  for(unsigned long n = 0; n < events; n++)
+  {
+    rand ^= rand << 13;
+    rand ^= rand >> 17;
+    rand ^= rand << 5;
+    m_signals[n] = (fsm_signal_t)(rand % (ABRT + 1));
+  }
+
+  hal_init();
+  for(uint8_t i = 0; i < sizeof(m_led_pins); i++)
+  {
+    hal_gpio_cfg_output(m_led_pins[i]);
+  }
+  for(unsigned r = 0; r < BENCH_ROUNDS; r++)
+  {
+    for(uint8_t b = 0; b < 2; b++)
+    {
+      FILE *p_output = (r == 0) ? backend[b].p_output : tmpfile();
+
+      bench_run(&backend[b], events, p_output);
+      if(r != 0)
+      {
+        fclose(p_output);
+      }
+    }
+  }
+
+  for(unsigned long n = 0; n < events; n++)
+  {
+    if(memcmp(&backend[0].p_steps[n], &backend[1].p_steps[n], sizeof(bench_step_t)) != 0)
+    {
+      diverged = n;
+      break;
+    }
+  }
+  same_output = output_same(backend[0].p_output, backend[1].p_output, &bytes);
+
+  printf("%lu events through state_machine.c, actions included, best of %u\n", events, BENCH_ROUNDS);
+  printf("  %-8s %12s %14s\n", "", "host ns", "virtual ms");
+  printf("  %-8s %12s %14s\n", "", "/event", "per run");
+  for(uint8_t b = 0; b < 2; b++)
+  {
+    printf("  %-8s %12.1f %14.1f\n", backend[b].p_name, (double)backend[b].ns / events,
+           (double)backend[b].virtual_us / 1000);
+  }
+  if(diverged < events)
+  {
+    bench_step_t const *p_s = &backend[0].p_steps[diverged];
+    bench_step_t const *p_g = &backend[1].p_steps[diverged];
+
+    printf("back-ends diverged at event %lu (signal %d): switch status %u state %u leds %u pins %x, "
+           "goto status %u state %u leds %u pins %x\n", diverged, m_signals[diverged], p_s->status, p_s->state,
+           p_s->leds, p_s->pins, p_g->status, p_g->state, p_g->leds, p_g->pins);
+  }
+  printf("state/status sequence %s, display output %s (%ld bytes), virtual time %s\n",
+         (diverged == events) ? "same" : "DIFFERS", same_output ? "same" : "DIFFERS", bytes,
+         (backend[0].virtual_us == backend[1].virtual_us) ? "same" : "DIFFERS");
+
+  pass = (diverged == events) && same_output && (backend[0].virtual_us == backend[1].virtual_us);
+  printf("%s\n", pass ? "ok" : "FAIL");
+  return pass ? 0 : 1;
+}
+
+#endif /* FSM_DISPATCH_BENCH */
@@ -2,26 +2,29 @@
 #include <stdint.h>
 #include <stdio.h>
 #include "main.h"
-#include "nrf_delay.h"
-#include "nrf_gpio.h"
-#include "boards.h"
+#include "button_scan.h"
+#include "hal.h"
 
 
+/* button pin -> bit of btn_pad_value */
+static const button_scan_map_t button_map[] = {
+  {BUTTON_ONE,   3},  // BUTTON_PAD_VALUE_INC_LED
+  {BUTTON_TWO,   2},  // BUTTON_PAD_VALUE_DEC_LED
+  {BUTTON_THREE, 1},  // BUTTON_PAD_VALUE_SP
+  {BUTTON_FOUR,  0}   // BUTTON_PAD_VALUE_ABRT
+};
+
 void fsm_button_init()
 {
-  
- nrf_gpio_cfg_input(BUTTON_ONE, NRF_GPIO_PIN_PULLUP);
- nrf_gpio_cfg_input(BUTTON_TWO, NRF_GPIO_PIN_PULLUP); 
- nrf_gpio_cfg_input(BUTTON_THREE, NRF_GPIO_PIN_PULLUP);
- nrf_gpio_cfg_input(BUTTON_FOUR, NRF_GPIO_PIN_PULLUP);
+  button_scan_init(button_map, sizeof(button_map) / sizeof(button_map[0]));
 }
 
 void fsm_led_init()
 {
-  nrf_gpio_cfg_output(LED_ONE);
-  nrf_gpio_cfg_output(LED_TWO);
-  nrf_gpio_cfg_output(LED_THREE);
-  nrf_gpio_cfg_output(LED_FOUR);
+  hal_gpio_cfg_output(LED_ONE);
+  hal_gpio_cfg_output(LED_TWO);
+  hal_gpio_cfg_output(LED_THREE);
+  hal_gpio_cfg_output(LED_FOUR);
 }
 
 static uint8_t process_btn_pad_value(uint8_t btn_pad_value)
@@ -35,7 +38,7 @@ static uint8_t process_btn_pad_value(uint8_t btn_pad_value)
         if(btn_pad_value)
         {
           btn_sm_state = BOUNCE;
-          nrf_delay_ms(50);
+          hal_delay_ms(50);
         }
       }
       case BOUNCE:
@@ -91,23 +94,18 @@ static void fsm_event_dispatcher(app_t *const myApp, event_t const *const e)
 int main(void) {
 
     static app_t fsm_App;
-    bsp_board_init(BSP_INIT_LEDS);
+    hal_init();
     fsm_button_init();
     fsm_led_init();
     fsm_init(&fsm_App);
 
-    uint8_t b1,b2,b3,b4,btn_pad_value;
+    uint8_t btn_pad_value;
     app_user_event_t ue;
 
     while(true)
     {
-      /* 1. Read the button pad tatus*/
-      b1 = nrf_gpio_pin_read(BUTTON_ONE);
-      b2 = nrf_gpio_pin_read(BUTTON_TWO);
-      b3 = nrf_gpio_pin_read(BUTTON_THREE);
-      b4 = nrf_gpio_pin_read(BUTTON_FOUR);
-
-      btn_pad_value = ((!b1)<<3)|((!b2)<<2)|((!b3)<<1)|(!b4);
+      /* 1. Read the button pad status, one port read */
+      btn_pad_value = (uint8_t)button_scan_read();
       //software button debouncing
       btn_pad_value = process_btn_pad_value(btn_pad_value);
 
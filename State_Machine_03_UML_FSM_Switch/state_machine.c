@@ -1,15 +1,30 @@
 
 #include "main.h"
-#include "boards.h"
-#include "nrf_delay.h"
+#include "hal.h"
 #include <stdio.h>
 
 
+/* Dispatch back-end selection.
+ * 1: labels-as-values jump table indexed by (state, signal), GCC/Clang only.
+ * 0: portable switch on active_state, then switch on e->sig in each handler. */
+#ifndef FSM_DISPATCH_COMPUTED_GOTO
+#if defined(__GNUC__)
+#define FSM_DISPATCH_COMPUTED_GOTO 1
+#else
+#define FSM_DISPATCH_COMPUTED_GOTO 0
+#endif
+#endif
+
+#define FSM_STATE_COUNT   (PAUSE + 1)
+#define FSM_SIGNAL_COUNT  (EXIT + 1)
+
+#if (FSM_DISPATCH_COMPUTED_GOTO == 0)
 // Function prototypes for state handlers
 static event_status_t fsm_state_handler_IDLE(app_t *const myApp, event_t const *const e);
 static event_status_t fsm_state_handler_LED_SET(app_t *const myApp, event_t const *const e);
 static event_status_t fsm_state_handler_BLINK(app_t *const myApp, event_t const *const e);
 static event_status_t fsm_state_handler_PAUSE(app_t *const myApp, event_t const *const e);
+#endif
 static void display_leds(app_t *const myApp);
 static void display_message(char *msg);
 static void display_clear(app_t *const myApp);
@@ -23,8 +38,8 @@ static void display_leds(app_t *const myApp)
   printf("Current LEDs: %d\r\n", myApp->curr_leds);
   for(uint8_t i = 0; i<myApp->curr_leds; i++)
   {
-    nrf_gpio_pin_clear(LED_GROUP[i]);//to turn on the led
-    nrf_delay_ms(50);
+    hal_gpio_clear(LED_GROUP[i]);//to turn on the led
+    hal_delay_ms(50);
   }
 }
 
@@ -38,8 +53,8 @@ static void display_clear(app_t *const myApp)
   printf("Clear led\r\n");
   for(uint8_t i = 0; i<4; i++)
   {
-    nrf_gpio_pin_set(LED_GROUP[i]);//to turn off the led
-    nrf_delay_ms(50);
+    hal_gpio_set(LED_GROUP[i]);//to turn off the led
+    hal_delay_ms(50);
   }
 }
 
@@ -49,18 +64,19 @@ void blink_leds(app_t *const myApp)
   {
     for (int i = 0; i < myApp->curr_leds; i++) 
     {
-      nrf_gpio_pin_clear(LED_GROUP[i]);//to turn on the led
+      hal_gpio_clear(LED_GROUP[i]);//to turn on the led
     }
-    nrf_delay_ms(100); // Wait for the specified time
+    hal_delay_ms(100); // Wait for the specified time
 
     for (int i = 0; i < myApp->curr_leds; i++) 
     {
-      nrf_gpio_pin_set(LED_GROUP[i]);//to turn off the led
+      hal_gpio_set(LED_GROUP[i]);//to turn off the led
     }
-    nrf_delay_ms(100); // Wait for the specified time
+    hal_delay_ms(100); // Wait for the specified time
   }
 }
 
+#if (FSM_DISPATCH_COMPUTED_GOTO == 0)
 static event_status_t fsm_state_handler_IDLE(app_t *const myApp, event_t const *const e)
 {
    switch(e->sig)
@@ -292,6 +308,112 @@ event_status_t fsm_state_machine(app_t *const myApp, event_t const *const e)
    }
 }
 
+#else
+
+/**@brief Direct threaded dispatcher.
+ *
+ * @details One indirect jump on the combined (state, signal) code replaces the
+ *          switch on active_state followed by the switch on e->sig. Every label
+ *          does exactly what the matching case of fsm_state_handler_* does.
+ */
+event_status_t fsm_state_machine(app_t *const myApp, event_t const *const e)
+{
+   static void * const dispatch_table[FSM_STATE_COUNT * FSM_SIGNAL_COUNT] = {
+     /* INC_LED            DEC_LED            START_PAUSE       ABRT               ENTRY               EXIT */
+     &&IDLE_INC_LED,    &&IDLE_DEC_LED,    &&IDLE_SP,        &&IGNORED,         &&IDLE_ENTRY,       &&IDLE_EXIT,
+     &&LED_SET_INC_LED, &&LED_SET_DEC_LED, &&TO_BLINK,       &&TO_IDLE,         &&LED_SET_ENTRY,    &&LED_SET_EXIT,
+     &&IGNORED,         &&IGNORED,         &&TO_PAUSE,       &&TO_IDLE,         &&BLINK_ENTRY,      &&BLINK_EXIT,
+     &&IGNORED,         &&IGNORED,         &&TO_BLINK,       &&TO_IDLE,         &&PAUSE_ENTRY,      &&PAUSE_EXIT
+   };
+   uint32_t code = ((uint32_t)myApp->active_state * FSM_SIGNAL_COUNT) + (uint32_t)e->sig;
+
+   if(code >= (FSM_STATE_COUNT * FSM_SIGNAL_COUNT))
+   {
+     return EVENT_IGNORED;
+   }
+   goto *dispatch_table[code];
+
+IDLE_ENTRY:
+   myApp->curr_leds = 0;
+   display_leds(myApp);
+   display_message("IDLE STATE\r\n");
+   return EVENT_HANDLED;
+
+IDLE_INC_LED:
+IDLE_DEC_LED:
+   myApp->active_state = LED_SET;
+   return EVENT_TRANSITION;
+
+IDLE_SP:
+TO_BLINK:
+   myApp->active_state = BLINK;
+   return EVENT_TRANSITION;
+
+LED_SET_ENTRY:
+   display_leds(myApp);
+   display_message("Set Leds");
+   return EVENT_HANDLED;
+
+LED_SET_INC_LED:
+   if(myApp->curr_leds < 4)
+   {
+     myApp->curr_leds += 1;
+     display_clear(myApp);
+     display_leds(myApp);
+     return EVENT_HANDLED;
+   }
+   return EVENT_IGNORED;
+
+LED_SET_DEC_LED:
+   if(myApp->curr_leds > 0)
+   {
+     myApp->curr_leds -= 1;
+     display_clear(myApp);
+     display_leds(myApp);
+     return EVENT_HANDLED;
+   }
+   return EVENT_IGNORED;
+
+BLINK_ENTRY:
+   if(myApp->curr_leds > 0)
+   {
+     display_leds(myApp);
+     display_message("APPLICATION is blinking LEDs\r\n");
+     blink_leds(myApp);
+     return EVENT_TRANSITION;
+   }
+   return EVENT_IGNORED;
+
+BLINK_EXIT:
+   display_clear(myApp);
+   myApp->active_state = PAUSE;
+   return EVENT_TRANSITION;
+
+TO_PAUSE:
+   myApp->active_state = PAUSE;
+   return EVENT_TRANSITION;
+
+PAUSE_ENTRY:
+   display_leds(myApp);
+   display_message("PAUSE Leds");
+   return EVENT_HANDLED;
+
+TO_IDLE:
+   myApp->active_state = IDLE;
+   return EVENT_TRANSITION;
+
+IDLE_EXIT:
+LED_SET_EXIT:
+PAUSE_EXIT:
+   display_clear(myApp);
+   return EVENT_HANDLED;
+
+IGNORED:
+   return EVENT_IGNORED;
+}
+
+#endif
+
 
 void fsm_init(app_t *myApp)
 {
@@ -302,10 +424,10 @@ void fsm_init(app_t *myApp)
 
   for(uint8_t i = 0; i<10; i++)
   {
-    bsp_board_leds_on();
-    nrf_delay_ms(50);
-    bsp_board_leds_off();
-    nrf_delay_ms(50);
+    hal_board_leds_on();
+    hal_delay_ms(50);
+    hal_board_leds_off();
+    hal_delay_ms(50);
   }
   fsm_state_machine(myApp, &ee);
 }
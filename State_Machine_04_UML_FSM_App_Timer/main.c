@@ -1,12 +1,9 @@
 
 
 #include <stdbool.h>
-#include "nrf.h"
-#include "nrf_drv_gpiote.h"
-#include "app_error.h"
-#include "boards.h"
 #include "main.h"
-#include "nrf_delay.h"
+#include "fsm_admit.h"
+#include "port_input.h"
 
 
 #define BUTTON_COUNT 4
@@ -19,10 +16,10 @@ static uint8_t button_pins[BUTTON_COUNT] = {BUTTON_ONE, BUTTON_TWO, BUTTON_THREE
 
 void fsm_led_init()
 {
-  nrf_gpio_cfg_output(LED_ONE);
-  nrf_gpio_cfg_output(LED_TWO);
-  nrf_gpio_cfg_output(LED_THREE);
-  nrf_gpio_cfg_output(LED_FOUR);
+  hal_gpio_cfg_output(LED_ONE);
+  hal_gpio_cfg_output(LED_TWO);
+  hal_gpio_cfg_output(LED_THREE);
+  hal_gpio_cfg_output(LED_FOUR);
 }
 
 static void fsm_event_dispatcher(app_t *const myApp, event_t const *const e)
@@ -47,13 +44,20 @@ static void fsm_event_dispatcher(app_t *const myApp, event_t const *const e)
     }
 }
 
-void in_pin_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
+void in_pin_handler(hal_pin_t pin, hal_edge_t action)
 {
   app_user_event_t ue;
 
+  /* Bounces and edge storms stop here, before they cost a dispatch */
+  if(!fsm_admit(pin))
+  {
+    return;
+  }
+
   /* 2. Make an event */
   if(action)
   {
+    ue.edge_time = port_input_edge_time(pin);
     if(pin == BUTTON_ONE)
     {
       ue.super.sig = INC_LED;
@@ -82,36 +86,12 @@ void in_pin_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
 
 /**
  * @brief Function for configuring: button pin for input, PIN_OUT pin for output,
- * and configures GPIOTE to give an interrupt on pin change.
+ * and configures the GPIOTE PORT event to give an interrupt on pin change.
  */
 static void gpio_init(void)
 {
-    ret_code_t err_code;
-
-    err_code = nrf_drv_gpiote_init();
-    APP_ERROR_CHECK(err_code);
-
-    nrf_drv_gpiote_in_config_t in_config = GPIOTE_CONFIG_IN_SENSE_HITOLO(true);
-    in_config.pull = NRF_GPIO_PIN_PULLUP;
-
-    for (int i = 0; i < BUTTON_COUNT; ++i) {
-        err_code = nrf_drv_gpiote_in_init(button_pins[i], &in_config, in_pin_handler);
-        APP_ERROR_CHECK(err_code);
-
-        nrf_drv_gpiote_in_event_enable(button_pins[i], true);
-    }
-}
-
-/**@brief Function starting the internal LFCLK oscillator.
- *
- * @details This is needed by RTC1 which is used by the Application Timer
- *          (When SoftDevice is enabled the LFCLK is always running and this is not needed).
- */
-static void lfclk_request(void)
-{
-    ret_code_t err_code = nrf_drv_clock_init();
-    APP_ERROR_CHECK(err_code);
-    nrf_drv_clock_lfclk_request(NULL);
+    fsm_admit_init(button_pins, BUTTON_COUNT);
+    port_input_init(button_pins, BUTTON_COUNT, in_pin_handler);
 }
 
 
@@ -120,16 +100,14 @@ static void lfclk_request(void)
  */
 int main(void)
 {
-    bsp_board_init(BSP_INIT_LEDS);
+    hal_init();
     fsm_led_init();
     fsm_init(&fsm_App);
     gpio_init();
-    lfclk_request();
-    app_timer_init();
 
     while (true)
     {
-        // Do nothing.
+        hal_idle();
     }
 }
 
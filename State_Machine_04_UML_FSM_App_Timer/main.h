@@ -3,12 +3,11 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
-#include "app_timer.h"
-#include "nrf_drv_clock.h"
+#include "hal.h"
 
 
 
-APP_TIMER_DEF(m_repeated_timer_id);     /**< Handler for repeated timer used to blink LED 1. */
+HAL_TIMER_DEF(m_repeated_timer_id);     /**< Handler for repeated timer used to blink LED 1. */
 
 
 /* define leds */
@@ -79,6 +78,7 @@ typedef struct event_tag
 typedef struct
 {
   event_t super;
+  uint32_t edge_time;   /* capture clock (us) of the button edge, see port_input.h */
 }app_user_event_t; 
 
 typedef struct
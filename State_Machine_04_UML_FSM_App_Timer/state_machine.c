@@ -1,7 +1,5 @@
 
 #include "main.h"
-#include "boards.h"
-#include "nrf_delay.h"
 #include <stdio.h>
 
 
@@ -35,19 +33,13 @@ static void repeated_timer_handler(void * p_context)
  */
 static void create_timers(app_t *const myApp)
 {
-    ret_code_t err_code;
-
     // Create timers
-    err_code = app_timer_create(&m_repeated_timer_id,
-                                APP_TIMER_MODE_REPEATED,
-                                repeated_timer_handler);
-    APP_ERROR_CHECK(err_code);
+    hal_timer_create(&m_repeated_timer_id,
+                     HAL_TIMER_REPEATED,
+                     repeated_timer_handler);
 
     // Start timer
-    err_code = app_timer_start(m_repeated_timer_id,
-                                APP_TIMER_TICKS(200),
-                                (void*)myApp );
-    APP_ERROR_CHECK(err_code);
+    hal_timer_start(m_repeated_timer_id, 200, (void*)myApp);
 }
 
 
@@ -56,9 +48,7 @@ static void create_timers(app_t *const myApp)
 static void stop_timers()
 {
   // Stop the repeated timer (stop blinking LED).
-  ret_code_t err_code;
-  err_code = app_timer_stop(m_repeated_timer_id);
-  APP_ERROR_CHECK(err_code);
+  hal_timer_stop(m_repeated_timer_id);
 }
 
 static void display_leds(app_t *const myApp)
@@ -66,8 +56,8 @@ static void display_leds(app_t *const myApp)
   printf("Current LEDs: %d\r\n", myApp->curr_leds);
   for(uint8_t i = 0; i<myApp->curr_leds; i++)
   {
-    nrf_gpio_pin_clear(LED_GROUP[i]);//to turn on the led
-    nrf_delay_ms(50);
+    hal_gpio_clear(LED_GROUP[i]);//to turn on the led
+    hal_delay_ms(50);
   }
 }
 
@@ -81,8 +71,8 @@ static void display_clear(app_t *const myApp)
   printf("Clear led\r\n");
   for(uint8_t i = 0; i<4; i++)
   {
-    nrf_gpio_pin_set(LED_GROUP[i]);//to turn off the led
-    nrf_delay_ms(50);
+    hal_gpio_set(LED_GROUP[i]);//to turn off the led
+    hal_delay_ms(50);
   }
 }
 
@@ -90,7 +80,7 @@ void blink_leds(app_t *const myApp)
 {
   for (int i = 0; i < myApp->curr_leds; i++) 
   {
-    nrf_gpio_pin_toggle(LED_GROUP[i]);//to turn on the led
+    hal_gpio_toggle(LED_GROUP[i]);//to turn on the led
   }
 }
 
@@ -313,10 +303,10 @@ void fsm_init(app_t *myApp)
 
   for(uint8_t i = 0; i<10; i++)
   {
-    bsp_board_leds_on();
-    nrf_delay_ms(50);
-    bsp_board_leds_off();
-    nrf_delay_ms(50);
+    hal_board_leds_on();
+    hal_delay_ms(50);
+    hal_board_leds_off();
+    hal_delay_ms(50);
   }
   (*myApp->active_state)(myApp, &ee); //Jump to the handler
 }
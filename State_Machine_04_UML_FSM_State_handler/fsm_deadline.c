@@ -0,0 +1,237 @@
+
+#include "fsm_deadline.h"
+#include <stdio.h>
+
+#if defined(HAL_POSIX)
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+#else
+#include "nrf.h"
+#include "nrfx_wdt.h"
+#include "app_error.h"
+#endif
+
+
+static fsm_deadline_stats_t m_stats;
+static uint32_t m_budget = FSM_DEADLINE_DEFAULT_BUDGET;
+static uint32_t m_start;
+static volatile bool m_in_dispatch;
+static fsm_deadline_overrun_t m_current;
+static volatile uint32_t m_logged;    /**< Overruns in the log, set once the entry is written. */
+static uint32_t m_reported;           /**< Overruns the main loop has printed or skipped. */
+
+/* Dispatch in flight when the watchdog fired, kept over the reset */
+typedef struct
+{
+  uint32_t magic;
+  fsm_deadline_overrun_t overrun;
+}wdt_trap_t;
+
+
+static void trap_report(fsm_deadline_overrun_t const *p_overrun)
+{
+  printf("Watchdog reset in %s, signal %d after %lu cycles\r\n",
+         fsm_state_name(p_overrun->state),
+         p_overrun->sig,
+         (unsigned long)p_overrun->cycles);
+}
+
+#if defined(HAL_POSIX)
+/* Host build: cycles of virtual time, a handler spends it in delays.
+ * A thread stands in for the watchdog: a dispatch still in flight after
+ * FSM_DEADLINE_WDT_RELOAD_MS of host time is reported as after the reset
+ * and the process ends with FSM_DEADLINE_WDT_EXIT. It watches dispatches
+ * only, the host loop may wait on stdin for longer than that. */
+static wdt_trap_t m_wdt_trap;
+static pthread_t m_monitor;
+
+static uint32_t cycles_now(void)
+{
+  return (uint32_t)(hal_posix_time_us() * (FSM_DEADLINE_CPU_HZ / 1000000));
+}
+
+/**@brief Look at the dispatch in flight four times a reload period.
+ */
+static void * monitor_thread(void *p_arg)
+{
+  uint32_t const period_ms = (FSM_DEADLINE_WDT_RELOAD_MS + 3) / 4;
+  struct timespec const period = {period_ms / 1000, (long)(period_ms % 1000) * 1000000L};
+  uint32_t seen = 0;
+  uint32_t periods = 0;
+
+  (void)p_arg;
+  while(true)
+  {
+    nanosleep(&period, NULL);
+    // the same dispatch in flight since the last look
+    periods = (m_in_dispatch && (m_stats.dispatches == seen)) ? (periods + 1) : 0;
+    seen = m_stats.dispatches;
+    if(periods > 4)
+    {
+      m_wdt_trap.overrun = m_current;
+      m_wdt_trap.overrun.cycles = cycles_now() - m_start;
+      trap_report(&m_wdt_trap.overrun);
+      fflush(stdout);
+      _exit(FSM_DEADLINE_WDT_EXIT);
+    }
+  }
+  return NULL;
+}
+
+void fsm_deadline_init(void)
+{
+  if(pthread_create(&m_monitor, NULL, monitor_thread, NULL) != 0)
+  {
+    printf("Deadline monitor not started\r\n");
+  }
+}
+
+void fsm_deadline_feed(void)
+{
+}
+
+#else
+#define WDT_TRAP_MAGIC  0x57445446UL    /* "WDTF" */
+
+static wdt_trap_t m_wdt_trap __attribute__((section(".non_init")));
+static nrfx_wdt_channel_id m_channel_id;
+
+static uint32_t cycles_now(void)
+{
+  return DWT->CYCCNT;
+}
+
+/**@brief Watchdog timeout, the chip resets two 32 kHz cycles later.
+ *
+ * @details Runs above the GPIOTE priority, so it preempts a stuck dispatch and
+ *          can record which state/signal was running.
+ */
+static void wdt_event_handler(void)
+{
+  if(m_in_dispatch)
+  {
+    m_wdt_trap.overrun = m_current;
+    m_wdt_trap.overrun.cycles = cycles_now() - m_start;
+    m_wdt_trap.magic = WDT_TRAP_MAGIC;
+  }
+  while(true)
+  {
+    // wait for the reset
+  }
+}
+
+void fsm_deadline_init(void)
+{
+  nrfx_err_t err_code;
+  nrfx_wdt_config_t config = NRFX_WDT_DEAFULT_CONFIG;
+
+  if(m_wdt_trap.magic == WDT_TRAP_MAGIC)
+  {
+    trap_report(&m_wdt_trap.overrun);
+  }
+  m_wdt_trap.magic = 0;
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  config.reload_value = FSM_DEADLINE_WDT_RELOAD_MS;
+  err_code = nrfx_wdt_init(&config, wdt_event_handler);
+  APP_ERROR_CHECK(err_code);
+  err_code = nrfx_wdt_channel_alloc(&m_channel_id);
+  APP_ERROR_CHECK(err_code);
+  nrfx_wdt_enable();
+}
+
+/**@brief Feed the watchdog from the thread-mode loop.
+ *
+ * @details Dispatches run in the GPIOTE interrupt, so this only runs between
+ *          them: a dispatch that never completes starves it.
+ */
+void fsm_deadline_feed(void)
+{
+  if(!m_in_dispatch)
+  {
+    nrfx_wdt_channel_feed(m_channel_id);
+  }
+}
+#endif
+
+void fsm_deadline_budget_set(uint32_t cycles)
+{
+  m_budget = cycles;
+}
+
+/**@brief Called by the dispatcher before the handler runs.
+ */
+void fsm_deadline_begin(app_state_t state, fsm_signal_t sig)
+{
+  m_current.state = state;
+  m_current.sig = sig;
+  m_start = cycles_now();
+  m_in_dispatch = true;
+}
+
+/**@brief Called by the dispatcher once exit and entry actions are done.
+ *
+ * @details Runs in the GPIOTE interrupt, an overrun is only logged here and
+ *          printed by fsm_deadline_report() from the main loop.
+ */
+void fsm_deadline_end(void)
+{
+  uint32_t cycles = cycles_now() - m_start;
+
+  m_in_dispatch = false;
+  m_stats.dispatches++;
+  if(cycles > m_stats.max_cycles)
+  {
+    m_stats.max_cycles = cycles;
+  }
+  if(cycles > m_budget)
+  {
+    m_current.cycles = cycles;
+    m_stats.log[m_stats.overruns % FSM_DEADLINE_LOG_SIZE] = m_current;
+    m_stats.overruns++;
+    m_logged = m_stats.overruns;
+  }
+}
+
+/**@brief Print the overruns logged since the last call, from the main loop.
+ *
+ * @details Overruns the circular log dropped before they were printed are
+ *          only counted. An entry overwritten while it is copied is dropped
+ *          the same way on the next call.
+ *
+ * @return Overruns printed.
+ */
+uint32_t fsm_deadline_report(void)
+{
+  uint32_t printed = 0;
+  uint32_t logged = m_logged;
+
+  if((logged - m_reported) > FSM_DEADLINE_LOG_SIZE)
+  {
+    printf("Deadline overruns not logged: %lu\r\n", (unsigned long)(logged - m_reported - FSM_DEADLINE_LOG_SIZE));
+    m_reported = logged - FSM_DEADLINE_LOG_SIZE;
+  }
+  while(m_reported != logged)
+  {
+    fsm_deadline_overrun_t overrun = m_stats.log[m_reported % FSM_DEADLINE_LOG_SIZE];
+
+    if((m_logged - m_reported) > FSM_DEADLINE_LOG_SIZE)
+    {
+      break;
+    }
+    printf("Deadline overrun: %s signal %d took %lu cycles\r\n",
+           fsm_state_name(overrun.state), overrun.sig, (unsigned long)overrun.cycles);
+    m_reported++;
+    printed++;
+  }
+  return printed;
+}
+
+fsm_deadline_stats_t const * fsm_deadline_stats_get(void)
+{
+  return &m_stats;
+}
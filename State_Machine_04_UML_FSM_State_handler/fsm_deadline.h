@@ -0,0 +1,52 @@
+#ifndef FSM_DEADLINE_H
+#define FSM_DEADLINE_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "main.h"
+
+
+#define FSM_DEADLINE_CPU_HZ           64000000UL
+
+/* Run-to-completion budget of one dispatch, in CPU cycles (DWT->CYCCNT) */
+#define FSM_DEADLINE_DEFAULT_BUDGET   (FSM_DEADLINE_CPU_HZ / 2)   /* 500 ms */
+
+/* Watchdog reload; only the thread-mode loop feeds it, so a dispatch that
+ * blocks the GPIOTE interrupt longer than this resets the chip */
+#ifndef FSM_DEADLINE_WDT_RELOAD_MS
+#define FSM_DEADLINE_WDT_RELOAD_MS    30000
+#endif
+
+#define FSM_DEADLINE_LOG_SIZE         8
+
+#if defined(HAL_POSIX)
+/* Exit status of the host stand-in for the watchdog reset, see fsm_deadline.c */
+#define FSM_DEADLINE_WDT_EXIT         3
+#endif
+
+/* One budget overrun */
+typedef struct
+{
+  app_state_t state;
+  fsm_signal_t sig;
+  uint32_t cycles;
+}fsm_deadline_overrun_t;
+
+typedef struct
+{
+  uint32_t dispatches;
+  uint32_t overruns;
+  uint32_t max_cycles;
+  fsm_deadline_overrun_t log[FSM_DEADLINE_LOG_SIZE];   /* latest overruns, circular */
+}fsm_deadline_stats_t;
+
+
+void fsm_deadline_init(void);
+void fsm_deadline_budget_set(uint32_t cycles);
+void fsm_deadline_begin(app_state_t state, fsm_signal_t sig);
+void fsm_deadline_end(void);
+void fsm_deadline_feed(void);
+uint32_t fsm_deadline_report(void);
+fsm_deadline_stats_t const * fsm_deadline_stats_get(void);
+
+
+#endif
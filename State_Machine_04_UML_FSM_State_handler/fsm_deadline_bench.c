@@ -0,0 +1,169 @@
+/* Host regression of fsm_deadline.c.
+ *
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DFSM_DEADLINE_BENCH -DFSM_DEADLINE_WDT_RELOAD_MS=200 -I. \
+ *       -I../State_Machine_Common fsm_deadline_bench.c fsm_deadline.c state_machine.c \
+ *       ../State_Machine_Common/hal_posix.c -o fsm_deadline_bench -lpthread
+ *   ./fsm_deadline_bench [dispatches]
+ *
+ * Overruns: dispatches delay in virtual time, most well inside a budget of
+ * BENCH_BUDGET_US, one in BENCH_LONG three budgets long. The main loop
+ * stand-in reports every BENCH_REPORT_EVERY dispatches, one stretch runs
+ * more overruns than the log holds. Every long dispatch and nothing else
+ * must be counted, every overrun printed by fsm_deadline_report() or, past
+ * the log size between two reports, counted as not logged, and the log
+ * must hold the state and signal of the last.
+ *
+ * Watchdog: a child process begins a dispatch that never ends. The monitor
+ * thread must end it with FSM_DEADLINE_WDT_EXIT between one and two reload
+ * periods later and report the state and signal in flight.
+ */
+#if defined(FSM_DEADLINE_BENCH)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "fsm_deadline.h"
+#include "hal.h"
+
+#define BENCH_DISPATCHES_DEFAULT  1024
+#define BENCH_BUDGET_US           200
+#define BENCH_LONG                64
+#define BENCH_REPORT_EVERY        32
+#define BENCH_BURST               (FSM_DEADLINE_LOG_SIZE + 3)   /* overruns between two reports */
+
+static uint32_t m_rand = 0x9E3779B9;
+
+
+static uint32_t bench_rand(uint32_t range)
+{
+  m_rand ^= m_rand << 13;
+  m_rand ^= m_rand >> 17;
+  m_rand ^= m_rand << 5;
+  return m_rand % range;
+}
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/**@brief A dispatch that takes us of virtual time.
+ */
+static void dispatch(app_state_t state, fsm_signal_t sig, uint32_t us)
+{
+  fsm_deadline_begin(state, sig);
+  hal_delay_us(us);
+  fsm_deadline_end();
+}
+
+/**@brief Run a dispatch that never ends in a child, the monitor has to end it.
+ *
+ * @return True if it did, in time, with the state and signal in flight.
+ */
+static bool watchdog_check(app_state_t state, char const *p_name)
+{
+  int pipe_fd[2];
+  char out[128] = {0};
+  char expect[64];
+  uint64_t t0 = host_ns();
+  double ms;
+  ssize_t n;
+  int status;
+  pid_t pid;
+
+  if(pipe(pipe_fd) != 0)
+  {
+    return false;
+  }
+  fflush(stdout);
+  pid = fork();
+  if(pid == 0)
+  {
+    dup2(pipe_fd[1], STDOUT_FILENO);
+    alarm(1 + ((4 * FSM_DEADLINE_WDT_RELOAD_MS) / 1000));   // no monitor: fail, do not hang
+    fsm_deadline_init();
+    fsm_deadline_begin(state, START_PAUSE);
+    while(true)
+    {
+      // stuck handler
+    }
+  }
+  close(pipe_fd[1]);
+  waitpid(pid, &status, 0);
+  ms = (double)(host_ns() - t0) / 1e6;
+  n = read(pipe_fd[0], out, sizeof(out) - 1);
+  close(pipe_fd[0]);
+  out[(n > 0) ? n : 0] = 0;
+  snprintf(expect, sizeof(expect), "Watchdog reset in %s, signal %d", p_name, START_PAUSE);
+
+  printf("watchdog, reload %u ms: ended after %.0f ms, exit %d, \"%.*s\"\n", FSM_DEADLINE_WDT_RELOAD_MS, ms,
+         WIFEXITED(status) ? WEXITSTATUS(status) : -1, (int)strcspn(out, "\r\n"), out);
+  return WIFEXITED(status) && (WEXITSTATUS(status) == FSM_DEADLINE_WDT_EXIT) &&
+         (ms >= FSM_DEADLINE_WDT_RELOAD_MS) && (ms < (2 * FSM_DEADLINE_WDT_RELOAD_MS)) &&
+         (strncmp(out, expect, strlen(expect)) == 0);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned dispatches = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : BENCH_DISPATCHES_DEFAULT;
+  fsm_deadline_stats_t const *p_stats = fsm_deadline_stats_get();
+  fsm_deadline_overrun_t last = {0};
+  app_t app;
+  uint32_t longs = 0;
+  uint32_t printed = 0;
+  uint32_t lost = 0;
+  uint32_t lost_expected = 0;
+  uint32_t reported = 0;
+  bool log_ok;
+  bool pass;
+
+  hal_init();
+  fsm_init(&app);
+  fsm_deadline_budget_set(BENCH_BUDGET_US * (FSM_DEADLINE_CPU_HZ / 1000000));
+
+  for(unsigned d = 0; d < dispatches; d++)
+  {
+    fsm_signal_t sig = (fsm_signal_t)bench_rand(ABRT + 1);
+    unsigned burst_start = (dispatches / 2) - ((dispatches / 2) % BENCH_REPORT_EVERY);
+    bool burst = (d >= burst_start) && (d < (burst_start + BENCH_BURST));
+    bool slow = burst || (bench_rand(BENCH_LONG) == 0);
+
+    dispatch(app.active_state, sig, slow ? (3 * BENCH_BUDGET_US) : (BENCH_BUDGET_US / 10));
+    if(slow)
+    {
+      last.state = app.active_state;
+      last.sig = sig;
+      longs++;
+    }
+    if((((d + 1) % BENCH_REPORT_EVERY) == 0) || ((d + 1) == dispatches))
+    {
+      uint32_t window = p_stats->overruns - reported;
+
+      lost_expected += (window > FSM_DEADLINE_LOG_SIZE) ? (window - FSM_DEADLINE_LOG_SIZE) : 0;
+      reported = p_stats->overruns;
+      printed += fsm_deadline_report();
+    }
+  }
+  lost = p_stats->overruns - printed;
+  log_ok = (p_stats->log[(p_stats->overruns - 1) % FSM_DEADLINE_LOG_SIZE].state == last.state) &&
+           (p_stats->log[(p_stats->overruns - 1) % FSM_DEADLINE_LOG_SIZE].sig == last.sig);
+
+  printf("%u dispatches, budget %u us, %u of them %u us, %u in one stretch between reports\n", dispatches,
+         BENCH_BUDGET_US, longs, 3 * BENCH_BUDGET_US, BENCH_BURST);
+  printf("overruns %u, printed from the loop %u, not logged %u (%u expected), max %lu cycles, last logged %s\n",
+         p_stats->overruns, printed, lost, lost_expected, (unsigned long)p_stats->max_cycles,
+         log_ok ? "right" : "WRONG");
+
+  pass = (p_stats->overruns == longs) && (lost == lost_expected) && (lost >= (BENCH_BURST - FSM_DEADLINE_LOG_SIZE)) &&
+         log_ok && (fsm_deadline_report() == 0);
+  pass = watchdog_check(app.active_state, fsm_state_name(app.active_state)) && pass;
+  printf("%s\n", pass ? "ok" : "FAIL");
+  return pass ? 0 : 1;
+}
+
+#endif /* FSM_DEADLINE_BENCH */
@@ -74,6 +74,7 @@ typedef struct event_tag
 typedef struct
 {
   event_t super;
+  uint32_t edge_time;   /* capture clock (us) of the button edge, see port_input.h */
 }app_user_event_t; 
 
 typedef struct
@@ -90,6 +91,7 @@ void fsm_init(app_t *myApp);
 void fsm_button_init();
 void fsm_led_init();
 event_status_t fsm_state_machine(app_t *const myApp, event_t const *const e);
+char const * fsm_state_name(app_state_t state);
 
 
 
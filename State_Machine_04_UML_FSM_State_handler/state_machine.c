@@ -1,7 +1,6 @@
 
 #include "main.h"
-#include "boards.h"
-#include "nrf_delay.h"
+#include "hal.h"
 #include <stdio.h>
 
 
@@ -27,8 +26,8 @@ static void display_leds(app_t *const myApp)
   printf("Current LEDs: %d\r\n", myApp->curr_leds);
   for(uint8_t i = 0; i<myApp->curr_leds; i++)
   {
-    nrf_gpio_pin_clear(LED_GROUP[i]);//to turn on the led
-    nrf_delay_ms(50);
+    hal_gpio_clear(LED_GROUP[i]);//to turn on the led
+    hal_delay_ms(50);
   }
 }
 
@@ -42,8 +41,8 @@ static void display_clear(app_t *const myApp)
   printf("Clear led\r\n");
   for(uint8_t i = 0; i<4; i++)
   {
-    nrf_gpio_pin_set(LED_GROUP[i]);//to turn off the led
-    nrf_delay_ms(50);
+    hal_gpio_set(LED_GROUP[i]);//to turn off the led
+    hal_delay_ms(50);
   }
 }
 
@@ -53,15 +52,15 @@ void blink_leds(app_t *const myApp)
   {
     for (int i = 0; i < myApp->curr_leds; i++) 
     {
-      nrf_gpio_pin_clear(LED_GROUP[i]);//to turn on the led
+      hal_gpio_clear(LED_GROUP[i]);//to turn on the led
     }
-    nrf_delay_ms(100); // Wait for the specified time
+    hal_delay_ms(100); // Wait for the specified time
 
     for (int i = 0; i < myApp->curr_leds; i++) 
     {
-      nrf_gpio_pin_set(LED_GROUP[i]);//to turn off the led
+      hal_gpio_set(LED_GROUP[i]);//to turn off the led
     }
-    nrf_delay_ms(100); // Wait for the specified time
+    hal_delay_ms(100); // Wait for the specified time
   }
 }
 
@@ -281,10 +280,20 @@ void fsm_init(app_t *myApp)
 
   for(uint8_t i = 0; i<10; i++)
   {
-    bsp_board_leds_on();
-    nrf_delay_ms(50);
-    bsp_board_leds_off();
-    nrf_delay_ms(50);
+    hal_board_leds_on();
+    hal_delay_ms(50);
+    hal_board_leds_off();
+    hal_delay_ms(50);
   }
   (*myApp->active_state)(myApp, &ee); //Jump to the handler
 }
+
+/* Handlers are anonymous pointers, map them back for diagnostics */
+char const * fsm_state_name(app_state_t state)
+{
+  if(state == IDLE)    return "IDLE";
+  if(state == LED_SET) return "LED_SET";
+  if(state == BLINK)   return "BLINK";
+  if(state == PAUSE)   return "PAUSE";
+  return "?";
+}
@@ -0,0 +1,83 @@
+#ifndef APP_FSM_HPP
+#define APP_FSM_HPP
+/* The IDLE/LED_SET/BLINK/PAUSE machine of 04/05 declared with fsm.hpp.
+ *
+ * Outputs go through the app_fsm_* hooks of app_fsm_port.h. app_fsm_port.c
+ * implements them on the LED bank and a hal timer, on the target and on the
+ * host. Digital twins and benches define their own.
+ */
+#include "fsm.hpp"
+#include "app_fsm_port.h"
+
+namespace app
+{
+
+enum class state : uint8_t
+{
+  IDLE,
+  LED_SET,
+  BLINK,
+  PAUSE,
+  count
+};
+
+enum class signal : uint8_t
+{
+  INC_LED,
+  DEC_LED,
+  START_PAUSE,
+  ABRT,
+  count
+};
+
+constexpr uint8_t max_leds = 4;
+
+struct context
+{
+  state active_state;
+  uint8_t curr_leds;
+};
+
+/* guards */
+inline bool has_leds(context const &c) { return c.curr_leds > 0; }
+inline bool below_max(context const &c) { return c.curr_leds < max_leds; }
+
+/* actions */
+inline void inc_led(context &c) { c.curr_leds++; app_fsm_display_leds(c.curr_leds); }
+inline void dec_led(context &c) { c.curr_leds--; app_fsm_display_leds(c.curr_leds); }
+
+/* entry/exit */
+inline void show(context &c) { app_fsm_display_leds(c.curr_leds); }
+inline void clear(context &) { app_fsm_display_clear(); }
+inline void blink_entry(context &c) { app_fsm_display_leds(c.curr_leds); app_fsm_blink_start(); }
+inline void blink_exit(context &) { app_fsm_blink_stop(); app_fsm_display_clear(); }
+
+using machine = fsm::machine<
+  context, state, signal,
+  fsm::states<
+    fsm::state<state::IDLE,    &show,        &clear>,
+    fsm::state<state::LED_SET, &show,        &clear>,
+    fsm::state<state::BLINK,   &blink_entry, &blink_exit>,
+    fsm::state<state::PAUSE,   &show,        &clear>
+  >,
+  fsm::rows<
+    fsm::row<state::IDLE, signal::INC_LED, state::LED_SET>,
+    fsm::row<state::IDLE, signal::DEC_LED, state::LED_SET>,
+    fsm::row<state::IDLE, signal::START_PAUSE, state::BLINK, &has_leds>,
+
+    fsm::internal_row<state::LED_SET, signal::INC_LED, &below_max, &inc_led>,
+    fsm::internal_row<state::LED_SET, signal::DEC_LED, &has_leds, &dec_led>,
+    fsm::row<state::LED_SET, signal::START_PAUSE, state::BLINK>,
+    fsm::row<state::LED_SET, signal::ABRT, state::IDLE>,
+
+    fsm::row<state::BLINK, signal::START_PAUSE, state::PAUSE>,
+    fsm::row<state::BLINK, signal::ABRT, state::IDLE>,
+
+    fsm::row<state::PAUSE, signal::START_PAUSE, state::BLINK>,
+    fsm::row<state::PAUSE, signal::ABRT, state::IDLE>
+  >
+>;
+
+} // namespace app
+
+#endif
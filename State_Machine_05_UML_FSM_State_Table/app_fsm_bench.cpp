@@ -0,0 +1,62 @@
+/* The app_fsm.hpp machine as two more variants of fsm_transition_bench.c.
+ *
+ *   g++ -std=c++17 -O2 -c -DFSM_TRANSITION_BENCH_CPP app_fsm_bench.cpp
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DFSM_TRANSITION_BENCH -DFSM_TRANSITION_BENCH_CPP -I. -I../State_Machine_Common \
+ *       fsm_transition_bench.c fsm_transition.c fsm_log.c ../State_Machine_Common/hal_posix.c app_fsm_bench.o \
+ *       -o fsm_transition_bench
+ *   ./fsm_transition_bench [events]
+ *
+ * The hooks count into a sink, like the output-free handlers of the C
+ * variants, and the signals are the same ring, so the five variants walk
+ * the same states at the same cost per action:
+ *   - table:  machine::dispatch, one indirect call per event
+ *   - static: machine::dispatch_static, every cell inlined into the loop
+ *
+ * Code size, the C handlers against the C++ cells, from the same objects
+ * built with -Os:
+ *   gcc ... -Os -c fsm_transition_bench.c && g++ ... -Os -c app_fsm_bench.cpp
+ *   nm -S -C --size-sort fsm_transition_bench.o app_fsm_bench.o
+ * app_fsm_bench_table brings the cell<S, G> functions and the table with it,
+ * app_fsm_bench_static is self-contained.
+ */
+#if defined(FSM_TRANSITION_BENCH_CPP)
+#include "app_fsm.hpp"
+
+static volatile uint32_t m_sink;
+
+extern "C" {
+
+void app_fsm_display_leds(uint8_t) { m_sink++; }
+void app_fsm_display_clear(void) { m_sink++; }
+void app_fsm_blink_start(void) { m_sink++; }
+void app_fsm_blink_stop(void) { m_sink++; }
+
+/**@brief Dispatch p_signals[n & mask], app::signal values, for n < events.
+ *
+ * @return active_state << 8 | curr_leds, as run() of fsm_transition_bench.c.
+ */
+uint32_t app_fsm_bench_table(uint8_t const *p_signals, uint32_t mask, unsigned long events)
+{
+  app::context ctx{app::state::IDLE, 0};
+
+  for(unsigned long n = 0; n < events; n++)
+  {
+    (void)app::machine::dispatch(ctx, static_cast<app::signal>(p_signals[n & mask]));
+  }
+  return (static_cast<uint32_t>(ctx.active_state) << 8) | ctx.curr_leds;
+}
+
+uint32_t app_fsm_bench_static(uint8_t const *p_signals, uint32_t mask, unsigned long events)
+{
+  app::context ctx{app::state::IDLE, 0};
+
+  for(unsigned long n = 0; n < events; n++)
+  {
+    (void)app::machine::dispatch_static(ctx, static_cast<app::signal>(p_signals[n & mask]));
+  }
+  return (static_cast<uint32_t>(ctx.active_state) << 8) | ctx.curr_leds;
+}
+
+}
+
+#endif /* FSM_TRANSITION_BENCH_CPP */
@@ -0,0 +1,47 @@
+#include "app_fsm_port.h"
+#include <stddef.h>
+#include "hal.h"
+#include "led_bank.h"
+
+
+HAL_TIMER_DEF(m_blink_timer_id);
+static uint8_t m_shown;       /**< LEDs of the last display, the ones that blink. */
+
+
+static void blink_timer_handler(void *p_context)
+{
+  (void)p_context;
+  led_bank_toggle_count(m_shown);
+}
+
+/**@brief Create the blink timer, before the machine enters its first state.
+ */
+void app_fsm_port_init(void)
+{
+  m_shown = 0;
+  hal_timer_create(&m_blink_timer_id, HAL_TIMER_REPEATED, blink_timer_handler);
+}
+
+void app_fsm_display_leds(uint8_t curr_leds)
+{
+  m_shown = curr_leds;
+  led_bank_show_count(curr_leds);
+}
+
+void app_fsm_display_clear(void)
+{
+  m_shown = 0;
+  led_bank_show_count(0);
+}
+
+/**@brief Blink the LEDs shown last, BLINK is entered with them on.
+ */
+void app_fsm_blink_start(void)
+{
+  hal_timer_start(m_blink_timer_id, APP_FSM_PORT_BLINK_MS, NULL);
+}
+
+void app_fsm_blink_stop(void)
+{
+  hal_timer_stop(m_blink_timer_id);
+}
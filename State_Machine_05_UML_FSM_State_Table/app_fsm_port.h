@@ -0,0 +1,27 @@
+#ifndef APP_FSM_PORT_H
+#define APP_FSM_PORT_H
+#include <stdint.h>
+
+
+/* Outputs of the app_fsm.hpp machine, on the LED bank the application has
+ * initialised and a repeated hal timer. The same file builds for the target
+ * and for -DHAL_POSIX. */
+
+#define APP_FSM_PORT_BLINK_MS   200   /* BLINK_PERIOD_MS of state_machine.c */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void app_fsm_port_init(void);
+void app_fsm_display_leds(uint8_t curr_leds);
+void app_fsm_display_clear(void);
+void app_fsm_blink_start(void);
+void app_fsm_blink_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
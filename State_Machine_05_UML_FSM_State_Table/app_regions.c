@@ -0,0 +1,211 @@
+
+#include "app_regions.h"
+#include "fsm_region.h"
+#include "fsm_persist.h"
+#include "led_bank.h"
+#include "fsm_latency.h"
+#include "fsm_log.h"
+#include "fsm_event.h"
+
+#if FSM_ORTHOGONAL_REGIONS
+
+
+static void display_leds(app_t *const myApp)
+{
+  FSM_LOG1(CURRENT_LEDS, myApp->curr_leds);
+  led_bank_show_count(myApp->curr_leds);
+  fsm_latency_mark(FSM_LAT_OUTPUT);
+}
+
+/**@brief Timeout handler for the repeated timer, blinks the LEDs of the current count.
+ */
+static void repeated_timer_handler(void * p_context)
+{
+  app_t * myApp = (app_t *)p_context;
+  led_bank_toggle_count(myApp->curr_leds);
+}
+
+
+/* EDIT region: LED count editing */
+static event_status_t EDIT_IDLE_ENTRY(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(EDIT_IDLE_ENTRY);
+  return EVENT_HANDLED;
+}
+
+static event_status_t EDIT_IDLE_INC_DEC(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(EDIT_IDLE_INC_DEC);
+  region->active_state = EDIT_SET;
+  return EVENT_TRANSITION;
+}
+
+static event_status_t EDIT_SET_ENTRY(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(EDIT_SET_ENTRY);
+  display_leds(myApp);
+  return EVENT_HANDLED;
+}
+
+static event_status_t EDIT_SET_INC_LED(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(EDIT_SET_INC_LED);
+  if(myApp->curr_leds < LED_COUNT)
+  {
+    myApp->curr_leds += fsm_led_step(FSM_EVENT_PAYLOAD(e, INC_LED), LED_COUNT - myApp->curr_leds);
+    display_leds(myApp);
+    return EVENT_HANDLED;
+  }
+  return EVENT_IGNORED;
+}
+
+static event_status_t EDIT_SET_DEC_LED(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(EDIT_SET_DEC_LED);
+  if(myApp->curr_leds > 0)
+  {
+    myApp->curr_leds -= fsm_led_step(FSM_EVENT_PAYLOAD(e, DEC_LED), myApp->curr_leds);
+    display_leds(myApp);
+    return EVENT_HANDLED;
+  }
+  return EVENT_IGNORED;
+}
+
+static event_status_t EDIT_SET_ABRT(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(EDIT_SET_ABRT);
+  region->active_state = EDIT_IDLE;
+  return EVENT_TRANSITION;
+}
+
+
+/* BLINKER region: blink control */
+static event_status_t BLINKER_OFF_ENTRY(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(BLINKER_OFF_ENTRY);
+  display_leds(myApp);
+  return EVENT_HANDLED;
+}
+
+static event_status_t BLINKER_OFF_START_PAUSE(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(BLINKER_OFF_START_PAUSE);
+  if(myApp->curr_leds > 0)
+  {
+    region->active_state = BLINKER_ON;
+    return EVENT_TRANSITION;
+  }
+  return EVENT_IGNORED;
+}
+
+static event_status_t BLINKER_ON_ENTRY(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(BLINKER_ON_ENTRY);
+  hal_timer_start(m_repeated_timer_id, 200, (void*)myApp);
+  return EVENT_HANDLED;
+}
+
+static event_status_t BLINKER_ON_EXIT(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(BLINKER_ON_EXIT);
+  hal_timer_stop(m_repeated_timer_id);
+  return EVENT_HANDLED;
+}
+
+static event_status_t BLINKER_ON_START_PAUSE(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(BLINKER_ON_START_PAUSE);
+  region->active_state = BLINKER_PAUSED;
+  return EVENT_TRANSITION;
+}
+
+static event_status_t BLINKER_PAUSED_ENTRY(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(BLINKER_PAUSED_ENTRY);
+  display_leds(myApp);
+  return EVENT_HANDLED;
+}
+
+static event_status_t BLINKER_PAUSED_START_PAUSE(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(BLINKER_PAUSED_START_PAUSE);
+  region->active_state = BLINKER_ON;
+  return EVENT_TRANSITION;
+}
+
+static event_status_t BLINKER_ABRT(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  FSM_LOG0(BLINKER_ABRT);
+  region->active_state = BLINKER_OFF;
+  return EVENT_TRANSITION;
+}
+
+
+/* NULL cells are not handled by the state, a signal no state handles is
+ * never offered to the region */
+static r_handler_t const edit_table[EDIT_STATES][MAX_SIGNALS] = {
+  [EDIT_IDLE] = {[ENTRY] = &EDIT_IDLE_ENTRY, [INC_LED] = &EDIT_IDLE_INC_DEC, [DEC_LED] = &EDIT_IDLE_INC_DEC},
+  [EDIT_SET] = {[ENTRY] = &EDIT_SET_ENTRY, [INC_LED] = &EDIT_SET_INC_LED, [DEC_LED] = &EDIT_SET_DEC_LED, [ABRT] = &EDIT_SET_ABRT}
+};
+
+static r_handler_t const blinker_table[BLINKER_STATES][MAX_SIGNALS] = {
+  [BLINKER_OFF] = {[ENTRY] = &BLINKER_OFF_ENTRY, [START_PAUSE] = &BLINKER_OFF_START_PAUSE},
+  [BLINKER_ON] = {[ENTRY] = &BLINKER_ON_ENTRY, [EXIT] = &BLINKER_ON_EXIT, [START_PAUSE] = &BLINKER_ON_START_PAUSE, [ABRT] = &BLINKER_ABRT},
+  [BLINKER_PAUSED] = {[ENTRY] = &BLINKER_PAUSED_ENTRY, [START_PAUSE] = &BLINKER_PAUSED_START_PAUSE, [ABRT] = &BLINKER_ABRT}
+};
+
+
+/**@brief Set active_state to the single machine state the regions correspond
+ * to, persistence, the link and traces keep working on it.
+ */
+void app_regions_project(app_t *const myApp)
+{
+  switch(myApp->region[APP_REGION_BLINKER].active_state)
+  {
+    case BLINKER_ON:
+      myApp->active_state = BLINK;
+      break;
+    case BLINKER_PAUSED:
+      myApp->active_state = PAUSE;
+      break;
+    default:
+      myApp->active_state = (myApp->region[APP_REGION_EDIT].active_state == EDIT_SET) ? LED_SET : IDLE;
+      break;
+  }
+}
+
+/**@brief Build the regions, resume from the last snapshot and enter the initial states.
+ */
+void app_regions_init(app_t *const myApp)
+{
+  uint8_t edit = EDIT_IDLE;
+  uint8_t blinker = BLINKER_OFF;
+
+  myApp->active_state = IDLE;
+  myApp->curr_leds = 0;
+  fsm_persist_restore(myApp);
+  if(myApp->active_state == LED_SET)
+  {
+    edit = EDIT_SET;
+  }
+  else if(myApp->active_state == BLINK)
+  {
+    blinker = BLINKER_ON;
+  }
+  else if(myApp->active_state == PAUSE)
+  {
+    blinker = BLINKER_PAUSED;
+  }
+
+  hal_timer_create(&m_repeated_timer_id, HAL_TIMER_REPEATED, repeated_timer_handler);
+  myApp->num_regions = APP_REGIONS;
+  fsm_region_init(&myApp->region[APP_REGION_EDIT], &edit_table[0][0], EDIT_STATES, edit);
+  fsm_region_init(&myApp->region[APP_REGION_BLINKER], &blinker_table[0][0], BLINKER_STATES, blinker);
+  for(uint8_t i = 0; i < myApp->num_regions; i++)
+  {
+    fsm_region_enter(myApp, &myApp->region[i]);
+  }
+  app_regions_project(myApp);
+}
+
+#endif /* FSM_ORTHOGONAL_REGIONS */
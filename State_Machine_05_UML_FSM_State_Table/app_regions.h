@@ -0,0 +1,38 @@
+#ifndef APP_REGIONS_H
+#define APP_REGIONS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "main.h"
+
+
+/* The application as two orthogonal regions: the LED count can be edited
+ * while the blinker runs, pauses or is off. */
+
+typedef enum
+{
+  APP_REGION_EDIT,
+  APP_REGION_BLINKER,
+  APP_REGIONS
+}app_region_id_t;
+
+typedef enum
+{
+  EDIT_IDLE,
+  EDIT_SET,
+  EDIT_STATES
+}edit_state_t;
+
+typedef enum
+{
+  BLINKER_OFF,
+  BLINKER_ON,
+  BLINKER_PAUSED,
+  BLINKER_STATES
+}blinker_state_t;
+
+
+void app_regions_init(app_t *const myApp);
+void app_regions_project(app_t *const myApp);
+
+
+#endif
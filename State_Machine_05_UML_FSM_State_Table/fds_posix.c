@@ -0,0 +1,424 @@
+/* Host side of fds_posix.h, part of -DHAL_POSIX builds only.
+ *
+ * A page starts with two tag words, the magic and the page type, and
+ * records follow back to back. The swap and data type words differ in one
+ * bit that programming can clear, so the garbage collection turns the swap
+ * page into a data page without an erase: it copies the valid records of a
+ * data page with invalidated ones into the swap page, retags it, erases the
+ * old page and tags it as the new swap page.
+ */
+#include "fds_posix.h"
+
+#if defined(HAL_POSIX)
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#define FDS_POSIX_FLASH_WORDS   (FDS_POSIX_PAGES * FDS_POSIX_PAGE_WORDS)
+#define FDS_POSIX_ERASED        0xFFFFFFFFUL
+
+#define PAGE_TAG_MAGIC          0xDEADC0DEUL
+#define PAGE_TAG_SWAP           0xF11E01FFUL
+#define PAGE_TAG_DATA           0xF11E01FEUL
+#define PAGE_TAG_WORDS          2
+
+/* [key | length_words << 16][file_id | crc16 << 16][record_id] */
+#define HEADER_WORDS            3
+#define KEY_DIRTY               0x0000
+
+static uint32_t *m_flash;
+static fds_cb_t m_handler;
+static uint32_t m_record_id;          /* last id handed out */
+static fds_posix_stats_t m_stats;
+
+
+/**@brief CRC-16/CCITT as crc16_compute() of the SDK.
+ */
+static uint16_t crc16(uint8_t const *p_data, uint32_t size, uint16_t crc)
+{
+  for(uint32_t i = 0; i < size; i++)
+  {
+    crc = (uint8_t)(crc >> 8) | (crc << 8);
+    crc ^= p_data[i];
+    crc ^= (uint8_t)(crc & 0xFF) >> 4;
+    crc ^= (crc << 8) << 4;
+    crc ^= ((crc & 0xFF) << 4) << 1;
+  }
+  return crc;
+}
+
+/**@brief Covers the header but the key, an invalidated record keeps its CRC.
+ */
+static uint16_t record_crc(uint32_t const *p_header, uint32_t const *p_data, uint16_t length_words)
+{
+  uint32_t fields[2] = {p_header[0] >> 16, (p_header[1] & 0xFFFF) | (p_header[2] << 16)};
+  uint16_t crc = crc16((uint8_t const *)fields, sizeof(fields), 0xFFFF);
+
+  return crc16((uint8_t const *)&p_header[2], 4, crc16((uint8_t const *)p_data, length_words * 4U, crc));
+}
+
+static uint32_t * page(uint16_t index)
+{
+  return &m_flash[index * FDS_POSIX_PAGE_WORDS];
+}
+
+/**@brief Program a word: bits only go from 1 to 0.
+ */
+static void flash_write(uint32_t *p_word, uint32_t value)
+{
+  *p_word &= value;
+  m_stats.words_written++;
+}
+
+static void page_erase(uint16_t index)
+{
+  memset(page(index), 0xFF, FDS_POSIX_PAGE_WORDS * sizeof(uint32_t));
+  m_stats.page_erases++;
+}
+
+static bool page_is(uint16_t index, uint32_t type)
+{
+  return (page(index)[0] == PAGE_TAG_MAGIC) && (page(index)[1] == type);
+}
+
+static uint16_t record_words(uint32_t const *p_header)
+{
+  return HEADER_WORDS + (uint16_t)(p_header[0] >> 16);
+}
+
+/**@brief First free word of a data page.
+ */
+static uint32_t page_end(uint16_t index)
+{
+  uint32_t offset = PAGE_TAG_WORDS;
+
+  while((offset + HEADER_WORDS <= FDS_POSIX_PAGE_WORDS) && (page(index)[offset] != FDS_POSIX_ERASED))
+  {
+    offset += record_words(&page(index)[offset]);
+  }
+  return offset;
+}
+
+/**@brief Header of the valid record with this id, NULL if there is none.
+ */
+static uint32_t * record_locate(uint32_t record_id)
+{
+  for(uint16_t p = 0; p < FDS_POSIX_PAGES; p++)
+  {
+    if(!page_is(p, PAGE_TAG_DATA))
+    {
+      continue;
+    }
+    for(uint32_t offset = PAGE_TAG_WORDS; offset < page_end(p); offset += record_words(&page(p)[offset]))
+    {
+      uint32_t *p_header = &page(p)[offset];
+
+      if(((p_header[0] & 0xFFFF) != KEY_DIRTY) && (p_header[2] == record_id))
+      {
+        return p_header;
+      }
+    }
+  }
+  return NULL;
+}
+
+static void event_send(fds_evt_id_t id, ret_code_t result)
+{
+  fds_evt_t evt = {.id = id, .result = result};
+
+  if(m_handler != NULL)
+  {
+    m_handler(&evt);
+  }
+}
+
+static bool flash_map(void)
+{
+  char const *path = getenv("FDS_FILE");
+  size_t size = FDS_POSIX_FLASH_WORDS * sizeof(uint32_t);
+  void *p_map;
+
+  if(path == NULL)
+  {
+    p_map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(p_map == MAP_FAILED)
+    {
+      return false;
+    }
+    memset(p_map, 0xFF, size);
+  }
+  else
+  {
+    struct stat st;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if((fd < 0) || (fstat(fd, &st) != 0))
+    {
+      perror(path);
+      return false;
+    }
+    if((size_t)st.st_size != size)
+    {
+      if(ftruncate(fd, (off_t)size) != 0)
+      {
+        close(fd);
+        return false;
+      }
+    }
+    p_map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p_map == MAP_FAILED)
+    {
+      return false;
+    }
+    if((size_t)st.st_size != size)
+    {
+      memset(p_map, 0xFF, size);    // a new file is erased flash
+    }
+  }
+  m_flash = p_map;
+  return true;
+}
+
+/**@brief Stop like the error handler of the SDK does.
+ */
+void fds_posix_error(ret_code_t err_code, char const *p_file, int line)
+{
+  fprintf(stderr, "%s:%d: error 0x%X\n", p_file, line, (unsigned)err_code);
+  exit(1);
+}
+
+ret_code_t fds_register(fds_cb_t cb)
+{
+  if(m_handler != NULL)
+  {
+    return NRF_ERROR_NO_MEM;      // one user, fsm_persist
+  }
+  m_handler = cb;
+  return NRF_SUCCESS;
+}
+
+/**@brief Map the flash, format it if its pages carry no tags, find the last record id.
+ */
+ret_code_t fds_init(void)
+{
+  uint16_t swap_pages = 0;
+
+  if((m_flash == NULL) && !flash_map())
+  {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  for(uint16_t p = 0; p < FDS_POSIX_PAGES; p++)
+  {
+    swap_pages += page_is(p, PAGE_TAG_SWAP);
+    if(!page_is(p, PAGE_TAG_SWAP) && !page_is(p, PAGE_TAG_DATA))
+    {
+      swap_pages = FDS_POSIX_PAGES;
+      break;
+    }
+  }
+  if(swap_pages != 1)
+  {
+    for(uint16_t p = 0; p < FDS_POSIX_PAGES; p++)
+    {
+      page_erase(p);
+      flash_write(&page(p)[0], PAGE_TAG_MAGIC);
+      flash_write(&page(p)[1], (p == (FDS_POSIX_PAGES - 1)) ? PAGE_TAG_SWAP : PAGE_TAG_DATA);
+    }
+  }
+
+  m_record_id = 0;
+  for(uint16_t p = 0; p < FDS_POSIX_PAGES; p++)
+  {
+    for(uint32_t offset = PAGE_TAG_WORDS; page_is(p, PAGE_TAG_DATA) && (offset < page_end(p));
+        offset += record_words(&page(p)[offset]))
+    {
+      m_record_id = (page(p)[offset + 2] > m_record_id) ? page(p)[offset + 2] : m_record_id;
+    }
+  }
+  event_send(FDS_EVT_INIT, NRF_SUCCESS);
+  return NRF_SUCCESS;
+}
+
+/**@brief Append a record to the first data page with room for it.
+ */
+static ret_code_t record_append(fds_record_desc_t *p_desc, fds_record_t const *p_record)
+{
+  uint32_t words = HEADER_WORDS + p_record->data.length_words;
+  uint32_t const *p_data = p_record->data.p_data;
+
+  if(words > (FDS_POSIX_PAGE_WORDS - PAGE_TAG_WORDS))
+  {
+    return FDS_ERR_RECORD_TOO_LARGE;
+  }
+  for(uint16_t p = 0; p < FDS_POSIX_PAGES; p++)
+  {
+    uint32_t offset = page_end(p);
+    uint32_t *p_header = &page(p)[offset];
+    uint32_t header[HEADER_WORDS];
+
+    if(!page_is(p, PAGE_TAG_DATA) || ((offset + words) > FDS_POSIX_PAGE_WORDS))
+    {
+      continue;
+    }
+    header[0] = p_record->key | (p_record->data.length_words << 16);
+    header[1] = p_record->file_id;
+    header[2] = ++m_record_id;
+    header[1] |= (uint32_t)record_crc(header, p_data, (uint16_t)p_record->data.length_words) << 16;
+    for(uint32_t i = 0; i < HEADER_WORDS; i++)
+    {
+      flash_write(&p_header[i], header[i]);
+    }
+    for(uint32_t i = 0; i < p_record->data.length_words; i++)
+    {
+      flash_write(&p_header[HEADER_WORDS + i], p_data[i]);
+    }
+    p_desc->record_id = m_record_id;
+    return NRF_SUCCESS;
+  }
+  return FDS_ERR_NO_SPACE_IN_FLASH;
+}
+
+ret_code_t fds_record_write(fds_record_desc_t *p_desc, fds_record_t const *p_record)
+{
+  ret_code_t err_code = record_append(p_desc, p_record);
+
+  if(err_code == NRF_SUCCESS)
+  {
+    event_send(FDS_EVT_WRITE, NRF_SUCCESS);
+  }
+  return err_code;
+}
+
+/**@brief Append the new record, then clear the key of the one p_desc describes.
+ *
+ * @details On success p_desc describes the new record.
+ */
+ret_code_t fds_record_update(fds_record_desc_t *p_desc, fds_record_t const *p_record)
+{
+  uint32_t *p_old = record_locate(p_desc->record_id);
+  ret_code_t err_code = record_append(p_desc, p_record);
+
+  if(err_code != NRF_SUCCESS)
+  {
+    return err_code;
+  }
+  if(p_old != NULL)
+  {
+    flash_write(&p_old[0], p_old[0] & 0xFFFF0000UL);
+  }
+  event_send(FDS_EVT_UPDATE, NRF_SUCCESS);
+  return NRF_SUCCESS;
+}
+
+/**@brief Next valid record of the file with the key, after the token.
+ */
+ret_code_t fds_record_find(uint16_t file_id, uint16_t record_key, fds_record_desc_t *p_desc, fds_find_token_t *p_token)
+{
+  for(; p_token->page < FDS_POSIX_PAGES; p_token->page++, p_token->offset = 0)
+  {
+    if(!page_is(p_token->page, PAGE_TAG_DATA))
+    {
+      continue;
+    }
+    if(p_token->offset == 0)
+    {
+      p_token->offset = PAGE_TAG_WORDS;
+    }
+    while((p_token->offset + HEADER_WORDS <= FDS_POSIX_PAGE_WORDS) &&
+          (page(p_token->page)[p_token->offset] != FDS_POSIX_ERASED))
+    {
+      uint32_t const *p_header = &page(p_token->page)[p_token->offset];
+
+      m_stats.words_searched += HEADER_WORDS;
+      p_token->offset += record_words(p_header);
+      if(((p_header[0] & 0xFFFF) == record_key) && ((p_header[1] & 0xFFFF) == file_id) && (record_key != KEY_DIRTY))
+      {
+        p_desc->record_id = p_header[2];
+        return NRF_SUCCESS;
+      }
+    }
+  }
+  return FDS_ERR_NOT_FOUND;
+}
+
+ret_code_t fds_record_open(fds_record_desc_t *p_desc, fds_flash_record_t *p_flash_record)
+{
+  uint32_t const *p_header = record_locate(p_desc->record_id);
+
+  if(p_header == NULL)
+  {
+    return FDS_ERR_NOT_FOUND;
+  }
+  if((p_header[1] >> 16) != record_crc(p_header, &p_header[HEADER_WORDS], (uint16_t)(p_header[0] >> 16)))
+  {
+    return FDS_ERR_CRC_CHECK_FAILED;
+  }
+  p_flash_record->p_data = &p_header[HEADER_WORDS];
+  return NRF_SUCCESS;
+}
+
+ret_code_t fds_record_close(fds_record_desc_t *p_desc)
+{
+  (void)p_desc;
+  return NRF_SUCCESS;
+}
+
+/**@brief Compact every data page that holds invalidated records.
+ */
+ret_code_t fds_gc(void)
+{
+  for(uint16_t p = 0; p < FDS_POSIX_PAGES; p++)
+  {
+    uint16_t swap = FDS_POSIX_PAGES;
+    bool dirty = false;
+    uint32_t end = page_end(p);
+    uint32_t out = PAGE_TAG_WORDS;
+
+    for(uint32_t offset = PAGE_TAG_WORDS; page_is(p, PAGE_TAG_DATA) && (offset < end); offset += record_words(&page(p)[offset]))
+    {
+      dirty |= ((page(p)[offset] & 0xFFFF) == KEY_DIRTY);
+    }
+    if(!dirty)
+    {
+      continue;
+    }
+    for(uint16_t s = 0; s < FDS_POSIX_PAGES; s++)
+    {
+      swap = page_is(s, PAGE_TAG_SWAP) ? s : swap;
+    }
+    if(swap == FDS_POSIX_PAGES)
+    {
+      return NRF_ERROR_INVALID_STATE;
+    }
+    for(uint32_t offset = PAGE_TAG_WORDS; offset < end; offset += record_words(&page(p)[offset]))
+    {
+      if((page(p)[offset] & 0xFFFF) == KEY_DIRTY)
+      {
+        continue;
+      }
+      for(uint32_t i = 0; i < record_words(&page(p)[offset]); i++)
+      {
+        flash_write(&page(swap)[out++], page(p)[offset + i]);
+      }
+    }
+    flash_write(&page(swap)[1], PAGE_TAG_DATA);
+    page_erase(p);
+    flash_write(&page(p)[0], PAGE_TAG_MAGIC);
+    flash_write(&page(p)[1], PAGE_TAG_SWAP);
+  }
+  event_send(FDS_EVT_GC, NRF_SUCCESS);
+  return NRF_SUCCESS;
+}
+
+fds_posix_stats_t const * fds_posix_stats_get(void)
+{
+  return &m_stats;
+}
+
+#endif /* HAL_POSIX */
@@ -0,0 +1,114 @@
+#ifndef FDS_POSIX_H
+#define FDS_POSIX_H
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Host stand-in of the FDS calls fsm_persist.c makes, part of -DHAL_POSIX
+ * builds only. Names and types follow fds.h, so fsm_persist.c runs the same
+ * code on both builds.
+ *
+ * Flash is FDS_POSIX_PAGES pages of FDS_POSIX_PAGE_WORDS words, the layout
+ * of sdk_config.h, one of them kept erased as the swap page of the garbage
+ * collection. Programming only clears bits, like the NVMC. Records are
+ * appended behind a three word header, an update appends the new record and
+ * clears the key of the old one. Operations complete before they return
+ * and the handler runs inside them, as with the NVMC backend the target
+ * uses (FDS_BACKEND 1).
+ *
+ * FDS_FILE=path in the environment maps the flash onto a file, so a second
+ * run restores what the first one wrote. Without it every run starts from
+ * erased flash. */
+
+#define FDS_POSIX_PAGES         3       /* FDS_VIRTUAL_PAGES */
+#define FDS_POSIX_PAGE_WORDS    1024    /* FDS_VIRTUAL_PAGE_SIZE */
+
+/* app_error.h and sdk_errors.h */
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS                 0
+#define NRF_ERROR_INVALID_STATE     8
+#define NRF_ERROR_NO_MEM            4
+#define FDS_ERR_NOT_FOUND           0x8602
+#define FDS_ERR_NO_SPACE_IN_FLASH   0x8603
+#define FDS_ERR_CRC_CHECK_FAILED    0x8605
+#define FDS_ERR_RECORD_TOO_LARGE    0x860B
+
+void fds_posix_error(ret_code_t err_code, char const *p_file, int line);
+
+#define APP_ERROR_CHECK(err_code)                                  \
+  do                                                               \
+  {                                                                \
+    ret_code_t const local_err = (err_code);                       \
+    if(local_err != NRF_SUCCESS)                                   \
+    {                                                              \
+      fds_posix_error(local_err, __FILE__, __LINE__);              \
+    }                                                              \
+  }while(0)
+
+typedef enum
+{
+  FDS_EVT_INIT,
+  FDS_EVT_WRITE,
+  FDS_EVT_UPDATE,
+  FDS_EVT_DEL_RECORD,
+  FDS_EVT_DEL_FILE,
+  FDS_EVT_GC
+}fds_evt_id_t;
+
+typedef struct
+{
+  fds_evt_id_t id;
+  ret_code_t result;
+}fds_evt_t;
+
+typedef void (*fds_cb_t)(fds_evt_t const *p_evt);
+
+typedef struct
+{
+  uint16_t file_id;
+  uint16_t key;
+  struct
+  {
+    void const *p_data;
+    uint32_t length_words;
+  }data;
+}fds_record_t;
+
+typedef struct
+{
+  uint32_t record_id;
+}fds_record_desc_t;
+
+typedef struct
+{
+  uint16_t page;
+  uint16_t offset;      /* words into the page, 0 before the first search */
+}fds_find_token_t;
+
+typedef struct
+{
+  void const *p_data;
+}fds_flash_record_t;
+
+/* Flash wear and search cost */
+typedef struct
+{
+  uint32_t words_written;   /* programmed, headers, invalidations and garbage collection copies included */
+  uint32_t page_erases;
+  uint32_t words_searched;  /* read by fds_record_find */
+}fds_posix_stats_t;
+
+
+ret_code_t fds_register(fds_cb_t cb);
+ret_code_t fds_init(void);
+ret_code_t fds_record_write(fds_record_desc_t *p_desc, fds_record_t const *p_record);
+ret_code_t fds_record_update(fds_record_desc_t *p_desc, fds_record_t const *p_record);
+ret_code_t fds_record_find(uint16_t file_id, uint16_t record_key, fds_record_desc_t *p_desc, fds_find_token_t *p_token);
+ret_code_t fds_record_open(fds_record_desc_t *p_desc, fds_flash_record_t *p_flash_record);
+ret_code_t fds_record_close(fds_record_desc_t *p_desc);
+ret_code_t fds_gc(void);
+fds_posix_stats_t const * fds_posix_stats_get(void);
+
+
+#endif
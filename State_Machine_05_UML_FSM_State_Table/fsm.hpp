@@ -0,0 +1,216 @@
+#ifndef FSM_HPP
+#define FSM_HPP
+/* Header-only C++17 state machine templates.
+ *
+ * A machine is declared as types: the states with their entry/exit actions
+ * and a list of transition rows {source, signal, guard, action, target}.
+ * The same declaration expands into either back-end:
+ *
+ *  - dispatch():        constexpr dense table of cell functions indexed by
+ *                       (state * signals + signal), like fsm_state_table.
+ *  - dispatch_static(): a fold over every (state, signal) cell that the
+ *                       compiler inlines into a switch, like fsm_state_handler_*.
+ *
+ * No heap, no RTTI, no exceptions: builds with arm-none-eabi-g++ as well as
+ * host g++.
+ */
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace fsm
+{
+
+enum class status : uint8_t
+{
+  handled,
+  ignored,
+  transition
+};
+
+/* State declaration, Entry/Exit are void (*)(Ctx &) or nullptr */
+template <auto State, auto Entry = nullptr, auto Exit = nullptr>
+struct state
+{
+  static constexpr auto id = State;
+
+  template <typename Ctx>
+  static void entry(Ctx &ctx)
+  {
+    if constexpr (!std::is_same_v<decltype(Entry), std::nullptr_t>) { Entry(ctx); }
+  }
+
+  template <typename Ctx>
+  static void exit(Ctx &ctx)
+  {
+    if constexpr (!std::is_same_v<decltype(Exit), std::nullptr_t>) { Exit(ctx); }
+  }
+};
+
+/* External transition: exit source, run action, enter target.
+ * Guard is bool (*)(Ctx const &) or nullptr, Action is void (*)(Ctx &) or nullptr. */
+template <auto Source, auto Signal, auto Target, auto Guard = nullptr, auto Action = nullptr>
+struct row
+{
+  static constexpr auto source = Source;
+  static constexpr auto signal = Signal;
+  static constexpr auto target = Target;
+  static constexpr bool internal = false;
+  static constexpr auto guard = Guard;
+  static constexpr auto action = Action;
+};
+
+/* Internal transition: action only, the state is not left */
+template <auto Source, auto Signal, auto Guard = nullptr, auto Action = nullptr>
+struct internal_row
+{
+  static constexpr auto source = Source;
+  static constexpr auto signal = Signal;
+  static constexpr auto target = Source;
+  static constexpr bool internal = true;
+  static constexpr auto guard = Guard;
+  static constexpr auto action = Action;
+};
+
+template <typename... States> struct states {};
+template <typename... Rows> struct rows {};
+
+template <typename Ctx, typename StateEnum, typename SignalEnum, typename States, typename Rows>
+class machine;
+
+/* Ctx must expose a StateEnum active_state member.
+ * StateEnum and SignalEnum must be dense, starting at 0, with a trailing count. */
+template <typename Ctx, typename StateEnum, typename SignalEnum, typename... States, typename... Rows>
+class machine<Ctx, StateEnum, SignalEnum, states<States...>, rows<Rows...>>
+{
+public:
+  static constexpr std::size_t num_states = static_cast<std::size_t>(StateEnum::count);
+  static constexpr std::size_t num_signals = static_cast<std::size_t>(SignalEnum::count);
+
+  static_assert(sizeof...(States) == num_states, "every state needs a declaration");
+  static_assert(((static_cast<std::size_t>(States::id) < num_states) && ...), "state id out of range");
+  static_assert(((static_cast<std::size_t>(Rows::source) < num_states) && ...), "row source out of range");
+  static_assert(((static_cast<std::size_t>(Rows::target) < num_states) && ...), "row target out of range");
+  static_assert(((static_cast<std::size_t>(Rows::signal) < num_signals) && ...), "row signal out of range");
+
+  using cell_t = status (*)(Ctx &);
+  using context_type = Ctx;
+  using state_type = StateEnum;
+  using signal_type = SignalEnum;
+
+  static void init(Ctx &ctx, StateEnum initial)
+  {
+    ctx.active_state = initial;
+    run_entry(ctx, static_cast<std::size_t>(initial));
+  }
+
+  /* Dense table back-end: one indirect call per event */
+  static status dispatch(Ctx &ctx, SignalEnum sig)
+  {
+    std::size_t idx = static_cast<std::size_t>(ctx.active_state) * num_signals + static_cast<std::size_t>(sig);
+    return table[idx](ctx);
+  }
+
+  /* Static back-end: every cell is inlined into the caller */
+  static status dispatch_static(Ctx &ctx, SignalEnum sig)
+  {
+    std::size_t idx = static_cast<std::size_t>(ctx.active_state) * num_signals + static_cast<std::size_t>(sig);
+    return dispatch_static_impl(ctx, idx, std::make_index_sequence<num_states * num_signals>{});
+  }
+
+private:
+  template <std::size_t S, typename St>
+  static void entry_if(Ctx &ctx)
+  {
+    if constexpr (static_cast<std::size_t>(St::id) == S) { St::entry(ctx); }
+  }
+
+  template <std::size_t S, typename St>
+  static void exit_if(Ctx &ctx)
+  {
+    if constexpr (static_cast<std::size_t>(St::id) == S) { St::exit(ctx); }
+  }
+
+  template <std::size_t S>
+  static void entry_of(Ctx &ctx) { (entry_if<S, States>(ctx), ...); }
+
+  template <std::size_t S>
+  static void exit_of(Ctx &ctx) { (exit_if<S, States>(ctx), ...); }
+
+  template <std::size_t... I>
+  static void run_entry_impl(Ctx &ctx, std::size_t s, std::index_sequence<I...>)
+  {
+    ((s == I ? (entry_of<I>(ctx), true) : false) || ...);
+  }
+
+  static void run_entry(Ctx &ctx, std::size_t s)
+  {
+    run_entry_impl(ctx, s, std::make_index_sequence<num_states>{});
+  }
+
+  /* Evaluate one row of cell (S, G); done is set once a row fired */
+  template <std::size_t S, std::size_t G, typename R>
+  static bool try_row(Ctx &ctx, status &result)
+  {
+    if constexpr ((static_cast<std::size_t>(R::source) == S) && (static_cast<std::size_t>(R::signal) == G))
+    {
+      if constexpr (!std::is_same_v<std::remove_cv_t<decltype(R::guard)>, std::nullptr_t>)
+      {
+        if (!R::guard(ctx)) { return false; }
+      }
+      if constexpr (R::internal)
+      {
+        if constexpr (!std::is_same_v<std::remove_cv_t<decltype(R::action)>, std::nullptr_t>) { R::action(ctx); }
+        result = status::handled;
+      }
+      else
+      {
+        constexpr std::size_t T = static_cast<std::size_t>(R::target);
+        exit_of<S>(ctx);
+        if constexpr (!std::is_same_v<std::remove_cv_t<decltype(R::action)>, std::nullptr_t>) { R::action(ctx); }
+        ctx.active_state = R::target;
+        entry_of<T>(ctx);
+        result = status::transition;
+      }
+      return true;
+    }
+    else
+    {
+      (void)ctx;
+      (void)result;
+      return false;
+    }
+  }
+
+  /* Rows are tried in declaration order, the first enabled one fires */
+  template <std::size_t S, std::size_t G>
+  static status cell(Ctx &ctx)
+  {
+    status result = status::ignored;
+    (try_row<S, G, Rows>(ctx, result) || ...);
+    return result;
+  }
+
+  template <std::size_t... I>
+  static constexpr std::array<cell_t, sizeof...(I)> make_table(std::index_sequence<I...>)
+  {
+    return {{&cell<I / num_signals, I % num_signals>...}};
+  }
+
+  template <std::size_t... I>
+  static status dispatch_static_impl(Ctx &ctx, std::size_t idx, std::index_sequence<I...>)
+  {
+    status result = status::ignored;
+    ((idx == I ? (result = cell<I / num_signals, I % num_signals>(ctx), true) : false) || ...);
+    return result;
+  }
+
+  static constexpr std::array<cell_t, num_states * num_signals> table =
+      make_table(std::make_index_sequence<num_states * num_signals>{});
+};
+
+} // namespace fsm
+
+#endif
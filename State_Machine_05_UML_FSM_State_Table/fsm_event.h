@@ -0,0 +1,168 @@
+#ifndef FSM_EVENT_H
+#define FSM_EVENT_H
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "main.h"
+
+
+/* Typed events.
+ *
+ * FSM_EVENT_SIGNALS binds every user signal to the type of its payload and
+ * to its queue class. The payload sits inline in fsm_event_t, a union
+ * member named after the signal, so FSM_EVENT_PAYLOAD(e, INC_LED) has the
+ * type bound to INC_LED and a field that type lacks does not compile.
+ * Handlers of the state table are defined with FSM_HANDLER(state, signal),
+ * which takes the signal of their payload from the cell they are named
+ * after. The table has to put an event in the cell of its own signal, and
+ * a hot swapped table may only move a handler to a signal of the same
+ * payload type and queue class (fsm_hotswap.c); without NDEBUG every
+ * payload access asserts that the event's signal has the type read. A
+ * zeroed payload is the plain signal of a button: one LED, periods kept.
+ *
+ * The queue keeps each class in slots sized to the largest payload of its
+ * signals (FSM_EVENT_SIZE), a long START_PAUSE payload does not widen the
+ * INC_LED/DEC_LED slots. */
+
+/* INC_LED/DEC_LED: LEDs to add or remove, 0 for one */
+typedef struct
+{
+  uint8_t count;
+}fsm_led_step_t;
+
+/**@brief LEDs an INC_LED/DEC_LED event steps by, at most room.
+ */
+static inline uint8_t fsm_led_step(fsm_led_step_t const *p_step, uint8_t room)
+{
+  uint8_t count = (p_step->count > 0) ? p_step->count : 1;
+
+  return (count < room) ? count : room;
+}
+
+/* START_PAUSE: blink period of each LED, ms, 0 keeps the period it has */
+typedef struct
+{
+  uint16_t period_ms[LED_COUNT];
+}fsm_blink_rate_t;
+
+typedef struct
+{
+  uint8_t unused;
+}fsm_no_payload_t;
+
+/* Queue classes, the higher is dispatched first */
+#define FSM_EVENT_CLASS_STEP      0
+#define FSM_EVENT_CLASS_CONTROL   1
+#define FSM_EVENT_CLASS_ABORT     2
+#define FSM_EVENT_CLASS_COUNT     3
+
+#define FSM_EVENT_CLASSES(X) \
+  X(FSM_EVENT_CLASS_STEP)    \
+  X(FSM_EVENT_CLASS_CONTROL) \
+  X(FSM_EVENT_CLASS_ABORT)
+
+/* X(signal, payload type, queue class, arg), arg is passed through */
+#define FSM_EVENT_SIGNALS(X, arg)                                     \
+  X(INC_LED,     fsm_led_step_t,    FSM_EVENT_CLASS_STEP,    arg)     \
+  X(DEC_LED,     fsm_led_step_t,    FSM_EVENT_CLASS_STEP,    arg)     \
+  X(START_PAUSE, fsm_blink_rate_t,  FSM_EVENT_CLASS_CONTROL, arg)     \
+  X(ABRT,        fsm_no_payload_t,  FSM_EVENT_CLASS_ABORT,   arg)
+
+typedef struct
+{
+  event_t super;
+  uint32_t edge_time;   /* capture clock (us) of the button edge, see port_input.h, or FSM_EVENT_NO_EDGE */
+  union
+  {
+#define FSM_EVENT_MEMBER(signal, type, class, arg) type signal;
+    FSM_EVENT_SIGNALS(FSM_EVENT_MEMBER, 0)
+#undef FSM_EVENT_MEMBER
+  }payload;
+}fsm_event_t;
+
+#define FSM_EVENT_CLASS_CHECK(signal, type, class, arg) \
+  _Static_assert((class) < FSM_EVENT_CLASS_COUNT, #signal " has no queue class");
+FSM_EVENT_SIGNALS(FSM_EVENT_CLASS_CHECK, 0)
+#undef FSM_EVENT_CLASS_CHECK
+
+/* Bytes of an event of a class: the header and the largest payload of the class */
+#define FSM_EVENT_SIZE_IN(signal, type, class, k) uint8_t signal[((class) == (k)) ? sizeof(type) : 1];
+#define FSM_EVENT_SIZE(k) \
+  (offsetof(fsm_event_t, payload) + sizeof(union { FSM_EVENT_SIGNALS(FSM_EVENT_SIZE_IN, k) }))
+
+/* edge_time of an event no button made (command link), a capture clock
+ * value an edge hits once in 71 minutes and is then left out of the latency */
+#define FSM_EVENT_NO_EDGE   UINT32_MAX
+
+/* An event of signal with its payload, e.g. FSM_EVENT(INC_LED, t, .count = 2) */
+#define FSM_EVENT(signal, time, ...) \
+  ((fsm_event_t){.super = {.sig = signal}, .edge_time = (time), .payload = {.signal = {__VA_ARGS__}}})
+
+/* Payload of e, handled as signal: the type bound to it in FSM_EVENT_SIGNALS.
+ * The table puts e in the cell of its own signal, ENTRY and EXIT have none */
+#define FSM_EVENT_PAYLOAD(e, signal)  (&fsm_event_payload_of((e), (signal))->payload.signal)
+
+#define FSM_EVENT_PAYLOAD_TYPE(signal)  __typeof__(((fsm_event_t *)0)->payload.signal)
+
+/* Definition of the handler of the cell (state, signal), with p_payload the
+ * payload of e as the type bound to signal, e.g.
+ *   FSM_HANDLER(LED_SET, INC_LED) { ... p_payload->count ... } */
+#define FSM_HANDLER(state, signal)                                                                   \
+  static event_status_t state##_##signal##_PAYLOAD(app_t *const myApp, event_t const *const e,       \
+                                                   FSM_EVENT_PAYLOAD_TYPE(signal) const *p_payload); \
+  event_status_t state##_##signal(app_t *const myApp, event_t const *const e)                        \
+  {                                                                                                  \
+    return state##_##signal##_PAYLOAD(myApp, e, FSM_EVENT_PAYLOAD(e, signal));                       \
+  }                                                                                                  \
+  static event_status_t state##_##signal##_PAYLOAD(app_t *const myApp, event_t const *const e,       \
+                                                   FSM_EVENT_PAYLOAD_TYPE(signal) const *p_payload)
+
+
+/**@brief The event e is the header of.
+ */
+static inline fsm_event_t const * fsm_event_of(event_t const *e)
+{
+  return (fsm_event_t const *)e;
+}
+
+/**@brief Name of the payload type bound to a signal, NULL for ENTRY and EXIT.
+ */
+static inline char const * fsm_event_payload_type(fsm_signal_t sig)
+{
+  switch(sig)
+  {
+#define FSM_EVENT_TYPE_CASE(signal, type, class, arg) case signal: return #type;
+    FSM_EVENT_SIGNALS(FSM_EVENT_TYPE_CASE, 0)
+#undef FSM_EVENT_TYPE_CASE
+    default:
+      return NULL;
+  }
+}
+
+/**@brief The event e is the header of, its payload read as the type of signal.
+ */
+static inline fsm_event_t const * fsm_event_payload_of(event_t const *e, fsm_signal_t signal)
+{
+  assert((fsm_event_payload_type(e->sig) != NULL) &&
+         (strcmp(fsm_event_payload_type(e->sig), fsm_event_payload_type(signal)) == 0));
+  (void)signal;
+  return fsm_event_of(e);
+}
+
+/**@brief Queue class of a signal, ENTRY and EXIT are never queued.
+ */
+static inline uint8_t fsm_event_class(fsm_signal_t sig)
+{
+  switch(sig)
+  {
+#define FSM_EVENT_CLASS_CASE(signal, type, class, arg) case signal: return class;
+    FSM_EVENT_SIGNALS(FSM_EVENT_CLASS_CASE, 0)
+#undef FSM_EVENT_CLASS_CASE
+    default:
+      return FSM_EVENT_CLASS_STEP;
+  }
+}
+
+
+#endif
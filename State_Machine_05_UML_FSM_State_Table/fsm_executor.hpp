@@ -0,0 +1,581 @@
+#ifndef FSM_EXECUTOR_HPP
+#define FSM_EXECUTOR_HPP
+/* Host runtime running many fsm.hpp machines as active objects on a thread pool.
+ *
+ * Every machine owns its context and a bounded MPSC mailbox, each machine on
+ * its own cache lines. post() from any thread queues an event and schedules
+ * the machine unless it is scheduled already. A scheduled machine sits in
+ * exactly one run queue, so one worker at a time runs it: the events of a
+ * machine are dispatched in order, each to completion, as on the target.
+ *
+ * Run queues: a Chase-Lev deque per worker, the owner pushes at the bottom
+ * and everybody, owner included, takes from the top, plus one injection
+ * queue for posts from outside the pool and for machines that used up their
+ * batch.
+ * A machine is in at most one queue, so every queue is sized for all of them
+ * and never grows.
+ *
+ * Host only (g++ -std=c++17 -pthread), never built for the target.
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "fsm.hpp"
+
+namespace fsm
+{
+
+constexpr std::size_t cache_line = 64;
+
+inline uint64_t now_ns()
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline std::size_t round_up_pow2(std::size_t n)
+{
+  std::size_t p = 1;
+  while(p < n) { p <<= 1; }
+  return p;
+}
+
+/* Log-linear histogram: 8 sub-buckets per power of two, values within 12.5 % */
+class latency_histogram
+{
+public:
+  static constexpr unsigned sub_bits = 3;
+  static constexpr unsigned sub_count = 1u << sub_bits;
+  static constexpr unsigned buckets = (64 - sub_bits + 1) * sub_count;
+
+  void record(uint64_t value)
+  {
+    m_count[index(value)]++;
+    m_total++;
+    if(value > m_max) { m_max = value; }
+  }
+
+  void merge(latency_histogram const &other)
+  {
+    for(unsigned i = 0; i < buckets; i++) { m_count[i] += other.m_count[i]; }
+    m_total += other.m_total;
+    if(other.m_max > m_max) { m_max = other.m_max; }
+  }
+
+  /* Upper bound of the bucket holding the p-th fraction of the samples */
+  uint64_t percentile(double p) const
+  {
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(m_total));
+    uint64_t seen = 0;
+
+    for(unsigned i = 0; i < buckets; i++)
+    {
+      seen += m_count[i];
+      if((seen > rank) && (seen > 0))
+      {
+        uint64_t upper = upper_bound(i);
+        return (upper < m_max) ? upper : m_max;
+      }
+    }
+    return m_max;
+  }
+
+  uint64_t total() const { return m_total; }
+  uint64_t max() const { return m_max; }
+
+private:
+  static unsigned index(uint64_t v)
+  {
+    if(v < sub_count) { return static_cast<unsigned>(v); }
+    unsigned shift = (63 - static_cast<unsigned>(__builtin_clzll(v))) - sub_bits;
+    return ((shift + 1) << sub_bits) + static_cast<unsigned>((v >> shift) & (sub_count - 1));
+  }
+
+  static uint64_t upper_bound(unsigned i)
+  {
+    if(i < sub_count) { return i; }
+    unsigned shift = (i >> sub_bits) - 1;
+    return ((static_cast<uint64_t>(sub_count + (i & (sub_count - 1))) + 1) << shift) - 1;
+  }
+
+  uint64_t m_count[buckets] = {};
+  uint64_t m_total = 0;
+  uint64_t m_max = 0;
+};
+
+/* Bounded MPSC queue (Vyukov): producers claim a slot with a CAS on the
+ * tail, the slot sequence number publishes the event to the one consumer. */
+template <typename T, std::size_t Size>
+class mailbox
+{
+  static_assert((Size & (Size - 1)) == 0, "mailbox size must be a power of two");
+
+public:
+  mailbox()
+  {
+    for(uint32_t i = 0; i < Size; i++) { m_slots[i].seq.store(i, std::memory_order_relaxed); }
+  }
+
+  /* Any thread, false when full */
+  bool push(T const &item)
+  {
+    uint32_t pos = m_tail.load(std::memory_order_relaxed);
+
+    while(true)
+    {
+      slot &s = m_slots[pos & (Size - 1)];
+      int32_t diff = static_cast<int32_t>(s.seq.load(std::memory_order_acquire) - pos);
+
+      if(diff == 0)
+      {
+        if(m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+      }
+      else if(diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = m_tail.load(std::memory_order_relaxed);
+      }
+    }
+    slot &s = m_slots[pos & (Size - 1)];
+    s.item = item;
+    s.seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /* The worker running the machine only */
+  bool pop(T &item)
+  {
+    slot &s = m_slots[m_head & (Size - 1)];
+
+    if(s.seq.load(std::memory_order_acquire) != m_head + 1) { return false; }
+    item = s.item;
+    s.seq.store(m_head + Size, std::memory_order_release);
+    m_head++;
+    return true;
+  }
+
+  /* Consumer position, to be passed to ready() once the mailbox may have
+   * another consumer */
+  uint32_t head() const { return m_head; }
+
+  /* Any thread: the event at position head has been published */
+  bool ready(uint32_t head) const
+  {
+    return m_slots[head & (Size - 1)].seq.load(std::memory_order_acquire) == head + 1;
+  }
+
+private:
+  struct slot
+  {
+    std::atomic<uint32_t> seq;
+    T item;
+  };
+
+  alignas(cache_line) std::atomic<uint32_t> m_tail{0};   /* producers */
+  alignas(cache_line) uint32_t m_head = 0;               /* consumer */
+  slot m_slots[Size];
+};
+
+/* Bounded MPMC queue of pointers, same scheme with a CAS on the head too */
+template <typename T>
+class injection_queue
+{
+public:
+  explicit injection_queue(std::size_t capacity)
+    : m_mask(round_up_pow2(capacity) - 1), m_slots(new slot[m_mask + 1])
+  {
+    for(std::size_t i = 0; i <= m_mask; i++) { m_slots[i].seq.store(i, std::memory_order_relaxed); }
+  }
+
+  bool push(T *item)
+  {
+    std::size_t pos = m_tail.load(std::memory_order_relaxed);
+
+    while(true)
+    {
+      slot &s = m_slots[pos & m_mask];
+      intptr_t diff = static_cast<intptr_t>(s.seq.load(std::memory_order_acquire) - pos);
+
+      if(diff == 0)
+      {
+        if(m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+      }
+      else if(diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = m_tail.load(std::memory_order_relaxed);
+      }
+    }
+    slot &s = m_slots[pos & m_mask];
+    s.item = item;
+    s.seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  T *pop()
+  {
+    std::size_t pos = m_head.load(std::memory_order_relaxed);
+
+    while(true)
+    {
+      slot &s = m_slots[pos & m_mask];
+      intptr_t diff = static_cast<intptr_t>(s.seq.load(std::memory_order_acquire) - (pos + 1));
+
+      if(diff == 0)
+      {
+        if(m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+      }
+      else if(diff < 0)
+      {
+        return nullptr;
+      }
+      else
+      {
+        pos = m_head.load(std::memory_order_relaxed);
+      }
+    }
+    slot &s = m_slots[pos & m_mask];
+    T *item = s.item;
+    s.seq.store(pos + m_mask + 1, std::memory_order_release);
+    return item;
+  }
+
+private:
+  struct slot
+  {
+    std::atomic<std::size_t> seq;
+    T *item;
+  };
+
+  alignas(cache_line) std::atomic<std::size_t> m_tail{0};
+  alignas(cache_line) std::atomic<std::size_t> m_head{0};
+  std::size_t m_mask;
+  std::unique_ptr<slot[]> m_slots;
+};
+
+/* Chase-Lev work-stealing deque, fixed capacity (Le et al., PPoPP 2013) */
+template <typename T>
+class ws_deque
+{
+public:
+  explicit ws_deque(std::size_t capacity)
+    : m_mask(round_up_pow2(capacity) - 1), m_buf(new std::atomic<T *>[m_mask + 1])
+  {
+  }
+
+  /* Owner only */
+  void push(T *item)
+  {
+    int64_t b = m_bottom.load(std::memory_order_relaxed);
+
+    m_buf[static_cast<std::size_t>(b) & m_mask].store(item, std::memory_order_relaxed);
+    m_bottom.store(b + 1, std::memory_order_release);
+  }
+
+  /* Owner only, newest first */
+  T *pop()
+  {
+    int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+    int64_t t;
+    T *item = nullptr;
+
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    t = m_top.load(std::memory_order_relaxed);
+    if(t <= b)
+    {
+      item = m_buf[static_cast<std::size_t>(b) & m_mask].load(std::memory_order_relaxed);
+      if(t == b)
+      {
+        // last one, race the thieves for it
+        if(!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+          item = nullptr;
+        }
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+      }
+    }
+    else
+    {
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+
+  /* Any thread, oldest first, nullptr when empty or lost a race */
+  T *steal()
+  {
+    int64_t t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = m_bottom.load(std::memory_order_acquire);
+
+    if(t >= b) { return nullptr; }
+    T *item = m_buf[static_cast<std::size_t>(t) & m_mask].load(std::memory_order_relaxed);
+    if(!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+      return nullptr;
+    }
+    return item;
+  }
+
+private:
+  alignas(cache_line) std::atomic<int64_t> m_top{0};
+  alignas(cache_line) std::atomic<int64_t> m_bottom{0};
+  std::size_t m_mask;
+  std::unique_ptr<std::atomic<T *>[]> m_buf;
+};
+
+struct no_observer
+{
+  template <typename Exec, typename Event>
+  static void dispatched(Exec &, uint32_t, Event const &, status) {}
+};
+
+/* Observer::dispatched(exec, id, event, status) runs on the worker after each
+ * event, it may post further events. */
+template <typename Machine, typename Observer = no_observer, std::size_t MailboxSize = 16>
+class executor
+{
+public:
+  using context = typename Machine::context_type;
+  using state_type = typename Machine::state_type;
+  using signal_type = typename Machine::signal_type;
+
+  /* events a machine runs before it goes back to the end of the line */
+  static constexpr unsigned batch = 32;
+  /* empty polls before an idle worker yields its core */
+  static constexpr unsigned idle_spins = 64;
+
+  struct event
+  {
+    uint64_t posted_ns;
+    signal_type sig;
+    uint32_t tag;       /* free for the poster */
+  };
+
+  struct stats_t
+  {
+    uint64_t dispatched = 0;
+    uint64_t dropped = 0;     /* mailbox full */
+    uint64_t steals = 0;
+    latency_histogram latency;  /* post to dispatch, ns */
+  };
+
+  executor(std::size_t machines, state_type initial)
+    : m_count(machines), m_actors(new actor[machines]), m_inject(machines)
+  {
+    for(std::size_t i = 0; i < machines; i++)
+    {
+      m_actors[i].id = static_cast<uint32_t>(i);
+      Machine::init(m_actors[i].ctx, initial);
+    }
+  }
+
+  ~executor() { stop(); }
+
+  executor(executor const &) = delete;
+  executor &operator=(executor const &) = delete;
+
+  std::size_t size() const { return m_count; }
+
+  /* Any thread. false when the machine's mailbox is full, the event is dropped. */
+  bool post(uint32_t id, signal_type sig, uint32_t tag = 0)
+  {
+    actor &a = m_actors[id];
+
+    if(!a.box.push(event{now_ns(), sig, tag}))
+    {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    // pairs with the fence in run(): either we see scheduled cleared or the worker sees the event
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(!a.scheduled.exchange(true, std::memory_order_acq_rel))
+    {
+      schedule(&a);
+    }
+    return true;
+  }
+
+  void start(unsigned threads)
+  {
+    if(threads == 0) { threads = 1; }
+    m_running.store(true, std::memory_order_relaxed);
+    for(unsigned i = 0; i < threads; i++)
+    {
+      m_workers.emplace_back(new worker(m_count, i));
+      m_workers.back()->owner = this;
+    }
+    for(auto &w : m_workers)
+    {
+      worker *p = w.get();
+      p->thread = std::thread([this, p] { worker_main(*p); });
+    }
+  }
+
+  /* Joins the pool, queued events stay queued */
+  void stop()
+  {
+    m_running.store(false, std::memory_order_relaxed);
+    for(auto &w : m_workers)
+    {
+      if(w->thread.joinable()) { w->thread.join(); }
+    }
+    for(auto &w : m_workers)
+    {
+      m_retired.dispatched += w->stats.dispatched;
+      m_retired.steals += w->stats.steals;
+      m_retired.latency.merge(w->stats.latency);
+      // machines still queued locally go back to the shared queue
+      for(actor *a = w->runq.pop(); a != nullptr; a = w->runq.pop()) { m_inject.push(a); }
+    }
+    m_workers.clear();
+  }
+
+  /* Only while stopped */
+  context const &ctx(uint32_t id) const { return m_actors[id].ctx; }
+
+  stats_t stats() const
+  {
+    stats_t s = m_retired;
+    s.dropped = m_dropped.load(std::memory_order_relaxed);
+    return s;
+  }
+
+private:
+  struct alignas(cache_line) actor
+  {
+    std::atomic<bool> scheduled{false};
+    uint32_t id = 0;
+    context ctx{};
+    mailbox<event, MailboxSize> box;
+  };
+
+  struct alignas(cache_line) worker
+  {
+    worker(std::size_t machines, unsigned index) : runq(machines), rng(index + 1) {}
+
+    ws_deque<actor> runq;
+    executor *owner = nullptr;
+    std::thread thread;
+    std::minstd_rand rng;
+    uint32_t ticks = 0;
+    stats_t stats;
+  };
+
+  inline static thread_local worker *t_self = nullptr;
+
+  void schedule(actor *a)
+  {
+    worker *w = t_self;
+
+    if((w != nullptr) && (w->owner == this))
+    {
+      w->runq.push(a);
+    }
+    else
+    {
+      while(!m_inject.push(a)) { std::this_thread::yield(); }  // sized for every machine, only transient
+    }
+  }
+
+  void run(worker &w, actor *a)
+  {
+    event e;
+    uint32_t head;
+
+    for(unsigned n = 0; (n < batch) && a->box.pop(e); n++)
+    {
+      w.stats.latency.record(now_ns() - e.posted_ns);
+      status s = Machine::dispatch(a->ctx, e.sig);
+      w.stats.dispatched++;
+      Observer::dispatched(*this, a->id, e, s);
+    }
+    // once scheduled is clear another worker may own the machine, mind its head
+    head = a->box.head();
+    a->scheduled.store(false, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(a->box.ready(head) && !a->scheduled.exchange(true, std::memory_order_acq_rel))
+    {
+      // batch used up or a post raced the clear: FIFO so busy machines take turns
+      while(!m_inject.push(a)) { std::this_thread::yield(); }
+    }
+  }
+
+  actor *steal(worker &w)
+  {
+    std::size_t n = m_workers.size();
+    std::size_t start = w.rng() % n;
+
+    for(std::size_t i = 0; i < n; i++)
+    {
+      worker &victim = *m_workers[(start + i) % n];
+      if(&victim == &w) { continue; }
+      actor *a = victim.runq.steal();
+      if(a != nullptr)
+      {
+        w.stats.steals++;
+        return a;
+      }
+    }
+    return nullptr;
+  }
+
+  actor *next(worker &w)
+  {
+    actor *a = nullptr;
+
+    // look at the shared queue first now and then, local work cannot starve it
+    if((++w.ticks % 61) == 0) { a = m_inject.pop(); }
+    // own deque oldest first too: LIFO would leave early machines waiting
+    // behind every newly woken one, and their mailboxes overflow meanwhile
+    if(a == nullptr) { a = w.runq.steal(); }
+    if(a == nullptr) { a = m_inject.pop(); }
+    if(a == nullptr) { a = steal(w); }
+    return a;
+  }
+
+  void worker_main(worker &w)
+  {
+    unsigned idle = 0;
+
+    t_self = &w;
+    while(m_running.load(std::memory_order_relaxed))
+    {
+      actor *a = next(w);
+      if(a != nullptr)
+      {
+        run(w, a);
+        idle = 0;
+      }
+      else if(++idle >= idle_spins)
+      {
+        std::this_thread::yield();
+        idle = 0;
+      }
+    }
+    t_self = nullptr;
+  }
+
+  std::size_t m_count;
+  std::unique_ptr<actor[]> m_actors;
+  injection_queue<actor> m_inject;
+  std::vector<std::unique_ptr<worker>> m_workers;
+  std::atomic<bool> m_running{false};
+  std::atomic<uint64_t> m_dropped{0};
+  stats_t m_retired;
+};
+
+} // namespace fsm
+
+#endif
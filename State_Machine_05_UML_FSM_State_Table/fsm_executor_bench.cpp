@@ -0,0 +1,86 @@
+/* Scaling benchmark of fsm_executor.hpp with the app_fsm.hpp machine.
+ *
+ *   g++ -std=c++17 -O2 -pthread fsm_executor_bench.cpp -o fsm_executor_bench
+ *   ./fsm_executor_bench [machines] [max_threads] [in_flight] [seconds]
+ *
+ * A fixed number of events is kept in flight: every dispatched event is
+ * forwarded with a pseudo random signal to a pseudo random machine, so the
+ * load is closed loop and the same for every thread count. Per thread count
+ * it reports throughput, efficiency against one thread and the post to
+ * dispatch latency percentiles. Counts above the core count only measure
+ * oversubscription.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include "app_fsm.hpp"
+#include "fsm_executor.hpp"
+
+/* Digital twins have no LEDs */
+extern "C" {
+void app_fsm_display_leds(uint8_t) {}
+void app_fsm_display_clear(void) {}
+void app_fsm_blink_start(void) {}
+void app_fsm_blink_stop(void) {}
+}
+
+static uint32_t xorshift32(uint32_t x)
+{
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+static app::signal signal_of(uint32_t r)
+{
+  return static_cast<app::signal>((r >> 16) % static_cast<uint32_t>(app::signal::count));
+}
+
+struct forward
+{
+  template <typename Exec, typename Event>
+  static void dispatched(Exec &exec, uint32_t, Event const &e, fsm::status)
+  {
+    uint32_t r = xorshift32(e.tag);
+    exec.post(r % exec.size(), signal_of(r), r);
+  }
+};
+
+using twin_executor = fsm::executor<app::machine, forward>;
+
+int main(int argc, char **argv)
+{
+  std::size_t machines = (argc > 1) ? std::strtoul(argv[1], nullptr, 0) : 32768;
+  unsigned max_threads = (argc > 2) ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 0)) : 64;
+  std::size_t in_flight = (argc > 3) ? std::strtoul(argv[3], nullptr, 0) : 4096;
+  double seconds = (argc > 4) ? std::strtod(argv[4], nullptr) : 1.0;
+  double base = 0.0;
+
+  std::printf("%zu machines, %zu events in flight, %u hardware threads\n",
+              machines, in_flight, std::thread::hardware_concurrency());
+  std::printf("threads    Mev/s  efficiency    p50 us    p99 us  p99.9 us    max us    steals  dropped\n");
+
+  for(unsigned threads = 1; threads <= max_threads; threads *= 2)
+  {
+    twin_executor exec(machines, app::state::IDLE);
+
+    for(std::size_t i = 0; i < in_flight; i++)
+    {
+      uint32_t r = xorshift32(static_cast<uint32_t>(i) + 1);
+      exec.post(static_cast<uint32_t>(i % machines), signal_of(r), r);
+    }
+    exec.start(threads);
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    exec.stop();
+
+    twin_executor::stats_t s = exec.stats();
+    double rate = static_cast<double>(s.dispatched) / seconds;
+    if(threads == 1) { base = rate; }
+    std::printf("%7u %8.2f %10.1f%% %9.1f %9.1f %9.1f %9.1f %9llu %8llu\n",
+                threads, rate / 1e6, (base > 0.0) ? (100.0 * rate / (base * threads)) : 0.0,
+                s.latency.percentile(0.50) / 1e3, s.latency.percentile(0.99) / 1e3,
+                s.latency.percentile(0.999) / 1e3, s.latency.max() / 1e3,
+                static_cast<unsigned long long>(s.steals), static_cast<unsigned long long>(s.dropped));
+  }
+  return 0;
+}
@@ -0,0 +1,416 @@
+/* Flash and RAM per module of every variant, from the SES linker map files.
+ *
+ *   g++ -std=c++17 -O2 fsm_footprint.cpp -o fsm_footprint
+ *   ./fsm_footprint [--build] [--config Debug] [--baseline footprint_baseline.txt]
+ *                   [--update] [--slack 32] ../State_Machine_0*
+ *
+ * Per project directory it reads pca10056/blank/ses/<name>.emProject and
+ * Output/<config>/Exe/<name>.map. --build first rebuilds every project in
+ * the same configuration with emBuild (the EMBUILD environment variable
+ * overrides its path). Input sections are summed per object file and the
+ * object files grouped into modules by the rules below: an allocated
+ * section below RAM counts as flash, one in RAM as RAM, initialised data
+ * as both. Linker fill counts for its output section, .heap and .stack in
+ * full as stack_heap.
+ * With --baseline every module growing by more than --slack bytes is a
+ * regression and the exit status is 1; --update rewrites the baseline.
+ * No baseline is kept in the tree: write one with --update from a build of
+ * the revision to compare against, in the configuration compared.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr uint64_t ram_start = 0x20000000;
+constexpr uint64_t ram_end = 0x30000000;
+constexpr uint64_t no_address = ~0ULL;
+
+/* First match wins, patterns are substrings of the object file name. The
+ * optional fsm_ modules come before the core, together with the SDK drivers
+ * only they pull in, so each shows what enabling it costs */
+struct module_rule
+{
+  char const *module;
+  std::vector<char const *> patterns;
+};
+
+std::vector<module_rule> const rules = {
+  {"logging",       {"fsm_log.o", "fsm_trace.o"}},
+  {"monitoring",    {"fsm_latency.o", "fsm_deadline.o"}},
+  {"link",          {"fsm_link.o", "nrfx_uarte", "nrfx_prs", "crc16"}},
+  {"persistence",   {"fsm_persist.o", "fds", "fstorage", "nrf_atfifo", "nrf_atflags"}},
+  {"queue",         {"fsm_queue.o"}},
+  {"fsm_core",      {"main.o", "fsm_hotswap.o", "fsm_transition.o", "fsm_region.o"}},
+  {"handlers",      {"state_machine.o", "app_regions.o"}},
+  {"app_io",        {"led_bank.o", "led_blink.o", "port_input.o", "button_scan.o", "pot_input.o", "fsm_admit.o",
+                     "app_fsm_port.o"}},
+  {"fsm_other",     {"fsm_"}},
+  {"printf",        {"vfprintf", "libdebugio", "debug_operations", "SEGGER_RTT", "nrf_log", "nrf_fprintf", "retarget"}},
+  {"app_timer",     {"app_timer", "drv_rtc", "nrfx_clock", "nrf_drv_clock"}},
+  {"gpiote",        {"nrfx_gpiote", "nrf_drv_gpiote"}},
+  {"startup",       {"system_nrf", "ses_startup", "thumb_crt0"}},
+  {"libc",          {".a("}},
+  {"sdk",           {".o"}},
+};
+
+struct footprint
+{
+  uint64_t flash = 0;
+  uint64_t ram = 0;
+};
+
+using module_map = std::map<std::string, footprint>;
+
+std::string module_of(std::string const &object)
+{
+  for(module_rule const &rule : rules)
+  {
+    for(char const *pattern : rule.patterns)
+    {
+      if(object.find(pattern) != std::string::npos)
+      {
+        return rule.module;
+      }
+    }
+  }
+  return "other";
+}
+
+bool allocated(std::string const &section, uint64_t vma)
+{
+  static char const *const skip[] = {".debug", ".comment", ".ARM", ".iplt", ".igot", ".rel", ".stab"};
+
+  for(char const *prefix : skip)
+  {
+    if(section.rfind(prefix, 0) == 0)
+    {
+      return false;
+    }
+  }
+  return vma < ram_end;
+}
+
+/* Output section being read */
+struct output_section
+{
+  std::string name;
+  uint64_t vma = no_address;
+  uint64_t size = 0;
+  bool load = false;      /* has a load address, initialised data */
+  uint64_t inputs = 0;    /* bytes of the input sections seen */
+};
+
+void add(module_map &modules, output_section const &out, std::string const &module, uint64_t size)
+{
+  footprint &fp = modules[module];
+  bool ram = (out.vma >= ram_start);
+
+  if(!ram || out.load)
+  {
+    fp.flash += size;
+  }
+  if(ram)
+  {
+    fp.ram += size;
+  }
+}
+
+void close(module_map &modules, output_section const &out)
+{
+  if(out.name.empty() || !allocated(out.name, out.vma) || (out.size <= out.inputs))
+  {
+    return;
+  }
+  bool stack_heap = (out.name == ".heap") || (out.name.rfind(".stack", 0) == 0);
+  add(modules, out, stack_heap ? "stack_heap" : "other", out.size - out.inputs);
+}
+
+bool parse_map(fs::path const &path, module_map &modules)
+{
+  std::ifstream in(path);
+  std::string line;
+  std::string pending;      // input section name whose numbers are on the next line
+  output_section out;
+  bool in_map = false;
+  static std::regex const out_head(R"(^(\.[^\s]+)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)(\s+load address\s+0x[0-9a-fA-F]+)?)?\s*$)");
+  static std::regex const out_nums(R"(^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)(\s+load address.*)?$)");
+  static std::regex const in_full(R"(^ (\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$)");
+  static std::regex const in_name(R"(^ (\S+)\s*$)");
+  static std::regex const in_nums(R"(^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$)");
+  std::smatch m;
+
+  if(!in)
+  {
+    std::perror(path.string().c_str());
+    return false;
+  }
+  while(std::getline(in, line))
+  {
+    if(!line.empty() && (line.back() == '\r'))
+    {
+      line.pop_back();
+    }
+    if(!in_map)
+    {
+      in_map = (line.rfind("Linker script and memory map", 0) == 0);
+      continue;
+    }
+    if(line.empty())
+    {
+      continue;
+    }
+    if(line[0] == '.')
+    {
+      close(modules, out);
+      out = output_section();
+      pending.clear();
+      if(std::regex_match(line, m, out_head))
+      {
+        out.name = m[1];
+        if(m[2].matched)
+        {
+          out.vma = std::stoull(m[2], nullptr, 16);
+          out.size = std::stoull(m[3], nullptr, 16);
+          out.load = m[4].matched;
+        }
+      }
+      else
+      {
+        std::istringstream(line) >> out.name;
+      }
+      continue;
+    }
+    if((out.vma == no_address) && !out.name.empty() && std::regex_match(line, m, out_nums))
+    {
+      // long output section name, numbers on the next line
+      out.vma = std::stoull(m[1], nullptr, 16);
+      out.size = std::stoull(m[2], nullptr, 16);
+      out.load = m[3].matched;
+      continue;
+    }
+    if(!allocated(out.name, out.vma))
+    {
+      continue;
+    }
+
+    std::string object;
+    uint64_t size = 0;
+
+    if(std::regex_match(line, m, in_full) && (m[1] != "*fill*"))
+    {
+      size = std::stoull(m[3], nullptr, 16);
+      object = m[4];
+    }
+    else if(!pending.empty() && std::regex_match(line, m, in_nums))
+    {
+      size = std::stoull(m[2], nullptr, 16);
+      object = m[3];
+      pending.clear();
+    }
+    else if(std::regex_match(line, m, in_name) && (m[1].str()[0] == '.'))
+    {
+      pending = m[1];
+      continue;
+    }
+    else
+    {
+      continue;
+    }
+    if(object.rfind("load address", 0) == 0)
+    {
+      continue;
+    }
+    object = fs::path(object).filename().string();
+    out.inputs += size;
+    add(modules, out, module_of(object), size);
+  }
+  close(modules, out);
+  return in_map;
+}
+
+std::string project_name(fs::path const &project_file)
+{
+  std::ifstream in(project_file);
+  std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  std::smatch m;
+  static std::regex const name(R"re(<project\s+Name="([^"]+)")re");
+
+  return std::regex_search(text, m, name) ? m[1].str() : project_file.stem().string();
+}
+
+fs::path find_project(fs::path const &dir)
+{
+  fs::path ses = dir / "pca10056" / "blank" / "ses";
+  std::error_code ec;
+
+  for(fs::directory_entry const &entry : fs::directory_iterator(ses, ec))
+  {
+    if(entry.path().extension() == ".emProject")
+    {
+      return entry.path();
+    }
+  }
+  return {};
+}
+
+bool build(fs::path const &project_file, std::string const &config)
+{
+  char const *embuild = std::getenv("EMBUILD");
+  std::string cmd = std::string((embuild != nullptr) ? embuild : "emBuild") +
+                    " -config \"" + config + "\" -rebuild \"" + project_file.string() + "\"";
+
+  std::fprintf(stderr, "%s\n", cmd.c_str());
+  return std::system(cmd.c_str()) == 0;
+}
+
+using baseline_map = std::map<std::pair<std::string, std::string>, footprint>;
+
+baseline_map load_baseline(fs::path const &path)
+{
+  baseline_map out;
+  std::ifstream in(path);
+  std::string line;
+
+  while(std::getline(in, line))
+  {
+    std::istringstream fields(line);
+    std::string variant, module;
+    footprint fp;
+
+    if(line.empty() || (line[0] == '#') || !(fields >> variant >> module >> fp.flash >> fp.ram))
+    {
+      continue;
+    }
+    out[{variant, module}] = fp;
+  }
+  return out;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  std::string config = "Debug";
+  fs::path baseline_path;
+  bool do_build = false;
+  bool update = false;
+  uint64_t slack = 32;
+  std::vector<fs::path> dirs;
+  std::vector<std::pair<std::string, std::vector<std::pair<std::string, footprint>>>> variants;
+  int regressions = 0;
+
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+
+    if((arg == "--config") && (i + 1 < argc))        { config = argv[++i]; }
+    else if((arg == "--baseline") && (i + 1 < argc)) { baseline_path = argv[++i]; }
+    else if((arg == "--slack") && (i + 1 < argc))    { slack = std::strtoull(argv[++i], nullptr, 0); }
+    else if(arg == "--build")                         { do_build = true; }
+    else if(arg == "--update")                        { update = true; }
+    else if(arg.rfind("--", 0) == 0)
+    {
+      std::fprintf(stderr, "usage: %s [--build] [--config name] [--baseline file] [--update] [--slack bytes] project_dir...\n", argv[0]);
+      return 2;
+    }
+    else                                              { dirs.emplace_back(arg); }
+  }
+  if(dirs.empty() || (update && baseline_path.empty()))
+  {
+    std::fprintf(stderr, "%s: project directories%s needed\n", argv[0], update ? " and --baseline" : "");
+    return 2;
+  }
+
+  for(fs::path const &dir : dirs)
+  {
+    fs::path project_file = find_project(dir);
+    module_map modules;
+
+    if(project_file.empty())
+    {
+      std::fprintf(stderr, "%s: no .emProject\n", dir.string().c_str());
+      return 2;
+    }
+    std::string name = project_name(project_file);
+    if(do_build && !build(project_file, config))
+    {
+      std::fprintf(stderr, "%s: build failed\n", name.c_str());
+      return 2;
+    }
+    fs::path map = project_file.parent_path() / "Output" / config / "Exe" / (name + ".map");
+    if(!parse_map(map, modules))
+    {
+      std::fprintf(stderr, "%s: not a linker map\n", map.string().c_str());
+      return 2;
+    }
+    footprint total;
+    std::vector<std::pair<std::string, footprint>> rows(modules.begin(), modules.end());
+
+    for(auto const &row : modules)
+    {
+      total.flash += row.second.flash;
+      total.ram += row.second.ram;
+    }
+    rows.emplace_back("TOTAL", total);
+    variants.emplace_back(name, std::move(rows));
+  }
+
+  baseline_map baseline = baseline_path.empty() ? baseline_map() : load_baseline(baseline_path);
+  bool compare = !baseline.empty() && !update;
+
+  std::printf("%-40s %-14s %8s %8s%s\n", "variant", "module", "flash", "ram", compare ? "   d flash    d ram" : "");
+  for(auto const &variant : variants)
+  {
+    for(auto const &row : variant.second)
+    {
+      std::printf("%-40s %-14s %8llu %8llu", variant.first.c_str(), row.first.c_str(),
+                  static_cast<unsigned long long>(row.second.flash), static_cast<unsigned long long>(row.second.ram));
+      if(compare)
+      {
+        auto it = baseline.find({variant.first, row.first});
+        footprint base = (it != baseline.end()) ? it->second : footprint();
+        long long d_flash = static_cast<long long>(row.second.flash) - static_cast<long long>(base.flash);
+        long long d_ram = static_cast<long long>(row.second.ram) - static_cast<long long>(base.ram);
+        bool regressed = (d_flash > static_cast<long long>(slack)) || (d_ram > static_cast<long long>(slack));
+
+        std::printf(" %+9lld %+8lld%s", d_flash, d_ram, regressed ? "  REGRESSION" : "");
+        regressions += regressed;
+      }
+      std::printf("\n");
+    }
+  }
+
+  if(update)
+  {
+    std::ofstream out(baseline_path);
+
+    out << "# fsm_footprint baseline, config " << config << ": variant module flash ram\n";
+    for(auto const &variant : variants)
+    {
+      for(auto const &row : variant.second)
+      {
+        out << variant.first << ' ' << row.first << ' ' << row.second.flash << ' ' << row.second.ram << '\n';
+      }
+    }
+    std::fprintf(stderr, "baseline written to %s\n", baseline_path.string().c_str());
+  }
+  if(regressions > 0)
+  {
+    std::fprintf(stderr, "%d regression(s) above %llu bytes\n", regressions, static_cast<unsigned long long>(slack));
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,155 @@
+/* Host measurement of entering BLINK from PAUSE, per FSM_HISTORY setting.
+ *
+ *   for h in 0 1 2; do
+ *     gcc -std=gnu99 -O2 -DHAL_POSIX -DFSM_HISTORY_BENCH -DFSM_HISTORY=$h -I. -I../State_Machine_Common \
+ *         fsm_history_bench.c state_machine.c led_bank.c led_blink.c fsm_latency.c fsm_persist.c fsm_log.c \
+ *         fds_posix.c ../State_Machine_Common/hal_posix.c -o fsm_history_bench_$h
+ *     ./fsm_history_bench_$h [rounds]
+ *   done
+ *
+ * Every round blinks, pauses and resumes after pseudo random virtual times.
+ * Per resume it reports the host time of the dispatch (PAUSE exit plus BLINK
+ * entry), the LED writes it took, and how far the next toggle is from where an
+ * uninterrupted blink with the pause cut out would have put it, modulo the
+ * period. Virtual time runs from event to event, so the toggle time is exact.
+ * With history the LEDs must come back as they were left, with deep history
+ * the next toggle must also be within BENCH_DEEP_ERR_MAX_US (the ms the
+ * remaining time is rounded to).
+ */
+#if defined(FSM_HISTORY_BENCH)
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "main.h"
+#include "led_bank.h"
+#include "fsm_persist.h"
+#include "fsm_event.h"
+
+#if !FSM_FUSED_TRANSITIONS
+#error "the bench dispatches through fsm_fused_state_table"
+#endif
+
+#define BENCH_ROUNDS_DEFAULT  2000
+#define BENCH_PERIOD_US       200000
+#define BENCH_DEEP_ERR_MAX_US 1000
+
+static uint32_t m_rand = 1;
+
+
+static uint32_t bench_rand(uint32_t range)
+{
+  m_rand ^= m_rand << 13;
+  m_rand ^= m_rand >> 17;
+  m_rand ^= m_rand << 5;
+  return m_rand % range;
+}
+
+static void dispatch(app_t *const myApp, fsm_signal_t sig)
+{
+  fsm_event_t e = {0};
+  e_handler_t ehandler = (e_handler_t) myApp->state_table[(myApp->active_state * MAX_SIGNALS) + sig];
+
+  e.super.sig = sig;
+  (void)(*ehandler)(myApp, &e.super);
+}
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_u64(void const *a, void const *b)
+{
+  uint64_t x = *(uint64_t const *)a;
+  uint64_t y = *(uint64_t const *)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+  static app_t app;
+  unsigned rounds = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : BENCH_ROUNDS_DEFAULT;
+  uint64_t *resume_ns = calloc(rounds, sizeof(uint64_t));
+  uint64_t writes = 0, err_sum = 0, err_max = 0;
+  uint64_t blink_us = 0;               // virtual time spent in BLINK, pauses cut out
+  uint64_t since;
+  unsigned kept = 0;
+  bool pass;
+
+  freopen("/dev/null", "w", stdout);   // handler printfs
+  hal_init();
+  fsm_persist_init();                  // fsm_init restores from the host flash, erased
+  led_bank_init(LED_GROUP, LED_COUNT, true);
+  app.state_table = (uintptr_t *) &fsm_fused_state_table[0][0];
+  fsm_init(&app);
+  dispatch(&app, INC_LED);             // IDLE -> LED_SET
+  dispatch(&app, INC_LED);
+  dispatch(&app, INC_LED);             // 2 LEDs
+  dispatch(&app, START_PAUSE);         // LED_SET -> BLINK
+  since = hal_posix_time_us();
+  m_rand = 0x9E3779B9;
+
+  for(unsigned r = 0; r < rounds; r++)
+  {
+    uint64_t left_us, expected_us, toggle_us, err;
+    uint32_t w;
+    bool lit;
+    uint64_t t0;
+
+    hal_posix_run_until(hal_posix_time_us() + 1000 + bench_rand(4 * BENCH_PERIOD_US));
+    lit = !hal_posix_output_get(LED_ONE);   // active low
+    t0 = hal_posix_time_us();
+    dispatch(&app, START_PAUSE);            // BLINK -> PAUSE
+    // the rest of the blink period the pause cut into is still due after the resume
+    blink_us += t0 - since;
+    left_us = BENCH_PERIOD_US - (blink_us % BENCH_PERIOD_US);
+    hal_posix_run_until(t0 + 1000 + bench_rand(2 * BENCH_PERIOD_US));
+
+    w = led_bank_writes_get();
+    t0 = host_ns();
+    dispatch(&app, START_PAUSE);            // PAUSE -> BLINK
+    resume_ns[r] = host_ns() - t0;
+    since = hal_posix_time_us();
+    writes += led_bank_writes_get() - w;
+    if(lit == !hal_posix_output_get(LED_ONE))
+    {
+      kept++;
+    }
+
+    // run virtual time event by event up to the first toggle after the resume
+    expected_us = hal_posix_time_us() + left_us;
+    w = led_bank_writes_get();
+    while(led_bank_writes_get() == w)
+    {
+      hal_idle();
+    }
+    toggle_us = hal_posix_time_us();
+    // measured per resume: the reference is realigned to the toggle seen
+    blink_us += left_us;
+    since = toggle_us;
+    err = ((toggle_us + BENCH_PERIOD_US) - expected_us) % BENCH_PERIOD_US;
+    err = (err > (BENCH_PERIOD_US / 2)) ? (BENCH_PERIOD_US - err) : err;
+    err_sum += err;
+    err_max = (err > err_max) ? err : err_max;
+  }
+
+  qsort(resume_ns, rounds, sizeof(uint64_t), cmp_u64);
+  fprintf(stderr, "FSM_HISTORY=%d, %u resumes\n", FSM_HISTORY, rounds);
+  fprintf(stderr, "resume host ns     p50 %llu  p99 %llu  max %llu\n",
+          (unsigned long long)resume_ns[rounds / 2], (unsigned long long)resume_ns[(rounds * 99) / 100],
+          (unsigned long long)resume_ns[rounds - 1]);
+  fprintf(stderr, "LED writes/resume  %.2f\n", (double)writes / rounds);
+  fprintf(stderr, "blink phase kept   %.1f%%\n", (100.0 * kept) / rounds);
+  fprintf(stderr, "next toggle error  mean %llu us  max %llu us\n", (unsigned long long)(err_sum / rounds),
+          (unsigned long long)err_max);
+  pass = ((FSM_HISTORY == FSM_HISTORY_NONE) || (kept == rounds)) &&
+         ((FSM_HISTORY != FSM_HISTORY_DEEP) || (err_max <= BENCH_DEEP_ERR_MAX_US));
+  fprintf(stderr, "%s\n", pass ? "ok" : "FAIL");
+  free(resume_ns);
+  return pass ? 0 : 1;
+}
+
+#endif /* FSM_HISTORY_BENCH */
@@ -0,0 +1,241 @@
+#include "fsm_hotswap.h"
+#include <stddef.h>
+#include <string.h>
+#include "hal.h"
+#include "fsm_event.h"
+
+#define FSM_HOTSWAP_IDS   (MAX_STATE * MAX_SIGNALS)
+
+/* Owner of the spare table, changed by the loader (FREE -> LOADING -> READY)
+ * and the dispatcher (READY -> RETIRED -> FREE) */
+typedef enum
+{
+  SPARE_FREE,
+  SPARE_LOADING,
+  SPARE_READY,        /* decoded image waiting for the next dispatch */
+  SPARE_RETIRED       /* the table swapped out, until the outermost dispatch returns */
+}spare_state_t;
+
+static e_handler_t const *m_registry;                       /**< The compiled table, ids index it. */
+static e_handler_t m_tables[2][MAX_STATE][MAX_SIGNALS];
+static uint8_t m_remap[MAX_STATE];
+static uint8_t m_spare;
+static volatile spare_state_t m_spare_state;
+static volatile uint8_t m_depth;                            /**< Dispatches in progress, nested by preemption. */
+static uint16_t m_version;
+static uint16_t m_pending_version;
+static uint32_t m_ready_ticks;
+static fsm_table_image_t m_image;                           /**< Aligned copy of the image being loaded. */
+static fsm_hotswap_stats_t m_stats;
+
+
+/**@brief The compiled table in myApp->state_table is version 0 and the registry of ids.
+ */
+void fsm_hotswap_init(app_t *const myApp)
+{
+  m_registry = (e_handler_t const *)myApp->state_table;
+  m_spare = 0;
+  m_spare_state = SPARE_FREE;
+  m_version = 0;
+  memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/**@brief CRC-16/CCITT-FALSE, the same value as crc16_compute(p_data, len, NULL).
+ */
+uint16_t fsm_hotswap_crc(void const *p_data, uint32_t len)
+{
+  uint8_t const *p_byte = p_data;
+  uint16_t crc = 0xFFFF;
+
+  for(uint32_t i = 0; i < len; i++)
+  {
+    crc = (uint8_t)(crc >> 8) | (crc << 8);
+    crc ^= p_byte[i];
+    crc ^= (uint8_t)(crc & 0xFF) >> 4;
+    crc ^= (crc << 8) << 4;
+    crc ^= ((crc & 0xFF) << 4) << 1;
+  }
+  return crc;
+}
+
+static fsm_hotswap_result_t image_check(fsm_table_image_t const *p_image)
+{
+  if((p_image->magic != FSM_HOTSWAP_MAGIC) ||
+     (p_image->num_states != MAX_STATE) || (p_image->num_signals != MAX_SIGNALS) ||
+     (p_image->crc != fsm_hotswap_crc(p_image, offsetof(fsm_table_image_t, crc))))
+  {
+    return FSM_HOTSWAP_BAD_IMAGE;
+  }
+  if(p_image->version <= m_version)
+  {
+    return FSM_HOTSWAP_OLD_VERSION;
+  }
+  for(uint8_t state = 0; state < MAX_STATE; state++)
+  {
+    if(p_image->remap[state] >= MAX_STATE)
+    {
+      return FSM_HOTSWAP_BAD_REMAP;
+    }
+    for(uint8_t sig = 0; sig < MAX_SIGNALS; sig++)
+    {
+      uint8_t id = p_image->cells[state][sig];
+      fsm_signal_t handled = (fsm_signal_t)(id % MAX_SIGNALS);
+
+      // entry and exit actions stay entry and exit actions, events stay events
+      if((id >= FSM_HOTSWAP_IDS) ||
+         (((sig == ENTRY) || (sig == EXIT)) ? (handled != sig) : (handled < INC_LED)))
+      {
+        return FSM_HOTSWAP_BAD_CELL;
+      }
+#if FSM_FUSED_TRANSITIONS
+      // a fused routine calls the exit action of its own source state and the
+      // compiled entry action, not the ENTRY and EXIT cells of the table
+      if((((sig == ENTRY) || (sig == EXIT)) || fsm_fused_cell[id / MAX_SIGNALS][handled]) &&
+         ((id / MAX_SIGNALS) != state))
+      {
+        return FSM_HOTSWAP_BAD_CELL;
+      }
+#endif
+      // a handler reads the payload of its own signal, the cell's event must carry it
+      if((sig >= INC_LED) &&
+         ((strcmp(fsm_event_payload_type(handled), fsm_event_payload_type((fsm_signal_t)sig)) != 0) ||
+          (fsm_event_class(handled) != fsm_event_class((fsm_signal_t)sig))))
+      {
+        return FSM_HOTSWAP_BAD_CELL;
+      }
+    }
+  }
+  return FSM_HOTSWAP_OK;
+}
+
+/**@brief Validate an image and decode it into the spare table.
+ *
+ * @details p_image may be unaligned (a link buffer) or in flash. The image
+ *          is swapped in by the next dispatch, or by fsm_hotswap_apply()
+ *          while no dispatch can run.
+ */
+fsm_hotswap_result_t fsm_hotswap_load(void const *p_image, uint32_t len)
+{
+  fsm_hotswap_result_t result;
+
+  if(m_spare_state != SPARE_FREE)
+  {
+    m_stats.rejects++;
+    return FSM_HOTSWAP_BUSY;
+  }
+  m_spare_state = SPARE_LOADING;
+  if(len != sizeof(fsm_table_image_t))
+  {
+    result = FSM_HOTSWAP_BAD_IMAGE;
+  }
+  else
+  {
+    memcpy(&m_image, p_image, sizeof(m_image));
+    result = image_check(&m_image);
+  }
+  if(result != FSM_HOTSWAP_OK)
+  {
+    m_stats.rejects++;
+    m_spare_state = SPARE_FREE;
+    return result;
+  }
+
+  for(uint8_t state = 0; state < MAX_STATE; state++)
+  {
+    for(uint8_t sig = 0; sig < MAX_SIGNALS; sig++)
+    {
+      m_tables[m_spare][state][sig] = m_registry[m_image.cells[state][sig]];
+    }
+  }
+  memcpy(m_remap, m_image.remap, sizeof(m_remap));
+  m_pending_version = m_image.version;
+  m_ready_ticks = hal_ticks();
+  m_stats.loads++;
+  m_spare_state = SPARE_READY;    // last, the dispatcher may take it from here on
+  return FSM_HOTSWAP_OK;
+}
+
+/**@brief Swap a pending image in: exit the active state on the old table,
+ *        continue in its remapped state, enter that on the new table.
+ *
+ * @details Only between run-to-completion steps: from fsm_hotswap_begin(),
+ *          or at start up before events can be dispatched.
+ *
+ * @return True if a table was swapped in.
+ */
+bool fsm_hotswap_apply(app_t *const myApp)
+{
+  app_state_t source = myApp->active_state;
+  app_state_t target;
+  uint32_t waited;
+  event_t ee;
+
+  if(m_spare_state != SPARE_READY)
+  {
+    return false;
+  }
+  target = (app_state_t)m_remap[source];
+  if(target != source)
+  {
+    ee.sig = EXIT;
+    (void)((e_handler_t)myApp->state_table[(source * MAX_SIGNALS) + EXIT])(myApp, &ee);
+  }
+  myApp->state_table = (uintptr_t *)&m_tables[m_spare][0][0];     // one word store, atomic
+  myApp->active_state = target;
+  if(target != source)
+  {
+    ee.sig = ENTRY;
+    (void)((e_handler_t)myApp->state_table[(target * MAX_SIGNALS) + ENTRY])(myApp, &ee);
+    m_stats.remaps++;
+  }
+  m_version = m_pending_version;
+  m_spare ^= 1;
+  m_spare_state = (m_depth == 0) ? SPARE_FREE : SPARE_RETIRED;
+
+  waited = hal_ticks_diff(hal_ticks(), m_ready_ticks);
+  if(waited > m_stats.swap_ticks_max)
+  {
+    m_stats.swap_ticks_max = waited;
+  }
+  m_stats.swaps++;
+  return true;
+}
+
+/**@brief Dispatcher, before the active state and its handler are read.
+ */
+void fsm_hotswap_begin(app_t *const myApp)
+{
+  m_depth++;
+  if(m_spare_state == SPARE_READY)
+  {
+    if(m_depth == 1)
+    {
+      (void)fsm_hotswap_apply(myApp);
+    }
+    else
+    {
+      m_stats.stale++;      // the preempted dispatch owns the active table
+    }
+  }
+}
+
+/**@brief Dispatcher, once exit and entry actions are done.
+ */
+void fsm_hotswap_end(void)
+{
+  m_depth--;
+  if((m_depth == 0) && (m_spare_state == SPARE_RETIRED))
+  {
+    m_spare_state = SPARE_FREE;
+  }
+}
+
+uint16_t fsm_hotswap_version(void)
+{
+  return m_version;
+}
+
+fsm_hotswap_stats_t const * fsm_hotswap_stats_get(void)
+{
+  return &m_stats;
+}
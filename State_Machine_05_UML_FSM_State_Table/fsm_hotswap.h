@@ -0,0 +1,68 @@
+#ifndef FSM_HOTSWAP_H
+#define FSM_HOTSWAP_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "main.h"
+
+
+/* Run time replacement of the state table by a versioned image.
+ *
+ * Handlers are code, an image cannot carry them: a cell holds the id of a
+ * cell of the compiled table, id = (state * MAX_SIGNALS) + signal, so an
+ * image rewires which compiled handler runs where. With
+ * FSM_FUSED_TRANSITIONS the transition routines run the exit and entry
+ * actions of the compiled table themselves: they stay in their source state
+ * and the ENTRY and EXIT cells stay the compiled ones. An accepted image is
+ * decoded into the spare of two RAM tables and swapped in by the next
+ * dispatch, before its handler runs, never inside a run-to-completion step.
+ * The table it replaces is retired until the outermost dispatch returns,
+ * a dispatch it preempted may still be using it. One loader at a time. */
+
+#define FSM_HOTSWAP_MAGIC     0x544D5346UL      /* "FSMT" */
+#define FSM_HOTSWAP_ID(state, sig)  ((uint8_t)(((state) * MAX_SIGNALS) + (sig)))
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version;       /* must be above the active version */
+  uint8_t num_states;     /* MAX_STATE */
+  uint8_t num_signals;    /* MAX_SIGNALS */
+  uint8_t remap[MAX_STATE];   /* state to continue in, per state active at the swap */
+  uint8_t cells[MAX_STATE][MAX_SIGNALS];
+  uint16_t crc;           /* CRC-16/CCITT-FALSE of the bytes before it, as crc16_compute() */
+}fsm_table_image_t;
+
+typedef enum
+{
+  FSM_HOTSWAP_OK,
+  FSM_HOTSWAP_BUSY,         /* an image is pending or the retired table may be in use */
+  FSM_HOTSWAP_BAD_IMAGE,    /* length, magic, dimensions or CRC */
+  FSM_HOTSWAP_OLD_VERSION,
+  FSM_HOTSWAP_BAD_CELL,     /* id out of range, ENTRY/EXIT cells not holding entry/exit actions, a
+                               handler of a signal with another payload type or queue class, or
+                               (fused) a transition or ENTRY/EXIT cell of another state */
+  FSM_HOTSWAP_BAD_REMAP
+}fsm_hotswap_result_t;
+
+typedef struct
+{
+  uint32_t loads;           /* images accepted */
+  uint32_t rejects;
+  uint32_t swaps;
+  uint32_t remaps;          /* swaps that moved the machine to another state */
+  uint32_t stale;           /* nested dispatches that ran on the old table with an image pending */
+  uint32_t swap_ticks_max;  /* hal ticks from accepted to swapped in */
+}fsm_hotswap_stats_t;
+
+
+void fsm_hotswap_init(app_t *const myApp);
+uint16_t fsm_hotswap_crc(void const *p_data, uint32_t len);
+fsm_hotswap_result_t fsm_hotswap_load(void const *p_image, uint32_t len);
+bool fsm_hotswap_apply(app_t *const myApp);
+void fsm_hotswap_begin(app_t *const myApp);
+void fsm_hotswap_end(void);
+uint16_t fsm_hotswap_version(void);
+fsm_hotswap_stats_t const * fsm_hotswap_stats_get(void);
+
+
+#endif
@@ -0,0 +1,273 @@
+/* Host measurement of fsm_hotswap.c under a stream of events.
+ *
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DFSM_HOTSWAP_BENCH -DFSM_HOTSWAP=1 -I. -I../State_Machine_Common \
+ *       fsm_hotswap_bench.c fsm_hotswap.c state_machine.c led_bank.c led_blink.c \
+ *       fsm_latency.c fsm_persist.c fds_posix.c fsm_log.c ../State_Machine_Common/hal_posix.c \
+ *       -o fsm_hotswap_bench
+ *   ./fsm_hotswap_bench [events]
+ *
+ * Events with pseudo random signals arrive at pseudo random virtual times.
+ * Now and then a new image is loaded, alternating between the compiled
+ * table and one with INC_LED and DEC_LED exchanged that leaves PAUSE for
+ * BLINK. A quarter of the loads arrive while a dispatch runs, with a
+ * dispatch preempting it, the way a link interrupt above the button
+ * interrupt would. It reports the host time of loading and of dispatches
+ * with and without a swap, and checks every dispatch against the table
+ * it must have run on: the newest image accepted before it started, unless
+ * it preempted a dispatch. First, images that move a fused transition or an
+ * ENTRY/EXIT cell to another state must be rejected.
+ */
+#if defined(FSM_HOTSWAP_BENCH)
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "main.h"
+#include "led_bank.h"
+#include "fsm_persist.h"
+#include "fsm_hotswap.h"
+#include "fsm_event.h"
+
+#if !FSM_FUSED_TRANSITIONS
+#error "the bench dispatches through fsm_fused_state_table"
+#endif
+
+#define BENCH_EVENTS_DEFAULT  200000
+#define BENCH_LOAD_EVERY      64      /* events between loads, on average */
+
+static uint32_t m_rand = 0x9E3779B9;
+static app_t m_app;
+static uint16_t m_accepted;           /* newest version accepted */
+static uint64_t m_wrong;              /* dispatches on a table other than the expected one */
+static unsigned m_nesting;
+static uint64_t m_remap_errors;
+static uint64_t m_dispatched;
+
+
+static uint32_t bench_rand(uint32_t range)
+{
+  m_rand ^= m_rand << 13;
+  m_rand ^= m_rand >> 17;
+  m_rand ^= m_rand << 5;
+  return m_rand % range;
+}
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_u64(void const *a, void const *b)
+{
+  uint64_t x = *(uint64_t const *)a;
+  uint64_t y = *(uint64_t const *)b;
+  return (x > y) - (x < y);
+}
+
+/**@brief Even versions are the compiled table, odd ones exchange INC_LED and DEC_LED.
+ */
+static void image_make(fsm_table_image_t *p_image, uint16_t version)
+{
+  bool swapped = (version & 1) != 0;
+
+  memset(p_image, 0, sizeof(*p_image));
+  p_image->magic = FSM_HOTSWAP_MAGIC;
+  p_image->version = version;
+  p_image->num_states = MAX_STATE;
+  p_image->num_signals = MAX_SIGNALS;
+  for(uint8_t state = 0; state < MAX_STATE; state++)
+  {
+    p_image->remap[state] = (swapped && (state == PAUSE)) ? BLINK : state;
+    for(uint8_t sig = 0; sig < MAX_SIGNALS; sig++)
+    {
+      uint8_t from = sig;
+
+      if(swapped && ((sig == INC_LED) || (sig == DEC_LED)))
+      {
+        from = (sig == INC_LED) ? DEC_LED : INC_LED;
+      }
+      p_image->cells[state][sig] = FSM_HOTSWAP_ID(state, from);
+    }
+  }
+  p_image->crc = fsm_hotswap_crc(p_image, offsetof(fsm_table_image_t, crc));
+}
+
+/**@brief Images whose fused routines would run the exit action of another state.
+ *
+ * @return True if each of them is rejected as FSM_HOTSWAP_BAD_CELL.
+ */
+static bool fused_cells_check(void)
+{
+  fsm_table_image_t image;
+  bool rejected;
+
+  image_make(&image, 1);
+  image.cells[LED_SET][START_PAUSE] = FSM_HOTSWAP_ID(IDLE, START_PAUSE);
+  image.crc = fsm_hotswap_crc(&image, offsetof(fsm_table_image_t, crc));
+  rejected = (fsm_hotswap_load(&image, sizeof(image)) == FSM_HOTSWAP_BAD_CELL);
+
+  image_make(&image, 1);
+  image.cells[PAUSE][ENTRY] = FSM_HOTSWAP_ID(LED_SET, ENTRY);
+  image.crc = fsm_hotswap_crc(&image, offsetof(fsm_table_image_t, crc));
+  rejected = (fsm_hotswap_load(&image, sizeof(image)) == FSM_HOTSWAP_BAD_CELL) && rejected;
+
+  image_make(&image, 1);
+  image.cells[IDLE][EXIT] = FSM_HOTSWAP_ID(PAUSE, EXIT);
+  image.crc = fsm_hotswap_crc(&image, offsetof(fsm_table_image_t, crc));
+  rejected = (fsm_hotswap_load(&image, sizeof(image)) == FSM_HOTSWAP_BAD_CELL) && rejected;
+  return rejected;
+}
+
+/**@brief Does the active table belong to the version?
+ */
+static bool table_is(uint16_t version)
+{
+  e_handler_t inc = (e_handler_t)m_app.state_table[FSM_HOTSWAP_ID(LED_SET, INC_LED)];
+  e_handler_t expected = fsm_fused_state_table[LED_SET][(version & 1) ? DEC_LED : INC_LED];
+
+  return inc == expected;
+}
+
+/**@brief The dispatcher of main.c, with the load of a preempting context
+ *        between its start and its handler.
+ */
+static void dispatch(fsm_signal_t sig, fsm_table_image_t const *p_preempt)
+{
+  fsm_event_t e = {0};
+  app_state_t before = m_app.active_state;
+  uint16_t version = fsm_hotswap_version();
+  e_handler_t ehandler;
+
+  fsm_hotswap_begin(&m_app);
+  if(fsm_hotswap_version() != version)
+  {
+    uint8_t remap = (fsm_hotswap_version() & 1) && (before == PAUSE) ? BLINK : before;
+    m_remap_errors += (m_app.active_state != remap);
+  }
+  if(m_nesting == 0)
+  {
+    m_wrong += (fsm_hotswap_version() != m_accepted) || !table_is(m_accepted);
+  }
+  if(p_preempt != NULL)
+  {
+    if(fsm_hotswap_load(p_preempt, sizeof(*p_preempt)) == FSM_HOTSWAP_OK)
+    {
+      m_accepted = p_preempt->version;
+    }
+    m_nesting++;
+    dispatch((fsm_signal_t)(INC_LED + bench_rand(4)), NULL);   // runs on the table of the preempted one
+    m_nesting--;
+  }
+  e.super.sig = sig;
+  ehandler = (e_handler_t)m_app.state_table[(m_app.active_state * MAX_SIGNALS) + sig];
+  (void)(*ehandler)(&m_app, &e.super);
+  fsm_hotswap_end();
+  m_dispatched++;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned events = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : BENCH_EVENTS_DEFAULT;
+  uint64_t *plain_ns = calloc(events, sizeof(uint64_t));
+  uint64_t *swap_ns = calloc(events, sizeof(uint64_t));
+  uint64_t *load_ns = calloc(events, sizeof(uint64_t));
+  unsigned plain = 0, swaps = 0, loads = 0, busy = 0, preempted = 0;
+  uint16_t next_version = 1;
+  fsm_table_image_t image;
+  fsm_hotswap_stats_t const *p_stats;
+  bool fused_rejected;
+
+  freopen("/dev/null", "w", stdout);   // handler printfs
+  hal_init();
+  fsm_persist_init();                  // fsm_init restores from the host flash, erased
+  led_bank_init(LED_GROUP, LED_COUNT, true);
+  m_app.state_table = (uintptr_t *) &fsm_fused_state_table[0][0];
+  fsm_init(&m_app);
+  fsm_hotswap_init(&m_app);
+  fused_rejected = fused_cells_check();
+
+  for(unsigned i = 0; i < events; i++)
+  {
+    fsm_signal_t sig = (fsm_signal_t)(INC_LED + bench_rand(4));
+    fsm_table_image_t const *p_preempt = NULL;
+    uint32_t swaps_before = fsm_hotswap_stats_get()->swaps;
+    uint64_t t0;
+
+    hal_posix_run_until(hal_posix_time_us() + bench_rand(20000));
+    if(bench_rand(BENCH_LOAD_EVERY) == 0)
+    {
+      fsm_hotswap_result_t result;
+
+      image_make(&image, next_version);
+      if(bench_rand(4) == 0)
+      {
+        p_preempt = &image;
+        preempted++;
+      }
+      else
+      {
+        t0 = host_ns();
+        result = fsm_hotswap_load(&image, sizeof(image));
+        load_ns[loads++] = host_ns() - t0;
+        if(result == FSM_HOTSWAP_OK)
+        {
+          m_accepted = image.version;
+        }
+        busy += (result == FSM_HOTSWAP_BUSY);
+      }
+      next_version++;
+    }
+
+    t0 = host_ns();
+    dispatch(sig, p_preempt);
+    t0 = host_ns() - t0;
+    if(p_preempt != NULL)
+    {
+      continue;                         // two dispatches, not timed
+    }
+    if(fsm_hotswap_stats_get()->swaps != swaps_before)
+    {
+      swap_ns[swaps++] = t0;
+    }
+    else
+    {
+      plain_ns[plain++] = t0;
+    }
+  }
+
+  p_stats = fsm_hotswap_stats_get();
+  qsort(plain_ns, plain, sizeof(uint64_t), cmp_u64);
+  qsort(swap_ns, swaps, sizeof(uint64_t), cmp_u64);
+  qsort(load_ns, loads, sizeof(uint64_t), cmp_u64);
+  fprintf(stderr, "%u events, %llu dispatches, %u loads between dispatches, %u inside one\n",
+          events, (unsigned long long)m_dispatched, loads, preempted);
+  fprintf(stderr, "fused cells moved to another state rejected: %s\n", fused_rejected ? "yes" : "NO");
+  fprintf(stderr, "accepted %u  rejected %u (busy between dispatches %u, 3 fused cell images)  swaps %u  remaps %u"
+          "  active version %u\n", p_stats->loads, p_stats->rejects, busy, p_stats->swaps, p_stats->remaps,
+          fsm_hotswap_version());
+  fprintf(stderr, "load + validate ns     p50 %llu  p99 %llu  max %llu\n",
+          (unsigned long long)load_ns[loads / 2], (unsigned long long)load_ns[(loads * 99) / 100],
+          (unsigned long long)load_ns[loads - 1]);
+  fprintf(stderr, "dispatch ns            p50 %llu  p99 %llu  max %llu\n",
+          (unsigned long long)plain_ns[plain / 2], (unsigned long long)plain_ns[(plain * 99) / 100],
+          (unsigned long long)plain_ns[plain - 1]);
+  fprintf(stderr, "dispatch + swap ns     p50 %llu  p99 %llu  max %llu\n",
+          (unsigned long long)swap_ns[swaps / 2], (unsigned long long)swap_ns[(swaps * 99) / 100],
+          (unsigned long long)swap_ns[swaps - 1]);
+  fprintf(stderr, "accepted to swapped    max %u us virtual (the next event)\n", p_stats->swap_ticks_max);
+  fprintf(stderr, "on an old table        %llu, preempting dispatches (expected) %u\n",
+          (unsigned long long)m_wrong, p_stats->stale);
+  fprintf(stderr, "remap errors           %llu\n", (unsigned long long)m_remap_errors);
+  fprintf(stderr, "lost events            %llu\n",
+          (unsigned long long)((events + preempted) - m_dispatched));
+  free(plain_ns);
+  free(swap_ns);
+  free(load_ns);
+  return fused_rejected ? 0 : 1;
+}
+
+#endif /* FSM_HOTSWAP_BENCH */
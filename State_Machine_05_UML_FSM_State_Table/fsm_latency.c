@@ -0,0 +1,158 @@
+
+#include "fsm_latency.h"
+#include <string.h>
+
+#if defined(HAL_POSIX)
+#include "hal.h"
+#define __CLZ(x)  ((uint32_t)__builtin_clz(x))
+#else
+#include "nrf.h"
+#endif
+
+
+static fsm_latency_hist_t m_hist[FSM_LAT_SEGMENTS];
+static uint32_t m_ts[FSM_LAT_PROBES];
+static bool m_chain_open;       /* the event being dispatched came from an edge */
+static bool m_output_pending;   /* no LED write since its dispatch started */
+
+
+/**@brief Default timebase, the DWT cycle counter (CPU clock ticks).
+ */
+static uint32_t dwt_now(void)
+{
+#if defined(HAL_POSIX)
+  return (uint32_t)(hal_posix_time_us() * FSM_LAT_TICKS_PER_US);   // virtual time, 64 MHz CPU clock
+#else
+  return DWT->CYCCNT;
+#endif
+}
+
+static fsm_latency_timebase_t m_now = dwt_now;
+static uint32_t m_ticks_per_us = FSM_LAT_TICKS_PER_US;
+
+static void hist_add(fsm_latency_segment_t segment, uint32_t delta)
+{
+  fsm_latency_hist_t *p_hist = &m_hist[segment];
+  uint32_t idx = (delta == 0) ? 0 : (32 - __CLZ(delta));
+
+  if(idx >= FSM_LAT_BUCKETS)
+  {
+    idx = FSM_LAT_BUCKETS - 1;
+  }
+  p_hist->bucket[idx]++;
+  p_hist->count++;
+  if(delta > p_hist->max)
+  {
+    p_hist->max = delta;
+  }
+}
+
+void fsm_latency_init(void)
+{
+#if !defined(HAL_POSIX)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+  fsm_latency_reset();
+}
+
+/**@brief Replace the timebase, e.g. by a simulated clock, NULL restores the default.
+ *
+ * @details ticks_per_us converts the edge age of fsm_latency_mark_dispatch and
+ *          goes out with the histograms, so they can be read in us.
+ */
+void fsm_latency_timebase_set(fsm_latency_timebase_t timebase, uint32_t ticks_per_us)
+{
+  m_now = (timebase != NULL) ? timebase : dwt_now;
+  m_ticks_per_us = ((timebase != NULL) && (ticks_per_us > 0)) ? ticks_per_us : FSM_LAT_TICKS_PER_US;
+}
+
+uint32_t fsm_latency_ticks_per_us(void)
+{
+  return m_ticks_per_us;
+}
+
+/**@brief Timestamp a probe and close the intervals that end at it.
+ *
+ * @details Only the dispatch of an event with an edge opens a chain, see
+ *          fsm_latency_mark_dispatch. Called at the dispatch priority only.
+ */
+static void mark_at(fsm_latency_probe_t probe, uint32_t now)
+{
+  m_ts[probe] = now;
+  switch(probe)
+  {
+    case FSM_LAT_DISPATCH:
+    {
+      if(m_chain_open)
+      {
+        hist_add(FSM_LAT_SEG_EDGE_TO_DISPATCH, now - m_ts[FSM_LAT_EDGE]);
+      }
+      break;
+    }
+
+    case FSM_LAT_HANDLER_DONE:
+    {
+      if(m_chain_open)
+      {
+        hist_add(FSM_LAT_SEG_DISPATCH_TO_DONE, now - m_ts[FSM_LAT_DISPATCH]);
+        hist_add(FSM_LAT_SEG_EDGE_TO_DONE, now - m_ts[FSM_LAT_EDGE]);
+        m_chain_open = false;
+      }
+      m_output_pending = false; // the event produced no output
+      break;
+    }
+
+    case FSM_LAT_OUTPUT:
+    {
+      if(m_output_pending)
+      {
+        hist_add(FSM_LAT_SEG_EDGE_TO_OUTPUT, now - m_ts[FSM_LAT_EDGE]);
+        m_output_pending = false;
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+void fsm_latency_mark(fsm_latency_probe_t probe)
+{
+  mark_at(probe, m_now());
+}
+
+/**@brief Timestamp the dispatch of an event whose button edge was edge_age_us
+ *        ago, FSM_LAT_NO_EDGE for events injected without one (command link).
+ *
+ * @details The edge comes with the event, so presses queued behind each
+ *          other are each measured from their own edge, the interrupt
+ *          latency of the capture path included. The age is converted at
+ *          the ticks per us of the timebase.
+ */
+void fsm_latency_mark_dispatch(uint32_t edge_age_us)
+{
+  uint32_t now = m_now();
+
+  m_chain_open = (edge_age_us != FSM_LAT_NO_EDGE);
+  m_output_pending = m_chain_open;
+  if(m_chain_open)
+  {
+    m_ts[FSM_LAT_EDGE] = now - (edge_age_us * m_ticks_per_us);
+  }
+  mark_at(FSM_LAT_DISPATCH, now);
+}
+
+void fsm_latency_reset(void)
+{
+  memset(m_hist, 0, sizeof(m_hist));
+  m_chain_open = false;
+  m_output_pending = false;
+}
+
+fsm_latency_hist_t const * fsm_latency_hist_get(fsm_latency_segment_t segment)
+{
+  return &m_hist[segment];
+}
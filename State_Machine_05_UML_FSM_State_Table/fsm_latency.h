@@ -0,0 +1,81 @@
+#ifndef FSM_LATENCY_H
+#define FSM_LATENCY_H
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Points of the button to LED chain where a timestamp is taken */
+typedef enum
+{
+  FSM_LAT_EDGE,           /* button edge, the edge_time the event carries */
+  FSM_LAT_DISPATCH,       /* fsm_event_dispatcher entered */
+  FSM_LAT_HANDLER_DONE,   /* handler, exit and entry actions returned */
+  FSM_LAT_OUTPUT,         /* LED port written */
+  FSM_LAT_PROBES
+}fsm_latency_probe_t;
+
+/* Intervals that are histogrammed */
+typedef enum
+{
+  FSM_LAT_SEG_EDGE_TO_DISPATCH,
+  FSM_LAT_SEG_DISPATCH_TO_DONE,
+  FSM_LAT_SEG_EDGE_TO_OUTPUT,   /* first LED write after the edge */
+  FSM_LAT_SEG_EDGE_TO_DONE,
+  FSM_LAT_SEGMENTS
+}fsm_latency_segment_t;
+
+/* Ticks per microsecond of the default timebase, the 64 MHz CPU clock */
+#define FSM_LAT_TICKS_PER_US  64
+
+/* Edge age of an event no button edge made, it opens no chain */
+#define FSM_LAT_NO_EDGE   UINT32_MAX
+
+/* Bucket n counts intervals d with 2^(n-1) <= d < 2^n ticks, bucket 0 counts d == 0 */
+#define FSM_LAT_BUCKETS   32
+
+typedef struct
+{
+  uint32_t bucket[FSM_LAT_BUCKETS];
+  uint32_t count;
+  uint32_t max;
+}fsm_latency_hist_t;
+
+typedef uint32_t (*fsm_latency_timebase_t)(void);
+
+
+/**@brief Upper bound, in ticks, of the permille/1000 percentile of p_hist.
+ *
+ * @details The bound is that of the bucket the percentile falls in, capped by
+ *          max: at least the true percentile, less than twice it. Shared with
+ *          the host decoder (fsm_log_decode.cpp), so both read a histogram
+ *          the same way.
+ */
+static inline uint32_t fsm_latency_percentile(fsm_latency_hist_t const *p_hist, uint32_t permille)
+{
+  uint64_t rank = (((uint64_t)p_hist->count * permille) + 999) / 1000;
+  uint64_t seen = 0;
+
+  rank = (rank > 0) ? rank : 1;
+  for(uint32_t n = 0; n < (FSM_LAT_BUCKETS - 1); n++)
+  {
+    seen += p_hist->bucket[n];
+    if(seen >= rank)
+    {
+      uint32_t bound = (n == 0) ? 0 : ((1UL << n) - 1);
+
+      return (bound < p_hist->max) ? bound : p_hist->max;
+    }
+  }
+  return p_hist->max;
+}
+
+void fsm_latency_init(void);
+void fsm_latency_timebase_set(fsm_latency_timebase_t timebase, uint32_t ticks_per_us);
+uint32_t fsm_latency_ticks_per_us(void);
+void fsm_latency_mark(fsm_latency_probe_t probe);
+void fsm_latency_mark_dispatch(uint32_t edge_age_us);
+void fsm_latency_reset(void);
+fsm_latency_hist_t const * fsm_latency_hist_get(fsm_latency_segment_t segment);
+
+
+#endif
@@ -0,0 +1,279 @@
+/* Host check of fsm_latency.c on a simulated timebase, and of its link export.
+ *
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DFSM_LATENCY_BENCH -I. -I../State_Machine_Common \
+ *       fsm_latency_bench.c fsm_latency.c fsm_link.c ../State_Machine_Common/hal_posix.c -o fsm_latency_bench
+ *   ./fsm_latency_bench [capture]
+ *   g++ -std=c++17 -O2 fsm_log_decode.cpp -o fsm_log_decode && ./fsm_log_decode capture
+ *
+ * The timebase is a counter at BENCH_TICKS_PER_US, not the 64 of the DWT.
+ * Every event has a known edge to output delay: 90 % at BENCH_FAST_US, 9 %
+ * at BENCH_SLOW_US, 1 % at BENCH_STALL_US; it is dispatched a quarter of
+ * the way and done BENCH_DONE_US after the output. For each segment the
+ * true p50/p99/max of the injected delays is computed and the histogram
+ * must give max exactly and p50/p99 at least the true value, less than
+ * twice it (the log2 buckets). The histograms are then exported over the
+ * link pty, decoded here and compared with the ones exported. The capture
+ * is kept if a file is named, fsm_log_decode prints it.
+ */
+#if defined(FSM_LATENCY_BENCH)
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "fsm_latency.h"
+#include "fsm_link.h"
+#include "hal.h"
+
+#define BENCH_EVENTS          1000
+#define BENCH_TICKS_PER_US    16
+#define BENCH_FAST_US         100
+#define BENCH_SLOW_US         1000
+#define BENCH_STALL_US        8000
+#define BENCH_DONE_US         5
+#define BENCH_GAP_US          20000
+
+static uint32_t m_clock;
+static uint32_t m_true[FSM_LAT_SEGMENTS][BENCH_EVENTS];   /**< Injected intervals, ticks. */
+static fsm_latency_hist_t m_decoded[FSM_LAT_SEGMENTS];
+static uint8_t m_decoded_tpu[FSM_LAT_SEGMENTS];
+
+
+static uint32_t sim_now(void)
+{
+  return m_clock;
+}
+
+static int ticks_cmp(void const *p_a, void const *p_b)
+{
+  uint32_t a = *(uint32_t const *)p_a;
+  uint32_t b = *(uint32_t const *)p_b;
+
+  return (a > b) - (a < b);
+}
+
+/**@brief True percentile of the sorted intervals, the rank rule of fsm_latency_percentile.
+ */
+static uint32_t true_percentile(uint32_t const *p_sorted, uint32_t permille)
+{
+  uint32_t rank = ((BENCH_EVENTS * permille) + 999) / 1000;
+
+  return p_sorted[(rank > 0) ? (rank - 1) : 0];
+}
+
+static bool bound_check(uint32_t bound, uint32_t truth)
+{
+  return (bound >= truth) && (bound < ((2 * truth) + 1));
+}
+
+static uint16_t crc16(uint8_t const *p_data, uint32_t size)
+{
+  uint16_t crc = 0xFFFF;
+
+  for(uint32_t i = 0; i < size; i++)
+  {
+    crc = (uint8_t)(crc >> 8) | (crc << 8);
+    crc ^= p_data[i];
+    crc ^= (uint8_t)(crc & 0xFF) >> 4;
+    crc ^= (crc << 8) << 4;
+    crc ^= ((crc & 0xFF) << 4) << 1;
+  }
+  return crc;
+}
+
+static uint8_t cobs_decode(uint8_t const *src, uint8_t len, uint8_t *dst)
+{
+  uint8_t in = 0;
+  uint8_t out = 0;
+
+  while(in < len)
+  {
+    uint8_t code = src[in++];
+    if((code == 0) || (in + code - 1 > len))
+    {
+      return 0;
+    }
+    for(uint8_t i = 1; i < code; i++)
+    {
+      dst[out++] = src[in++];
+    }
+    if((code < 0xFF) && (in < len))
+    {
+      dst[out++] = 0;
+    }
+  }
+  return out;
+}
+
+/**@brief Decode the exported frames into m_decoded.
+ *
+ * @return Frames with a bad CRC or length.
+ */
+static uint32_t export_decode(uint8_t const *p_bytes, size_t bytes)
+{
+  uint8_t frame[FSM_LINK_TX_SLOT_SIZE];
+  uint8_t raw[FSM_LINK_TX_SLOT_SIZE];
+  uint8_t len = 0;
+  uint32_t bad = 0;
+
+  for(size_t i = 0; i < bytes; i++)
+  {
+    uint8_t n;
+
+    if(p_bytes[i] != FSM_LINK_DELIMITER)
+    {
+      if(len < sizeof(frame))
+      {
+        frame[len++] = p_bytes[i];
+      }
+      continue;
+    }
+    n = cobs_decode(frame, len, raw);
+    len = 0;
+    if((n < 5) || (crc16(raw, n - 2) != (raw[n - 2] | (raw[n - 1] << 8))) || (raw[1] >= FSM_LAT_SEGMENTS))
+    {
+      bad++;
+    }
+    else if((raw[0] == FSM_LINK_TLM_LATENCY_SUM) && (n == 13))
+    {
+      m_decoded[raw[1]].count = raw[2] | (raw[3] << 8) | (raw[4] << 16) | ((uint32_t)raw[5] << 24);
+      m_decoded[raw[1]].max = raw[6] | (raw[7] << 8) | (raw[8] << 16) | ((uint32_t)raw[9] << 24);
+      m_decoded_tpu[raw[1]] = raw[10];
+    }
+    else if((raw[0] == FSM_LINK_TLM_LATENCY) && (n == (3 + (2 * FSM_LINK_LATENCY_BUCKETS_PER_FRAME) + 2)))
+    {
+      for(uint8_t b = 0; b < FSM_LINK_LATENCY_BUCKETS_PER_FRAME; b++)
+      {
+        m_decoded[raw[1]].bucket[raw[2] + b] = raw[3 + (2 * b)] | (raw[4 + (2 * b)] << 8);
+      }
+    }
+    else
+    {
+      bad++;
+    }
+  }
+  return bad;
+}
+
+/**@brief Export the histograms over the link pty.
+ *
+ * @return Bytes read back from the device end, 0 if the link did not open.
+ */
+static size_t export_read(uint8_t *p_bytes, size_t size)
+{
+  app_t app = {0};
+  char const *p_name;
+  struct termios tio;
+  size_t bytes = 0;
+  ssize_t n;
+  int fd;
+
+  setenv("FSM_LINK", "pty", 1);
+  fsm_link_init(&app, NULL);
+  p_name = fsm_link_pty_name();
+  fd = (p_name != NULL) ? open(p_name, O_RDWR | O_NOCTTY | O_NONBLOCK) : -1;
+  if(fd < 0)
+  {
+    perror("fsm_latency_bench");
+    return 0;
+  }
+  tcgetattr(fd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(fd, TCSANOW, &tio);
+
+  fsm_link_latency_send();
+  hal_posix_run_until(hal_posix_time_us() + 2000);
+  while((bytes < size) && ((n = read(fd, &p_bytes[bytes], size - bytes)) > 0))
+  {
+    bytes += (size_t)n;
+  }
+  close(fd);
+  return bytes;
+}
+
+int main(int argc, char **argv)
+{
+  static char const *const names[FSM_LAT_SEGMENTS] = {"edge to dispatch", "dispatch to done", "edge to output",
+                                                      "edge to done"};
+  uint8_t capture[4096];
+  size_t bytes;
+  uint32_t bad;
+  bool pass = true;
+
+  hal_init();
+  fsm_latency_init();
+  fsm_latency_timebase_set(sim_now, BENCH_TICKS_PER_US);
+
+  for(uint32_t i = 0; i < BENCH_EVENTS; i++)
+  {
+    uint32_t e2o_us = ((i % 100) < 90) ? BENCH_FAST_US : (((i % 100) < 99) ? BENCH_SLOW_US : BENCH_STALL_US);
+    uint32_t e2d_us = e2o_us / 4;
+    uint32_t edge = m_clock + (BENCH_GAP_US * BENCH_TICKS_PER_US);
+
+    m_clock = edge + (e2d_us * BENCH_TICKS_PER_US);
+    fsm_latency_mark_dispatch(e2d_us);
+    m_clock = edge + (e2o_us * BENCH_TICKS_PER_US);
+    fsm_latency_mark(FSM_LAT_OUTPUT);
+    m_clock += BENCH_DONE_US * BENCH_TICKS_PER_US;
+    fsm_latency_mark(FSM_LAT_HANDLER_DONE);
+
+    m_true[FSM_LAT_SEG_EDGE_TO_DISPATCH][i] = e2d_us * BENCH_TICKS_PER_US;
+    m_true[FSM_LAT_SEG_DISPATCH_TO_DONE][i] = (e2o_us - e2d_us + BENCH_DONE_US) * BENCH_TICKS_PER_US;
+    m_true[FSM_LAT_SEG_EDGE_TO_OUTPUT][i] = e2o_us * BENCH_TICKS_PER_US;
+    m_true[FSM_LAT_SEG_EDGE_TO_DONE][i] = (e2o_us + BENCH_DONE_US) * BENCH_TICKS_PER_US;
+  }
+
+  printf("%u events, timebase %u ticks/us, us           true p50/p99/max      histogram p50/p99/max\n",
+         BENCH_EVENTS, BENCH_TICKS_PER_US);
+  for(uint8_t seg = 0; seg < FSM_LAT_SEGMENTS; seg++)
+  {
+    fsm_latency_hist_t const *p_hist = fsm_latency_hist_get((fsm_latency_segment_t)seg);
+    uint32_t *p_true = m_true[seg];
+    uint32_t p50;
+    uint32_t p99;
+    bool ok;
+
+    qsort(p_true, BENCH_EVENTS, sizeof(p_true[0]), ticks_cmp);
+    p50 = fsm_latency_percentile(p_hist, 500);
+    p99 = fsm_latency_percentile(p_hist, 990);
+    ok = (p_hist->count == BENCH_EVENTS) && (p_hist->max == p_true[BENCH_EVENTS - 1]) &&
+         bound_check(p50, true_percentile(p_true, 500)) && bound_check(p99, true_percentile(p_true, 990));
+    printf("  %-18s %8.1f %8.1f %8.1f   %8.1f %8.1f %8.1f  %s\n", names[seg],
+           (double)true_percentile(p_true, 500) / BENCH_TICKS_PER_US,
+           (double)true_percentile(p_true, 990) / BENCH_TICKS_PER_US,
+           (double)p_true[BENCH_EVENTS - 1] / BENCH_TICKS_PER_US, (double)p50 / BENCH_TICKS_PER_US,
+           (double)p99 / BENCH_TICKS_PER_US, (double)p_hist->max / BENCH_TICKS_PER_US, ok ? "ok" : "WRONG");
+    pass = pass && ok;
+  }
+
+  bytes = export_read(capture, sizeof(capture));
+  bad = export_decode(capture, bytes);
+  for(uint8_t seg = 0; seg < FSM_LAT_SEGMENTS; seg++)
+  {
+    fsm_latency_hist_t const *p_hist = fsm_latency_hist_get((fsm_latency_segment_t)seg);
+
+    pass = pass && (memcmp(&m_decoded[seg], p_hist, sizeof(*p_hist)) == 0) &&
+           (m_decoded_tpu[seg] == BENCH_TICKS_PER_US);
+  }
+  printf("link export: %u bytes, %u bad frames, histograms %s\n", (unsigned)bytes, bad,
+         pass ? "as exported" : "DIFFER");
+  if(argc > 1)
+  {
+    FILE *fp = fopen(argv[1], "wb");
+
+    if((fp == NULL) || (fwrite(capture, 1, bytes, fp) != bytes))
+    {
+      perror(argv[1]);
+      pass = false;
+    }
+    if(fp != NULL)
+    {
+      fclose(fp);
+    }
+  }
+  printf("%s\n", pass ? "ok" : "FAIL");
+  return pass ? 0 : 1;
+}
+
+#endif /* FSM_LATENCY_BENCH */
@@ -0,0 +1,573 @@
+#if defined(HAL_POSIX)
+#define _GNU_SOURCE     /* posix_openpt and friends */
+#endif
+#include "fsm_link.h"
+#include "fsm_latency.h"
+#include "fsm_hotswap.h"
+#include "hal.h"
+#include <string.h>
+
+
+#if defined(HAL_POSIX)
+/* Host build: the link runs over a pseudo terminal when FSM_LINK=pty is in
+ * the environment, its name is printed on stderr for the host tools. The
+ * device end is polled every FSM_LINK_POLL_MS, as if the UARTE had filled
+ * a buffer. Without it telemetry is counted as dropped. */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define FSM_LINK_POLL_MS    1
+#define LINK_LOCK()         do {
+#define LINK_UNLOCK()       } while(0)
+
+HAL_TIMER_DEF(m_poll_timer_id);
+
+static int m_fd = -1;         /**< Master end of the pty. */
+static uint8_t m_tx_sent;     /**< Bytes of the tail slot the pty already took. */
+#else
+#include "nrf.h"
+#include "nrfx_uarte.h"
+#include "crc16.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "boards.h"
+
+#define LINK_LOCK()         CRITICAL_REGION_ENTER()
+#define LINK_UNLOCK()       CRITICAL_REGION_EXIT()
+
+static nrfx_uarte_t const m_uarte = NRFX_UARTE_INSTANCE(0);
+
+/* RX is double buffered, each DMA chunk holds exactly one command frame */
+static uint8_t m_rx_buf[2][FSM_LINK_CMD_FRAME_LEN];
+#endif
+
+static app_t const *m_app;
+static fsm_link_event_handler_t m_event_handler;
+
+static uint8_t m_rx_frame[FSM_LINK_CMD_FRAME_LEN];
+static uint8_t m_rx_len;
+
+/* TX frames are encoded in place in their slot and sent from there by EasyDMA */
+static uint8_t m_tx_slot[FSM_LINK_TX_SLOTS][FSM_LINK_TX_SLOT_SIZE];
+static uint8_t m_tx_slot_len[FSM_LINK_TX_SLOTS];
+static uint8_t m_tx_head;
+static uint8_t m_tx_tail;
+static bool m_tx_busy;
+
+static fsm_link_stats_t m_stats;
+
+#if FSM_HOTSWAP
+/* Table image assembled one command at a time, the command frames stay fixed size */
+static uint8_t m_table_buf[sizeof(fsm_table_image_t)];
+static uint8_t m_table_len;
+#endif
+
+#if defined(HAL_POSIX)
+/**@brief CRC-16/CCITT as crc16_compute() of the SDK.
+ */
+static uint16_t crc16_compute(uint8_t const *p_data, uint32_t size, uint16_t const *p_crc)
+{
+  uint16_t crc = (p_crc == NULL) ? 0xFFFF : *p_crc;
+
+  for(uint32_t i = 0; i < size; i++)
+  {
+    crc = (uint8_t)(crc >> 8) | (crc << 8);
+    crc ^= p_data[i];
+    crc ^= (uint8_t)(crc & 0xFF) >> 4;
+    crc ^= (crc << 8) << 4;
+    crc ^= ((crc & 0xFF) << 4) << 1;
+  }
+  return crc;
+}
+#endif
+
+/**@brief COBS encode src into dst.
+ *
+ * @return Encoded length, delimiter not included.
+ */
+static uint8_t cobs_encode(uint8_t const *src, uint8_t len, uint8_t *dst)
+{
+  uint8_t code_idx = 0;
+  uint8_t out = 1;
+  uint8_t code = 1;
+
+  for(uint8_t i = 0; i < len; i++)
+  {
+    if(src[i] == 0)
+    {
+      dst[code_idx] = code;
+      code_idx = out++;
+      code = 1;
+    }
+    else
+    {
+      dst[out++] = src[i];
+      code++;
+    }
+  }
+  dst[code_idx] = code;
+  return out;
+}
+
+/**@brief COBS decode src into dst.
+ *
+ * @return Decoded length, 0 if the frame is malformed.
+ */
+static uint8_t cobs_decode(uint8_t const *src, uint8_t len, uint8_t *dst)
+{
+  uint8_t in = 0;
+  uint8_t out = 0;
+
+  while(in < len)
+  {
+    uint8_t code = src[in++];
+    if((code == 0) || (in + code - 1 > len))
+    {
+      return 0;
+    }
+    for(uint8_t i = 1; i < code; i++)
+    {
+      dst[out++] = src[in++];
+    }
+    if((code < 0xFF) && (in < len))
+    {
+      dst[out++] = 0;
+    }
+  }
+  return out;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+#if defined(HAL_POSIX)
+/**@brief Write the queued slots to the pty, what it does not take now goes on the next poll.
+ */
+static void tx_kick(void)
+{
+  while(m_tx_head != m_tx_tail)
+  {
+    ssize_t n = write(m_fd, &m_tx_slot[m_tx_tail][m_tx_sent], m_tx_slot_len[m_tx_tail] - m_tx_sent);
+
+    if(n <= 0)
+    {
+      m_tx_busy = true;
+      return;
+    }
+    m_tx_sent += (uint8_t)n;
+    if(m_tx_sent == m_tx_slot_len[m_tx_tail])
+    {
+      m_tx_tail = (m_tx_tail + 1) & (FSM_LINK_TX_SLOTS - 1);
+      m_tx_sent = 0;
+    }
+  }
+  m_tx_busy = false;
+}
+#else
+static void tx_kick(void)
+{
+  nrfx_err_t err_code;
+
+  if(m_tx_busy || (m_tx_head == m_tx_tail))
+  {
+    return;
+  }
+  m_tx_busy = true;
+  err_code = nrfx_uarte_tx(&m_uarte, m_tx_slot[m_tx_tail], m_tx_slot_len[m_tx_tail]);
+  APP_ERROR_CHECK(err_code);
+}
+#endif
+
+/**@brief Frame raw into the next free TX slot and start sending.
+ *
+ * @details Callers run at the GPIOTE/UARTE interrupt priority, so the slot ring
+ *          is never touched concurrently.
+ */
+static void frame_send(uint8_t *raw, uint8_t len)
+{
+  uint8_t next = (m_tx_head + 1) & (FSM_LINK_TX_SLOTS - 1);
+  uint8_t *slot;
+  uint16_t crc;
+
+#if defined(HAL_POSIX)
+  if(m_fd < 0)
+  {
+    m_stats.tx_dropped++;
+    return;
+  }
+#endif
+  if(next == m_tx_tail)
+  {
+    m_stats.tx_dropped++;
+    return;
+  }
+
+  crc = crc16_compute(raw, len, NULL);
+  raw[len++] = (uint8_t)crc;
+  raw[len++] = (uint8_t)(crc >> 8);
+
+  slot = m_tx_slot[m_tx_head];
+  len = cobs_encode(raw, len, slot);
+  slot[len++] = FSM_LINK_DELIMITER;
+  m_tx_slot_len[m_tx_head] = len;
+  m_tx_head = next;
+  m_stats.tx_frames++;
+
+  tx_kick();
+}
+
+static void frame_process(uint8_t const *frame, uint8_t len)
+{
+  uint8_t raw[FSM_LINK_CMD_FRAME_LEN];
+  uint8_t raw_len;
+  uint16_t crc;
+
+  raw_len = cobs_decode(frame, len, raw);
+  if(raw_len != FSM_LINK_CMD_RAW_LEN)
+  {
+    m_stats.rx_framing_errors++;
+    return;
+  }
+
+  crc = crc16_compute(raw, FSM_LINK_CMD_RAW_LEN - 2, NULL);
+  if((raw[2] != (uint8_t)crc) || (raw[3] != (uint8_t)(crc >> 8)))
+  {
+    m_stats.rx_crc_errors++;
+    return;
+  }
+  m_stats.rx_frames++;
+
+  switch(raw[0])
+  {
+    case FSM_LINK_CMD_EVENT:
+    {
+      /* ENTRY and EXIT are internal, only user signals may be injected */
+      if((raw[1] < INC_LED) || (raw[1] > ABRT) || (m_event_handler == NULL))
+      {
+        m_stats.rx_framing_errors++;
+        return;
+      }
+      m_event_handler((fsm_signal_t)raw[1]);
+      break;
+    }
+
+    case FSM_LINK_CMD_GET_STATE:
+    {
+      fsm_link_state_send(m_app);
+      break;
+    }
+
+    case FSM_LINK_CMD_GET_LATENCY:
+    {
+      fsm_link_latency_send();
+      if(raw[1])
+      {
+        fsm_latency_reset();
+      }
+      break;
+    }
+
+#if FSM_HOTSWAP
+    case FSM_LINK_CMD_TABLE_BYTE:
+    {
+      if(m_table_len < sizeof(m_table_buf))
+      {
+        m_table_buf[m_table_len] = raw[1];
+      }
+      if(m_table_len < UINT8_MAX)
+      {
+        m_table_len++;    // too many bytes fail the length check of the load
+      }
+      break;
+    }
+
+    case FSM_LINK_CMD_TABLE_LOAD:
+    {
+      uint8_t tlm[FSM_LINK_TX_SLOT_SIZE];
+      uint16_t version;
+
+      tlm[0] = FSM_LINK_TLM_TABLE;
+      tlm[1] = (uint8_t)fsm_hotswap_load(m_table_buf, (m_table_len <= sizeof(m_table_buf)) ? m_table_len : 0);
+      version = fsm_hotswap_version();
+      tlm[2] = (uint8_t)version;
+      tlm[3] = (uint8_t)(version >> 8);
+      frame_send(tlm, 4);
+      m_table_len = 0;
+      break;
+    }
+#endif
+
+    default:
+    {
+      m_stats.rx_framing_errors++;
+      break;
+    }
+  }
+}
+
+/**@brief Feed a received DMA chunk through the frame assembler.
+ *
+ * @details Frames are split on the delimiter, so a chunk boundary that is not
+ *          aligned with a frame (after line noise) resynchronises on the next 0x00.
+ */
+static void rx_chunk_process(uint8_t const *p_data, size_t bytes)
+{
+  for(size_t i = 0; i < bytes; i++)
+  {
+    if(p_data[i] == FSM_LINK_DELIMITER)
+    {
+      if(m_rx_len > 0)
+      {
+        frame_process(m_rx_frame, m_rx_len);
+      }
+      m_rx_len = 0;
+    }
+    else if(m_rx_len < sizeof(m_rx_frame))
+    {
+      m_rx_frame[m_rx_len++] = p_data[i];
+    }
+    else
+    {
+      m_stats.rx_framing_errors++;
+      m_rx_len = 0;
+    }
+  }
+}
+
+#if defined(HAL_POSIX)
+/**@brief Take what the host sent since the last poll, send what the pty refused.
+ */
+static void poll_timer_handler(void *p_context)
+{
+  uint8_t buf[64];
+  ssize_t n;
+
+  (void)p_context;
+  while((n = read(m_fd, buf, sizeof(buf))) > 0)
+  {
+    rx_chunk_process(buf, (size_t)n);
+  }
+  // EIO: nobody has the other end open
+  if((n < 0) && (errno != EAGAIN) && (errno != EIO))
+  {
+    m_stats.rx_uart_errors++;
+    m_rx_len = 0;
+  }
+  tx_kick();
+}
+
+/**@brief Open the pty of the link if FSM_LINK=pty, its name goes to stderr.
+ *
+ * @details The poll timer runs in the single host context with the button
+ *          handlers, the same run-to-completion the UARTE priority gives.
+ */
+void fsm_link_init(app_t const *const myApp, fsm_link_event_handler_t handler)
+{
+  char const *p_link = getenv("FSM_LINK");
+  struct termios tio;
+
+  m_app = myApp;
+  m_event_handler = handler;
+  if((p_link == NULL) || (strcmp(p_link, "pty") != 0))
+  {
+    return;
+  }
+
+  m_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if((m_fd < 0) || (grantpt(m_fd) != 0) || (unlockpt(m_fd) != 0) || (tcgetattr(m_fd, &tio) != 0))
+  {
+    perror("fsm_link: pty");
+    if(m_fd >= 0)
+    {
+      close(m_fd);
+    }
+    m_fd = -1;
+    return;
+  }
+  cfmakeraw(&tio);
+  tcsetattr(m_fd, TCSANOW, &tio);
+  fprintf(stderr, "fsm_link: %s\n", ptsname(m_fd));
+
+  hal_timer_create(&m_poll_timer_id, HAL_TIMER_REPEATED, poll_timer_handler);
+  hal_timer_start(m_poll_timer_id, FSM_LINK_POLL_MS, NULL);
+}
+
+char const * fsm_link_pty_name(void)
+{
+  return (m_fd >= 0) ? ptsname(m_fd) : NULL;
+}
+#else
+static void uarte_event_handler(nrfx_uarte_event_t const * p_event, void * p_context)
+{
+  nrfx_err_t err_code;
+
+  switch(p_event->type)
+  {
+    case NRFX_UARTE_EVT_RX_DONE:
+    {
+      rx_chunk_process(p_event->data.rxtx.p_data, p_event->data.rxtx.bytes);
+      // the other buffer is already receiving, queue this one behind it
+      err_code = nrfx_uarte_rx(&m_uarte, p_event->data.rxtx.p_data, FSM_LINK_CMD_FRAME_LEN);
+      APP_ERROR_CHECK(err_code);
+      break;
+    }
+
+    case NRFX_UARTE_EVT_TX_DONE:
+    {
+      m_tx_tail = (m_tx_tail + 1) & (FSM_LINK_TX_SLOTS - 1);
+      m_tx_busy = false;
+      tx_kick();
+      break;
+    }
+
+    case NRFX_UARTE_EVT_ERROR:
+    {
+      m_stats.rx_uart_errors++;
+      m_rx_len = 0;
+      err_code = nrfx_uarte_rx(&m_uarte, p_event->data.error.rxtx.p_data, FSM_LINK_CMD_FRAME_LEN);
+      APP_ERROR_CHECK(err_code);
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+/**@brief Start the command/telemetry link on UARTE0.
+ *
+ * @details The UARTE interrupt runs at the GPIOTE priority, so injected events
+ *          and button events are dispatched run-to-completion with respect to
+ *          each other. A NULL handler rejects injected events.
+ */
+void fsm_link_init(app_t const *const myApp, fsm_link_event_handler_t handler)
+{
+  nrfx_err_t err_code;
+  nrfx_uarte_config_t config = NRFX_UARTE_DEFAULT_CONFIG;
+
+  m_app = myApp;
+  m_event_handler = handler;
+
+  config.pseltxd = TX_PIN_NUMBER;
+  config.pselrxd = RX_PIN_NUMBER;
+  config.baudrate = FSM_LINK_BAUDRATE;
+  config.interrupt_priority = GPIOTE_CONFIG_IRQ_PRIORITY;
+
+  err_code = nrfx_uarte_init(&m_uarte, &config, uarte_event_handler);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = nrfx_uarte_rx(&m_uarte, m_rx_buf[0], FSM_LINK_CMD_FRAME_LEN);
+  APP_ERROR_CHECK(err_code);
+  err_code = nrfx_uarte_rx(&m_uarte, m_rx_buf[1], FSM_LINK_CMD_FRAME_LEN);
+  APP_ERROR_CHECK(err_code);
+}
+#endif
+
+void fsm_link_state_send(app_t const *const myApp)
+{
+  uint8_t raw[FSM_LINK_TX_SLOT_SIZE];
+
+  raw[0] = FSM_LINK_TLM_STATE;
+  raw[1] = (uint8_t)myApp->active_state;
+  raw[2] = myApp->curr_leds;
+  frame_send(raw, 3);
+}
+
+void fsm_link_transition_send(app_state_t source, app_state_t target, fsm_signal_t sig)
+{
+  uint8_t raw[FSM_LINK_TX_SLOT_SIZE];
+  uint32_t ts = hal_ticks();
+
+  raw[0] = FSM_LINK_TLM_TRANSITION;
+  raw[1] = (uint8_t)source;
+  raw[2] = (uint8_t)target;
+  raw[3] = (uint8_t)sig;
+  raw[4] = 0;
+  put_u32(&raw[5], ts);
+  frame_send(raw, 9);
+}
+
+/**@brief One deferred log record, fsm_log_decode prints it with the catalogue.
+ *
+ * @details Called from the main loop, the slot ring is shared with the
+ *          interrupts for the length of a frame_send().
+ *
+ * @return False, and nothing sent, if the link is not started or has no free slot.
+ */
+bool fsm_link_log_send(uint16_t id, uint32_t time, uint32_t const *args, uint8_t nargs)
+{
+  uint8_t raw[FSM_LINK_TX_SLOT_SIZE];
+  uint8_t len = 7;
+  bool sent = false;
+
+  if(m_app == NULL)
+  {
+    return false;
+  }
+  raw[0] = FSM_LINK_TLM_LOG;
+  raw[1] = (uint8_t)id;
+  raw[2] = (uint8_t)(id >> 8);
+  put_u32(&raw[3], time);
+  for(uint8_t i = 0; i < nargs; i++)
+  {
+    put_u32(&raw[len], args[i]);
+    len += 4;
+  }
+
+  LINK_LOCK();
+  if(((m_tx_head + 1) & (FSM_LINK_TX_SLOTS - 1)) != m_tx_tail)
+  {
+    frame_send(raw, len);
+    sent = true;
+  }
+  LINK_UNLOCK();
+  return sent;
+}
+
+/**@brief Export every latency histogram, fsm_log_decode prints them as p50/p99/max.
+ */
+void fsm_link_latency_send(void)
+{
+  uint8_t raw[FSM_LINK_TX_SLOT_SIZE];
+
+  for(uint8_t seg = 0; seg < FSM_LAT_SEGMENTS; seg++)
+  {
+    fsm_latency_hist_t const *p_hist = fsm_latency_hist_get((fsm_latency_segment_t)seg);
+
+    raw[0] = FSM_LINK_TLM_LATENCY_SUM;
+    raw[1] = seg;
+    put_u32(&raw[2], p_hist->count);
+    put_u32(&raw[6], p_hist->max);
+    raw[10] = (uint8_t)fsm_latency_ticks_per_us();
+    frame_send(raw, 11);
+
+    for(uint8_t first = 0; first < FSM_LAT_BUCKETS; first += FSM_LINK_LATENCY_BUCKETS_PER_FRAME)
+    {
+      raw[0] = FSM_LINK_TLM_LATENCY;
+      raw[1] = seg;
+      raw[2] = first;
+      for(uint8_t i = 0; i < FSM_LINK_LATENCY_BUCKETS_PER_FRAME; i++)
+      {
+        uint32_t n = p_hist->bucket[first + i];
+        uint16_t sat = (n > 0xFFFF) ? 0xFFFF : (uint16_t)n;
+        raw[3 + (2 * i)] = (uint8_t)sat;
+        raw[4 + (2 * i)] = (uint8_t)(sat >> 8);
+      }
+      frame_send(raw, 3 + (2 * FSM_LINK_LATENCY_BUCKETS_PER_FRAME));
+    }
+  }
+}
+
+fsm_link_stats_t const * fsm_link_stats_get(void)
+{
+  return &m_stats;
+}
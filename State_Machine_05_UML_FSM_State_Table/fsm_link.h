@@ -0,0 +1,63 @@
+#ifndef FSM_LINK_H
+#define FSM_LINK_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "main.h"
+
+
+/* Frames are COBS encoded [type][payload][crc16 LE] followed by a 0x00 delimiter */
+#define FSM_LINK_DELIMITER      0x00
+
+/* host -> device */
+#define FSM_LINK_CMD_EVENT      0x01    /* payload: fsm_signal_t */
+#define FSM_LINK_CMD_GET_STATE  0x02    /* payload: unused */
+#define FSM_LINK_CMD_GET_LATENCY 0x03   /* payload: 1 = reset histograms after export */
+#define FSM_LINK_CMD_TABLE_BYTE 0x04    /* payload: next byte of a fsm_table_image_t (FSM_HOTSWAP) */
+#define FSM_LINK_CMD_TABLE_LOAD 0x05    /* payload: unused, loads the bytes sent and starts over */
+
+/* device -> host */
+#define FSM_LINK_TLM_STATE      0x81    /* payload: active_state, curr_leds */
+#define FSM_LINK_TLM_TRANSITION 0x82    /* payload: source, target, sig, 0, timestamp u32 LE */
+#define FSM_LINK_TLM_LATENCY    0x83    /* payload: segment, first bucket, 8 x count u16 LE (saturated) */
+#define FSM_LINK_TLM_LATENCY_SUM 0x84   /* payload: segment, count u32 LE, max u32 LE, ticks per us */
+#define FSM_LINK_TLM_TABLE      0x85    /* payload: fsm_hotswap_result_t, active version u16 LE */
+#define FSM_LINK_TLM_LOG        0x86    /* payload: message id u16 LE, timestamp u32 LE, 0..3 x arg u32 LE (fsm_log.h) */
+
+#define FSM_LINK_LATENCY_BUCKETS_PER_FRAME 8
+
+/* Every command is [type][arg][crc16], 4 raw bytes, 6 bytes on the wire */
+#define FSM_LINK_CMD_RAW_LEN    4
+#define FSM_LINK_CMD_FRAME_LEN  (FSM_LINK_CMD_RAW_LEN + 2)
+
+#define FSM_LINK_BAUDRATE       NRF_UARTE_BAUDRATE_1000000
+#define FSM_LINK_TX_SLOTS       32      /* must be a power of two */
+#define FSM_LINK_TX_SLOT_SIZE   32
+
+typedef void (*fsm_link_event_handler_t)(fsm_signal_t sig);
+
+/* Link counters */
+typedef struct
+{
+  uint32_t rx_frames;
+  uint32_t rx_crc_errors;
+  uint32_t rx_framing_errors;   /* bad COBS, bad length or unknown command */
+  uint32_t rx_uart_errors;
+  uint32_t tx_frames;
+  uint32_t tx_dropped;          /* no free TX slot, or on the host no pty */
+}fsm_link_stats_t;
+
+
+void fsm_link_init(app_t const *const myApp, fsm_link_event_handler_t handler);
+void fsm_link_state_send(app_t const *const myApp);
+void fsm_link_transition_send(app_state_t source, app_state_t target, fsm_signal_t sig);
+void fsm_link_latency_send(void);
+bool fsm_link_log_send(uint16_t id, uint32_t time, uint32_t const *args, uint8_t nargs);
+fsm_link_stats_t const * fsm_link_stats_get(void);
+
+#if defined(HAL_POSIX)
+/* Device end of the link pty, NULL unless FSM_LINK=pty, see fsm_link.c */
+char const * fsm_link_pty_name(void);
+#endif
+
+
+#endif
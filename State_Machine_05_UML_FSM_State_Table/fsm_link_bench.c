@@ -0,0 +1,292 @@
+/* Host load test of fsm_link.c over its pty.
+ *
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DFSM_LINK_BENCH -I. -I../State_Machine_Common \
+ *       fsm_link_bench.c fsm_link.c fsm_latency.c ../State_Machine_Common/hal_posix.c -o fsm_link_bench
+ *   ./fsm_link_bench [ms]
+ *
+ * The bench is the host end of the link: it opens the device end of the pty
+ * and, every virtual ms, writes the command frames FSM_LINK_BAUDRATE carries
+ * in a ms (10 bits a byte), EVENT and GET_STATE at random, one in
+ * BENCH_BAD_CRC with its CRC flipped. Then the link polls and the bench
+ * reads back the telemetry. Every good EVENT must reach the handler, in the
+ * order sent, every bad CRC must be counted and nothing else, and every
+ * GET_STATE must be answered by a STATE frame with a good CRC and the state.
+ * It reports the frames lost, the CRC errors and the host time per frame.
+ */
+#if defined(FSM_LINK_BENCH)
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "fsm_link.h"
+
+#define BENCH_MS_DEFAULT      2000
+#define BENCH_LINE_BYTES_MS   (1000000 / 10 / 1000)   /* 1 Mbaud, 8N1 */
+#define BENCH_FRAMES_MS       (BENCH_LINE_BYTES_MS / FSM_LINK_CMD_FRAME_LEN)
+#define BENCH_BAD_CRC         37
+#define BENCH_EVENTS_MAX      (1u << 20)
+
+static uint32_t m_rand = 0x9E3779B9;
+
+static uint8_t *m_sent_sig;         /**< Good EVENT signals in the order written. */
+static uint32_t m_sent_events;
+static uint32_t m_recv_events;
+static uint32_t m_out_of_order;
+
+static uint8_t m_tlm_frame[FSM_LINK_TX_SLOT_SIZE];
+static uint8_t m_tlm_len;
+
+
+static uint32_t bench_rand(uint32_t range)
+{
+  m_rand ^= m_rand << 13;
+  m_rand ^= m_rand >> 17;
+  m_rand ^= m_rand << 5;
+  return m_rand % range;
+}
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/**@brief CRC-16/CCITT of the link, computed here so both ends are checked.
+ */
+static uint16_t crc16(uint8_t const *p_data, uint32_t size)
+{
+  uint16_t crc = 0xFFFF;
+
+  for(uint32_t i = 0; i < size; i++)
+  {
+    crc = (uint8_t)(crc >> 8) | (crc << 8);
+    crc ^= p_data[i];
+    crc ^= (uint8_t)(crc & 0xFF) >> 4;
+    crc ^= (crc << 8) << 4;
+    crc ^= ((crc & 0xFF) << 4) << 1;
+  }
+  return crc;
+}
+
+static uint8_t cobs_encode(uint8_t const *src, uint8_t len, uint8_t *dst)
+{
+  uint8_t code_idx = 0;
+  uint8_t out = 1;
+  uint8_t code = 1;
+
+  for(uint8_t i = 0; i < len; i++)
+  {
+    if(src[i] == 0)
+    {
+      dst[code_idx] = code;
+      code_idx = out++;
+      code = 1;
+    }
+    else
+    {
+      dst[out++] = src[i];
+      code++;
+    }
+  }
+  dst[code_idx] = code;
+  return out;
+}
+
+static uint8_t cobs_decode(uint8_t const *src, uint8_t len, uint8_t *dst)
+{
+  uint8_t in = 0;
+  uint8_t out = 0;
+
+  while(in < len)
+  {
+    uint8_t code = src[in++];
+    if((code == 0) || (in + code - 1 > len))
+    {
+      return 0;
+    }
+    for(uint8_t i = 1; i < code; i++)
+    {
+      dst[out++] = src[in++];
+    }
+    if((code < 0xFF) && (in < len))
+    {
+      dst[out++] = 0;
+    }
+  }
+  return out;
+}
+
+static void link_event_handler(fsm_signal_t sig)
+{
+  if((m_recv_events >= m_sent_events) || (m_sent_sig[m_recv_events] != sig))
+  {
+    m_out_of_order++;
+  }
+  m_recv_events++;
+}
+
+/**@brief One command frame, delimiter included.
+ *
+ * @return Bytes written to p_out.
+ */
+static uint8_t command_frame(uint8_t cmd, uint8_t payload, bool bad_crc, uint8_t *p_out)
+{
+  uint8_t raw[FSM_LINK_CMD_RAW_LEN] = {cmd, payload};
+  uint16_t crc = crc16(raw, 2);
+  uint8_t len;
+
+  raw[2] = (uint8_t)crc;
+  raw[3] = (uint8_t)(crc >> 8);
+  if(bad_crc)
+  {
+    raw[2 + bench_rand(2)] ^= (uint8_t)(1 << bench_rand(8));
+  }
+  len = cobs_encode(raw, sizeof(raw), p_out);
+  p_out[len++] = FSM_LINK_DELIMITER;
+  return len;
+}
+
+typedef struct
+{
+  uint32_t state;
+  uint32_t state_wrong;
+  uint32_t bad_crc;
+  uint32_t other;
+}tlm_count_t;
+
+static void telemetry_read(int fd, app_t const *p_app, tlm_count_t *p_count)
+{
+  uint8_t buf[256];
+  ssize_t n;
+
+  while((n = read(fd, buf, sizeof(buf))) > 0)
+  {
+    for(ssize_t i = 0; i < n; i++)
+    {
+      uint8_t raw[FSM_LINK_TX_SLOT_SIZE];
+      uint8_t len;
+
+      if(buf[i] != FSM_LINK_DELIMITER)
+      {
+        if(m_tlm_len < sizeof(m_tlm_frame))
+        {
+          m_tlm_frame[m_tlm_len++] = buf[i];
+        }
+        continue;
+      }
+      len = cobs_decode(m_tlm_frame, m_tlm_len, raw);
+      m_tlm_len = 0;
+      if((len < 3) || (crc16(raw, len - 2) != (raw[len - 2] | (raw[len - 1] << 8))))
+      {
+        p_count->bad_crc++;
+      }
+      else if(raw[0] == FSM_LINK_TLM_STATE)
+      {
+        p_count->state++;
+        p_count->state_wrong += (len != 5) || (raw[1] != p_app->active_state) || (raw[2] != p_app->curr_leds);
+      }
+      else
+      {
+        p_count->other++;
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  unsigned ms = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : BENCH_MS_DEFAULT;
+  app_t app = {.active_state = LED_SET, .curr_leds = 2};
+  fsm_link_stats_t const *p_stats = fsm_link_stats_get();
+  tlm_count_t tlm = {0};
+  uint32_t get_state = 0;
+  uint32_t bad_crc = 0;
+  uint64_t ns = 0;
+  struct termios tio;
+  char const *p_name;
+  int fd;
+  bool pass;
+
+  m_sent_sig = malloc(BENCH_EVENTS_MAX);
+  setenv("FSM_LINK", "pty", 1);
+  hal_init();
+  fsm_link_init(&app, link_event_handler);
+  p_name = fsm_link_pty_name();
+  fd = (p_name != NULL) ? open(p_name, O_RDWR | O_NOCTTY | O_NONBLOCK) : -1;
+  if((fd < 0) || (m_sent_sig == NULL))
+  {
+    perror("fsm_link_bench");
+    return 1;
+  }
+  tcgetattr(fd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(fd, TCSANOW, &tio);
+
+  for(unsigned t = 0; t < ms; t++)
+  {
+    uint8_t line[BENCH_FRAMES_MS * FSM_LINK_CMD_FRAME_LEN];
+    uint8_t len = 0;
+    uint64_t t0;
+
+    for(unsigned f = 0; f < BENCH_FRAMES_MS; f++)
+    {
+      bool bad = (bench_rand(BENCH_BAD_CRC) == 0);
+
+      if(bench_rand(2) == 0)
+      {
+        uint8_t sig = (uint8_t)(INC_LED + bench_rand(ABRT - INC_LED + 1));
+
+        len += command_frame(FSM_LINK_CMD_EVENT, sig, bad, &line[len]);
+        if(!bad && (m_sent_events < BENCH_EVENTS_MAX))
+        {
+          m_sent_sig[m_sent_events++] = sig;
+        }
+      }
+      else
+      {
+        len += command_frame(FSM_LINK_CMD_GET_STATE, 0, bad, &line[len]);
+        get_state += !bad;
+      }
+      bad_crc += bad;
+    }
+    if(write(fd, line, len) != len)
+    {
+      perror("fsm_link_bench: write");
+      return 1;
+    }
+
+    t0 = host_ns();
+    hal_posix_run_until(hal_posix_time_us() + 1000);
+    ns += host_ns() - t0;
+    telemetry_read(fd, &app, &tlm);
+  }
+  hal_posix_run_until(hal_posix_time_us() + 2000);
+  telemetry_read(fd, &app, &tlm);
+
+  printf("%u ms at %u command frames/ms (%u bytes/ms of %u), 1 in %u with a bad CRC\n", ms, BENCH_FRAMES_MS,
+         BENCH_FRAMES_MS * FSM_LINK_CMD_FRAME_LEN, BENCH_LINE_BYTES_MS, BENCH_BAD_CRC);
+  printf("  %-32s %10s %10s\n", "", "sent", "seen");
+  printf("  %-32s %10u %10u\n", "EVENT, handler calls", m_sent_events, m_recv_events);
+  printf("  %-32s %10u %10u\n", "GET_STATE, STATE replies", get_state, tlm.state);
+  printf("  %-32s %10u %10u\n", "bad CRC, rx_crc_errors", bad_crc, p_stats->rx_crc_errors);
+  printf("  %-32s %10u %10u\n", "rx_frames", m_sent_events + get_state, p_stats->rx_frames);
+  printf("events out of order %u, wrong STATE %u, telemetry with a bad CRC %u, other %u\n", m_out_of_order,
+         tlm.state_wrong, tlm.bad_crc, tlm.other);
+  printf("framing errors %u, uart errors %u, tx dropped %u\n", p_stats->rx_framing_errors, p_stats->rx_uart_errors,
+         p_stats->tx_dropped);
+  printf("host time %.0f ns per command frame\n", (double)ns / ((m_sent_events + get_state + bad_crc) ? : 1));
+
+  pass = (m_recv_events == m_sent_events) && (m_out_of_order == 0) && (tlm.state == get_state) &&
+         (tlm.state_wrong == 0) && (tlm.bad_crc == 0) && (tlm.other == 0) && (p_stats->rx_crc_errors == bad_crc) &&
+         (p_stats->rx_frames == m_sent_events + get_state) && (p_stats->rx_framing_errors == 0) &&
+         (p_stats->tx_dropped == 0);
+  printf("%s\n", pass ? "no frame lost" : "FAIL");
+  return pass ? 0 : 1;
+}
+
+#endif /* FSM_LINK_BENCH */
@@ -0,0 +1,151 @@
+#include "fsm_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "hal.h"
+#include "fsm_link.h"
+
+#define FSM_LOG_RING_MASK   (FSM_LOG_RING_WORDS - 1)
+
+#if (FSM_LOG_RING_WORDS & FSM_LOG_RING_MASK) != 0
+#error "FSM_LOG_RING_WORDS must be a power of two"
+#endif
+
+#if FSM_LOG_DEFERRED
+/* A record is [id | nargs << 16][timestamp][args], the indices run freely
+ * and are masked on access */
+static uint32_t m_ring[FSM_LOG_RING_WORDS];
+static volatile uint32_t m_head;      /* written by the loggers only */
+static volatile uint32_t m_tail;      /* written by fsm_log_flush() only */
+static uint32_t m_dropped_reported;
+#endif
+static fsm_log_stats_t m_stats;
+
+#if defined(HAL_POSIX) || !FSM_LOG_DEFERRED
+static char const * const m_formats[FSM_LOG_IDS] = {
+#define FSM_LOG_FORMAT(name, level, format) format,
+  FSM_LOG_MESSAGES(FSM_LOG_FORMAT)
+#undef FSM_LOG_FORMAT
+};
+
+static bool record_emit(uint16_t id, uint32_t time, uint32_t const *args, uint8_t nargs)
+{
+  (void)time;
+  (void)nargs;
+  printf(m_formats[id], args[0], args[1], args[2]);
+  printf("\r\n");
+  return true;
+}
+#else
+/**@brief Off to the host, false while the link has no free TX slot.
+ */
+static bool record_emit(uint16_t id, uint32_t time, uint32_t const *args, uint8_t nargs)
+{
+  return fsm_link_log_send(id, time, args, nargs);
+}
+#endif
+
+
+void fsm_log_init(void)
+{
+#if FSM_LOG_DEFERRED
+  m_head = 0;
+  m_tail = 0;
+  m_dropped_reported = 0;
+#if defined(HAL_POSIX)
+  // a run ends inside hal_idle(), the records of its last events are still in the ring
+  atexit(fsm_log_flush);
+#endif
+#endif
+}
+
+/**@brief Log one message of the catalogue, only its id and arguments are stored.
+ */
+void fsm_log_write(fsm_log_id_t id, uint8_t nargs, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+#if FSM_LOG_DEFERRED
+  uint32_t head = m_head;
+  uint32_t used = head - m_tail;
+  uint32_t words = 2 + nargs;
+
+  if(used + words > FSM_LOG_RING_WORDS)
+  {
+    m_stats.dropped++;
+    return;
+  }
+  m_ring[head & FSM_LOG_RING_MASK] = (uint32_t)id | ((uint32_t)nargs << 16);
+  m_ring[(head + 1) & FSM_LOG_RING_MASK] = hal_ticks();
+  if(nargs > 0)
+  {
+    m_ring[(head + 2) & FSM_LOG_RING_MASK] = a0;
+  }
+  if(nargs > 1)
+  {
+    m_ring[(head + 3) & FSM_LOG_RING_MASK] = a1;
+  }
+  if(nargs > 2)
+  {
+    m_ring[(head + 4) & FSM_LOG_RING_MASK] = a2;
+  }
+  if(used + words > m_stats.words_max)
+  {
+    m_stats.words_max = (uint16_t)(used + words);
+  }
+  m_stats.records++;
+  m_head = head + words;      // last, the reader may take the record from here on
+#else
+  uint32_t args[FSM_LOG_MAX_ARGS] = {a0, a1, a2};
+
+  (void)record_emit((uint16_t)id, hal_ticks(), args, nargs);
+  m_stats.records++;
+  m_stats.flushed++;
+#endif
+}
+
+/**@brief Format or send every stored record, from the main loop.
+ *
+ * @details Stops at the first record the link cannot take, the next call
+ *          continues there. Records lost to a full ring are reported once
+ *          the ring is empty.
+ */
+void fsm_log_flush(void)
+{
+#if FSM_LOG_DEFERRED
+  uint32_t tail = m_tail;
+  uint32_t args[FSM_LOG_MAX_ARGS];
+
+  while(tail != m_head)
+  {
+    uint32_t header = m_ring[tail & FSM_LOG_RING_MASK];
+    uint8_t nargs = (uint8_t)(header >> 16);
+
+    for(uint8_t i = 0; i < FSM_LOG_MAX_ARGS; i++)
+    {
+      args[i] = (i < nargs) ? m_ring[(tail + 2 + i) & FSM_LOG_RING_MASK] : 0;
+    }
+    if(!record_emit((uint16_t)header, m_ring[(tail + 1) & FSM_LOG_RING_MASK], args, nargs))
+    {
+      m_stats.deferred++;
+      return;
+    }
+    tail += 2 + nargs;
+    m_tail = tail;
+    m_stats.flushed++;
+  }
+
+  if(m_stats.dropped != m_dropped_reported)
+  {
+    args[0] = m_stats.dropped - m_dropped_reported;
+    args[1] = 0;
+    args[2] = 0;
+    if(record_emit(FSM_LOG_ID_LOG_DROPPED, hal_ticks(), args, 1))
+    {
+      m_dropped_reported += args[0];
+    }
+  }
+#endif
+}
+
+fsm_log_stats_t const * fsm_log_stats_get(void)
+{
+  return &m_stats;
+}
@@ -0,0 +1,70 @@
+#ifndef FSM_LOG_H
+#define FSM_LOG_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "main.h"
+#include "fsm_log_msgs.h"
+
+
+/* Deferred logging without strings on the target.
+ *
+ * FSM_LOGn(name, args) stores the message id of fsm_log_msgs.h, a timestamp
+ * and n raw arguments in a word ring, nothing is formatted in the handler.
+ * fsm_log_flush() from the main loop empties the ring: the target sends
+ * every record as a FSM_LINK_TLM_LOG frame and fsm_log_decode turns them
+ * back into text, a host build prints them with the catalogue formats.
+ * Messages above FSM_LOG_LEVEL are removed at compile time, call and
+ * arguments. FSM_LOG_DEFERRED 0 prints every message where it is logged,
+ * with the formats in flash.
+ * Loggers run at one interrupt priority (GPIOTE = UARTE) or before the
+ * interrupts are enabled, the main loop is the only reader. */
+
+/* Ring size in 32 bit words, a record takes 2 + args, must be a power of two */
+#ifndef FSM_LOG_RING_WORDS
+#define FSM_LOG_RING_WORDS  256
+#endif
+
+typedef enum
+{
+#define FSM_LOG_ID(name, level, format) FSM_LOG_ID_##name,
+  FSM_LOG_MESSAGES(FSM_LOG_ID)
+#undef FSM_LOG_ID
+  FSM_LOG_IDS
+}fsm_log_id_t;
+
+/* FSM_LOG_LV_<name>: level of each message, for the compile time filter */
+enum
+{
+#define FSM_LOG_LV(name, level, format) FSM_LOG_LV_##name = (level),
+  FSM_LOG_MESSAGES(FSM_LOG_LV)
+#undef FSM_LOG_LV
+};
+
+typedef struct
+{
+  uint32_t records;
+  uint32_t dropped;         /* ring full */
+  uint32_t flushed;
+  uint32_t deferred;        /* flushes stopped by a full link, retried by the next one */
+  uint16_t words_max;       /* highest ring fill */
+}fsm_log_stats_t;
+
+
+/* Constant conditions, a filtered message leaves no code behind */
+#define FSM_LOG0(name) \
+  do { if(FSM_LOG_LV_##name <= FSM_LOG_LEVEL) fsm_log_write(FSM_LOG_ID_##name, 0, 0, 0, 0); } while(0)
+#define FSM_LOG1(name, a0) \
+  do { if(FSM_LOG_LV_##name <= FSM_LOG_LEVEL) fsm_log_write(FSM_LOG_ID_##name, 1, (uint32_t)(a0), 0, 0); } while(0)
+#define FSM_LOG2(name, a0, a1) \
+  do { if(FSM_LOG_LV_##name <= FSM_LOG_LEVEL) fsm_log_write(FSM_LOG_ID_##name, 2, (uint32_t)(a0), (uint32_t)(a1), 0); } while(0)
+#define FSM_LOG3(name, a0, a1, a2) \
+  do { if(FSM_LOG_LV_##name <= FSM_LOG_LEVEL) fsm_log_write(FSM_LOG_ID_##name, 3, (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2)); } while(0)
+
+
+void fsm_log_init(void);
+void fsm_log_write(fsm_log_id_t id, uint8_t nargs, uint32_t a0, uint32_t a1, uint32_t a2);
+void fsm_log_flush(void);
+fsm_log_stats_t const * fsm_log_stats_get(void);
+
+
+#endif
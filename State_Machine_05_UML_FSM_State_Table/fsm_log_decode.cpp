@@ -0,0 +1,321 @@
+/* Prints the deferred log records and latency histograms of a link capture as text.
+ *
+ *   g++ -std=c++17 -O2 fsm_log_decode.cpp -o fsm_log_decode
+ *   ./fsm_log_decode [--tick-hz 32768] [--tick-bits 24] [capture]
+ *
+ * Reads the raw bytes the device sent on the link (fsm_link.h), from the
+ * file or stdin, e.g. stty -F /dev/ttyACM0 1000000 raw; ./fsm_log_decode
+ * < /dev/ttyACM0. Every FSM_LINK_TLM_LOG frame becomes one line: seconds
+ * since the first record, from the app_timer timestamp unwrapped over
+ * --tick-bits, and the message of fsm_log_msgs.h with its arguments.
+ * The catalogue must be the one the firmware was built with. The latency
+ * export of FSM_LINK_CMD_GET_LATENCY becomes one line per segment: count,
+ * p50, p99 and max in us, the percentiles as fsm_latency_percentile reads
+ * the log2 buckets. Other frames are counted, frames that fail COBS or the
+ * CRC are skipped.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "fsm_log_msgs.h"
+#include "fsm_latency.h"
+
+namespace
+{
+
+constexpr uint8_t tlm_log = 0x86;         /* FSM_LINK_TLM_LOG of fsm_link.h */
+constexpr uint8_t tlm_latency = 0x83;     /* FSM_LINK_TLM_LATENCY */
+constexpr uint8_t tlm_latency_sum = 0x84; /* FSM_LINK_TLM_LATENCY_SUM */
+constexpr size_t log_header_len = 7;      /* type, id u16, timestamp u32 */
+constexpr size_t latency_sum_len = 11;    /* type, segment, count u32, max u32, ticks per us */
+constexpr size_t latency_buckets = 8;     /* FSM_LINK_LATENCY_BUCKETS_PER_FRAME */
+constexpr size_t latency_len = 3 + (2 * latency_buckets);
+
+char const *const segment_names[FSM_LAT_SEGMENTS] = {
+  "edge to dispatch", "dispatch to done", "edge to output", "edge to done"
+};
+
+char const *const formats[] = {
+#define FSM_LOG_FORMAT(name, level, format) format,
+  FSM_LOG_MESSAGES(FSM_LOG_FORMAT)
+#undef FSM_LOG_FORMAT
+};
+
+struct counters
+{
+  unsigned long records = 0;
+  unsigned long histograms = 0;
+  unsigned long other = 0;
+  unsigned long bad = 0;
+  unsigned long unknown = 0;
+};
+
+/* CRC-16/CCITT-FALSE, crc16_compute() of the SDK */
+uint16_t crc16(uint8_t const *p, size_t len)
+{
+  uint16_t crc = 0xFFFF;
+
+  for(size_t i = 0; i < len; i++)
+  {
+    crc = static_cast<uint16_t>((crc >> 8) | (crc << 8));
+    crc ^= p[i];
+    crc ^= static_cast<uint8_t>(crc & 0xFF) >> 4;
+    crc ^= static_cast<uint16_t>((crc << 8) << 4);
+    crc ^= static_cast<uint16_t>(((crc & 0xFF) << 4) << 1);
+  }
+  return crc;
+}
+
+bool cobs_decode(std::vector<uint8_t> const &in, std::vector<uint8_t> &out)
+{
+  size_t i = 0;
+
+  out.clear();
+  while(i < in.size())
+  {
+    uint8_t code = in[i++];
+
+    if((code == 0) || (i + code - 1 > in.size()))
+    {
+      return false;
+    }
+    for(uint8_t k = 1; k < code; k++)
+    {
+      out.push_back(in[i++]);
+    }
+    if((code < 0xFF) && (i < in.size()))
+    {
+      out.push_back(0);
+    }
+  }
+  return true;
+}
+
+uint32_t get_u32(uint8_t const *p)
+{
+  return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+class decoder
+{
+public:
+  decoder(double tick_hz, unsigned tick_bits)
+    : m_tick_hz(tick_hz), m_mask((tick_bits >= 32) ? 0xFFFFFFFFu : ((1u << tick_bits) - 1))
+  {
+  }
+
+  void frame(std::vector<uint8_t> const &encoded)
+  {
+    if(!cobs_decode(encoded, m_raw) || (m_raw.size() < 3) ||
+       (crc16(m_raw.data(), m_raw.size() - 2) != (m_raw[m_raw.size() - 2] | (m_raw[m_raw.size() - 1] << 8))))
+    {
+      m_count.bad++;
+      return;
+    }
+    m_raw.resize(m_raw.size() - 2);
+    if((m_raw[0] == tlm_latency_sum) || (m_raw[0] == tlm_latency))
+    {
+      latency();
+      return;
+    }
+    if(m_raw[0] != tlm_log)
+    {
+      m_count.other++;
+      return;
+    }
+    if((m_raw.size() < log_header_len) || (((m_raw.size() - log_header_len) % 4) != 0) ||
+       (((m_raw.size() - log_header_len) / 4) > FSM_LOG_MAX_ARGS))
+    {
+      m_count.bad++;
+      return;
+    }
+    record(static_cast<uint16_t>(m_raw[1] | (m_raw[2] << 8)), get_u32(&m_raw[3]));
+  }
+
+  counters const &count() const
+  {
+    return m_count;
+  }
+
+private:
+  /* A histogram is its LATENCY_SUM frame, then its LATENCY frames in bucket order */
+  struct segment
+  {
+    fsm_latency_hist_t hist;
+    uint32_t ticks_per_us;
+    size_t next_bucket;
+  };
+
+  void latency()
+  {
+    uint8_t seg = m_raw[1];
+
+    if(seg >= FSM_LAT_SEGMENTS)
+    {
+      m_count.bad++;
+      return;
+    }
+    segment &s = m_segment[seg];
+    if(m_raw[0] == tlm_latency_sum)
+    {
+      if((m_raw.size() != latency_sum_len) || (m_raw[10] == 0))
+      {
+        m_count.bad++;
+        return;
+      }
+      s = segment{};
+      s.hist.max = get_u32(&m_raw[6]);
+      s.ticks_per_us = m_raw[10];
+      return;
+    }
+    if((m_raw.size() != latency_len) || (s.ticks_per_us == 0) || (m_raw[2] != s.next_bucket) ||
+       ((m_raw[2] + latency_buckets) > FSM_LAT_BUCKETS))
+    {
+      m_count.bad++;
+      s.ticks_per_us = 0;   // wait for the next LATENCY_SUM
+      return;
+    }
+    for(size_t i = 0; i < latency_buckets; i++)
+    {
+      // the frames saturate at 0xFFFF, the percentiles go by the counts sent
+      uint32_t n = m_raw[3 + (2 * i)] | (m_raw[4 + (2 * i)] << 8);
+
+      s.hist.bucket[m_raw[2] + i] = n;
+      s.hist.count += n;
+    }
+    s.next_bucket += latency_buckets;
+    if(s.next_bucket == FSM_LAT_BUCKETS)
+    {
+      double tpu = s.ticks_per_us;
+
+      std::printf("latency %-17s n %8u  p50 %10.1f us  p99 %10.1f us  max %10.1f us\n", segment_names[seg],
+                  s.hist.count, fsm_latency_percentile(&s.hist, 500) / tpu,
+                  fsm_latency_percentile(&s.hist, 990) / tpu, s.hist.max / tpu);
+      m_count.histograms++;
+      s.ticks_per_us = 0;
+    }
+  }
+
+  void record(uint16_t id, uint32_t time)
+  {
+    uint32_t args[FSM_LOG_MAX_ARGS] = {0, 0, 0};
+    size_t nargs = (m_raw.size() - log_header_len) / 4;
+    char text[256];
+
+    for(size_t i = 0; i < nargs; i++)
+    {
+      args[i] = get_u32(&m_raw[log_header_len + (4 * i)]);
+    }
+    if(id < (sizeof(formats) / sizeof(formats[0])))
+    {
+      std::snprintf(text, sizeof(text), formats[id], args[0], args[1], args[2]);
+    }
+    else
+    {
+      std::snprintf(text, sizeof(text), "<unknown message %u> %u %u %u", id, args[0], args[1], args[2]);
+      m_count.unknown++;
+    }
+
+    // the catalogue keeps the line breaks the messages had on the console
+    std::string line(text);
+    while(!line.empty() && ((line.back() == '\n') || (line.back() == '\r')))
+    {
+      line.pop_back();
+    }
+    std::printf("%12.6f  %s\n", seconds(time), line.c_str());
+    m_count.records++;
+  }
+
+  double seconds(uint32_t time)
+  {
+    time &= m_mask;
+    if(m_count.records == 0)
+    {
+      m_last = time;
+    }
+    m_elapsed += (time - m_last) & m_mask;
+    m_last = time;
+    return static_cast<double>(m_elapsed) / m_tick_hz;
+  }
+
+  double m_tick_hz;
+  uint32_t m_mask;
+  uint32_t m_last = 0;
+  uint64_t m_elapsed = 0;
+  std::vector<uint8_t> m_raw;
+  segment m_segment[FSM_LAT_SEGMENTS] = {};
+  counters m_count;
+};
+
+}
+
+int main(int argc, char **argv)
+{
+  double tick_hz = 32768.0;
+  unsigned tick_bits = 24;
+  char const *path = nullptr;
+  std::FILE *fp = stdin;
+
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+
+    if((arg == "--tick-hz") && (i + 1 < argc))
+    {
+      tick_hz = std::strtod(argv[++i], nullptr);
+    }
+    else if((arg == "--tick-bits") && (i + 1 < argc))
+    {
+      tick_bits = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+    }
+    else if((arg[0] != '-') && (path == nullptr))
+    {
+      path = argv[i];
+    }
+    else
+    {
+      std::fprintf(stderr, "usage: %s [--tick-hz hz] [--tick-bits bits] [capture]\n", argv[0]);
+      return 1;
+    }
+  }
+  if((tick_hz <= 0.0) || (tick_bits == 0) || (tick_bits > 32))
+  {
+    std::fprintf(stderr, "%s: bad timestamp clock\n", argv[0]);
+    return 1;
+  }
+  if((path != nullptr) && ((fp = std::fopen(path, "rb")) == nullptr))
+  {
+    std::perror(path);
+    return 1;
+  }
+
+  decoder dec(tick_hz, tick_bits);
+  std::vector<uint8_t> encoded;
+  int c;
+
+  while((c = std::fgetc(fp)) != EOF)
+  {
+    if(c != 0)
+    {
+      encoded.push_back(static_cast<uint8_t>(c));
+      continue;
+    }
+    if(!encoded.empty())
+    {
+      dec.frame(encoded);
+      encoded.clear();
+      std::fflush(stdout);    // live captures
+    }
+  }
+  if(fp != stdin)
+  {
+    std::fclose(fp);
+  }
+
+  counters const &n = dec.count();
+  std::fprintf(stderr, "%lu log records, %lu latency histograms, %lu other frames, %lu bad frames, %lu unknown ids\n",
+               n.records, n.histograms, n.other, n.bad, n.unknown);
+  return 0;
+}
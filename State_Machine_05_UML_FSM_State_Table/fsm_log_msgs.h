@@ -0,0 +1,93 @@
+#ifndef FSM_LOG_MSGS_H
+#define FSM_LOG_MSGS_H
+
+
+/* Catalogue of the log messages: X(name, level, format).
+ *
+ * A message is logged by its position in this list, the formats are only
+ * compiled into host builds and fsm_log_decode. Append new messages at the
+ * end, a decoder built from another catalogue prints the wrong text.
+ * Formats take up to FSM_LOG_MAX_ARGS 32 bit integer arguments (%d, %u, %x),
+ * the line ending is added by the formatter. Includes nothing, so host
+ * tools can use it on its own. */
+
+#define FSM_LOG_ERROR   1
+#define FSM_LOG_WARN    2
+#define FSM_LOG_INFO    3
+#define FSM_LOG_DEBUG   4
+
+#define FSM_LOG_MAX_ARGS  3
+
+#define FSM_LOG_MESSAGES(X)                                                                       \
+  X(LOG_DROPPED,                FSM_LOG_WARN,  "fsm_log: %u records dropped")                    \
+  /* buttons, main.c */                                                                           \
+  X(SIGNAL_INC_LED,             FSM_LOG_INFO,  "Signal: INC_LED")                                \
+  X(SIGNAL_DEC_LED,             FSM_LOG_INFO,  "Signal: DEC_LED")                                \
+  X(SIGNAL_START_PAUSE,         FSM_LOG_INFO,  "Signal: START_PAUSE")                            \
+  X(SIGNAL_ABRT,                FSM_LOG_INFO,  "Signal: ABRT")                                   \
+  /* display, state_machine.c and app_regions.c */                                                \
+  X(CURRENT_LEDS,               FSM_LOG_INFO,  "Current LEDs: %d")                               \
+  X(CLEAR_LED,                  FSM_LOG_INFO,  "Clear led")                                      \
+  X(MSG_IDLE_STATE,             FSM_LOG_INFO,  "IDLE STATE\r\n")                                 \
+  X(MSG_EXIT_IDLE,              FSM_LOG_INFO,  "Exit from: IDLE")                                \
+  X(MSG_SET_LEDS,               FSM_LOG_INFO,  "Set Leds")                                       \
+  X(MSG_EXIT_LED_SET,           FSM_LOG_INFO,  "Exit from: LED_SET")                             \
+  X(MSG_BLINKING,               FSM_LOG_INFO,  "APPLICATION is blinking LEDs\r\n")               \
+  X(MSG_EXIT_BLINK,             FSM_LOG_INFO,  "Exit from: BLINK")                               \
+  X(MSG_PAUSE_LEDS,             FSM_LOG_INFO,  "PAUSE Leds")                                     \
+  X(MSG_EXIT_PAUSE,             FSM_LOG_INFO,  "Exit from: PAUSE")                               \
+  X(MSG_EVENT_IGNORED,          FSM_LOG_INFO,  "EVENT_IGNORED\r\n")                              \
+  /* handlers, state_machine.c */                                                                 \
+  X(IDLE_ENTRY,                 FSM_LOG_DEBUG, "IDLE_ENTRY")                                     \
+  X(IDLE_EXIT,                  FSM_LOG_DEBUG, "IDLE_EXIT")                                      \
+  X(IDLE_INC_LED,               FSM_LOG_DEBUG, "IDLE_INC_LED")                                   \
+  X(IDLE_DEC_LED,               FSM_LOG_DEBUG, "IDLE_DEC_LED")                                   \
+  X(IDLE_START_PAUSE,           FSM_LOG_DEBUG, "IDLE_START_PAUSE")                               \
+  X(IDLE_ABRT,                  FSM_LOG_DEBUG, "IDLE_ABRT")                                      \
+  X(LED_SET_ENTRY,              FSM_LOG_DEBUG, "LED_SET_ENTRY")                                  \
+  X(LED_SET_EXIT,               FSM_LOG_DEBUG, "LED_SET_EXIT")                                   \
+  X(LED_SET_INC_LED,            FSM_LOG_DEBUG, "LED_SET_INC_LED")                                \
+  X(LED_SET_DEC_LED,            FSM_LOG_DEBUG, "LED_SET_DEC_LED")                                \
+  X(LED_SET_START_PAUSE,        FSM_LOG_DEBUG, "LED_SET_START_PAUSE")                            \
+  X(LED_SET_ABRT,               FSM_LOG_DEBUG, "LED_SET_ABRT")                                   \
+  X(BLINK_ENTRY,                FSM_LOG_DEBUG, "BLINK_ENTRY")                                    \
+  X(BLINK_EXIT,                 FSM_LOG_DEBUG, "BLINK_EXIT")                                     \
+  X(BLINK_INC_LED,              FSM_LOG_DEBUG, "BLINK_INC_LED")                                  \
+  X(BLINK_DEC_LED,              FSM_LOG_DEBUG, "BLINK_DEC_LED")                                  \
+  X(BLINK_START_PAUSE,          FSM_LOG_DEBUG, "BLINK_START_PAUSE")                              \
+  X(BLINK_ABRT,                 FSM_LOG_DEBUG, "BLINK_ABRT")                                     \
+  X(BLINK_RESUME,               FSM_LOG_DEBUG, "BLINK_RESUME")                                   \
+  X(PAUSE_ENTRY,                FSM_LOG_DEBUG, "PAUSE_ENTRY")                                    \
+  X(PAUSE_EXIT,                 FSM_LOG_DEBUG, "PAUSE_EXIT")                                     \
+  X(PAUSE_INC_LED,              FSM_LOG_DEBUG, "PAUSE_INC_LED")                                  \
+  X(PAUSE_DEC_LED,              FSM_LOG_DEBUG, "PAUSE_DEC_LED")                                  \
+  X(PAUSE_START_PAUSE,          FSM_LOG_DEBUG, "PAUSE_START_PAUSE")                              \
+  X(PAUSE_ABRT,                 FSM_LOG_DEBUG, "PAUSE_ABRT")                                     \
+  /* region handlers, app_regions.c */                                                            \
+  X(EDIT_IDLE_ENTRY,            FSM_LOG_DEBUG, "EDIT_IDLE_ENTRY")                                \
+  X(EDIT_IDLE_INC_DEC,          FSM_LOG_DEBUG, "EDIT_IDLE_INC_DEC")                              \
+  X(EDIT_SET_ENTRY,             FSM_LOG_DEBUG, "EDIT_SET_ENTRY")                                 \
+  X(EDIT_SET_INC_LED,           FSM_LOG_DEBUG, "EDIT_SET_INC_LED")                               \
+  X(EDIT_SET_DEC_LED,           FSM_LOG_DEBUG, "EDIT_SET_DEC_LED")                               \
+  X(EDIT_SET_ABRT,              FSM_LOG_DEBUG, "EDIT_SET_ABRT")                                  \
+  X(BLINKER_OFF_ENTRY,          FSM_LOG_DEBUG, "BLINKER_OFF_ENTRY")                              \
+  X(BLINKER_OFF_START_PAUSE,    FSM_LOG_DEBUG, "BLINKER_OFF_START_PAUSE")                        \
+  X(BLINKER_ON_ENTRY,           FSM_LOG_DEBUG, "BLINKER_ON_ENTRY")                               \
+  X(BLINKER_ON_EXIT,            FSM_LOG_DEBUG, "BLINKER_ON_EXIT")                                \
+  X(BLINKER_ON_START_PAUSE,     FSM_LOG_DEBUG, "BLINKER_ON_START_PAUSE")                         \
+  X(BLINKER_PAUSED_ENTRY,       FSM_LOG_DEBUG, "BLINKER_PAUSED_ENTRY")                           \
+  X(BLINKER_PAUSED_START_PAUSE, FSM_LOG_DEBUG, "BLINKER_PAUSED_START_PAUSE")                     \
+  X(BLINKER_ABRT,               FSM_LOG_DEBUG, "BLINKER_ABRT")                                   \
+  /* fsm_persist.c */                                                                             \
+  X(PERSIST_RESTORED,           FSM_LOG_INFO,  "Restored LEDs: %d state: %d")                    \
+  /* fsm_transition_validate() */                                                                 \
+  X(TRANSITION_NO_ENTRY_EXIT,   FSM_LOG_ERROR, "fsm_transition: state %u has no entry or exit action") \
+  X(TRANSITION_ENTRY_EXIT_RECORDS, FSM_LOG_ERROR, "fsm_transition: state %u has records for ENTRY/EXIT") \
+  X(TRANSITION_TOO_MANY,        FSM_LOG_ERROR, "fsm_transition: state %u signal %u has %u records") \
+  X(TRANSITION_BAD_TARGET,      FSM_LOG_ERROR, "fsm_transition: state %u signal %u targets %u")  \
+  X(TRANSITION_UNREACHABLE,     FSM_LOG_ERROR, "fsm_transition: state %u signal %u record %u is never reached") \
+  /* potentiometers, main.c */                                                                    \
+  X(POT_LEVEL,                  FSM_LOG_DEBUG, "Pot %u: level %u")
+
+
+#endif
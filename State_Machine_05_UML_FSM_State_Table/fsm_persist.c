@@ -0,0 +1,236 @@
+
+#include "fsm_persist.h"
+#include "fsm_log.h"
+
+
+#if defined(HAL_POSIX)
+/* Host build: the flash of fds_posix.c, erased at every start unless FDS_FILE names a file */
+#include "fds_posix.h"
+#else
+#include "nrf.h"
+#include "fds.h"
+#include "app_error.h"
+#endif
+
+
+HAL_TIMER_DEF(m_persist_timer_id);      /**< Single shot timer used to coalesce snapshot writes. */
+
+static volatile bool m_fds_ready;
+static volatile bool m_write_pending;   /* record handed to FDS, waiting for completion */
+static bool m_flush_armed;              /* coalesce timer running */
+static bool m_have_record;              /* a record already exists, update it instead of write */
+
+static fsm_persist_record_t m_snapshot;  /* latest committed application state */
+static fsm_persist_record_t m_flash_rec; /* copy owned by FDS while a write is in flight */
+static fds_record_desc_t m_desc;
+static fsm_persist_stats_t m_stats;
+
+static void persist_flush(void);
+
+
+/**@brief Sequence numbers wrap, newer means less than half the range ahead.
+ */
+static bool seq_is_newer(uint16_t a, uint16_t b)
+{
+  return (int16_t)(a - b) > 0;
+}
+
+static void fds_evt_handler(fds_evt_t const * p_evt)
+{
+  switch(p_evt->id)
+  {
+    case FDS_EVT_INIT:
+    {
+      APP_ERROR_CHECK(p_evt->result);
+      m_fds_ready = true;
+      break;
+    }
+
+    case FDS_EVT_WRITE:
+    case FDS_EVT_UPDATE:
+    {
+      m_write_pending = false;
+      if(p_evt->result == NRF_SUCCESS)
+      {
+        m_have_record = true;
+        m_stats.writes++;
+      }
+      /* state may have moved on while this record was being written */
+      if((m_flash_rec.curr_leds != m_snapshot.curr_leds) ||
+         (m_flash_rec.active_state != m_snapshot.active_state))
+      {
+        persist_flush();
+      }
+      break;
+    }
+
+    case FDS_EVT_GC:
+    {
+      persist_flush();
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+/**@brief Hand the latest snapshot to FDS.
+ *
+ * @details FDS is log structured: an update appends a new record and invalidates the
+ *          previous one, so each flush costs one record of flash and no page erase.
+ *          When the pages run full the dirty records are reclaimed with fds_gc().
+ */
+static void persist_flush(void)
+{
+  ret_code_t err_code;
+  fds_record_t record;
+
+  if(m_write_pending)
+  {
+    return; // retried from the completion event
+  }
+
+  m_flash_rec = m_snapshot;
+  /* The NVMC backend completes the write, and runs fds_evt_handler, before
+   * fds_record_write/update return: the flag has to be set first */
+  m_write_pending = true;
+
+  record.file_id = FSM_PERSIST_FILE_ID;
+  record.key = FSM_PERSIST_RECORD_KEY;
+  record.data.p_data = &m_flash_rec;
+  record.data.length_words = (sizeof(m_flash_rec) + 3) / sizeof(uint32_t);
+
+  /* on success m_desc is updated to describe the new record */
+  if(m_have_record)
+  {
+    err_code = fds_record_update(&m_desc, &record);
+  }
+  else
+  {
+    err_code = fds_record_write(&m_desc, &record);
+  }
+
+  if(err_code != NRF_SUCCESS)
+  {
+    m_write_pending = false;
+  }
+  if(err_code == FDS_ERR_NO_SPACE_IN_FLASH)
+  {
+    m_stats.gc_runs++;
+    err_code = fds_gc();    // FDS_EVT_GC flushes again
+  }
+  APP_ERROR_CHECK(err_code);
+}
+
+/**@brief Timeout handler for the coalesce timer.
+ */
+static void persist_timer_handler(void * p_context)
+{
+  (void)p_context;
+  m_flush_armed = false;
+  persist_flush();
+}
+
+void fsm_persist_init(void)
+{
+  ret_code_t err_code;
+
+  err_code = fds_register(fds_evt_handler);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = fds_init();
+  APP_ERROR_CHECK(err_code);
+
+  while(!m_fds_ready)
+  {
+#if !defined(HAL_POSIX)
+    __WFE();
+#endif
+  }
+
+  hal_timer_create(&m_persist_timer_id, HAL_TIMER_SINGLE_SHOT, persist_timer_handler);
+}
+
+/**@brief Load the newest snapshot into myApp.
+ *
+ * @details Normally a single record exists. A reset between the append and the
+ *          invalidation of an update leaves two, the higher sequence number wins.
+ *          The search is bounded by the FDS page count.
+ *
+ * @return true if a valid snapshot was restored.
+ */
+bool fsm_persist_restore(app_t *const myApp)
+{
+  fds_record_desc_t desc;
+  fds_find_token_t tok = {0};
+  fds_flash_record_t flash_rec;
+  fsm_persist_record_t latest;
+  bool found = false;
+  uint32_t start = hal_ticks();
+
+  while(fds_record_find(FSM_PERSIST_FILE_ID, FSM_PERSIST_RECORD_KEY, &desc, &tok) == NRF_SUCCESS)
+  {
+    if(fds_record_open(&desc, &flash_rec) != NRF_SUCCESS)
+    {
+      continue; // CRC failure, torn write
+    }
+    fsm_persist_record_t const *p_rec = (fsm_persist_record_t const *)flash_rec.p_data;
+    if(!found || seq_is_newer(p_rec->seq, latest.seq))
+    {
+      latest = *p_rec;
+      m_desc = desc;
+      found = true;
+    }
+    (void)fds_record_close(&desc);
+  }
+
+  m_stats.restore_ticks = hal_ticks_diff(hal_ticks(), start);
+
+  if(!found || (latest.active_state >= MAX_STATE) || (latest.curr_leds > LED_COUNT))
+  {
+    return false;
+  }
+
+  m_have_record = true;
+  m_snapshot = latest;
+
+  myApp->curr_leds = latest.curr_leds;
+  myApp->active_state = (app_state_t)latest.active_state;
+  if((myApp->active_state == BLINK || myApp->active_state == PAUSE) && (myApp->curr_leds == 0))
+  {
+    myApp->active_state = IDLE;
+  }
+  FSM_LOG2(PERSIST_RESTORED, myApp->curr_leds, myApp->active_state);
+  return true;
+}
+
+/**@brief Record the state reached by a completed run-to-completion step.
+ *
+ * @details Only a change of the snapshot arms the coalesce timer, and bursts of
+ *          changes inside FSM_PERSIST_COALESCE_MS are written once.
+ */
+void fsm_persist_commit(app_t const *const myApp)
+{
+  if((myApp->curr_leds == m_snapshot.curr_leds) &&
+     (myApp->active_state == (app_state_t)m_snapshot.active_state))
+  {
+    return;
+  }
+
+  m_snapshot.curr_leds = myApp->curr_leds;
+  m_snapshot.active_state = (uint8_t)myApp->active_state;
+  m_snapshot.seq++;
+  m_stats.commits++;
+
+  if(!m_flush_armed)
+  {
+    hal_timer_start(m_persist_timer_id, FSM_PERSIST_COALESCE_MS, NULL);
+    m_flush_armed = true;
+  }
+}
+
+fsm_persist_stats_t const * fsm_persist_stats_get(void)
+{
+  return &m_stats;
+}
@@ -0,0 +1,39 @@
+#ifndef FSM_PERSIST_H
+#define FSM_PERSIST_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "main.h"
+
+
+/* FDS file and record key holding the application snapshot */
+#define FSM_PERSIST_FILE_ID     0x5A01
+#define FSM_PERSIST_RECORD_KEY  0x0001
+
+/* Writes requested within this window are coalesced into one flash write */
+#define FSM_PERSIST_COALESCE_MS 1000
+
+/* Snapshot of app_t stored in flash, one word long */
+typedef struct
+{
+  uint8_t curr_leds;
+  uint8_t active_state;
+  uint16_t seq;
+}fsm_persist_record_t;
+
+/* Flash usage counters */
+typedef struct
+{
+  uint32_t commits;       /* fsm_persist_commit() calls that changed the snapshot */
+  uint32_t writes;        /* records actually written to flash */
+  uint32_t gc_runs;       /* garbage collections started */
+  uint32_t restore_ticks; /* hal_ticks() spent in fsm_persist_restore() */
+}fsm_persist_stats_t;
+
+
+void fsm_persist_init(void);
+bool fsm_persist_restore(app_t *const myApp);
+void fsm_persist_commit(app_t const *const myApp);
+fsm_persist_stats_t const * fsm_persist_stats_get(void);
+
+
+#endif
@@ -0,0 +1,126 @@
+/* Host measurement of fsm_persist.c on the flash of fds_posix.c.
+ *
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DFSM_PERSIST_BENCH -I. -I../State_Machine_Common \
+ *       fsm_persist_bench.c fsm_persist.c fds_posix.c fsm_log.c ../State_Machine_Common/hal_posix.c \
+ *       -o fsm_persist_bench
+ *   ./fsm_persist_bench [bursts]
+ *
+ * State changes are committed in bursts of up to BENCH_BURST changes
+ * BENCH_BURST_GAP_MS apart, with pseudo random virtual time between the
+ * bursts. After a burst the coalesce window runs out and the snapshot is
+ * read back with fsm_persist_restore, it must be the last state committed.
+ * It reports the records written per commit, the words programmed per
+ * record written (the write amplification of the header, the invalidation
+ * and the garbage collection copies), the erases per page per day at this
+ * rate and the cost of a restore: words searched and host time.
+ */
+#if defined(FSM_PERSIST_BENCH)
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fsm_persist.h"
+#include "fds_posix.h"
+
+#define BENCH_BURSTS_DEFAULT  20000
+#define BENCH_BURST           5
+#define BENCH_BURST_GAP_MS    20
+#define BENCH_IDLE_MS         4000    /* mean time between bursts */
+#define BENCH_ERASE_CYCLES    10000   /* nRF52840 flash endurance */
+
+static uint32_t m_rand = 0x9E3779B9;
+
+
+static uint32_t bench_rand(uint32_t range)
+{
+  m_rand ^= m_rand << 13;
+  m_rand ^= m_rand >> 17;
+  m_rand ^= m_rand << 5;
+  return m_rand % range;
+}
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/**@brief A state fsm_persist_restore gives back unchanged: no BLINK or PAUSE without LEDs.
+ */
+static void state_next(app_t *p_app)
+{
+  do
+  {
+    p_app->curr_leds = (uint8_t)bench_rand(LED_COUNT + 1);
+    p_app->active_state = (app_state_t)bench_rand(MAX_STATE);
+  }while((p_app->curr_leds == 0) && ((p_app->active_state == BLINK) || (p_app->active_state == PAUSE)));
+}
+
+int main(int argc, char **argv)
+{
+  unsigned bursts = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : BENCH_BURSTS_DEFAULT;
+  app_t app = {0};
+  uint32_t mismatches = 0;
+  uint32_t searched_max = 0;
+  uint64_t restore_ns = 0;
+  uint64_t restore_ns_max = 0;
+  uint32_t searched_before;
+  fsm_persist_stats_t const *p_stats;
+  fds_posix_stats_t const *p_flash;
+  double days;
+
+  hal_init();
+  fsm_persist_init();
+  p_flash = fds_posix_stats_get();
+  p_stats = fsm_persist_stats_get();
+
+  for(unsigned b = 0; b < bursts; b++)
+  {
+    unsigned changes = 1 + bench_rand(BENCH_BURST);
+    app_t restored = {0};
+    uint64_t t0;
+    uint64_t ns;
+
+    for(unsigned c = 0; c < changes; c++)
+    {
+      state_next(&app);
+      fsm_persist_commit(&app);
+      hal_posix_run_until(hal_posix_time_us() + (BENCH_BURST_GAP_MS * 1000));
+    }
+    hal_posix_run_until(hal_posix_time_us() + (FSM_PERSIST_COALESCE_MS * 1000) + 1000);
+
+    searched_before = p_flash->words_searched;
+    t0 = host_ns();
+    if(!fsm_persist_restore(&restored) || (restored.curr_leds != app.curr_leds) ||
+       (restored.active_state != app.active_state))
+    {
+      mismatches++;
+    }
+    ns = host_ns() - t0;
+    restore_ns += ns;
+    restore_ns_max = (ns > restore_ns_max) ? ns : restore_ns_max;
+    searched_max = ((p_flash->words_searched - searched_before) > searched_max) ?
+                   (p_flash->words_searched - searched_before) : searched_max;
+
+    hal_posix_run_until(hal_posix_time_us() + (bench_rand(2 * BENCH_IDLE_MS) * 1000));
+  }
+  days = (double)hal_posix_time_us() / 86400e6;
+
+  printf("%u bursts of 1..%u changes, %.1f virtual days, flash %u pages of %u words\n", bursts, BENCH_BURST, days,
+         FDS_POSIX_PAGES, FDS_POSIX_PAGE_WORDS);
+  printf("commits %u, records written %u (%.2f per commit), garbage collections %u\n", p_stats->commits,
+         p_stats->writes, (double)p_stats->writes / p_stats->commits, p_stats->gc_runs);
+  printf("words programmed %u: %.2f per record of %u word(s)\n", p_flash->words_written,
+         (double)p_flash->words_written / p_stats->writes,
+         (unsigned)((sizeof(fsm_persist_record_t) + 3) / sizeof(uint32_t)));
+  printf("page erases %u: %.2f per page per day, %u cycles last %.0f days\n", p_flash->page_erases,
+         p_flash->page_erases / (FDS_POSIX_PAGES * days), BENCH_ERASE_CYCLES,
+         BENCH_ERASE_CYCLES / (p_flash->page_erases / (FDS_POSIX_PAGES * days)));
+  printf("restore: %.0f ns mean, %llu ns max, %u words searched at most\n", (double)restore_ns / bursts,
+         (unsigned long long)restore_ns_max, searched_max);
+  printf("restored state differs from the last commit after %u of %u bursts\n", mismatches, bursts);
+  return (mismatches == 0) ? 0 : 1;
+}
+
+#endif /* FSM_PERSIST_BENCH */
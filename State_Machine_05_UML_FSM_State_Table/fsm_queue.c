@@ -0,0 +1,233 @@
+#include "fsm_queue.h"
+#include <string.h>
+
+#if !defined(HAL_POSIX)
+#include "nrf.h"
+#include "app_util_platform.h"
+#define QUEUE_LOCK()      CRITICAL_REGION_ENTER()
+#define QUEUE_UNLOCK()    CRITICAL_REGION_EXIT()
+#else
+#define __CLZ(x)          ((uint32_t)__builtin_clz(x))
+#define QUEUE_LOCK()      do {
+#define QUEUE_UNLOCK()    } while(0)
+#endif
+
+#define FSM_QUEUE_MASK    (FSM_QUEUE_DEPTH - 1)
+
+#if ((FSM_QUEUE_DEPTH & FSM_QUEUE_MASK) != 0) || (FSM_QUEUE_DEPTH > 128)
+#error "FSM_QUEUE_DEPTH must be a power of two up to 128"
+#endif
+#if (FSM_QUEUE_LEVELS < 1) || (FSM_QUEUE_LEVELS > 32)
+#error "FSM_QUEUE_LEVELS must be 1..32"
+#endif
+
+/* A slot is the post time in hal ticks, then the event up to the size of its class */
+#define FSM_QUEUE_SLOT_WORDS(class)   (1 + ((FSM_EVENT_SIZE(class) + 3) / 4))
+#define FSM_QUEUE_POOL_WORDS(class)   + (FSM_QUEUE_DEPTH * FSM_QUEUE_SLOT_WORDS(class))
+#define FSM_QUEUE_EVENT_SIZE(class)   FSM_EVENT_SIZE(class),
+
+/* One ring, head and tail run freely and are masked on access */
+typedef struct
+{
+  uint32_t *p_slots;
+  uint8_t slot_words;
+  uint8_t head;
+  uint8_t tail;
+  fsm_queue_policy_t policy;
+}fsm_queue_level_t;
+
+static uint8_t const m_event_size[FSM_QUEUE_LEVELS] = {FSM_EVENT_CLASSES(FSM_QUEUE_EVENT_SIZE)};
+static uint32_t m_pool[0 FSM_EVENT_CLASSES(FSM_QUEUE_POOL_WORDS)];
+static fsm_queue_level_t m_level[FSM_QUEUE_LEVELS];
+static volatile uint32_t m_ready;     /**< Bit n: level n is not empty. */
+static fsm_queue_handler_t m_handler;
+static fsm_queue_stats_t m_stats[FSM_QUEUE_LEVELS];
+
+static void dispatch_run(void);
+
+/**@brief Copy whole words, an event is at most a few of them.
+ *
+ * @details fsm_event_t is word aligned and a multiple of words, a class
+ *          rounded up to words stays within it. A memcpy of a variable size
+ *          costs more than the copy itself.
+ */
+static inline void words_copy(void *p_dst, void const *p_src, uint8_t words)
+{
+  uint8_t *p_d = p_dst;
+  uint8_t const *p_s = p_src;
+
+  for(uint8_t i = 0; i < words; i++)
+  {
+    memcpy(&p_d[4 * i], &p_s[4 * i], 4);
+  }
+}
+
+
+#if !defined(HAL_POSIX)
+void SWI1_EGU1_IRQHandler(void)
+{
+  dispatch_run();
+}
+
+static void dispatch_enable(void)
+{
+  NVIC_SetPriority(SWI1_EGU1_IRQn, FSM_QUEUE_IRQ_PRIORITY);
+  NVIC_ClearPendingIRQ(SWI1_EGU1_IRQn);
+  NVIC_EnableIRQ(SWI1_EGU1_IRQn);
+}
+
+static inline void dispatch_pend(void)
+{
+  NVIC_SetPendingIRQ(SWI1_EGU1_IRQn);
+}
+#else
+static void dispatch_enable(void)
+{
+  hal_posix_swi_set(dispatch_run);
+}
+
+static inline void dispatch_pend(void)
+{
+  hal_posix_swi_pend();
+}
+#endif
+
+/**@brief Software interrupt: one event, highest level first, then give way
+ *        to the interrupts pending at the same priority.
+ */
+static void dispatch_run(void)
+{
+  fsm_event_t event = {0};    // a slot holds the payload of its class, the rest of the union stays zero
+
+  if(fsm_queue_get(&event))
+  {
+    m_handler(&event);
+  }
+  if(m_ready != 0)
+  {
+    dispatch_pend();
+  }
+}
+
+/**@brief Empty every level, set the overflow policy of each.
+ *
+ * @details With a NULL handler nothing is dispatched, events are taken
+ *          with fsm_queue_get().
+ */
+void fsm_queue_init(fsm_queue_policy_t const *policies, fsm_queue_handler_t handler)
+{
+  uint32_t *p_slots = m_pool;
+
+  memset(m_level, 0, sizeof(m_level));
+  memset(m_stats, 0, sizeof(m_stats));
+  for(uint8_t level = 0; level < FSM_QUEUE_LEVELS; level++)
+  {
+    fsm_queue_level_t *p_level = &m_level[level];
+
+    p_level->p_slots = p_slots;
+    p_level->slot_words = 1 + ((m_event_size[level] + 3) / 4);
+    p_level->policy = policies[level];
+    p_slots += FSM_QUEUE_DEPTH * p_level->slot_words;
+  }
+  m_ready = 0;
+  m_handler = handler;
+  if(handler != NULL)
+  {
+    dispatch_enable();
+  }
+}
+
+/**@brief Queue an event at the level of its class, higher levels are
+ *        dispatched first.
+ *
+ * @return False if the event was rejected by a full level.
+ */
+bool fsm_queue_post(fsm_event_t const *p_event)
+{
+  uint8_t level = fsm_event_class(p_event->super.sig);
+  fsm_queue_level_t *p_level = &m_level[level];
+  fsm_queue_stats_t *p_stats = &m_stats[level];
+  bool queued = true;
+  uint8_t depth;
+
+  QUEUE_LOCK();
+  p_stats->posted++;
+  if((uint8_t)(p_level->head - p_level->tail) == FSM_QUEUE_DEPTH)
+  {
+    p_stats->dropped++;
+    if(p_level->policy == FSM_QUEUE_DROP_OLDEST)
+    {
+      p_level->tail++;
+    }
+    else
+    {
+      queued = false;
+    }
+  }
+  if(queued)
+  {
+    uint32_t *p_slot = &p_level->p_slots[(p_level->head & FSM_QUEUE_MASK) * p_level->slot_words];
+
+    p_slot[0] = hal_ticks();
+    words_copy(&p_slot[1], p_event, p_level->slot_words - 1);
+    p_level->head++;
+    m_ready |= 1UL << level;
+    depth = (uint8_t)(p_level->head - p_level->tail);
+    if(depth > p_stats->depth_max)
+    {
+      p_stats->depth_max = depth;
+    }
+  }
+  QUEUE_UNLOCK();
+
+  if(queued && (m_handler != NULL))
+  {
+    dispatch_pend();
+  }
+  return queued;
+}
+
+/**@brief Take the oldest event of the highest level that holds one.
+ *
+ * @details Only the size of its class is written, the payload of its
+ *          signal, the rest of the union is left as it was.
+ */
+bool fsm_queue_get(fsm_event_t *p_event)
+{
+  bool taken = false;
+
+  QUEUE_LOCK();
+  if(m_ready != 0)
+  {
+    uint8_t level = (uint8_t)(31 - __CLZ(m_ready));
+    fsm_queue_level_t *p_level = &m_level[level];
+    uint32_t const *p_slot = &p_level->p_slots[(p_level->tail & FSM_QUEUE_MASK) * p_level->slot_words];
+    fsm_queue_stats_t *p_stats = &m_stats[level];
+    uint32_t wait = hal_ticks_diff(hal_ticks(), p_slot[0]);
+
+    words_copy(p_event, &p_slot[1], p_level->slot_words - 1);
+    p_level->tail++;
+    if(p_level->head == p_level->tail)
+    {
+      m_ready &= ~(1UL << level);
+    }
+    p_stats->taken++;
+    if(wait > p_stats->wait_max)
+    {
+      p_stats->wait_max = wait;
+    }
+    taken = true;
+  }
+  QUEUE_UNLOCK();
+  return taken;
+}
+
+bool fsm_queue_pending(void)
+{
+  return m_ready != 0;
+}
+
+fsm_queue_stats_t const * fsm_queue_stats_get(uint8_t level)
+{
+  return &m_stats[level];
+}
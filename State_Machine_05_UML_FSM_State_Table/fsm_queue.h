@@ -0,0 +1,55 @@
+#ifndef FSM_QUEUE_H
+#define FSM_QUEUE_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "main.h"
+#include "fsm_event.h"
+
+
+/* Events waiting for dispatch, one ring per priority level, the queue class
+ * of their signal (fsm_event.h).
+ *
+ * Bit n of the ready mask is set while level n holds events, the highest
+ * level, 31 - CLZ(ready), gives the next event: constant time whatever the
+ * number of levels, FIFO within a level. Posting pends a software interrupt
+ * (SWI1, SWI0 belongs to app_timer) at the GPIOTE priority that dispatches
+ * one event per activation, so button and link interrupts pending meanwhile
+ * run first and their events compete for the next one. Posting is safe from
+ * any priority. A slot holds the event up to the largest payload of its
+ * class. */
+
+#define FSM_QUEUE_LEVELS        FSM_EVENT_CLASS_COUNT
+
+/* events per level, must be a power of two */
+#ifndef FSM_QUEUE_DEPTH
+#define FSM_QUEUE_DEPTH         8
+#endif
+
+#define FSM_QUEUE_IRQ_PRIORITY  GPIOTE_CONFIG_IRQ_PRIORITY
+
+typedef enum
+{
+  FSM_QUEUE_DROP_NEWEST,    /* a full level rejects the event posted */
+  FSM_QUEUE_DROP_OLDEST     /* a full level makes room by discarding its oldest event */
+}fsm_queue_policy_t;
+
+typedef struct
+{
+  uint32_t posted;
+  uint32_t dropped;         /* rejected or discarded by the policy */
+  uint32_t taken;
+  uint32_t wait_max;        /* hal ticks from post to take */
+  uint8_t depth_max;
+}fsm_queue_stats_t;
+
+typedef void (*fsm_queue_handler_t)(fsm_event_t const *p_event);
+
+
+void fsm_queue_init(fsm_queue_policy_t const *policies, fsm_queue_handler_t handler);
+bool fsm_queue_post(fsm_event_t const *p_event);
+bool fsm_queue_get(fsm_event_t *p_event);
+bool fsm_queue_pending(void);
+fsm_queue_stats_t const * fsm_queue_stats_get(uint8_t level);
+
+
+#endif
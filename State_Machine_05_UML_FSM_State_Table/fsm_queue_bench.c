@@ -0,0 +1,258 @@
+/* Host measurement of fsm_queue.c under mixed priority load.
+ *
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DFSM_QUEUE_BENCH -DFSM_QUEUE_DEPTH=64 -I. -I../State_Machine_Common \
+ *       fsm_queue_bench.c fsm_queue.c ../State_Machine_Common/hal_posix.c -lm -o fsm_queue_bench
+ *   ./fsm_queue_bench [events]
+ *
+ * Events arrive as a Poisson stream, 70 % INC_LED/DEC_LED, 20 % START_PAUSE
+ * and 10 % ABRT, and one dispatcher serves them with exponential service
+ * times of mean BENCH_SERVICE_US, all in virtual time. Per utilisation it
+ * reports the time every class waits in the queue, once through fsm_queue
+ * with the policies of main.c and once through one FIFO ring of whole
+ * events as deep as a level. The depth is raised so that drops stay rare
+ * and both runs see the same events. Last, the slot sizes of the classes
+ * and the host time of a post and a get.
+ */
+#if defined(FSM_QUEUE_BENCH)
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fsm_queue.h"
+
+#define BENCH_EVENTS_DEFAULT  200000
+#define BENCH_SERVICE_US      200.0
+#define BENCH_CLASSES         3       /* INC_LED/DEC_LED, START_PAUSE, ABRT */
+
+static double const m_loads[] = {0.5, 0.8, 0.95};
+#define BENCH_LOADS   (sizeof(m_loads) / sizeof(m_loads[0]))
+
+static fsm_queue_policy_t const m_policies[FSM_QUEUE_LEVELS] = {FSM_QUEUE_DROP_NEWEST, FSM_QUEUE_DROP_NEWEST, FSM_QUEUE_DROP_OLDEST};
+static char const * const m_class_names[BENCH_CLASSES] = {"INC/DEC", "START_PAUSE", "ABRT"};
+
+static uint32_t m_rand;
+
+/* The reference queue: arrival order, every slot as large as the largest event */
+static fsm_event_t m_fifo[FSM_QUEUE_DEPTH];
+static uint32_t m_fifo_head;
+static uint32_t m_fifo_tail;
+
+typedef struct
+{
+  uint32_t *p_wait;
+  uint32_t count;
+  uint32_t dropped;
+}bench_class_t;
+
+typedef struct
+{
+  bool (*post)(fsm_event_t const *p_event);
+  bool (*get)(fsm_event_t *p_event);
+}bench_queue_t;
+
+
+static uint32_t bench_rand(void)
+{
+  m_rand ^= m_rand << 13;
+  m_rand ^= m_rand >> 17;
+  m_rand ^= m_rand << 5;
+  return m_rand;
+}
+
+static double bench_exp(double mean)
+{
+  return -mean * log((bench_rand() + 1.0) / 4294967297.0);
+}
+
+static fsm_signal_t bench_signal(void)
+{
+  uint32_t r = bench_rand() % 100;
+
+  if(r < 70)
+  {
+    return (r & 1) ? INC_LED : DEC_LED;
+  }
+  return (r < 90) ? START_PAUSE : ABRT;
+}
+
+static uint8_t class_of(fsm_signal_t sig)
+{
+  return (sig == ABRT) ? 2 : ((sig == START_PAUSE) ? 1 : 0);
+}
+
+static bool fifo_post(fsm_event_t const *p_event)
+{
+  if((m_fifo_head - m_fifo_tail) == FSM_QUEUE_DEPTH)
+  {
+    return false;
+  }
+  m_fifo[m_fifo_head++ & (FSM_QUEUE_DEPTH - 1)] = *p_event;
+  return true;
+}
+
+static bool fifo_get(fsm_event_t *p_event)
+{
+  if(m_fifo_head == m_fifo_tail)
+  {
+    return false;
+  }
+  *p_event = m_fifo[m_fifo_tail++ & (FSM_QUEUE_DEPTH - 1)];
+  return true;
+}
+
+static bench_queue_t const m_prio = {fsm_queue_post, fsm_queue_get};
+static bench_queue_t const m_fifo_queue = {fifo_post, fifo_get};
+
+static int cmp_u32(void const *a, void const *b)
+{
+  uint32_t x = *(uint32_t const *)a;
+  uint32_t y = *(uint32_t const *)b;
+  return (x > y) - (x < y);
+}
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/**@brief Serve queued events until the dispatcher is busy past until_us.
+ */
+static void serve(bench_queue_t const *p_queue, double *p_free_at, double until_us, bench_class_t *p_classes)
+{
+  fsm_event_t e;
+
+  while(*p_free_at <= until_us)
+  {
+    hal_posix_run_until((uint64_t)*p_free_at);
+    if(!p_queue->get(&e))
+    {
+      return;
+    }
+    bench_class_t *p_class = &p_classes[class_of(e.super.sig)];
+    p_class->p_wait[p_class->count++] = (uint32_t)hal_posix_time_us() - e.edge_time;
+    *p_free_at += bench_exp(BENCH_SERVICE_US);
+  }
+}
+
+static void run(bench_queue_t const *p_queue, unsigned events, double load, bench_class_t *p_classes)
+{
+  double arrival = hal_posix_time_us() + 1000.0;
+  double free_at = arrival;
+
+  m_rand = 0x9E3779B9;              // both runs see the same events
+  fsm_queue_init(m_policies, NULL);
+  m_fifo_head = 0;
+  m_fifo_tail = 0;
+  for(uint8_t c = 0; c < BENCH_CLASSES; c++)
+  {
+    p_classes[c].count = 0;
+    p_classes[c].dropped = 0;
+  }
+
+  for(unsigned i = 0; i < events; i++)
+  {
+    fsm_event_t e = {0};
+
+    serve(p_queue, &free_at, arrival, p_classes);
+    hal_posix_run_until((uint64_t)arrival);
+    if(free_at < arrival)
+    {
+      free_at = arrival;            // idle dispatcher, starts on this event
+    }
+    e.super.sig = bench_signal();
+    e.edge_time = (uint32_t)hal_posix_time_us();
+    if(!p_queue->post(&e))
+    {
+      p_classes[class_of(e.super.sig)].dropped++;
+    }
+    arrival += bench_exp(BENCH_SERVICE_US / load);
+  }
+  serve(p_queue, &free_at, INFINITY, p_classes);
+  for(uint8_t level = 0; level < FSM_QUEUE_LEVELS; level++)
+  {
+    // DROP_OLDEST discards events already counted as posted, the level is the class
+    p_classes[level].dropped += (m_policies[level] == FSM_QUEUE_DROP_OLDEST) ? fsm_queue_stats_get(level)->dropped : 0;
+  }
+}
+
+static void report(char const *name, bench_class_t *p_classes)
+{
+  for(uint8_t c = 0; c < BENCH_CLASSES; c++)
+  {
+    bench_class_t *p_class = &p_classes[c];
+    uint64_t sum = 0;
+
+    qsort(p_class->p_wait, p_class->count, sizeof(uint32_t), cmp_u32);
+    for(uint32_t i = 0; i < p_class->count; i++)
+    {
+      sum += p_class->p_wait[i];
+    }
+    printf("  %-5s %-12s %8u %10.1f %8u %8u %8u %8u\n", name, m_class_names[c], p_class->count,
+           p_class->count ? ((double)sum / p_class->count) : 0.0,
+           p_class->count ? p_class->p_wait[p_class->count / 2] : 0,
+           p_class->count ? p_class->p_wait[(p_class->count * 99) / 100] : 0,
+           p_class->count ? p_class->p_wait[p_class->count - 1] : 0, p_class->dropped);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  unsigned events = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : BENCH_EVENTS_DEFAULT;
+  bench_class_t classes[BENCH_CLASSES];
+  fsm_event_t e = FSM_EVENT(INC_LED, 0, .count = 1);
+  unsigned slot_bytes = 0;
+  uint64_t t0;
+  unsigned ops = 0;
+
+  for(uint8_t c = 0; c < BENCH_CLASSES; c++)
+  {
+    classes[c].p_wait = calloc(events, sizeof(uint32_t));
+  }
+  hal_init();
+
+  printf("%u events, mean service %.0f us, queue depth %u per level\n", events, BENCH_SERVICE_US, FSM_QUEUE_DEPTH);
+  printf("  queue class         dispatched  wait us mean      p50      p99      max  dropped\n");
+  for(unsigned l = 0; l < BENCH_LOADS; l++)
+  {
+    printf("load %.2f\n", m_loads[l]);
+    run(&m_prio, events, m_loads[l], classes);
+    report("prio", classes);
+    run(&m_fifo_queue, events, m_loads[l], classes);
+    report("fifo", classes);
+  }
+
+#define BENCH_SLOT_BYTES(class)  slot_bytes += 4 * (1 + ((FSM_EVENT_SIZE(class) + 3) / 4)); \
+                                 printf(" %u", (unsigned)FSM_EVENT_SIZE(class));
+  printf("event bytes per class:");
+  FSM_EVENT_CLASSES(BENCH_SLOT_BYTES)
+  printf(" (whole event %u), %u bytes per queue depth against %u with whole events\n", (unsigned)sizeof(fsm_event_t),
+         slot_bytes, (unsigned)(FSM_QUEUE_LEVELS * 4 * (1 + ((sizeof(fsm_event_t) + 3) / 4))));
+
+  // host cost: a post of a pseudo random signal, with up to 3 levels busy, and a get
+  fsm_queue_init(m_policies, NULL);
+  t0 = host_ns();
+  for(unsigned i = 0; i < events * 10; i++)
+  {
+    e.super.sig = (fsm_signal_t)(INC_LED + (bench_rand() % (MAX_SIGNALS - INC_LED)));
+    (void)fsm_queue_post(&e);
+    if((i & 3) == 3)
+    {
+      while(fsm_queue_get(&e))
+      {
+        ops++;
+      }
+    }
+  }
+  printf("post + get  %.1f ns (%u events)\n", (double)(host_ns() - t0) / ops, ops);
+
+  for(uint8_t c = 0; c < BENCH_CLASSES; c++)
+  {
+    free(classes[c].p_wait);
+  }
+  return 0;
+}
+
+#endif /* FSM_QUEUE_BENCH */
@@ -0,0 +1,122 @@
+
+#include "fsm_region.h"
+
+#if FSM_ORTHOGONAL_REGIONS
+
+static fsm_region_stats_t m_stats;
+
+
+/**@brief Table cell of a state and signal, NULL when the state does not handle it.
+ */
+static inline r_handler_t region_cell(region_t const *const region, uint8_t state, fsm_signal_t sig)
+{
+  return region->table[(state * MAX_SIGNALS) + sig];
+}
+
+/**@brief Set up a region over a [num_states][MAX_SIGNALS] table.
+ *
+ * The subscription mask gets a bit for every signal some state handles,
+ * ENTRY and EXIT are only run by the dispatcher and are left out.
+ */
+void fsm_region_init(region_t *const region, r_handler_t const *table, uint8_t num_states, uint8_t initial)
+{
+  region->table = table;
+  region->num_states = num_states;
+  region->active_state = initial;
+  region->subscribed = 0;
+  for(uint8_t state = 0; state < num_states; state++)
+  {
+    for(uint8_t sig = INC_LED; sig < MAX_SIGNALS; sig++)
+    {
+      if(region_cell(region, state, (fsm_signal_t)sig) != NULL)
+      {
+        region->subscribed |= FSM_REGION_SIG_BIT(sig);
+      }
+    }
+  }
+}
+
+/**@brief Run the entry action of the region's active state.
+ */
+void fsm_region_enter(app_t *const myApp, region_t *const region)
+{
+  event_t ee;
+  r_handler_t rhandler = region_cell(region, region->active_state, ENTRY);
+
+  if(rhandler != NULL)
+  {
+    ee.sig = ENTRY;
+    (*rhandler)(myApp, region, &ee);
+  }
+}
+
+/**@brief Offer one event to every region of the app.
+ *
+ * A region whose mask has no bit for the signal costs one test. A handler
+ * that returns EVENT_TRANSITION has already set the region's new active
+ * state, the exit and entry actions run before the next region sees the event.
+ *
+ * @return EVENT_TRANSITION if a region transitioned, else EVENT_HANDLED if a
+ *         region handled it, else EVENT_IGNORED.
+ */
+event_status_t fsm_region_dispatch(app_t *const myApp, event_t const *const e)
+{
+  event_status_t result = EVENT_IGNORED;
+  uint32_t bit = FSM_REGION_SIG_BIT(e->sig);
+
+  for(uint8_t i = 0; i < myApp->num_regions; i++)
+  {
+    region_t *const region = &myApp->region[i];
+    r_handler_t rhandler;
+    event_status_t status;
+    uint8_t source;
+
+    if((region->subscribed & bit) == 0)
+    {
+      m_stats.skipped[i]++;
+      continue;
+    }
+    source = region->active_state;
+    rhandler = region_cell(region, source, e->sig);
+    if(rhandler == NULL)
+    {
+      continue;
+    }
+    m_stats.dispatched[i]++;
+    status = (*rhandler)(myApp, region, e);
+    if(status == EVENT_TRANSITION)
+    {
+      event_t ee;
+      uint8_t target = region->active_state;
+
+      m_stats.transitions[i]++;
+      //1. run exit action for source state
+      rhandler = region_cell(region, source, EXIT);
+      if(rhandler != NULL)
+      {
+        ee.sig = EXIT;
+        (*rhandler)(myApp, region, &ee);
+      }
+      //2. run entry action for target state
+      rhandler = region_cell(region, target, ENTRY);
+      if(rhandler != NULL)
+      {
+        ee.sig = ENTRY;
+        (*rhandler)(myApp, region, &ee);
+      }
+      result = EVENT_TRANSITION;
+    }
+    else if((status == EVENT_HANDLED) && (result == EVENT_IGNORED))
+    {
+      result = EVENT_HANDLED;
+    }
+  }
+  return result;
+}
+
+fsm_region_stats_t const * fsm_region_stats_get(void)
+{
+  return &m_stats;
+}
+
+#endif /* FSM_ORTHOGONAL_REGIONS */
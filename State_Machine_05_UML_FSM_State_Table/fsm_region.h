@@ -0,0 +1,28 @@
+#ifndef FSM_REGION_H
+#define FSM_REGION_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "main.h"
+
+
+/* Orthogonal regions: every region of an app_t has its own active state and
+ * table, one event is offered to each region that subscribes to its signal
+ * within the same run-to-completion step, in region order. */
+
+#define FSM_REGION_SIG_BIT(sig)   (1UL << (sig))
+
+typedef struct
+{
+  uint32_t dispatched[FSM_MAX_REGIONS];   /* events handed to the region's handler */
+  uint32_t skipped[FSM_MAX_REGIONS];      /* events the region is not subscribed to */
+  uint32_t transitions[FSM_MAX_REGIONS];
+}fsm_region_stats_t;
+
+
+void fsm_region_init(region_t *const region, r_handler_t const *table, uint8_t num_states, uint8_t initial);
+void fsm_region_enter(app_t *const myApp, region_t *const region);
+event_status_t fsm_region_dispatch(app_t *const myApp, event_t const *const e);
+fsm_region_stats_t const * fsm_region_stats_get(void);
+
+
+#endif
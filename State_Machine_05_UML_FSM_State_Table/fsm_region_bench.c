@@ -0,0 +1,228 @@
+/* Host benchmark of fsm_region.c: one app_t with orthogonal regions against
+ * the same regions run as separate single machines.
+ *
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DFSM_REGION_BENCH -DFSM_ORTHOGONAL_REGIONS=1 \
+ *       -DFSM_MAX_REGIONS=8 -I. -I../State_Machine_Common fsm_region_bench.c fsm_region.c -o fsm_region_bench
+ *   ./fsm_region_bench [events]
+ *
+ * Handlers only count, so the numbers are the dispatch cost per event:
+ *   - regions:        fsm_region_dispatch with the subscription fast path
+ *   - regions, no fast path: same, with every mask forced to all signals
+ *   - separate machines: one full table per machine (unhandled cells hold an
+ *     ignore handler), every event dispatched to every machine the way
+ *     fsm_event_dispatcher does it
+ * for the product topology (edit and blinker regions) and for 8 regions that
+ * each handle one signal.
+ */
+#if defined(FSM_REGION_BENCH)
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "main.h"
+#include "fsm_region.h"
+
+#if FSM_MAX_REGIONS < 8
+#error "build with -DFSM_MAX_REGIONS=8"
+#endif
+
+#define BENCH_EVENTS_DEFAULT  20000000UL
+#define BENCH_RING            4096      /* pre-drawn signals, power of two */
+#define BENCH_MAX_STATES      3
+
+static volatile uint32_t m_sink;
+static event_t m_ring[BENCH_RING];
+
+
+static event_status_t action(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  m_sink++;
+  return EVENT_HANDLED;
+}
+
+static event_status_t ignore(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  return EVENT_IGNORED;
+}
+
+static event_status_t step(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  region->active_state = (uint8_t)((region->active_state + 1) % region->num_states);
+  return EVENT_TRANSITION;
+}
+
+static event_status_t reset(app_t *const myApp, region_t *const region, event_t const *const e)
+{
+  region->active_state = 0;
+  return EVENT_TRANSITION;
+}
+
+typedef struct
+{
+  uint8_t num_regions;
+  uint8_t num_states[FSM_MAX_REGIONS];
+  r_handler_t table[FSM_MAX_REGIONS][BENCH_MAX_STATES][MAX_SIGNALS];
+}topology_t;
+
+/**@brief Edit region {IDLE, SET} and blinker region {OFF, ON, PAUSED} of app_regions.c.
+ */
+static void topology_product(topology_t *const t)
+{
+  *t = (topology_t){0};
+  t->num_regions = 2;
+  t->num_states[0] = 2;
+  t->table[0][0][ENTRY] = &action;
+  t->table[0][0][INC_LED] = &step;
+  t->table[0][0][DEC_LED] = &step;
+  t->table[0][1][ENTRY] = &action;
+  t->table[0][1][INC_LED] = &action;
+  t->table[0][1][DEC_LED] = &action;
+  t->table[0][1][ABRT] = &reset;
+
+  t->num_states[1] = 3;
+  for(uint8_t s = 0; s < 3; s++)
+  {
+    t->table[1][s][ENTRY] = &action;
+    t->table[1][s][START_PAUSE] = &step;
+    t->table[1][s][ABRT] = (s == 0) ? NULL : &reset;
+  }
+  t->table[1][1][EXIT] = &action;
+}
+
+/**@brief 8 regions of two states, region i toggles on one signal only.
+ */
+static void topology_wide(topology_t *const t)
+{
+  *t = (topology_t){0};
+  t->num_regions = 8;
+  for(uint8_t i = 0; i < t->num_regions; i++)
+  {
+    fsm_signal_t sig = (fsm_signal_t)(INC_LED + (i % (MAX_SIGNALS - INC_LED)));
+
+    t->num_states[i] = 2;
+    for(uint8_t s = 0; s < 2; s++)
+    {
+      t->table[i][s][ENTRY] = &action;
+      t->table[i][s][EXIT] = &action;
+      t->table[i][s][sig] = &step;
+    }
+  }
+}
+
+static void app_build(app_t *const myApp, topology_t *const t, bool full_tables)
+{
+  myApp->num_regions = t->num_regions;
+  for(uint8_t i = 0; i < t->num_regions; i++)
+  {
+    if(full_tables)
+    {
+      for(uint8_t s = 0; s < t->num_states[i]; s++)
+      {
+        for(uint8_t sig = 0; sig < MAX_SIGNALS; sig++)
+        {
+          if(t->table[i][s][sig] == NULL)
+          {
+            t->table[i][s][sig] = &ignore;
+          }
+        }
+      }
+    }
+    fsm_region_init(&myApp->region[i], &t->table[i][0][0], t->num_states[i], 0);
+  }
+}
+
+/**@brief One single machine, as fsm_event_dispatcher runs it: every cell is a handler.
+ */
+__attribute__((noinline))
+static void machine_dispatch(app_t *const myApp, region_t *const machine, event_t const *const e)
+{
+  uint8_t source = machine->active_state;
+  r_handler_t const *row = &machine->table[source * MAX_SIGNALS];
+  event_t ee;
+
+  if((*row[e->sig])(myApp, machine, e) == EVENT_TRANSITION)
+  {
+    ee.sig = EXIT;
+    (*row[EXIT])(myApp, machine, &ee);
+    ee.sig = ENTRY;
+    (*machine->table[(machine->active_state * MAX_SIGNALS) + ENTRY])(myApp, machine, &ee);
+  }
+}
+
+static double now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+typedef enum
+{
+  RUN_REGIONS,
+  RUN_REGIONS_NO_FAST_PATH,
+  RUN_SEPARATE
+}run_t;
+
+static double run(void (*topology)(topology_t *const), run_t mode, unsigned long events)
+{
+  static topology_t t;
+  static app_t app;
+  double start;
+
+  topology(&t);
+  app_build(&app, &t, mode == RUN_SEPARATE);
+  if(mode == RUN_REGIONS_NO_FAST_PATH)
+  {
+    for(uint8_t i = 0; i < app.num_regions; i++)
+    {
+      app.region[i].subscribed = UINT32_MAX;
+    }
+  }
+
+  start = now_ns();
+  for(unsigned long n = 0; n < events; n++)
+  {
+    event_t const *e = &m_ring[n & (BENCH_RING - 1)];
+
+    if(mode == RUN_SEPARATE)
+    {
+      for(uint8_t i = 0; i < app.num_regions; i++)
+      {
+        machine_dispatch(&app, &app.region[i], e);
+      }
+    }
+    else
+    {
+      (void)fsm_region_dispatch(&app, e);
+    }
+  }
+  return (now_ns() - start) / events;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long events = (argc > 1) ? strtoul(argv[1], NULL, 0) : BENCH_EVENTS_DEFAULT;
+  uint32_t x = 1;
+
+  for(unsigned i = 0; i < BENCH_RING; i++)
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    m_ring[i].sig = (fsm_signal_t)(INC_LED + ((x >> 16) % (MAX_SIGNALS - INC_LED)));
+  }
+
+  printf("%lu events, ns/event\n", events);
+  printf("topology        regions  no fast path  separate machines\n");
+  printf("product (2) %11.2f %13.2f %18.2f\n",
+         run(topology_product, RUN_REGIONS, events),
+         run(topology_product, RUN_REGIONS_NO_FAST_PATH, events),
+         run(topology_product, RUN_SEPARATE, events));
+  printf("wide (8)    %11.2f %13.2f %18.2f\n",
+         run(topology_wide, RUN_REGIONS, events),
+         run(topology_wide, RUN_REGIONS_NO_FAST_PATH, events),
+         run(topology_wide, RUN_SEPARATE, events));
+  return 0;
+}
+
+#endif /* FSM_REGION_BENCH */
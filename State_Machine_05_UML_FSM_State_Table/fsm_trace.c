@@ -0,0 +1,236 @@
+
+/* Host side of fsm_trace.h, part of -DHAL_POSIX builds only.
+ *
+ * The file is mapped MAP_SHARED: an append is two stores into the mapping
+ * and the kernel writes the pages back, also when the process dies. A full
+ * file is doubled with ftruncate and mremap up to FSM_TRACE_MAX_BYTES,
+ * then renamed to path.1 (older ones shift up to path.FSM_TRACE_KEEP) and
+ * a new file is started.
+ */
+#define _GNU_SOURCE
+#include "fsm_trace.h"
+
+#if defined(HAL_POSIX)
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "hal.h"
+
+
+#define FSM_TRACE_PATH_LEN    240
+
+static int m_fd = -1;
+static fsm_trace_header_t *m_header;
+static fsm_trace_record_t *m_records;
+static size_t m_size;                 /* bytes of the file and the mapping */
+static uint64_t m_capacity;           /* records that fit in m_size */
+static uint32_t m_sequence;
+static char m_path[FSM_TRACE_PATH_LEN];
+static char m_names[FSM_TRACE_HEADER_SIZE - sizeof(fsm_trace_header_t)];
+static uint16_t m_names_len;
+static uint8_t m_num_states;
+static uint8_t m_num_signals;
+static struct timespec m_begin;
+static fsm_trace_stats_t m_stats;
+
+
+static void mapping_set(void *p_map)
+{
+  m_header = p_map;
+  m_records = (fsm_trace_record_t *)((uint8_t *)p_map + FSM_TRACE_HEADER_SIZE);
+  m_capacity = (m_size - FSM_TRACE_HEADER_SIZE) / sizeof(fsm_trace_record_t);
+}
+
+static bool file_open(void)
+{
+  void *p_map;
+
+  m_fd = open(m_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(m_fd < 0)
+  {
+    return false;
+  }
+  m_size = FSM_TRACE_CHUNK_BYTES;
+  if(ftruncate(m_fd, (off_t)m_size) != 0)
+  {
+    close(m_fd);
+    m_fd = -1;
+    return false;
+  }
+  p_map = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if(p_map == MAP_FAILED)
+  {
+    close(m_fd);
+    m_fd = -1;
+    return false;
+  }
+  mapping_set(p_map);
+
+  memcpy(m_header->magic, "FSMTRC1", 8);
+  m_header->header_size = FSM_TRACE_HEADER_SIZE;
+  m_header->record_size = sizeof(fsm_trace_record_t);
+  m_header->count = 0;
+  m_header->sequence = m_sequence;
+  m_header->names_len = m_names_len;
+  m_header->num_states = m_num_states;
+  m_header->num_signals = m_num_signals;
+  memcpy(m_header->names, m_names, m_names_len);
+  return true;
+}
+
+/**@brief Unmap and cut the file to the records written.
+ */
+static void file_close(void)
+{
+  size_t used;
+
+  if(m_fd < 0)
+  {
+    return;
+  }
+  used = FSM_TRACE_HEADER_SIZE + ((size_t)m_header->count * sizeof(fsm_trace_record_t));
+  munmap(m_header, m_size);
+  m_header = NULL;
+  m_records = NULL;
+  (void)ftruncate(m_fd, (off_t)used);
+  close(m_fd);
+  m_fd = -1;
+}
+
+static bool file_grow(void)
+{
+  size_t size = m_size * 2;
+  void *p_map;
+
+  if(size > FSM_TRACE_MAX_BYTES)
+  {
+    size = FSM_TRACE_MAX_BYTES;
+  }
+  if(ftruncate(m_fd, (off_t)size) != 0)
+  {
+    return false;
+  }
+  p_map = mremap(m_header, m_size, size, MREMAP_MAYMOVE);
+  if(p_map == MAP_FAILED)
+  {
+    return false;
+  }
+  m_size = size;
+  mapping_set(p_map);
+  m_stats.grows++;
+  return true;
+}
+
+static bool file_rotate(void)
+{
+  char from[FSM_TRACE_PATH_LEN + 4];
+  char to[FSM_TRACE_PATH_LEN + 4];
+
+  file_close();
+  for(unsigned k = FSM_TRACE_KEEP; k > 1; k--)
+  {
+    snprintf(from, sizeof(from), "%s.%u", m_path, k - 1);
+    snprintf(to, sizeof(to), "%s.%u", m_path, k);
+    (void)rename(from, to);
+  }
+  snprintf(to, sizeof(to), "%s.1", m_path);
+  (void)rename(m_path, to);
+  m_sequence++;
+  m_stats.rotations++;
+  return file_open();
+}
+
+/**@brief Open the trace if FSM_TRACE names a file, the names go into every file header.
+ */
+void fsm_trace_init(char const * const *state_names, uint8_t num_states,
+                    char const * const *signal_names, uint8_t num_signals)
+{
+  char const *path = getenv("FSM_TRACE");
+  size_t len = 0;
+
+  if((path == NULL) || (path[0] == '\0') || (strlen(path) >= sizeof(m_path)))
+  {
+    return;
+  }
+  for(uint16_t i = 0; i < (uint16_t)num_states + num_signals; i++)
+  {
+    char const *name = (i < num_states) ? state_names[i] : signal_names[i - num_states];
+    size_t n = strlen(name) + 1;
+
+    if(len + n > sizeof(m_names))
+    {
+      fprintf(stderr, "fsm_trace: names do not fit the header\n");
+      return;
+    }
+    memcpy(&m_names[len], name, n);
+    len += n;
+  }
+  m_names_len = (uint16_t)len;
+  m_num_states = num_states;
+  m_num_signals = num_signals;
+  strcpy(m_path, path);
+
+  if(!file_open())
+  {
+    perror("fsm_trace");
+    return;
+  }
+  atexit(file_close);
+}
+
+/**@brief Called by the dispatcher before the handler runs.
+ */
+void fsm_trace_begin(void)
+{
+  clock_gettime(CLOCK_MONOTONIC, &m_begin);   // vDSO, no system call
+}
+
+/**@brief Called by the dispatcher once exit and entry actions are done.
+ */
+void fsm_trace_end(uint8_t source, uint8_t target, uint8_t sig, uint8_t status)
+{
+  struct timespec end;
+  fsm_trace_record_t *p_rec;
+  uint64_t count;
+  int64_t dur;
+
+  if(m_fd < 0)
+  {
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  dur = ((int64_t)(end.tv_sec - m_begin.tv_sec) * 1000000000) + (end.tv_nsec - m_begin.tv_nsec);
+
+  count = m_header->count;
+  if(count == m_capacity)
+  {
+    bool ok = (m_size < FSM_TRACE_MAX_BYTES) ? file_grow() : file_rotate();
+
+    if(!ok)
+    {
+      m_stats.dropped++;
+      return;
+    }
+    count = m_header->count;
+  }
+  p_rec = &m_records[count];
+  p_rec->time_us = hal_posix_time_us();
+  p_rec->dur_ns = (dur > (int64_t)UINT32_MAX) ? UINT32_MAX : (uint32_t)dur;
+  p_rec->status = status;
+  p_rec->source = source;
+  p_rec->target = target;
+  p_rec->sig = sig;
+  m_header->count = count + 1;
+  m_stats.records++;
+}
+
+fsm_trace_stats_t const * fsm_trace_stats_get(void)
+{
+  return &m_stats;
+}
+
+#endif /* HAL_POSIX */
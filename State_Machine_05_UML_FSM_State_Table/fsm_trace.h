@@ -0,0 +1,83 @@
+#ifndef FSM_TRACE_H
+#define FSM_TRACE_H
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Dispatch trace of host runs: one fixed size record per dispatch, appended
+ * to a memory mapped file, no system call on the way. fsm_trace2json turns
+ * the files into Chrome/Perfetto trace events.
+ * Enabled by FSM_TRACE=path in the environment of a -DHAL_POSIX build, the
+ * target build compiles the calls to nothing. */
+
+#define FSM_TRACE_HEADER_SIZE   4096
+
+/* first file size, doubled when full */
+#ifndef FSM_TRACE_CHUNK_BYTES
+#define FSM_TRACE_CHUNK_BYTES   (1UL << 20)
+#endif
+
+/* a full file at this size is rotated */
+#ifndef FSM_TRACE_MAX_BYTES
+#define FSM_TRACE_MAX_BYTES     (64UL << 20)
+#endif
+
+/* rotated files kept: path.1 (newest) .. path.FSM_TRACE_KEEP */
+#ifndef FSM_TRACE_KEEP
+#define FSM_TRACE_KEEP          3
+#endif
+
+typedef struct
+{
+  uint64_t time_us;     /* virtual time of the dispatch */
+  uint32_t dur_ns;      /* host time spent in handler, exit and entry actions */
+  uint8_t status;       /* event_status_t */
+  uint8_t source;
+  uint8_t target;       /* equal to source unless a transition was taken */
+  uint8_t sig;
+}fsm_trace_record_t;
+
+/* First FSM_TRACE_HEADER_SIZE bytes of a file, records follow */
+typedef struct
+{
+  char magic[8];        /* "FSMTRC1" */
+  uint32_t header_size;
+  uint32_t record_size;
+  uint64_t count;       /* records in the file, updated by every append */
+  uint32_t sequence;    /* files opened before this one in the run */
+  uint16_t names_len;
+  uint8_t num_states;
+  uint8_t num_signals;
+  char names[];         /* state names then signal names, each NUL terminated */
+}fsm_trace_header_t;
+
+typedef struct
+{
+  uint64_t records;
+  uint32_t grows;
+  uint32_t rotations;
+  uint32_t dropped;     /* file could not be grown or rotated */
+}fsm_trace_stats_t;
+
+
+#if defined(HAL_POSIX)
+void fsm_trace_init(char const * const *state_names, uint8_t num_states,
+                    char const * const *signal_names, uint8_t num_signals);
+void fsm_trace_begin(void);
+void fsm_trace_end(uint8_t source, uint8_t target, uint8_t sig, uint8_t status);
+fsm_trace_stats_t const * fsm_trace_stats_get(void);
+#else
+static inline void fsm_trace_init(char const * const *state_names, uint8_t num_states,
+                                  char const * const *signal_names, uint8_t num_signals)
+{
+  (void)state_names; (void)num_states; (void)signal_names; (void)num_signals;
+}
+static inline void fsm_trace_begin(void) {}
+static inline void fsm_trace_end(uint8_t source, uint8_t target, uint8_t sig, uint8_t status)
+{
+  (void)source; (void)target; (void)sig; (void)status;
+}
+#endif
+
+
+#endif
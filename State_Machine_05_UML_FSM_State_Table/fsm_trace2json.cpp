@@ -0,0 +1,165 @@
+/* Converts fsm_trace.h files to Chrome trace-event JSON (chrome://tracing,
+ * ui.perfetto.dev).
+ *
+ *   g++ -std=c++17 -O2 fsm_trace2json.cpp -o fsm_trace2json
+ *   ./fsm_trace2json trace.3 trace.2 trace.1 trace > trace.json
+ *
+ * Files are read in the order given, oldest first. The timeline is the
+ * virtual time of the run:
+ *   - "state" track: one slice per state residency
+ *   - "dispatch" track: one slice per dispatch, named after the signal,
+ *     lasting the host time the handler took (it takes no virtual time)
+ *   - instant events for transitions
+ */
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "fsm_trace.h"
+
+namespace
+{
+
+constexpr uint8_t status_transition = 2;   /* EVENT_TRANSITION of event_status_t */
+
+struct trace_file
+{
+  uint32_t sequence;
+  std::vector<std::string> states;
+  std::vector<std::string> signals;
+  std::vector<fsm_trace_record_t> records;
+};
+
+bool load(char const *path, trace_file &out)
+{
+  std::FILE *fp = std::fopen(path, "rb");
+  std::vector<char> head(FSM_TRACE_HEADER_SIZE);
+  fsm_trace_header_t const *p_header = reinterpret_cast<fsm_trace_header_t const *>(head.data());
+
+  if(fp == nullptr)
+  {
+    std::perror(path);
+    return false;
+  }
+  if((std::fread(head.data(), 1, head.size(), fp) != head.size()) ||
+     (std::memcmp(p_header->magic, "FSMTRC1", 8) != 0) ||
+     (p_header->header_size != FSM_TRACE_HEADER_SIZE) ||
+     (p_header->record_size != sizeof(fsm_trace_record_t)))
+  {
+    std::fprintf(stderr, "%s: not an fsm_trace file\n", path);
+    std::fclose(fp);
+    return false;
+  }
+
+  char const *name = p_header->names;
+  out.sequence = p_header->sequence;
+  out.states.clear();
+  out.signals.clear();
+  for(unsigned i = 0; i < unsigned(p_header->num_states) + p_header->num_signals; i++)
+  {
+    (i < p_header->num_states ? out.states : out.signals).emplace_back(name);
+    name += std::strlen(name) + 1;
+  }
+
+  out.records.resize(p_header->count);
+  // a file of a killed run may hold fewer records than the count says
+  out.records.resize(std::fread(out.records.data(), sizeof(fsm_trace_record_t), out.records.size(), fp));
+  std::fclose(fp);
+  return true;
+}
+
+std::string const &name_of(std::vector<std::string> const &names, uint8_t id)
+{
+  static std::string const unknown = "?";
+  return (id < names.size()) ? names[id] : unknown;
+}
+
+bool m_first = true;
+
+void emit(char const *json)
+{
+  std::printf("%s\n  %s", m_first ? "" : ",", json);
+  m_first = false;
+}
+
+/* Complete event: a slice from ts lasting dur, times in us */
+void slice(std::string const &name, int tid, double ts, double dur, char const *args)
+{
+  char buf[512];
+
+  std::snprintf(buf, sizeof(buf),
+                "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f%s%s}",
+                name.c_str(), tid, ts, dur, (args != nullptr) ? ",\"args\":" : "", (args != nullptr) ? args : "");
+  emit(buf);
+}
+
+/* Instant event on one track */
+void instant(std::string const &name, int tid, double ts)
+{
+  char buf[256];
+
+  std::snprintf(buf, sizeof(buf), "{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+                name.c_str(), tid, ts);
+  emit(buf);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  trace_file file;
+  bool have_state = false;
+  uint8_t state = 0;
+  double state_since = 0.0;
+  double last = 0.0;
+
+  if(argc < 2)
+  {
+    std::fprintf(stderr, "usage: %s trace [trace ...] > trace.json\n", argv[0]);
+    return 1;
+  }
+
+  std::printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  emit("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"fsm\"}}");
+  emit("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"state\"}}");
+  emit("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"dispatch\"}}");
+
+  for(int i = 1; i < argc; i++)
+  {
+    if(!load(argv[i], file))
+    {
+      return 1;
+    }
+    for(fsm_trace_record_t const &r : file.records)
+    {
+      double ts = static_cast<double>(r.time_us);
+      char args[160];
+
+      if(!have_state)
+      {
+        have_state = true;
+        state = r.source;
+        state_since = (file.sequence == 0) ? 0.0 : ts;   // the run started in this state
+      }
+      std::snprintf(args, sizeof(args), "{\"source\":\"%s\",\"target\":\"%s\",\"status\":%u,\"host_ns\":%u}",
+                    name_of(file.states, r.source).c_str(), name_of(file.states, r.target).c_str(),
+                    r.status, r.dur_ns);
+      slice(name_of(file.signals, r.sig), 2, ts, r.dur_ns / 1000.0, args);
+
+      if(r.status == status_transition)
+      {
+        slice(name_of(file.states, state), 1, state_since, ts - state_since, nullptr);
+        instant(name_of(file.states, r.source) + " -> " + name_of(file.states, r.target), 1, ts);
+        state = r.target;
+        state_since = ts;
+      }
+      last = ts + (r.dur_ns / 1000.0);
+    }
+  }
+  if(have_state)
+  {
+    slice(name_of(file.states, state), 1, state_since, last - state_since, nullptr);
+  }
+  std::printf("\n]}\n");
+  return 0;
+}
@@ -0,0 +1,105 @@
+
+#include "fsm_transition.h"
+#include "fsm_log.h"
+
+
+static inline fsm_cell_t const * cell_of(fsm_transition_table_t const *table, uint8_t state, fsm_signal_t sig)
+{
+  return &table->cells[(state * MAX_SIGNALS) + sig];
+}
+
+/**@brief Check a table once before it is used.
+ *
+ * @details Rejects targets that are out of range, records after an
+ *          unguarded one (never reached), too many records in a cell,
+ *          records in ENTRY/EXIT cells and missing entry or exit actions.
+ *
+ * @return true if the table is valid, every problem is logged.
+ */
+bool fsm_transition_validate(fsm_transition_table_t const *table)
+{
+  bool valid = true;
+
+  for(uint8_t state = 0; state < table->num_states; state++)
+  {
+    if((table->entry[state] == NULL) || (table->exit[state] == NULL))
+    {
+      FSM_LOG1(TRANSITION_NO_ENTRY_EXIT, state);
+      valid = false;
+    }
+    for(uint8_t sig = 0; sig < MAX_SIGNALS; sig++)
+    {
+      fsm_cell_t const *cell = cell_of(table, state, (fsm_signal_t)sig);
+
+      if((cell->count > 0) && ((sig == ENTRY) || (sig == EXIT)))
+      {
+        FSM_LOG1(TRANSITION_ENTRY_EXIT_RECORDS, state);
+        valid = false;
+      }
+      if(cell->count > FSM_TRANSITION_MAX_RECORDS)
+      {
+        FSM_LOG3(TRANSITION_TOO_MANY, state, sig, cell->count);
+        valid = false;
+      }
+      for(uint8_t i = 0; i < cell->count; i++)
+      {
+        fsm_transition_t const *t = &cell->records[i];
+
+        if((t->target >= table->num_states) && (t->target != FSM_TARGET_INTERNAL) && (t->target != FSM_TARGET_IGNORED))
+        {
+          FSM_LOG3(TRANSITION_BAD_TARGET, state, sig, t->target);
+          valid = false;
+        }
+        if((t->guard == NULL) && (i + 1 < cell->count))
+        {
+          FSM_LOG3(TRANSITION_UNREACHABLE, state, sig, i + 1);
+          valid = false;
+        }
+      }
+    }
+  }
+  return valid;
+}
+
+/**@brief Take the first record of the cell whose guard holds.
+ *
+ * @details For a transition the order is the one of fsm_event_dispatcher:
+ *          action, exit of the source, entry of the target. active_state is
+ *          set from the record, before the entry action runs.
+ */
+event_status_t fsm_transition_dispatch(app_t *const myApp, fsm_transition_table_t const *table, event_t const *const e)
+{
+  fsm_cell_t const *cell = cell_of(table, myApp->active_state, e->sig);
+  fsm_transition_t const *t = cell->records;
+  fsm_transition_t const *end = t + cell->count;
+  uint8_t source = myApp->active_state;
+  event_t ee;
+
+  while((t != end) && (t->guard != NULL) && !(*t->guard)(myApp, e))
+  {
+    t++;
+  }
+  if(t == end)
+  {
+    return EVENT_IGNORED;
+  }
+  if(t->action != NULL)
+  {
+    (void)(*t->action)(myApp, e);
+  }
+  if(t->target == FSM_TARGET_INTERNAL)
+  {
+    return EVENT_HANDLED;
+  }
+  if(t->target == FSM_TARGET_IGNORED)
+  {
+    return EVENT_IGNORED;
+  }
+
+  ee.sig = EXIT;
+  (void)(*table->exit[source])(myApp, &ee);
+  myApp->active_state = t->target;
+  ee.sig = ENTRY;
+  (void)(*table->entry[t->target])(myApp, &ee);
+  return EVENT_TRANSITION;
+}
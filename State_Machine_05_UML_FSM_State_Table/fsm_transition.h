@@ -0,0 +1,53 @@
+#ifndef FSM_TRANSITION_H
+#define FSM_TRANSITION_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "main.h"
+
+
+/* Declarative transitions: a cell of the table is an ordered list of
+ * {guard, action, target} records. The first record whose guard holds is
+ * taken, so targets are data the dispatcher and the validator can see. */
+
+/* Targets that are not states */
+#define FSM_TARGET_INTERNAL   0xFE    /* handled, no exit or entry */
+#define FSM_TARGET_IGNORED    0xFF    /* action runs, the event counts as ignored */
+
+#define FSM_TRANSITION_MAX_RECORDS 4  /* per cell */
+
+typedef bool (*fsm_guard_t)(app_t const *const myApp, event_t const *const e);
+
+typedef struct
+{
+  fsm_guard_t guard;      /* NULL: always holds */
+  e_handler_t action;     /* NULL: none, its return value is not used */
+  uint8_t target;         /* a state, FSM_TARGET_INTERNAL or FSM_TARGET_IGNORED */
+}fsm_transition_t;
+
+typedef struct
+{
+  fsm_transition_t const *records;
+  uint8_t count;          /* 0: the state does not handle the signal */
+}fsm_cell_t;
+
+typedef struct
+{
+  fsm_cell_t const *cells;      /* [num_states][MAX_SIGNALS], ENTRY and EXIT cells unused */
+  e_handler_t const *entry;     /* [num_states] */
+  e_handler_t const *exit;      /* [num_states] */
+  uint8_t num_states;
+}fsm_transition_table_t;
+
+#define FSM_CELL(...)  {(fsm_transition_t const []){__VA_ARGS__}, \
+                        sizeof((fsm_transition_t const []){__VA_ARGS__}) / sizeof(fsm_transition_t)}
+
+
+bool fsm_transition_validate(fsm_transition_table_t const *table);
+event_status_t fsm_transition_dispatch(app_t *const myApp, fsm_transition_table_t const *table, event_t const *const e);
+
+#if FSM_TRANSITION_RECORDS
+extern fsm_transition_table_t const fsm_transition_table;
+#endif
+
+
+#endif
@@ -0,0 +1,357 @@
+/* Host benchmark of fsm_transition.c records against handler-per-cell tables.
+ *
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DFSM_TRANSITION_BENCH -I. -I../State_Machine_Common \
+ *       fsm_transition_bench.c fsm_transition.c fsm_log.c ../State_Machine_Common/hal_posix.c -o fsm_transition_bench
+ *   ./fsm_transition_bench [events]
+ *
+ * The machine has the states, signals and guards of state_machine.c with
+ * output-free handlers, so the numbers are the dispatch cost per event:
+ *   - cells:   a handler per cell tests its guard and sets active_state, the
+ *              dispatcher looks up and calls exit and entry on a transition
+ *              (-DFSM_FUSED_TRANSITIONS=0)
+ *   - fused:   the same handlers wrapped in FSM_FUSED_TRANSITION routines
+ *   - records: {guard, action, target} records through fsm_transition_dispatch
+ * Two signal streams: random signals, where most events are ignored, and a
+ * cycle where five events in six transition, the only ones fusing speeds up.
+ * With -DFSM_TRANSITION_BENCH_CPP it also runs the two back-ends of the
+ * app_fsm.hpp machine, see app_fsm_bench.cpp for the build.
+ */
+#if defined(FSM_TRANSITION_BENCH)
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "main.h"
+#include "fsm_transition.h"
+
+#define BENCH_EVENTS_DEFAULT  20000000UL
+#define BENCH_RING            4096      /* pre-drawn signals, power of two */
+
+static volatile uint32_t m_sink;
+static event_t m_ring[BENCH_RING];
+static event_t m_transition_ring[BENCH_RING];
+
+/* IDLE -> LED_SET, internal, -> BLINK -> PAUSE -> BLINK -> IDLE */
+static fsm_signal_t const m_transition_cycle[] = {INC_LED, INC_LED, START_PAUSE, START_PAUSE, START_PAUSE, ABRT};
+
+#if defined(FSM_TRANSITION_BENCH_CPP)
+static uint8_t m_cpp_ring[BENCH_RING];     /* the same signals as app::signal */
+
+uint32_t app_fsm_bench_table(uint8_t const *p_signals, uint32_t mask, unsigned long events);
+uint32_t app_fsm_bench_static(uint8_t const *p_signals, uint32_t mask, unsigned long events);
+#endif
+
+
+/* Handler per cell: guard in the body, target by side effect */
+#define CELL_GO(name, target)                                                     \
+static event_status_t name(app_t *const myApp, event_t const *const e)            \
+{                                                                                 \
+  m_sink++;                                                                       \
+  myApp->active_state = target;                                                   \
+  return EVENT_TRANSITION;                                                        \
+}
+
+#define CELL_GUARD_GO(name, cond, target)                                         \
+static event_status_t name(app_t *const myApp, event_t const *const e)            \
+{                                                                                 \
+  m_sink++;                                                                       \
+  if(cond)                                                                        \
+  {                                                                               \
+    myApp->active_state = target;                                                 \
+    return EVENT_TRANSITION;                                                      \
+  }                                                                               \
+  return EVENT_IGNORED;                                                           \
+}
+
+#define CELL_IGNORE(name)                                                         \
+static event_status_t name(app_t *const myApp, event_t const *const e)            \
+{                                                                                 \
+  m_sink++;                                                                       \
+  return EVENT_IGNORED;                                                           \
+}
+
+#define CELL_ACTION(name)                                                         \
+static event_status_t name(app_t *const myApp, event_t const *const e)            \
+{                                                                                 \
+  m_sink++;                                                                       \
+  return EVENT_HANDLED;                                                           \
+}
+
+CELL_ACTION(S_ENTRY)
+CELL_ACTION(S_EXIT)
+
+CELL_GO(IDLE_INC, LED_SET)
+CELL_GO(IDLE_DEC, LED_SET)
+CELL_GUARD_GO(IDLE_START, myApp->curr_leds > 0, BLINK)
+CELL_IGNORE(IDLE_ABRT_)
+
+static event_status_t SET_INC(app_t *const myApp, event_t const *const e)
+{
+  m_sink++;
+  if(myApp->curr_leds < LED_COUNT)
+  {
+    myApp->curr_leds += 1;
+    return EVENT_HANDLED;
+  }
+  return EVENT_IGNORED;
+}
+
+static event_status_t SET_DEC(app_t *const myApp, event_t const *const e)
+{
+  m_sink++;
+  if(myApp->curr_leds > 0)
+  {
+    myApp->curr_leds -= 1;
+    return EVENT_HANDLED;
+  }
+  return EVENT_IGNORED;
+}
+
+CELL_GO(SET_START, BLINK)
+CELL_GO(SET_ABRT, IDLE)
+CELL_IGNORE(RUN_INC)
+CELL_IGNORE(RUN_DEC)
+CELL_GO(BLINK_START, PAUSE)
+CELL_GO(PAUSE_START, BLINK)
+
+static event_status_t RUN_ABRT(app_t *const myApp, event_t const *const e)
+{
+  m_sink++;
+  if(myApp->curr_leds > 0)
+  {
+    m_sink++;   // stop_timers
+  }
+  myApp->active_state = IDLE;
+  return EVENT_TRANSITION;
+}
+
+static e_handler_t const cell_table[MAX_STATE][MAX_SIGNALS] = {
+  [IDLE] = {&S_ENTRY, &S_EXIT, &IDLE_INC, &IDLE_DEC, &IDLE_START, &IDLE_ABRT_},
+  [LED_SET] = {&S_ENTRY, &S_EXIT, &SET_INC, &SET_DEC, &SET_START, &SET_ABRT},
+  [BLINK] = {&S_ENTRY, &S_EXIT, &RUN_INC, &RUN_DEC, &BLINK_START, &RUN_ABRT},
+  [PAUSE] = {&S_ENTRY, &S_EXIT, &RUN_INC, &RUN_DEC, &PAUSE_START, &RUN_ABRT}
+};
+
+#define BENCH_FUSED(name)                                                         \
+static event_status_t name##_FUSED(app_t *const myApp, event_t const *const e)    \
+{                                                                                 \
+  event_t ee;                                                                     \
+  event_status_t status = name(myApp, e);                                         \
+  if(status == EVENT_TRANSITION)                                                  \
+  {                                                                               \
+    ee.sig = EXIT;                                                                \
+    S_EXIT(myApp, &ee);                                                           \
+    ee.sig = ENTRY;                                                               \
+    S_ENTRY(myApp, &ee);                                                          \
+  }                                                                               \
+  return status;                                                                  \
+}
+
+BENCH_FUSED(IDLE_INC)
+BENCH_FUSED(IDLE_DEC)
+BENCH_FUSED(IDLE_START)
+BENCH_FUSED(SET_START)
+BENCH_FUSED(SET_ABRT)
+BENCH_FUSED(BLINK_START)
+BENCH_FUSED(PAUSE_START)
+BENCH_FUSED(RUN_ABRT)
+
+static e_handler_t const fused_table[MAX_STATE][MAX_SIGNALS] = {
+  [IDLE] = {&S_ENTRY, &S_EXIT, &IDLE_INC_FUSED, &IDLE_DEC_FUSED, &IDLE_START_FUSED, &IDLE_ABRT_},
+  [LED_SET] = {&S_ENTRY, &S_EXIT, &SET_INC, &SET_DEC, &SET_START_FUSED, &SET_ABRT_FUSED},
+  [BLINK] = {&S_ENTRY, &S_EXIT, &RUN_INC, &RUN_DEC, &BLINK_START_FUSED, &RUN_ABRT_FUSED},
+  [PAUSE] = {&S_ENTRY, &S_EXIT, &RUN_INC, &RUN_DEC, &PAUSE_START_FUSED, &RUN_ABRT_FUSED}
+};
+
+
+/* Records: guards are data, actions only act */
+static bool has_leds(app_t const *const myApp, event_t const *const e)
+{
+  return myApp->curr_leds > 0;
+}
+
+static bool below_max(app_t const *const myApp, event_t const *const e)
+{
+  return myApp->curr_leds < LED_COUNT;
+}
+
+static event_status_t inc(app_t *const myApp, event_t const *const e)
+{
+  m_sink++;
+  myApp->curr_leds += 1;
+  return EVENT_HANDLED;
+}
+
+static event_status_t dec(app_t *const myApp, event_t const *const e)
+{
+  m_sink++;
+  myApp->curr_leds -= 1;
+  return EVENT_HANDLED;
+}
+
+static event_status_t stop(app_t *const myApp, event_t const *const e)
+{
+  m_sink += 2;
+  return EVENT_HANDLED;
+}
+
+static fsm_cell_t const record_cells[MAX_STATE][MAX_SIGNALS] = {
+  [IDLE] = {
+    [INC_LED] = FSM_CELL({NULL, &S_ENTRY, LED_SET}),
+    [DEC_LED] = FSM_CELL({NULL, &S_ENTRY, LED_SET}),
+    [START_PAUSE] = FSM_CELL({&has_leds, &S_ENTRY, BLINK}, {NULL, &S_ENTRY, FSM_TARGET_IGNORED}),
+    [ABRT] = FSM_CELL({NULL, &S_ENTRY, FSM_TARGET_IGNORED})
+  },
+  [LED_SET] = {
+    [INC_LED] = FSM_CELL({&below_max, &inc, FSM_TARGET_INTERNAL}, {NULL, &S_ENTRY, FSM_TARGET_IGNORED}),
+    [DEC_LED] = FSM_CELL({&has_leds, &dec, FSM_TARGET_INTERNAL}, {NULL, &S_ENTRY, FSM_TARGET_IGNORED}),
+    [START_PAUSE] = FSM_CELL({NULL, &S_ENTRY, BLINK}),
+    [ABRT] = FSM_CELL({NULL, &S_ENTRY, IDLE})
+  },
+  [BLINK] = {
+    [INC_LED] = FSM_CELL({NULL, &S_ENTRY, FSM_TARGET_IGNORED}),
+    [DEC_LED] = FSM_CELL({NULL, &S_ENTRY, FSM_TARGET_IGNORED}),
+    [START_PAUSE] = FSM_CELL({NULL, &S_ENTRY, PAUSE}),
+    [ABRT] = FSM_CELL({&has_leds, &stop, IDLE}, {NULL, &S_ENTRY, IDLE})
+  },
+  [PAUSE] = {
+    [INC_LED] = FSM_CELL({NULL, &S_ENTRY, FSM_TARGET_IGNORED}),
+    [DEC_LED] = FSM_CELL({NULL, &S_ENTRY, FSM_TARGET_IGNORED}),
+    [START_PAUSE] = FSM_CELL({NULL, &S_ENTRY, BLINK}),
+    [ABRT] = FSM_CELL({&has_leds, &stop, IDLE}, {NULL, &S_ENTRY, IDLE})
+  }
+};
+
+static e_handler_t const record_entry[MAX_STATE] = {&S_ENTRY, &S_ENTRY, &S_ENTRY, &S_ENTRY};
+static e_handler_t const record_exit[MAX_STATE] = {&S_EXIT, &S_EXIT, &S_EXIT, &S_EXIT};
+
+static fsm_transition_table_t const record_table = {
+  .cells = &record_cells[0][0],
+  .entry = record_entry,
+  .exit = record_exit,
+  .num_states = MAX_STATE
+};
+
+
+/**@brief fsm_event_dispatcher without FSM_FUSED_TRANSITIONS.
+ */
+static void cell_dispatch(app_t *const myApp, e_handler_t const *table, event_t const *const e)
+{
+  app_state_t source = myApp->active_state;
+  event_status_t status = (*table[(source * MAX_SIGNALS) + e->sig])(myApp, e);
+
+  if(status == EVENT_TRANSITION)
+  {
+    event_t ee;
+
+    ee.sig = EXIT;
+    (*table[(source * MAX_SIGNALS) + EXIT])(myApp, &ee);
+    ee.sig = ENTRY;
+    (*table[(myApp->active_state * MAX_SIGNALS) + ENTRY])(myApp, &ee);
+  }
+}
+
+static double now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+typedef enum
+{
+  RUN_CELLS,
+  RUN_FUSED,
+  RUN_RECORDS
+}run_t;
+
+static double run(run_t mode, event_t const *p_ring, unsigned long events, uint32_t *p_final)
+{
+  app_t app = {0};
+  double start = now_ns();
+
+  app.active_state = IDLE;
+  for(unsigned long n = 0; n < events; n++)
+  {
+    event_t const *e = &p_ring[n & (BENCH_RING - 1)];
+
+    switch(mode)
+    {
+      case RUN_CELLS:
+        cell_dispatch(&app, &cell_table[0][0], e);
+        break;
+      case RUN_FUSED:
+        (void)(*fused_table[app.active_state][e->sig])(&app, e);
+        break;
+      default:
+        (void)fsm_transition_dispatch(&app, &record_table, e);
+        break;
+    }
+  }
+  // same walk through the machine in every mode
+  *p_final = ((uint32_t)app.active_state << 8) | app.curr_leds;
+  return (now_ns() - start) / events;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long events = (argc > 1) ? strtoul(argv[1], NULL, 0) : BENCH_EVENTS_DEFAULT;
+  uint32_t x = 1;
+  uint32_t final[3];
+  uint32_t transition_final[3];
+  double ns[3];
+  double transition_ns[3];
+
+  if(!fsm_transition_validate(&record_table))
+  {
+    return 1;
+  }
+  for(unsigned i = 0; i < BENCH_RING; i++)
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    m_ring[i].sig = (fsm_signal_t)(INC_LED + ((x >> 16) % (MAX_SIGNALS - INC_LED)));
+    m_transition_ring[i].sig = m_transition_cycle[i % (sizeof(m_transition_cycle) / sizeof(m_transition_cycle[0]))];
+#if defined(FSM_TRANSITION_BENCH_CPP)
+    m_cpp_ring[i] = (uint8_t)(m_ring[i].sig - INC_LED);
+#endif
+  }
+
+  for(run_t mode = RUN_CELLS; mode <= RUN_RECORDS; mode++)
+  {
+    ns[mode] = run(mode, m_ring, events, &final[mode]);
+    transition_ns[mode] = run(mode, m_transition_ring, events, &transition_final[mode]);
+  }
+  printf("%lu events, ns/event      random  transitions\n", events);
+  printf("cells (unfused)         %8.2f %12.2f\n", ns[RUN_CELLS], transition_ns[RUN_CELLS]);
+  printf("fused                   %8.2f %12.2f\n", ns[RUN_FUSED], transition_ns[RUN_FUSED]);
+  printf("records                 %8.2f %12.2f\n", ns[RUN_RECORDS], transition_ns[RUN_RECORDS]);
+  if((final[RUN_FUSED] != final[RUN_CELLS]) || (final[RUN_RECORDS] != final[RUN_CELLS]) ||
+     (transition_final[RUN_FUSED] != transition_final[RUN_CELLS]) ||
+     (transition_final[RUN_RECORDS] != transition_final[RUN_CELLS]))
+  {
+    printf("machines diverged\n");
+    return 1;
+  }
+#if defined(FSM_TRANSITION_BENCH_CPP)
+  {
+    double start = now_ns();
+    uint32_t table_final = app_fsm_bench_table(m_cpp_ring, BENCH_RING - 1, events);
+    double table_ns = (now_ns() - start) / events;
+    uint32_t static_final;
+
+    start = now_ns();
+    static_final = app_fsm_bench_static(m_cpp_ring, BENCH_RING - 1, events);
+    printf("app_fsm.hpp table %.2f  static %.2f\n", table_ns, (now_ns() - start) / events);
+    if((table_final != final[RUN_CELLS]) || (static_final != final[RUN_CELLS]))
+    {
+      printf("app_fsm.hpp diverged from the C machines\n");
+      return 1;
+    }
+  }
+#endif
+  return 0;
+}
+
+#endif /* FSM_TRANSITION_BENCH */
@@ -0,0 +1,150 @@
+
+#include "led_bank.h"
+#include <string.h>
+
+
+/* m_count_mask[n] holds the first n LEDs of the bank, built once at init */
+static led_bank_mask_t m_count_mask[LED_BANK_MAX_LEDS + 1];
+static led_bank_mask_t m_shadow;
+static uint8_t m_count;
+static bool m_active_low;
+static uint32_t m_writes;
+
+
+static void port_write(uint8_t port, uint32_t on, uint32_t off)
+{
+  if(m_active_low)
+  {
+    uint32_t tmp = on;
+    on = off;
+    off = tmp;
+  }
+  if(on)
+  {
+    hal_gpio_port_set(port, on);
+    m_writes++;
+  }
+  if(off)
+  {
+    hal_gpio_port_clear(port, off);
+    m_writes++;
+  }
+}
+
+/**@brief Configure the bank pins as outputs, all LEDs off.
+ */
+void led_bank_init(uint8_t const *pins, uint8_t count, bool active_low)
+{
+  led_bank_mask_t all;
+
+  if(count > LED_BANK_MAX_LEDS)
+  {
+    count = LED_BANK_MAX_LEDS;
+  }
+  m_count = count;
+  m_active_low = active_low;
+  memset(m_count_mask, 0, sizeof(m_count_mask));
+
+  for(uint8_t i = 0; i < count; i++)
+  {
+    m_count_mask[i + 1] = m_count_mask[i];
+    m_count_mask[i + 1].port[pins[i] >> 5] |= (1UL << (pins[i] & 0x1F));
+    hal_gpio_cfg_output(pins[i]);
+  }
+
+  /* force every pin to the off level once, the shadow is exact from here on */
+  all = m_count_mask[count];
+  for(uint8_t p = 0; p < LED_BANK_PORTS; p++)
+  {
+    port_write(p, 0, all.port[p]);
+  }
+  memset(&m_shadow, 0, sizeof(m_shadow));
+}
+
+/**@brief Drive the bank to target, touching only the bits that differ.
+ *
+ * @details At most one OUTSET and one OUTCLR write per port, whatever the
+ *          number of LEDs that change.
+ */
+void led_bank_apply(led_bank_mask_t const *target)
+{
+  for(uint8_t p = 0; p < LED_BANK_PORTS; p++)
+  {
+    uint32_t diff = target->port[p] ^ m_shadow.port[p];
+    if(diff)
+    {
+      port_write(p, diff & target->port[p], diff & m_shadow.port[p]);
+      m_shadow.port[p] = target->port[p];
+    }
+  }
+}
+
+/**@brief Turn on the first n LEDs and turn off the rest.
+ */
+void led_bank_show_count(uint8_t n)
+{
+  if(n > m_count)
+  {
+    n = m_count;
+  }
+  led_bank_apply(&m_count_mask[n]);
+}
+
+/**@brief Toggle the first n LEDs.
+ */
+void led_bank_toggle_count(uint8_t n)
+{
+  led_bank_mask_t target;
+
+  if(n > m_count)
+  {
+    n = m_count;
+  }
+  for(uint8_t p = 0; p < LED_BANK_PORTS; p++)
+  {
+    target.port[p] = m_shadow.port[p] ^ m_count_mask[n].port[p];
+  }
+  led_bank_apply(&target);
+}
+
+void led_bank_count_mask(uint8_t n, led_bank_mask_t *mask)
+{
+  *mask = m_count_mask[(n > m_count) ? m_count : n];
+}
+
+/**@brief Mask of LED index alone.
+ */
+void led_bank_led_mask(uint8_t index, led_bank_mask_t *mask)
+{
+  for(uint8_t p = 0; p < LED_BANK_PORTS; p++)
+  {
+    mask->port[p] = (index < m_count) ? (m_count_mask[index + 1].port[p] ^ m_count_mask[index].port[p]) : 0;
+  }
+}
+
+/**@brief Toggle the LEDs in mask, one write per port and direction.
+ */
+void led_bank_toggle(led_bank_mask_t const *mask)
+{
+  led_bank_mask_t target;
+
+  for(uint8_t p = 0; p < LED_BANK_PORTS; p++)
+  {
+    target.port[p] = m_shadow.port[p] ^ mask->port[p];
+  }
+  led_bank_apply(&target);
+}
+
+/**@brief LEDs that are on.
+ */
+void led_bank_state_get(led_bank_mask_t *mask)
+{
+  *mask = m_shadow;
+}
+
+/**@brief Number of OUTSET/OUTCLR writes issued since init.
+ */
+uint32_t led_bank_writes_get(void)
+{
+  return m_writes;
+}
@@ -0,0 +1,29 @@
+#ifndef LED_BANK_H
+#define LED_BANK_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+
+#define LED_BANK_MAX_LEDS   64
+#define LED_BANK_PORTS      HAL_GPIO_PORTS
+
+/* Logical LED state, one bit per pin, set means on */
+typedef struct
+{
+  uint32_t port[LED_BANK_PORTS];
+}led_bank_mask_t;
+
+
+void led_bank_init(uint8_t const *pins, uint8_t count, bool active_low);
+void led_bank_apply(led_bank_mask_t const *target);
+void led_bank_show_count(uint8_t n);
+void led_bank_toggle_count(uint8_t n);
+void led_bank_count_mask(uint8_t n, led_bank_mask_t *mask);
+void led_bank_led_mask(uint8_t index, led_bank_mask_t *mask);
+void led_bank_toggle(led_bank_mask_t const *mask);
+void led_bank_state_get(led_bank_mask_t *mask);
+uint32_t led_bank_writes_get(void);
+
+
+#endif
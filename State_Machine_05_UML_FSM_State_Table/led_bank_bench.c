@@ -0,0 +1,214 @@
+/* Host test of led_bank.c: register writes and pin levels.
+ *
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DLED_BANK_BENCH -I. -I../State_Machine_Common \
+ *       led_bank_bench.c led_bank.c ../State_Machine_Common/hal_posix.c -o led_bank_bench
+ *   ./led_bank_bench [updates]
+ *
+ * Random updates, as the state handlers issue them: show the first n LEDs,
+ * toggle the first n (blink), toggle one LED (a region of app_regions.c).
+ * A model of the LEDs gives the pins each update has to change; after every
+ * update all pins must be at their level, and the bank must have issued
+ * exactly one OUTSET write per port with an LED to turn on and one OUTCLR
+ * write per port with an LED to turn off. The same updates are written pin
+ * by pin, one write per LED touched, as the handlers did before the bank,
+ * for comparison. Host ns per update are for the host HAL only.
+ */
+#if defined(LED_BANK_BENCH)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "led_bank.h"
+
+#define BENCH_UPDATES_DEFAULT 200000
+
+static uint8_t const m_board_pins[] = {13, 14, 15, 16};
+static uint8_t const m_spread_pins[] = {2, 3, 4, 5, 13, 14, 15, 16, 28, 29, 32 + 1, 32 + 2, 32 + 3, 32 + 4,
+                                        32 + 10, 32 + 12};
+
+static uint32_t m_rand = 0x9E3779B9;
+
+
+static uint32_t bench_rand(uint32_t range)
+{
+  m_rand ^= m_rand << 13;
+  m_rand ^= m_rand >> 17;
+  m_rand ^= m_rand << 5;
+  return m_rand % range;
+}
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/**@brief One update on the model: the LEDs on after it.
+ *
+ * @param[out] p_touched LEDs a per pin loop writes for it.
+ */
+static uint64_t update_next(uint64_t on, uint8_t count, uint8_t *p_op, uint8_t *p_n, uint8_t *p_touched)
+{
+  uint64_t first;
+
+  *p_op = (uint8_t)bench_rand(3);
+  *p_n = (uint8_t)bench_rand(count + 1);
+  first = (*p_n < 64) ? ((1ULL << *p_n) - 1) : UINT64_MAX;
+  switch(*p_op)
+  {
+    case 0:
+      *p_touched = count;      // the handlers set the first n and cleared the rest
+      return first;
+    case 1:
+      *p_touched = *p_n;
+      return on ^ first;
+    default:
+      *p_n = (uint8_t)bench_rand(count);
+      *p_touched = 1;
+      return on ^ (1ULL << *p_n);
+  }
+}
+
+static void update_apply(uint8_t op, uint8_t n)
+{
+  led_bank_mask_t mask;
+
+  switch(op)
+  {
+    case 0:
+      led_bank_show_count(n);
+      break;
+    case 1:
+      led_bank_toggle_count(n);
+      break;
+    default:
+      led_bank_led_mask(n, &mask);
+      led_bank_toggle(&mask);
+      break;
+  }
+}
+
+/**@brief The writes the bank owes for going from on to next: one per port and direction.
+ */
+static uint32_t writes_expected(uint8_t const *pins, uint8_t count, uint64_t on, uint64_t next)
+{
+  bool set[LED_BANK_PORTS] = {false};
+  bool clear[LED_BANK_PORTS] = {false};
+  uint32_t writes = 0;
+
+  for(uint8_t i = 0; i < count; i++)
+  {
+    if(((on ^ next) >> i) & 1)
+    {
+      set[pins[i] >> 5] |= (next >> i) & 1;
+      clear[pins[i] >> 5] |= !((next >> i) & 1);
+    }
+  }
+  for(uint8_t p = 0; p < LED_BANK_PORTS; p++)
+  {
+    writes += set[p] + clear[p];
+  }
+  return writes;
+}
+
+static bool pins_check(uint8_t const *pins, uint8_t count, uint64_t on)
+{
+  for(uint8_t i = 0; i < count; i++)
+  {
+    // active low: an LED that is on has its pin low
+    if(hal_posix_output_get(pins[i]) == ((on >> i) & 1))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void per_pin_apply(uint8_t const *pins, uint8_t count, uint64_t next, uint8_t op, uint8_t n)
+{
+  uint8_t first = (op == 2) ? n : 0;
+  uint8_t last = (op == 0) ? count : ((op == 1) ? n : (n + 1));
+
+  for(uint8_t i = first; i < last; i++)
+  {
+    if((next >> i) & 1)
+    {
+      hal_gpio_clear(pins[i]);
+    }
+    else
+    {
+      hal_gpio_set(pins[i]);
+    }
+  }
+}
+
+static bool bank_bench(char const *name, uint8_t const *pins, uint8_t count, unsigned updates)
+{
+  uint64_t on = 0;
+  uint32_t wrong_pins = 0;
+  uint32_t wrong_writes = 0;
+  uint64_t pin_writes = 0;
+  uint32_t bank_writes;
+  uint64_t bank_ns = 0;
+  uint64_t pin_ns = 0;
+
+  m_rand = 0x9E3779B9;
+  led_bank_init(pins, count, true);
+  bank_writes = led_bank_writes_get();
+  for(unsigned u = 0; u < updates; u++)
+  {
+    uint8_t op;
+    uint8_t n;
+    uint8_t touched;
+    uint64_t next = update_next(on, count, &op, &n, &touched);
+    uint32_t writes = led_bank_writes_get();
+    uint64_t t0 = host_ns();
+
+    update_apply(op, n);
+    bank_ns += host_ns() - t0;
+    wrong_writes += (led_bank_writes_get() - writes) != writes_expected(pins, count, on, next);
+    wrong_pins += !pins_check(pins, count, next);
+    on = next;
+  }
+  bank_writes = led_bank_writes_get() - bank_writes;
+
+  m_rand = 0x9E3779B9;
+  on = 0;
+  for(unsigned u = 0; u < updates; u++)
+  {
+    uint8_t op;
+    uint8_t n;
+    uint8_t touched;
+    uint64_t next = update_next(on, count, &op, &n, &touched);
+    uint64_t t0 = host_ns();
+
+    per_pin_apply(pins, count, next, op, n);
+    pin_ns += host_ns() - t0;
+    pin_writes += touched;
+    on = next;
+  }
+
+  printf("  %-24s %10.2f %10.2f %10.1f %10.1f %8u %8u\n", name, (double)bank_writes / updates,
+         (double)pin_writes / updates, (double)bank_ns / updates, (double)pin_ns / updates, wrong_writes,
+         wrong_pins);
+  return (wrong_writes == 0) && (wrong_pins == 0);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned updates = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : BENCH_UPDATES_DEFAULT;
+  bool pass = true;
+
+  hal_init();
+  printf("%u updates: show n, toggle n, toggle one\n", updates);
+  printf("  %-24s %10s %10s %10s %10s %8s %8s\n", "", "writes", "per pin", "ns", "per pin", "wrong", "wrong");
+  printf("  %-24s %10s %10s %10s %10s %8s %8s\n", "LEDs", "/update", "writes", "/update", "ns", "writes", "pins");
+  pass = bank_bench("4, board (P0)", m_board_pins, sizeof(m_board_pins), updates) && pass;
+  pass = bank_bench("16, both ports", m_spread_pins, sizeof(m_spread_pins), updates) && pass;
+  printf("%s\n", pass ? "ok" : "FAIL");
+  return pass ? 0 : 1;
+}
+
+#endif /* LED_BANK_BENCH */
@@ -0,0 +1,318 @@
+
+#include "led_blink.h"
+#include <string.h>
+
+#if !defined(HAL_POSIX)
+#include "nrf.h"
+#include "app_timer.h"
+
+#define LED_BLINK_COUNTER_MASK  0x00FFFFFFUL    /* 24 bit RTC */
+#define LED_BLINK_MIN_TICKS     2               /* CC closer than this to COUNTER may not fire */
+#else
+#define LED_BLINK_COUNTER_MASK  0xFFFFFFFFUL
+#define LED_BLINK_MIN_TICKS     0
+#endif
+
+typedef struct
+{
+  uint32_t next_ms;         /* next deadline, ms from m_base */
+  uint16_t period_ms;
+  uint16_t phase_ms;
+}led_blink_led_t;
+
+static led_blink_led_t m_led[LED_BLINK_MAX_LEDS];
+static led_bank_mask_t m_mask[LED_BLINK_MAX_LEDS];
+static uint8_t m_heap[LED_BLINK_MAX_LEDS];            /**< Min-heap of LED indexes on next_ms. */
+static uint8_t m_heap_len;
+static uint8_t m_count;                               /**< LEDs started. */
+static uint32_t m_base;                               /**< Counter value deadlines count from. */
+static uint32_t m_suspended_at;                       /**< Counter value at led_blink_suspend. */
+static led_bank_mask_t m_suspended;                   /**< LEDs on when suspended. */
+static led_blink_stats_t m_stats;
+
+static void blink_run(void);
+
+
+#if !defined(HAL_POSIX)
+void RTC2_IRQHandler(void)
+{
+  if(NRF_RTC2->EVENTS_COMPARE[0])
+  {
+    NRF_RTC2->EVENTS_COMPARE[0] = 0;
+    (void)NRF_RTC2->EVENTS_COMPARE[0];
+    blink_run();
+  }
+}
+
+static void counter_init(void)
+{
+  NRF_RTC2->PRESCALER = APP_TIMER_CONFIG_RTC_FREQUENCY;   // same tick as hal_ticks()
+  NRF_RTC2->EVTENSET = RTC_EVTEN_COMPARE0_Msk;
+  NRF_RTC2->INTENSET = RTC_INTENSET_COMPARE0_Msk;
+  NVIC_SetPriority(RTC2_IRQn, LED_BLINK_IRQ_PRIORITY);
+  NVIC_ClearPendingIRQ(RTC2_IRQn);
+  NVIC_EnableIRQ(RTC2_IRQn);
+  NRF_RTC2->TASKS_START = 1;
+}
+
+static inline uint32_t counter_get(void)
+{
+  return NRF_RTC2->COUNTER;
+}
+
+static inline void compare_set(uint32_t ticks)
+{
+  NRF_RTC2->EVENTS_COMPARE[0] = 0;
+  NRF_RTC2->CC[0] = ticks & LED_BLINK_COUNTER_MASK;
+}
+
+static inline void compare_stop(void)
+{
+  NRF_RTC2->CC[0] = (NRF_RTC2->COUNTER - 1) & LED_BLINK_COUNTER_MASK;   // a full wrap away
+  NRF_RTC2->EVENTS_COMPARE[0] = 0;
+}
+#else
+static void counter_init(void)
+{
+}
+
+static inline uint32_t counter_get(void)
+{
+  return hal_ticks();
+}
+
+static inline void compare_set(uint32_t ticks)
+{
+  hal_posix_compare_set(ticks, blink_run);
+}
+
+static inline void compare_stop(void)
+{
+  hal_posix_compare_stop();
+}
+#endif
+
+/* a before b, on the wrapping ms scale */
+static inline bool before(uint32_t a, uint32_t b)
+{
+  return (int32_t)(a - b) < 0;
+}
+
+/* ticks from b to a, negative if a is behind b */
+static inline int32_t ticks_between(uint32_t a, uint32_t b)
+{
+  uint32_t d = (a - b) & LED_BLINK_COUNTER_MASK;
+  return (d > (LED_BLINK_COUNTER_MASK >> 1)) ? -(int32_t)((LED_BLINK_COUNTER_MASK + 1 - d) & LED_BLINK_COUNTER_MASK) : (int32_t)d;
+}
+
+static inline uint32_t deadline_ticks(uint32_t ms)
+{
+  return (m_base + HAL_TICKS_FROM_MS(ms)) & LED_BLINK_COUNTER_MASK;
+}
+
+static void heap_down(uint8_t pos)
+{
+  uint8_t led = m_heap[pos];
+
+  while(true)
+  {
+    uint8_t child = (uint8_t)((2 * pos) + 1);
+
+    if(child >= m_heap_len)
+    {
+      break;
+    }
+    if((child + 1 < m_heap_len) && before(m_led[m_heap[child + 1]].next_ms, m_led[m_heap[child]].next_ms))
+    {
+      child++;
+    }
+    if(!before(m_led[m_heap[child]].next_ms, m_led[led].next_ms))
+    {
+      break;
+    }
+    m_heap[pos] = m_heap[child];
+    pos = child;
+  }
+  m_heap[pos] = led;
+}
+
+static void heap_build(void)
+{
+  m_heap_len = m_count;
+  for(uint8_t i = 0; i < m_count; i++)
+  {
+    m_heap[i] = i;
+  }
+  for(uint8_t i = m_count / 2; i-- > 0; )
+  {
+    heap_down(i);
+  }
+}
+
+/**@brief Set the compare to the earliest deadline.
+ *
+ * @return false if that deadline is already due, it is served without waiting for the compare.
+ */
+static bool compare_program(void)
+{
+  uint32_t ticks;
+
+  if(m_heap_len == 0)
+  {
+    compare_stop();
+    return true;
+  }
+  ticks = deadline_ticks(m_led[m_heap[0]].next_ms);
+  compare_set(ticks);
+  if(ticks_between(ticks, counter_get()) < LED_BLINK_MIN_TICKS)
+  {
+    m_stats.late++;
+    return false;
+  }
+  return true;
+}
+
+/**@brief Toggle every LED due, one write per batch, until the compare is
+ * set to a deadline still ahead.
+ */
+static void blink_serve(void)
+{
+  led_bank_mask_t toggles;
+  uint32_t now;
+
+  do
+  {
+    uint32_t due = m_led[m_heap[0]].next_ms + LED_BLINK_SLACK_MS;
+
+    memset(&toggles, 0, sizeof(toggles));
+    now = counter_get();
+    while((m_heap_len > 0) && !before(due, m_led[m_heap[0]].next_ms))
+    {
+      led_blink_led_t *p_led = &m_led[m_heap[0]];
+      int32_t jitter = ticks_between(now, deadline_ticks(p_led->next_ms));
+      uint32_t abs_jitter = (jitter < 0) ? (uint32_t)-jitter : (uint32_t)jitter;
+
+      for(uint8_t p = 0; p < LED_BANK_PORTS; p++)
+      {
+        toggles.port[p] |= m_mask[m_heap[0]].port[p];
+      }
+      m_stats.toggles++;
+      m_stats.jitter_sum += abs_jitter;
+      m_stats.jitter_max = (abs_jitter > m_stats.jitter_max) ? abs_jitter : m_stats.jitter_max;
+      p_led->next_ms += p_led->period_ms;   // absolute: the deadline moves, not the time it was served
+      heap_down(0);
+    }
+    led_bank_toggle(&toggles);
+    m_stats.batches++;
+  }while(!compare_program());
+}
+
+/**@brief Compare interrupt.
+ */
+static void blink_run(void)
+{
+  if(m_heap_len == 0)
+  {
+    return;
+  }
+  m_stats.wakeups++;
+  // a compare that matched while it was being moved to a later deadline
+  if(ticks_between(deadline_ticks(m_led[m_heap[0]].next_ms), counter_get()) > 0)
+  {
+    (void)compare_program();
+    return;
+  }
+  blink_serve();
+}
+
+
+/**@brief Take RTC2 for the scheduler, the LFCLK is already running for the application timer.
+ */
+void led_blink_init(void)
+{
+  counter_init();
+}
+
+/**@brief Blink rate of one LED: it toggles every period_ms, the first time
+ * phase_ms + period_ms after led_blink_start.
+ */
+void led_blink_set(uint8_t led, uint16_t period_ms, uint16_t phase_ms)
+{
+  if(led < LED_BLINK_MAX_LEDS)
+  {
+    m_led[led].period_ms = (period_ms > 0) ? period_ms : 1;
+    m_led[led].phase_ms = phase_ms;
+  }
+}
+
+/**@brief Blink LEDs 0 .. count - 1 from now on, from the state they are in.
+ */
+void led_blink_start(uint8_t count)
+{
+  m_count = (count > LED_BLINK_MAX_LEDS) ? LED_BLINK_MAX_LEDS : count;
+  m_base = counter_get();
+  for(uint8_t i = 0; i < m_count; i++)
+  {
+    led_bank_led_mask(i, &m_mask[i]);
+    if(m_led[i].period_ms == 0)
+    {
+      m_led[i].period_ms = 1;
+    }
+    m_led[i].next_ms = (uint32_t)m_led[i].phase_ms + m_led[i].period_ms;
+  }
+  heap_build();
+  if(!compare_program())
+  {
+    blink_serve();
+  }
+}
+
+void led_blink_stop(void)
+{
+  m_heap_len = 0;
+  compare_stop();
+}
+
+/**@brief Stop, keeping the deadlines and the LED states for led_blink_resume.
+ */
+void led_blink_suspend(void)
+{
+  m_suspended_at = counter_get();
+  led_bank_state_get(&m_suspended);
+  led_blink_stop();
+}
+
+/**@brief Blink the suspended LEDs again, in the states they were left in.
+ *
+ * @param keep_phase  true: every LED first waits the rest of its interrupted
+ *                    period, false: a full period.
+ */
+void led_blink_resume(bool keep_phase)
+{
+  uint32_t now = counter_get();
+
+  led_bank_apply(&m_suspended);
+  if(keep_phase)
+  {
+    // every deadline moves by the time spent suspended, to the tick
+    m_base = (m_base + now - m_suspended_at) & LED_BLINK_COUNTER_MASK;
+  }
+  else
+  {
+    m_base = now;
+    for(uint8_t i = 0; i < m_count; i++)
+    {
+      m_led[i].next_ms = m_led[i].period_ms;
+    }
+  }
+  heap_build();
+  if(!compare_program())
+  {
+    blink_serve();
+  }
+}
+
+led_blink_stats_t const * led_blink_stats_get(void)
+{
+  return &m_stats;
+}
@@ -0,0 +1,46 @@
+#ifndef LED_BLINK_H
+#define LED_BLINK_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "led_bank.h"
+
+
+/* Per LED blink scheduler on one compare channel (RTC2 CC[0], a virtual
+ * compare on the host). Every LED toggles on its own absolute deadlines,
+ * phase + k * period in ms from the start, so rounding to ticks never
+ * accumulates. The compare is set to the earliest deadline, LEDs falling due
+ * together are toggled with one led_bank write. */
+
+#define LED_BLINK_MAX_LEDS  LED_BANK_MAX_LEDS
+
+/* Deadlines up to this far behind the earliest one are toggled with it,
+ * fewer wake-ups for at most this much early toggling */
+#ifndef LED_BLINK_SLACK_MS
+#define LED_BLINK_SLACK_MS  0
+#endif
+
+#if !defined(HAL_POSIX)
+#define LED_BLINK_IRQ_PRIORITY  APP_TIMER_CONFIG_IRQ_PRIORITY
+#endif
+
+typedef struct
+{
+  uint32_t wakeups;         /* compare interrupts */
+  uint32_t batches;         /* led_bank writes, one per set of LEDs due together */
+  uint32_t toggles;
+  uint32_t late;            /* next deadline already passed when the compare was set */
+  uint32_t jitter_max;      /* ticks between a deadline and its toggle, either way */
+  uint64_t jitter_sum;
+}led_blink_stats_t;
+
+
+void led_blink_init(void);
+void led_blink_set(uint8_t led, uint16_t period_ms, uint16_t phase_ms);
+void led_blink_start(uint8_t count);
+void led_blink_stop(void);
+void led_blink_suspend(void);
+void led_blink_resume(bool keep_phase);
+led_blink_stats_t const * led_blink_stats_get(void);
+
+
+#endif
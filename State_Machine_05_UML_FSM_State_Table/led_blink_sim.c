@@ -0,0 +1,87 @@
+/* Host simulation of led_blink.c as the LED count grows.
+ *
+ *   for s in 0 2 10; do
+ *     gcc -std=gnu99 -O2 -DHAL_POSIX -DLED_BLINK_SIM -DLED_BLINK_SLACK_MS=$s -I. -I../State_Machine_Common \
+ *         led_blink_sim.c led_blink.c led_bank.c ../State_Machine_Common/hal_posix.c -o led_blink_sim_$s
+ *     ./led_blink_sim_$s [seconds]
+ *   done
+ *
+ * Every LED gets a pseudo random period from 100 to 500 ms and runs for the
+ * given virtual time. Per LED count it reports the toggles per second (the
+ * wake-ups a timer per LED would take), the compare wake-ups and led_bank
+ * port writes per second, the jitter between deadlines and toggles, and
+ * whether the toggle count matches the absolute deadlines (no drift,
+ * nothing lost). Host interrupts are served on time, the jitter shown is the
+ * one LED_BLINK_SLACK_MS trades for wake-ups.
+ */
+#if defined(LED_BLINK_SIM)
+#include <stdio.h>
+#include <stdlib.h>
+#include "hal.h"
+#include "led_bank.h"
+#include "led_blink.h"
+
+#define SIM_SECONDS_DEFAULT   60
+
+static uint32_t m_rand = 0x2545F491;
+
+
+static uint32_t sim_rand(uint32_t range)
+{
+  m_rand ^= m_rand << 13;
+  m_rand ^= m_rand >> 17;
+  m_rand ^= m_rand << 5;
+  return m_rand % range;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned seconds = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : SIM_SECONDS_DEFAULT;
+  uint8_t pins[LED_BLINK_MAX_LEDS];
+
+  for(uint8_t i = 0; i < LED_BLINK_MAX_LEDS; i++)
+  {
+    pins[i] = i;
+  }
+  hal_init();
+  led_blink_init();
+
+  printf("slack %u ms, %u s virtual time\n", LED_BLINK_SLACK_MS, seconds);
+  printf("LEDs  toggles/s  wakeups/s  writes/s  jitter mean us  max us  toggles as due\n");
+  for(unsigned n = 1; n <= LED_BLINK_MAX_LEDS; n *= 2)
+  {
+    led_blink_stats_t before = *led_blink_stats_get();
+    led_blink_stats_t const *p_after;
+    uint64_t start = hal_posix_time_us();
+    uint64_t due = 0;
+    uint64_t due_slack = 0;    // toggles may run up to the slack early, past the end too
+    uint32_t writes;
+    uint32_t toggles;
+
+    led_bank_init(pins, (uint8_t)n, false);
+    writes = led_bank_writes_get();
+    for(uint8_t i = 0; i < n; i++)
+    {
+      uint16_t period = (uint16_t)(100 + sim_rand(401));
+
+      led_blink_set(i, period, 0);
+      due += ((uint64_t)seconds * 1000) / period;
+      due_slack += (((uint64_t)seconds * 1000) + LED_BLINK_SLACK_MS) / period;
+    }
+    led_blink_start((uint8_t)n);
+    hal_posix_run_until(start + ((uint64_t)seconds * 1000000));
+    led_blink_stop();
+
+    p_after = led_blink_stats_get();
+    toggles = p_after->toggles - before.toggles;
+    printf("%4u %10.1f %10.1f %9.1f %15.1f %7u  %s\n", n,
+           (double)toggles / seconds,
+           (double)(p_after->wakeups - before.wakeups) / seconds,
+           (double)(led_bank_writes_get() - writes) / seconds,
+           (toggles > 0) ? (double)(p_after->jitter_sum - before.jitter_sum) / toggles : 0.0,
+           p_after->jitter_max, ((toggles >= due) && (toggles <= due_slack)) ? "yes" : "NO");
+  }
+  return 0;
+}
+
+#endif /* LED_BLINK_SIM */
@@ -1,12 +1,21 @@
 
 
 #include <stdbool.h>
-#include "nrf.h"
-#include "nrf_drv_gpiote.h"
-#include "app_error.h"
-#include "boards.h"
 #include "main.h"
-#include "nrf_delay.h"
+#include "fsm_persist.h"
+#include "fsm_link.h"
+#include "led_bank.h"
+#include "fsm_latency.h"
+#include "fsm_admit.h"
+#include "port_input.h"
+#include "fsm_trace.h"
+#include "fsm_region.h"
+#include "app_regions.h"
+#include "fsm_transition.h"
+#include "fsm_hotswap.h"
+#include "fsm_log.h"
+#include "fsm_queue.h"
+#include "pot_input.h"
 
 
 #define BUTTON_COUNT 4
@@ -16,24 +25,88 @@ uint8_t btn_pad_value;
 
 static uint8_t button_pins[BUTTON_COUNT] = {BUTTON_ONE, BUTTON_TWO, BUTTON_THREE, BUTTON_FOUR}; // Define your button pins
 
+/* Names written into trace files */
+static char const * const state_names[MAX_STATE] = {"IDLE", "LED_SET", "BLINK", "PAUSE"};
+static char const * const signal_names[MAX_SIGNALS] = {"ENTRY", "EXIT", "INC_LED", "DEC_LED", "START_PAUSE", "ABRT"};
+
+#if FSM_EVENT_QUEUE
+/* Overflow policy of each queue class (fsm_event.h). A burst of aborts keeps
+ * the newest; LED count steps keep their order and a full level refuses more */
+static fsm_queue_policy_t const level_policies[FSM_QUEUE_LEVELS] = {FSM_QUEUE_DROP_NEWEST, FSM_QUEUE_DROP_NEWEST, FSM_QUEUE_DROP_OLDEST};
+#endif
+
+#if POT_INPUT
+#define POT_COUNT     0
+#define POT_RATE      1
+#define POT_CHANNELS  2
+
+static uint16_t const pot_rate_periods[] = POT_RATE_PERIODS_MS;
+
+/* A level per LED count, 0..LED_COUNT, and per blink period */
+static pot_input_channel_t const pot_channels[POT_CHANNELS] =
+{
+  {.ain = POT_COUNT_AIN, .levels = LED_COUNT + 1},
+  {.ain = POT_RATE_AIN,  .levels = sizeof(pot_rate_periods) / sizeof(pot_rate_periods[0])},
+};
+#endif
+
 
 void fsm_led_init()
 {
-  nrf_gpio_cfg_output(LED_ONE);
-  nrf_gpio_cfg_output(LED_TWO);
-  nrf_gpio_cfg_output(LED_THREE);
-  nrf_gpio_cfg_output(LED_FOUR);
+  led_bank_init(LED_GROUP, LED_COUNT, true); //LEDs are active low
 }
 
+#if FSM_ORTHOGONAL_REGIONS
+/* Every region sees the event in one run-to-completion step, the projected
+ * active_state is what goes to the link, the trace and flash */
+static void fsm_event_dispatcher(app_t *const myApp, event_t const *const e)
+{
+    event_status_t status;
+    app_state_t source;
+
+    fsm_trace_begin();
+    source = myApp->active_state;
+    status = fsm_region_dispatch(myApp, e);
+    app_regions_project(myApp);
+    fsm_latency_mark(FSM_LAT_HANDLER_DONE);
+    if(myApp->active_state != source)
+    {
+      fsm_link_transition_send(source, myApp->active_state, e->sig);
+    }
+    fsm_trace_end(source, myApp->active_state, e->sig, status);
+    fsm_persist_commit(myApp);
+    fsm_link_state_send(myApp);
+}
+#else
 static void fsm_event_dispatcher(app_t *const myApp, event_t const *const e)
 {
     event_status_t status;
     app_state_t source, target;
+#if !FSM_TRANSITION_RECORDS
     e_handler_t ehandler;
+#endif
      
+#if FSM_HOTSWAP
+    //a pending table goes in here, between run-to-completion steps
+    fsm_hotswap_begin(myApp);
+#endif
+    fsm_trace_begin();
     source = myApp->active_state;
+#if FSM_TRANSITION_RECORDS
+    status = fsm_transition_dispatch(myApp, &fsm_transition_table, e);
+#else
     ehandler = (e_handler_t) myApp->state_table[(myApp->active_state * MAX_SIGNALS) + e->sig];
     status = (*ehandler)(myApp, e);
+#endif
+#if FSM_FUSED_TRANSITIONS || FSM_TRANSITION_RECORDS
+    //exit and entry actions already ran inside the fused transition routine or the record dispatcher
+    fsm_latency_mark(FSM_LAT_HANDLER_DONE);
+    if(status == EVENT_TRANSITION)
+    {
+      target = myApp->active_state;
+      fsm_link_transition_send(source, target, e->sig);
+    }
+#else
     if(status == EVENT_TRANSITION)
     {
       target = myApp->active_state;
@@ -49,10 +122,26 @@ static void fsm_event_dispatcher(app_t *const myApp, event_t const *const e)
       ehandler = (e_handler_t) myApp->state_table[(target * MAX_SIGNALS) + ENTRY];
       (*ehandler)(myApp, &ee);
     }
+    fsm_latency_mark(FSM_LAT_HANDLER_DONE);
+    if(status == EVENT_TRANSITION)
+    {
+      fsm_link_transition_send(source, target, e->sig);
+    }
+#endif
+    fsm_trace_end(source, myApp->active_state, e->sig, status);
+#if FSM_HOTSWAP
+    fsm_hotswap_end();
+#endif
+    fsm_persist_commit(myApp);
+    fsm_link_state_send(myApp);
 }
+#endif
 
 static void fsm_state_table_init(app_t *const myApp)
 {
+#if FSM_FUSED_TRANSITIONS
+    myApp->state_table = (uintptr_t *) &fsm_fused_state_table[0][0];
+#else
     static e_handler_t fsm_state_table[MAX_STATE][MAX_SIGNALS] = {
       [IDLE] = {&IDLE_ENTRY, &IDLE_EXIT, &IDLE_INC_LED, &IDLE_DEC_LED, &IDLE_START_PAUSE, &IDLE_ABRT},
       [LED_SET] = {&LED_SET_ENTRY, &LED_SET_EXIT, &LED_SET_INC_LED, &LED_SET_DEC_LED, &LED_SET_START_PAUSE, &LED_SET_ABRT},
@@ -61,73 +150,135 @@ static void fsm_state_table_init(app_t *const myApp)
     };
     
     myApp->state_table = (uintptr_t *) &fsm_state_table[0][0];
+#endif
+}
+
+/**@brief Dispatch an event, its latency is measured from its own button edge.
+ */
+static void event_dispatch(fsm_event_t const *p_event)
+{
+  fsm_latency_mark_dispatch((p_event->edge_time == FSM_EVENT_NO_EDGE) ? FSM_LAT_NO_EDGE :
+                            (hal_capture_now() - p_event->edge_time));
+  fsm_event_dispatcher(&fsm_App, &p_event->super);
+}
+
+#if FSM_EVENT_QUEUE
+/**@brief Dispatch of a queued event, from the queue's software interrupt.
+ */
+static void queued_event_handler(fsm_event_t const *p_event)
+{
+  event_dispatch(p_event);
+}
+#endif
+
+/**@brief Queue the event in the class of its signal, or dispatch it right away.
+ */
+static void event_post(fsm_event_t const *p_event)
+{
+#if FSM_EVENT_QUEUE
+  (void)fsm_queue_post(p_event);
+#else
+  event_dispatch(p_event);
+#endif
+}
+
+#if POT_INPUT
+/**@brief Level changes of the potentiometers, from the SAADC interrupt.
+ *
+ * @details The count potentiometer steps the LEDs by the levels it crossed,
+ *          in one event. The rate potentiometer is only read when
+ *          START_PAUSE is pressed, turning it does not start blinking.
+ */
+static void pot_level_handler(uint8_t channel, uint8_t level, uint8_t previous)
+{
+  FSM_LOG2(POT_LEVEL, channel, level);
+  if(channel == POT_COUNT)
+  {
+    fsm_event_t ue = (level > previous) ? FSM_EVENT(INC_LED, hal_capture_now(), .count = level - previous)
+                                        : FSM_EVENT(DEC_LED, hal_capture_now(), .count = previous - level);
+    event_post(&ue);
+  }
 }
 
-void in_pin_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
+/**@brief The blink period the rate potentiometer is set to, for every LED.
+ */
+static void pot_rate_apply(fsm_blink_rate_t *p_rate)
 {
-  app_user_event_t ue;
+  uint8_t level = pot_input_level(POT_RATE);
+
+  if(level != POT_INPUT_NO_LEVEL)
+  {
+    for(uint8_t i = 0; i < LED_COUNT; i++)
+    {
+      p_rate->period_ms[i] = pot_rate_periods[level];
+    }
+  }
+}
+#endif
+
+void in_pin_handler(hal_pin_t pin, hal_edge_t action)
+{
+  fsm_event_t ue = {0};     // buttons send plain signals, the payload stays zero but for the pot rate
+
+  /* Bounces and edge storms stop here, before they cost a dispatch */
+  if(!fsm_admit(pin))
+  {
+    return;
+  }
 
   /* 2. Make an event */
   if(action)
   {
+    ue.edge_time = port_input_edge_time(pin);
     if(pin == BUTTON_ONE)
     {
       ue.super.sig = INC_LED;
-      printf("Signal: INC_LED\r\n");
+      FSM_LOG0(SIGNAL_INC_LED);
     }
     else if (pin == BUTTON_TWO)
     {
       ue.super.sig = DEC_LED;  
-      printf("Signal: DEC_LED\r\n");      
+      FSM_LOG0(SIGNAL_DEC_LED);
     }
     else if (pin == BUTTON_THREE)
     {
       ue.super.sig = START_PAUSE;
-      printf("Signal: START_PAUSE\r\n");        
+#if POT_INPUT
+      pot_rate_apply(&ue.payload.START_PAUSE);
+#endif
+      FSM_LOG0(SIGNAL_START_PAUSE);
     }
     else if (pin == BUTTON_FOUR)
     {
       ue.super.sig = ABRT;  
-      printf("Signal: ABRT\r\n");      
+      FSM_LOG0(SIGNAL_ABRT);
     }
-    /* 3. Send it to an event dispatcher */
-    fsm_event_dispatcher(&fsm_App, &ue.super);
+    /* 3. Send it to an event dispatcher, through the queue */
+    event_post(&ue);
   }
 }
 
-
 /**
- * @brief Function for configuring: button pin for input, PIN_OUT pin for output,
- * and configures GPIOTE to give an interrupt on pin change.
+ * @brief Events injected by the host over the command link.
  */
-static void gpio_init(void)
+static void link_event_handler(fsm_signal_t sig)
 {
-    ret_code_t err_code;
-
-    err_code = nrf_drv_gpiote_init();
-    APP_ERROR_CHECK(err_code);
+  fsm_event_t ue = {0};
 
-    nrf_drv_gpiote_in_config_t in_config = GPIOTE_CONFIG_IN_SENSE_HITOLO(true);
-    in_config.pull = NRF_GPIO_PIN_PULLUP;
-
-    for (int i = 0; i < BUTTON_COUNT; ++i) {
-        err_code = nrf_drv_gpiote_in_init(button_pins[i], &in_config, in_pin_handler);
-        APP_ERROR_CHECK(err_code);
-
-        nrf_drv_gpiote_in_event_enable(button_pins[i], true);
-    }
+  ue.super.sig = sig;
+  ue.edge_time = FSM_EVENT_NO_EDGE;
+  event_post(&ue);
 }
 
-/**@brief Function starting the internal LFCLK oscillator.
- *
- * @details This is needed by RTC1 which is used by the Application Timer
- *          (When SoftDevice is enabled the LFCLK is always running and this is not needed).
+
+/**
+ * @brief Function for configuring: button pin for input, PIN_OUT pin for output,
+ * and configures the GPIOTE PORT event to give an interrupt on pin change.
  */
-static void lfclk_request(void)
+static void gpio_init(void)
 {
-    ret_code_t err_code = nrf_drv_clock_init();
-    APP_ERROR_CHECK(err_code);
-    nrf_drv_clock_lfclk_request(NULL);
+    fsm_admit_init(button_pins, BUTTON_COUNT);
+    port_input_init(button_pins, BUTTON_COUNT, in_pin_handler);
 }
 
 
@@ -136,17 +287,55 @@ static void lfclk_request(void)
  */
 int main(void)
 {
-    bsp_board_init(BSP_INIT_LEDS);
+    hal_init();
+    fsm_log_init();
     fsm_led_init();
+    fsm_persist_init();
+    fsm_latency_init();
+    fsm_trace_init(state_names, MAX_STATE, signal_names, MAX_SIGNALS);
+#if FSM_ORTHOGONAL_REGIONS
+    app_regions_init(&fsm_App);
+#else
+#if FSM_TRANSITION_RECORDS
+    if(!fsm_transition_validate(&fsm_transition_table))
+    {
+      hal_board_leds_on();
+      //no events, the link only carries the problems logged by the check
+      fsm_link_init(&fsm_App, NULL);
+      while(true)
+      {
+        fsm_log_flush();
+        hal_idle();
+      }
+    }
+#endif
     fsm_state_table_init(&fsm_App);
     fsm_init(&fsm_App);
+#if FSM_HOTSWAP
+    fsm_hotswap_init(&fsm_App);
+#if defined(FSM_HOTSWAP_FLASH_ADDR)
+    //an image programmed separately into flash, erased flash fails the magic
+    if(fsm_hotswap_load((void const *)FSM_HOTSWAP_FLASH_ADDR, sizeof(fsm_table_image_t)) == FSM_HOTSWAP_OK)
+    {
+      (void)fsm_hotswap_apply(&fsm_App);
+    }
+#endif
+#endif
+#endif
+#if FSM_EVENT_QUEUE
+    fsm_queue_init(level_policies, queued_event_handler);
+#endif
     gpio_init();
-    lfclk_request();
-    app_timer_init();
+#if POT_INPUT
+    pot_input_init(pot_channels, POT_CHANNELS, pot_level_handler);
+#endif
+    fsm_link_init(&fsm_App, link_event_handler);
 
     while (true)
     {
-        // Do nothing.
+        //log records are formatted or sent here, out of the interrupts that logged them
+        fsm_log_flush();
+        hal_idle();
     }
 }
 
@@ -3,12 +3,11 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
-#include "app_timer.h"
-#include "nrf_drv_clock.h"
+#include "hal.h"
 
 
 
-APP_TIMER_DEF(m_repeated_timer_id);     /**< Handler for repeated timer used to blink LED 1. */
+HAL_TIMER_DEF(m_repeated_timer_id);     /**< Handler for repeated timer used to blink LED 1. */
 
 
 /* define leds */
@@ -16,6 +15,88 @@ APP_TIMER_DEF(m_repeated_timer_id);     /**< Handler for repeated timer used to
 #define LED_TWO   14
 #define LED_THREE 15
 #define LED_FOUR  16
+#define LED_COUNT 4
+
+/* 1: transitions run through precompiled fused routines, one indirect call per event */
+#ifndef FSM_FUSED_TRANSITIONS
+#define FSM_FUSED_TRANSITIONS 1
+#endif
+
+/* 1: cells hold {guard, action, target} records (fsm_transition.h), the
+ * dispatcher evaluates the guards and runs exit and entry itself */
+#ifndef FSM_TRANSITION_RECORDS
+#define FSM_TRANSITION_RECORDS 0
+#endif
+
+/* 1: the app runs as orthogonal regions (app_regions.c), LED count editing
+ * and blink control each with their own active state */
+#ifndef FSM_ORTHOGONAL_REGIONS
+#define FSM_ORTHOGONAL_REGIONS 0
+#endif
+
+#ifndef FSM_MAX_REGIONS
+#define FSM_MAX_REGIONS 4
+#endif
+
+/* History of BLINK, entered from PAUSE: NONE restarts the blink from its
+ * entry action, SHALLOW returns to the blink phase (LEDs lit or dark) BLINK
+ * was left in, DEEP also keeps the time already spent in the blink period */
+#define FSM_HISTORY_NONE    0
+#define FSM_HISTORY_SHALLOW 1
+#define FSM_HISTORY_DEEP    2
+
+#ifndef FSM_HISTORY
+#define FSM_HISTORY FSM_HISTORY_DEEP
+#endif
+
+/* 1: BLINK runs on the led_blink.c scheduler, every LED on its own period */
+#ifndef FSM_BLINK_SCHEDULER
+#define FSM_BLINK_SCHEDULER 1
+#endif
+
+/* Toggle period of each LED while blinking, ms */
+#define BLINK_PERIODS_MS  {200, 200, 200, 200}
+
+/* 1: the state table can be replaced at run time by a versioned image from
+ * the command link or flash (fsm_hotswap.h) */
+#ifndef FSM_HOTSWAP
+#define FSM_HOTSWAP 0
+#endif
+
+#if FSM_HOTSWAP && (FSM_TRANSITION_RECORDS || FSM_ORTHOGONAL_REGIONS)
+#error "FSM_HOTSWAP replaces the state table, records and regions do not use it"
+#endif
+
+/* 1: button and link events are queued by priority and dispatched from a
+ * software interrupt, ABRT ahead of START_PAUSE ahead of INC_LED/DEC_LED
+ * (fsm_queue.h), 0: dispatched in the interrupt that made them */
+#ifndef FSM_EVENT_QUEUE
+#define FSM_EVENT_QUEUE 1
+#endif
+
+/* 1: log messages are stored as ids and raw arguments and sent to the host
+ * by the main loop, 0: printed where they are logged (fsm_log.h) */
+#ifndef FSM_LOG_DEFERRED
+#define FSM_LOG_DEFERRED 1
+#endif
+
+/* Highest level compiled in: 1 error, 2 warning, 3 info, 4 debug (fsm_log_msgs.h) */
+#ifndef FSM_LOG_LEVEL
+#define FSM_LOG_LEVEL 4
+#endif
+
+/* 1: a potentiometer on POT_COUNT_AIN steps the LED count and one on
+ * POT_RATE_AIN sets the blink period START_PAUSE carries (pot_input.h),
+ * 0: off, open analog inputs would step the LEDs on noise */
+#ifndef POT_INPUT
+#define POT_INPUT 0
+#endif
+
+#define POT_COUNT_AIN  1    /* P0.03 */
+#define POT_RATE_AIN   2    /* P0.04 */
+
+/* Blink period of each level of the rate potentiometer, ms */
+#define POT_RATE_PERIODS_MS  {800, 400, 200, 100, 50}
     
 /* define button group */
 extern uint8_t LED_GROUP[]; // Declare LED_GROUP as an external variable
@@ -73,8 +154,30 @@ typedef  enum
 //forward decleration
 struct app_tag;
 struct event_tag;
+struct region_tag;
 
 typedef event_status_t (*e_handler_t)(struct app_tag *const, struct event_tag const *const); 
+typedef event_status_t (*r_handler_t)(struct app_tag *const, struct region_tag *const, struct event_tag const *const);
+
+/* One orthogonal region: its own active state over a [num_states][MAX_SIGNALS]
+ * table. NULL cells are not handled, subscribed has a bit per signal that has
+ * a handler in some state. */
+typedef struct region_tag
+{
+  uint8_t active_state;
+  uint8_t num_states;
+  uint32_t subscribed;
+  r_handler_t const *table;
+}region_t;
+
+/* History pseudostate of BLINK, its substates are the two blink phases */
+typedef struct
+{
+  bool valid;           /* BLINK was left at least once */
+  bool enter;           /* the transition being taken targets the history */
+  bool lit;             /* shallow: blink phase BLINK was left in */
+  uint32_t elapsed;     /* deep: ticks of the blink period already spent */
+}fsm_history_t;
 
 /* Main application structure */
 
@@ -83,29 +186,28 @@ typedef struct app_tag
   uint8_t curr_leds;
   app_state_t active_state;
   uintptr_t *state_table;
+  fsm_history_t blink_history;
+#if FSM_ORTHOGONAL_REGIONS
+  uint8_t num_regions;
+  region_t region[FSM_MAX_REGIONS];
+#endif
 }app_t; 
 
+/* Header of every event, the events of user signals carry a payload (fsm_event.h) */
 typedef struct event_tag
 {
   fsm_signal_t sig;
 }event_t;
 
-typedef struct
-{
-  event_t super;
-}app_user_event_t; 
-
-typedef struct
-{
-  event_t super;
-  uint8_t ss;
-}app_blink_event_t; 
 
+#if FSM_FUSED_TRANSITIONS
+extern e_handler_t fsm_fused_state_table[MAX_STATE][MAX_SIGNALS];
+extern bool const fsm_fused_cell[MAX_STATE][MAX_SIGNALS];   /* cells holding a fused transition routine */
+#endif
 
 void fsm_init(app_t *myApp);
 void fsm_button_init();
 void fsm_led_init();
-static void fsm_state_table_init(app_t *const myApp);
 
 
 /* IDLE state events and their functions */
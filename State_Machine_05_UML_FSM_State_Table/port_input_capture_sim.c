@@ -0,0 +1,190 @@
+/* Host simulation of the port_input.c edge timestamps under interrupt load.
+ *
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DPORT_INPUT_CAPTURE_SIM -I. -I../State_Machine_Common \
+ *       port_input_capture_sim.c ../State_Machine_Common/port_input.c ../State_Machine_Common/hal_posix.c -o port_input_capture_sim
+ *   ./port_input_capture_sim [seconds per load]
+ *
+ * Four buttons are pressed at pseudo random times for pseudo random lengths
+ * by a generated hal_posix script. The press handler blocks for a pseudo
+ * random time up to the load, holding off the PORT event of every other
+ * button meanwhile. Per load it compares, against the scripted edges, the
+ * time the handler sees a press (what a timestamp taken in the interrupt
+ * gets) with port_input_edge_time(), and port_input_press_duration() with
+ * the scripted press lengths. Reports with -DPORT_INPUT_CAPTURE=0 show the
+ * scan timestamps instead.
+ * Inexact edge times with capture on are represses: a release held off until
+ * the button was pressed again, the new press is only known by the scan.
+ */
+#if defined(PORT_INPUT_CAPTURE_SIM)
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "hal.h"
+#include "port_input.h"
+
+#define SIM_SECONDS_DEFAULT   60
+#define SIM_PINS              4
+#define SIM_PRESSES_MAX       4096    /* per pin and load */
+
+static uint8_t const m_pins[SIM_PINS] = {11, 12, 24, 25};
+static uint32_t const m_loads_us[] = {0, 500, 2000, 10000, 40000};
+#define SIM_LOADS   (sizeof(m_loads_us) / sizeof(m_loads_us[0]))
+
+typedef struct
+{
+  uint64_t at_us;
+  uint32_t length_us;
+}sim_press_t;
+
+typedef struct
+{
+  uint32_t presses;
+  uint32_t inexact;     /* edge_time off the scripted edge */
+  uint64_t sw_sum;
+  uint32_t sw_max;
+  uint64_t cap_sum;
+  uint32_t cap_max;
+  uint32_t dur_max;
+}sim_result_t;
+
+static sim_press_t m_truth[SIM_LOADS][SIM_PINS][SIM_PRESSES_MAX];
+static uint32_t m_truth_count[SIM_LOADS][SIM_PINS];
+static uint32_t m_seen[SIM_LOADS][SIM_PINS];
+static sim_result_t m_result[SIM_LOADS];
+static uint64_t m_window_us;
+static uint32_t m_rand = 0x2545F491;
+
+
+static uint32_t sim_rand(uint32_t range)
+{
+  m_rand ^= m_rand << 13;
+  m_rand ^= m_rand >> 17;
+  m_rand ^= m_rand << 5;
+  return m_rand % range;
+}
+
+static uint32_t abs_diff(uint64_t a, uint64_t b)
+{
+  return (uint32_t)((a > b) ? (a - b) : (b - a));
+}
+
+/**@brief Press handler: score the timestamps, then hold the interrupt for the load.
+ */
+static void press_handler(hal_pin_t pin, hal_edge_t edge)
+{
+  uint64_t now = hal_posix_time_us();
+  unsigned load = (unsigned)(now / m_window_us);
+  sim_result_t *p_res;
+  sim_press_t const *p_true;
+  unsigned slot;
+  uint32_t n;
+  uint32_t sw;
+  uint32_t cap;
+
+  (void)edge;
+  for(slot = 0; (slot < SIM_PINS) && (m_pins[slot] != pin); slot++)
+  {
+  }
+  if((slot == SIM_PINS) || (load >= SIM_LOADS))
+  {
+    return;
+  }
+  n = m_seen[load][slot]++;
+  if(n >= m_truth_count[load][slot])
+  {
+    return;
+  }
+
+  p_res = &m_result[load];
+  p_true = &m_truth[load][slot][n];
+  sw = abs_diff(now, p_true->at_us);
+  cap = abs_diff(port_input_edge_time(pin), (uint32_t)p_true->at_us);
+  p_res->presses++;
+  p_res->sw_sum += sw;
+  p_res->sw_max = (sw > p_res->sw_max) ? sw : p_res->sw_max;
+  p_res->cap_sum += cap;
+  p_res->cap_max = (cap > p_res->cap_max) ? cap : p_res->cap_max;
+  p_res->inexact += (cap != 0);
+  if(n > 0)
+  {
+    // the previous press of this pin is complete, its release was scanned before this press
+    uint32_t dur = abs_diff(port_input_press_duration(pin), m_truth[load][slot][n - 1].length_us);
+
+    p_res->dur_max = (dur > p_res->dur_max) ? dur : p_res->dur_max;
+  }
+  hal_delay_us(sim_rand(m_loads_us[load] + 1));
+}
+
+/**@brief Script the presses of every load window, 20..300 ms apart, 30..250 ms long.
+ */
+static int script_write(char const *path)
+{
+  FILE *fp = fopen(path, "w");
+
+  if(fp == NULL)
+  {
+    return -1;
+  }
+  for(unsigned load = 0; load < SIM_LOADS; load++)
+  {
+    for(unsigned slot = 0; slot < SIM_PINS; slot++)
+    {
+      uint64_t t_ms = (load * (m_window_us / 1000)) + 100 + sim_rand(100);
+      uint64_t end_ms = ((load + 1) * (m_window_us / 1000)) - 1000;
+
+      while((t_ms < end_ms) && (m_truth_count[load][slot] < SIM_PRESSES_MAX))
+      {
+        sim_press_t *p_press = &m_truth[load][slot][m_truth_count[load][slot]++];
+        uint32_t length_ms = 30 + sim_rand(221);
+
+        p_press->at_us = t_ms * 1000;
+        p_press->length_us = length_ms * 1000;
+        fprintf(fp, "%llu %u 0\n%llu %u 1\n", (unsigned long long)t_ms, m_pins[slot],
+                (unsigned long long)(t_ms + length_ms), m_pins[slot]);
+        t_ms += length_ms + 20 + sim_rand(281);
+      }
+    }
+  }
+  fclose(fp);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned seconds = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : SIM_SECONDS_DEFAULT;
+  char path[] = "/tmp/port_input_capture_XXXXXX";
+  int fd = mkstemp(path);
+  port_input_stats_t const *p_stats;
+
+  m_window_us = (uint64_t)seconds * 1000000;
+  if((fd < 0) || (close(fd) != 0) || (script_write(path) != 0) || (hal_posix_script_load(path) < 0))
+  {
+    perror(path);
+    return 1;
+  }
+  unlink(path);
+
+  hal_init();
+  port_input_init(m_pins, SIM_PINS, press_handler);
+  hal_posix_run_until(SIM_LOADS * m_window_us);
+
+  p_stats = port_input_stats_get();
+  printf("capture %s, %u buttons, %u s virtual time per load\n",
+         PORT_INPUT_CAPTURE ? "on" : "off", SIM_PINS, seconds);
+  printf("load us  presses  isr stamp err mean us  max us  edge_time err mean us  max us"
+         "  duration err max us  inexact\n");
+  for(unsigned load = 0; load < SIM_LOADS; load++)
+  {
+    sim_result_t const *p_res = &m_result[load];
+
+    printf("%7u %8u %22.1f %7u %22.1f %7u %20u %10u\n", m_loads_us[load], p_res->presses,
+           p_res->presses ? ((double)p_res->sw_sum / p_res->presses) : 0.0, p_res->sw_max,
+           p_res->presses ? ((double)p_res->cap_sum / p_res->presses) : 0.0, p_res->cap_max,
+           p_res->dur_max, p_res->inexact);
+  }
+  printf("edges captured %u, scan stamped %u, longest edge to scan %u us\n",
+         p_stats->captured, p_stats->uncaptured, p_stats->service_max);
+  return 0;
+}
+
+#endif /* PORT_INPUT_CAPTURE_SIM */
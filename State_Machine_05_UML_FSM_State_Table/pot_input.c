@@ -0,0 +1,270 @@
+#include "pot_input.h"
+#include <string.h>
+
+#if !defined(HAL_POSIX)
+#include "nrf.h"
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+#if (POT_INPUT_DECIMATION & (POT_INPUT_DECIMATION - 1)) != 0
+#error "POT_INPUT_DECIMATION must be a power of two"
+#endif
+#if ((1000 * POT_INPUT_DECIMATION) % POT_INPUT_SAMPLE_HZ) != 0
+#error "a buffer must last a whole number of ms"
+#endif
+
+#define POT_INPUT_FRACTION    4       /* fraction bits of the IIR state */
+
+typedef struct
+{
+  int32_t filtered;     /* IIR output, POT_INPUT_FRACTION fraction bits */
+  uint16_t width;       /* LSB per level */
+  uint8_t levels;
+  uint8_t level;
+}pot_input_state_t;
+
+static int16_t m_buffer[2][POT_INPUT_MAX_CHANNELS * POT_INPUT_DECIMATION];
+static pot_input_state_t m_state[POT_INPUT_MAX_CHANNELS];
+static uint8_t m_count;
+static pot_input_handler_t m_handler;
+static pot_input_stats_t m_stats;
+
+static void buffer_process(int16_t const *p_samples);
+
+
+#if !defined(HAL_POSIX)
+static uint8_t m_filled;    /**< Buffer the SAADC ends next. */
+
+void SAADC_IRQHandler(void)
+{
+  if(NRF_SAADC->EVENTS_END)
+  {
+    int16_t const *p_done = m_buffer[m_filled];
+
+    NRF_SAADC->EVENTS_END = 0;
+    (void)NRF_SAADC->EVENTS_END;
+    // END already started the other buffer through PPI, this one is filled after it
+    NRF_SAADC->RESULT.PTR = (uint32_t)p_done;
+    m_filled ^= 1;
+    buffer_process(p_done);
+  }
+}
+
+/**@brief Scan the channels from TIMER4 through PPI, chain the buffers on END.
+ *
+ * @details Full scale is VDD (gain 1/4 of VDD/4), ratiometric with a
+ *          potentiometer between VDD and GND.
+ */
+static void sampling_start(pot_input_channel_t const *p_channels)
+{
+  for(uint8_t ch = 0; ch < m_count; ch++)
+  {
+    NRF_SAADC->CH[ch].CONFIG = (SAADC_CH_CONFIG_RESP_Bypass << SAADC_CH_CONFIG_RESP_Pos) |
+                               (SAADC_CH_CONFIG_RESN_Bypass << SAADC_CH_CONFIG_RESN_Pos) |
+                               (SAADC_CH_CONFIG_GAIN_Gain1_4 << SAADC_CH_CONFIG_GAIN_Pos) |
+                               (SAADC_CH_CONFIG_REFSEL_VDD1_4 << SAADC_CH_CONFIG_REFSEL_Pos) |
+                               (SAADC_CH_CONFIG_TACC_10us << SAADC_CH_CONFIG_TACC_Pos) |
+                               (SAADC_CH_CONFIG_MODE_SE << SAADC_CH_CONFIG_MODE_Pos) |
+                               (SAADC_CH_CONFIG_BURST_Disabled << SAADC_CH_CONFIG_BURST_Pos);
+    NRF_SAADC->CH[ch].PSELN = SAADC_CH_PSELN_PSELN_NC;
+    NRF_SAADC->CH[ch].PSELP = SAADC_CH_PSELP_PSELP_AnalogInput0 + p_channels[ch].ain;
+  }
+  NRF_SAADC->RESOLUTION = SAADC_RESOLUTION_VAL_12bit;
+  NRF_SAADC->OVERSAMPLE = SAADC_OVERSAMPLE_OVERSAMPLE_Bypass;
+  NRF_SAADC->SAMPLERATE = SAADC_SAMPLERATE_MODE_Task << SAADC_SAMPLERATE_MODE_Pos;
+  NRF_SAADC->ENABLE = SAADC_ENABLE_ENABLE_Enabled;
+
+  NRF_SAADC->EVENTS_CALIBRATEDONE = 0;
+  NRF_SAADC->TASKS_CALIBRATEOFFSET = 1;
+  while(NRF_SAADC->EVENTS_CALIBRATEDONE == 0)
+  {
+  }
+  NRF_SAADC->EVENTS_CALIBRATEDONE = 0;
+
+  NRF_SAADC->RESULT.MAXCNT = m_count * POT_INPUT_DECIMATION;
+  NRF_SAADC->RESULT.PTR = (uint32_t)m_buffer[0];
+  NRF_SAADC->EVENTS_STARTED = 0;
+  NRF_SAADC->TASKS_START = 1;
+  while(NRF_SAADC->EVENTS_STARTED == 0)
+  {
+  }
+  NRF_SAADC->EVENTS_STARTED = 0;
+  NRF_SAADC->RESULT.PTR = (uint32_t)m_buffer[1];    // latched by the START that END triggers
+  m_filled = 0;
+
+  NRF_SAADC->EVENTS_END = 0;
+  NRF_SAADC->INTENSET = SAADC_INTENSET_END_Msk;
+  NVIC_SetPriority(SAADC_IRQn, POT_INPUT_IRQ_PRIORITY);
+  NVIC_ClearPendingIRQ(SAADC_IRQn);
+  NVIC_EnableIRQ(SAADC_IRQn);
+
+  NRF_PPI->CH[POT_INPUT_PPI_SAMPLE].EEP = (uint32_t)&NRF_TIMER4->EVENTS_COMPARE[0];
+  NRF_PPI->CH[POT_INPUT_PPI_SAMPLE].TEP = (uint32_t)&NRF_SAADC->TASKS_SAMPLE;
+  NRF_PPI->CH[POT_INPUT_PPI_RESTART].EEP = (uint32_t)&NRF_SAADC->EVENTS_END;
+  NRF_PPI->CH[POT_INPUT_PPI_RESTART].TEP = (uint32_t)&NRF_SAADC->TASKS_START;
+  NRF_PPI->CHENSET = (1UL << POT_INPUT_PPI_SAMPLE) | (1UL << POT_INPUT_PPI_RESTART);
+
+  NRF_TIMER4->MODE = TIMER_MODE_MODE_Timer;
+  NRF_TIMER4->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  NRF_TIMER4->PRESCALER = 4;            // 1 MHz
+  NRF_TIMER4->CC[0] = 1000000 / POT_INPUT_SAMPLE_HZ;
+  NRF_TIMER4->SHORTS = TIMER_SHORTS_COMPARE0_CLEAR_Msk;
+  NRF_TIMER4->TASKS_CLEAR = 1;
+  NRF_TIMER4->TASKS_START = 1;
+}
+#else
+HAL_TIMER_DEF(m_buffer_timer_id);       /**< Stands in for the SAADC END event. */
+
+static FILE *m_stream;
+
+/**@brief Host backend: the next buffer of the recorded stream, every
+ *        POT_INPUT_BUFFER_MS of virtual time, until the stream ends.
+ */
+static void buffer_timer_handler(void *p_context)
+{
+  int16_t *p_buffer = m_buffer[0];
+
+  (void)p_context;
+  for(uint16_t i = 0; i < (m_count * POT_INPUT_DECIMATION); i++)
+  {
+    int sample;
+
+    if(fscanf(m_stream, "%d", &sample) != 1)
+    {
+      hal_timer_stop(m_buffer_timer_id);
+      fclose(m_stream);
+      m_stream = NULL;
+      return;
+    }
+    p_buffer[i] = (int16_t)sample;
+  }
+  buffer_process(p_buffer);
+}
+
+/**@brief Play the stream POT_SAMPLES names: a line per conversion, a column
+ *        per channel. Without it nothing is sampled.
+ */
+static void sampling_start(pot_input_channel_t const *p_channels)
+{
+  char const *path = getenv("POT_SAMPLES");
+
+  (void)p_channels;
+  if(path == NULL)
+  {
+    return;
+  }
+  if((m_stream = fopen(path, "r")) == NULL)
+  {
+    perror(path);
+    return;
+  }
+  hal_timer_create(&m_buffer_timer_id, HAL_TIMER_REPEATED, buffer_timer_handler);
+  hal_timer_start(m_buffer_timer_id, POT_INPUT_BUFFER_MS, NULL);
+}
+
+/**@brief Process samples as if the SAADC had filled a buffer with them,
+ *        POT_INPUT_DECIMATION conversions of every channel, interleaved.
+ */
+void pot_input_feed(int16_t const *p_samples)
+{
+  buffer_process(p_samples);
+}
+#endif
+
+/**@brief Filter the mean of a buffer, move the level once the value is
+ *        POT_INPUT_HYSTERESIS past a boundary.
+ */
+static void value_process(uint8_t ch, int32_t value)
+{
+  pot_input_state_t *p_state = &m_state[ch];
+  uint8_t level;
+
+  if(p_state->level == POT_INPUT_NO_LEVEL)
+  {
+    level = (uint8_t)(value / p_state->width);
+    p_state->filtered = value << POT_INPUT_FRACTION;
+    p_state->level = (level < p_state->levels) ? level : (p_state->levels - 1);
+    return;
+  }
+
+  p_state->filtered += ((value << POT_INPUT_FRACTION) - p_state->filtered) / (1 << POT_INPUT_FILTER_SHIFT);
+  value = p_state->filtered >> POT_INPUT_FRACTION;
+  level = p_state->level;
+  while(((level + 1) < p_state->levels) && (value >= (((level + 1) * p_state->width) + POT_INPUT_HYSTERESIS)))
+  {
+    level++;
+  }
+  while((level > 0) && (value < ((level * p_state->width) - POT_INPUT_HYSTERESIS)))
+  {
+    level--;
+  }
+  if(level != p_state->level)
+  {
+    uint8_t previous = p_state->level;
+
+    p_state->level = level;
+    m_stats.changes++;
+    m_handler(ch, level, previous);
+  }
+}
+
+/**@brief Decimate a buffer to the mean of every channel.
+ */
+static void buffer_process(int16_t const *p_samples)
+{
+  uint16_t len = m_count * POT_INPUT_DECIMATION;
+
+  m_stats.buffers++;
+  m_stats.samples += len;
+  for(uint8_t ch = 0; ch < m_count; ch++)
+  {
+    int32_t sum = 0;
+
+    for(uint16_t i = ch; i < len; i += m_count)
+    {
+      int16_t sample = p_samples[i];
+
+      if(sample < 0)
+      {
+        m_stats.clipped++;      // noise around 0 V on a single ended input
+        sample = 0;
+      }
+      sum += sample;
+    }
+    value_process(ch, sum / POT_INPUT_DECIMATION);
+  }
+}
+
+/**@brief Start sampling the channels, the handler gets their level changes.
+ */
+void pot_input_init(pot_input_channel_t const *p_channels, uint8_t count, pot_input_handler_t handler)
+{
+  m_count = (count > POT_INPUT_MAX_CHANNELS) ? POT_INPUT_MAX_CHANNELS : count;
+  m_handler = handler;
+  memset(&m_stats, 0, sizeof(m_stats));
+  for(uint8_t ch = 0; ch < m_count; ch++)
+  {
+    uint8_t levels = p_channels[ch].levels;
+
+    levels = (levels < 2) ? 2 : ((levels > POT_INPUT_MAX_LEVELS) ? POT_INPUT_MAX_LEVELS : levels);
+    m_state[ch].levels = levels;
+    m_state[ch].width = POT_INPUT_FULL_SCALE / levels;
+    m_state[ch].level = POT_INPUT_NO_LEVEL;
+    m_state[ch].filtered = 0;
+  }
+  sampling_start(p_channels);
+}
+
+/**@brief Current level of a channel, POT_INPUT_NO_LEVEL before its first buffer.
+ */
+uint8_t pot_input_level(uint8_t channel)
+{
+  return (channel < m_count) ? m_state[channel].level : POT_INPUT_NO_LEVEL;
+}
+
+pot_input_stats_t const * pot_input_stats_get(void)
+{
+  return &m_stats;
+}
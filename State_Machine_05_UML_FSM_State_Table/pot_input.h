@@ -0,0 +1,81 @@
+#ifndef POT_INPUT_H
+#define POT_INPUT_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+
+/* Potentiometers on SAADC analog inputs. TIMER4 COMPARE0 -> PPI -> SAMPLE
+ * converts every channel (scan mode) POT_INPUT_SAMPLE_HZ times a second,
+ * EasyDMA writes them into one of two buffers while the other one waits to
+ * be processed, END -> PPI -> START moves on to the next buffer without the
+ * CPU. Only END interrupts: one wake per buffer, not per sample.
+ *
+ * A buffer is decimated to one value per channel (the mean of its
+ * POT_INPUT_DECIMATION samples), smoothed by a first order IIR and
+ * quantized into levels with a hysteresis around every boundary, the
+ * handler only runs when the level of a channel changes. The first value
+ * of a channel sets its level without calling the handler. Owns the SAADC
+ * interrupt, TIMER4 and two PPI channels, the SAADC driver must be
+ * disabled. */
+
+#define POT_INPUT_MAX_CHANNELS    2
+#define POT_INPUT_MAX_LEVELS      16
+
+/* per channel */
+#ifndef POT_INPUT_SAMPLE_HZ
+#define POT_INPUT_SAMPLE_HZ       1000
+#endif
+
+/* samples per channel in a buffer, a power of two */
+#ifndef POT_INPUT_DECIMATION
+#define POT_INPUT_DECIMATION      32
+#endif
+
+#define POT_INPUT_BUFFER_MS       ((1000 * POT_INPUT_DECIMATION) / POT_INPUT_SAMPLE_HZ)
+#define POT_INPUT_FULL_SCALE      4096    /* 12 bit, single ended */
+
+/* IIR: a new value weighs 1 / 2^POT_INPUT_FILTER_SHIFT */
+#ifndef POT_INPUT_FILTER_SHIFT
+#define POT_INPUT_FILTER_SHIFT    2
+#endif
+
+/* LSB past a boundary before the level changes */
+#ifndef POT_INPUT_HYSTERESIS
+#define POT_INPUT_HYSTERESIS      64
+#endif
+
+#define POT_INPUT_NO_LEVEL        0xFF    /* no value yet */
+
+#if !defined(HAL_POSIX)
+#define POT_INPUT_IRQ_PRIORITY    GPIOTE_CONFIG_IRQ_PRIORITY
+#define POT_INPUT_PPI_SAMPLE      4       /* PPI 0..3 belong to the capture path of hal.h */
+#define POT_INPUT_PPI_RESTART     5
+#endif
+
+typedef struct
+{
+  uint8_t ain;          /* analog input, 0..7 for AIN0..AIN7 */
+  uint8_t levels;       /* the full scale is split into this many, 2..POT_INPUT_MAX_LEVELS */
+}pot_input_channel_t;
+
+typedef void (*pot_input_handler_t)(uint8_t channel, uint8_t level, uint8_t previous);
+
+typedef struct
+{
+  uint32_t buffers;
+  uint32_t samples;
+  uint32_t clipped;     /* negative samples, taken as 0 */
+  uint32_t changes;     /* level changes, handler calls */
+}pot_input_stats_t;
+
+
+void pot_input_init(pot_input_channel_t const *p_channels, uint8_t count, pot_input_handler_t handler);
+uint8_t pot_input_level(uint8_t channel);
+pot_input_stats_t const * pot_input_stats_get(void);
+#if defined(HAL_POSIX)
+void pot_input_feed(int16_t const *p_samples);
+#endif
+
+
+#endif
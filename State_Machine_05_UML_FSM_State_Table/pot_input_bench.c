@@ -0,0 +1,201 @@
+/* Host measurement of pot_input.c on a sampled stream.
+ *
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DPOT_INPUT_BENCH -I. -I../State_Machine_Common \
+ *       pot_input_bench.c pot_input.c ../State_Machine_Common/hal_posix.c -lm -o pot_input_bench
+ *   ./pot_input_bench [stream]
+ *
+ * The stream is what POT_SAMPLES plays into the application: a line per
+ * conversion, the count and the rate potentiometer. Without one, a stream
+ * is made up: both potentiometers turned back and forth across the full
+ * scale, with white noise and 50 Hz hum on top. It is fed through
+ * pot_input_feed buffer by buffer, and the level changes are compared with
+ * a threshold on every raw sample (no decimation, no filter, no hysteresis)
+ * and, for the made up stream, with the crossings of the clean signal.
+ * Last, the host time pot_input takes per buffer and per sample.
+ */
+#if defined(POT_INPUT_BENCH)
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pot_input.h"
+
+#define BENCH_CHANNELS      2
+#define BENCH_SECONDS       60
+#define BENCH_NOISE_LSB     25.0      /* standard deviation */
+#define BENCH_HUM_LSB       30.0      /* amplitude */
+#define BENCH_REPEAT        200
+
+static pot_input_channel_t const m_channels[BENCH_CHANNELS] = {{.ain = 1, .levels = 5}, {.ain = 2, .levels = 5}};
+static double const m_sweep_s[BENCH_CHANNELS] = {8.0, 13.0};     /* time for a full turn and back */
+
+static int16_t *m_samples;        /* interleaved, BENCH_CHANNELS per conversion */
+static int16_t *m_clean;          /* the made up stream without noise and hum */
+static uint32_t m_conversions;
+static uint32_t m_events;
+static uint32_t m_rand = 0x9E3779B9;
+
+
+static void level_handler(uint8_t channel, uint8_t level, uint8_t previous)
+{
+  (void)channel;
+  (void)level;
+  (void)previous;
+  m_events++;
+}
+
+static double bench_uniform(void)
+{
+  m_rand ^= m_rand << 13;
+  m_rand ^= m_rand >> 17;
+  m_rand ^= m_rand << 5;
+  return (m_rand + 1.0) / 4294967297.0;
+}
+
+static double bench_gauss(void)
+{
+  return sqrt(-2.0 * log(bench_uniform())) * cos(2.0 * M_PI * bench_uniform());
+}
+
+static int16_t clamp12(double v)
+{
+  return (int16_t)((v > 4095.0) ? 4095.0 : ((v < -32.0) ? -32.0 : lround(v)));
+}
+
+static void stream_make(void)
+{
+  m_conversions = BENCH_SECONDS * POT_INPUT_SAMPLE_HZ;
+  m_samples = malloc(m_conversions * BENCH_CHANNELS * sizeof(int16_t));
+  m_clean = malloc(m_conversions * BENCH_CHANNELS * sizeof(int16_t));
+  for(uint32_t n = 0; n < m_conversions; n++)
+  {
+    double t = (double)n / POT_INPUT_SAMPLE_HZ;
+
+    for(uint8_t ch = 0; ch < BENCH_CHANNELS; ch++)
+    {
+      double phase = fmod(t / m_sweep_s[ch], 1.0);
+      double v = 4095.0 * ((phase < 0.5) ? (2.0 * phase) : (2.0 - (2.0 * phase)));
+
+      m_clean[(n * BENCH_CHANNELS) + ch] = clamp12(v);
+      m_samples[(n * BENCH_CHANNELS) + ch] = clamp12(v + (BENCH_NOISE_LSB * bench_gauss()) +
+                                                     (BENCH_HUM_LSB * sin(2.0 * M_PI * 50.0 * t)));
+    }
+  }
+}
+
+static int stream_read(char const *path)
+{
+  FILE *p_file = fopen(path, "r");
+  uint32_t size = 1024;
+  int sample;
+  uint32_t n = 0;
+
+  if(p_file == NULL)
+  {
+    perror(path);
+    return -1;
+  }
+  m_samples = malloc(size * sizeof(int16_t));
+  while(fscanf(p_file, "%d", &sample) == 1)
+  {
+    if(n == size)
+    {
+      size *= 2;
+      m_samples = realloc(m_samples, size * sizeof(int16_t));
+    }
+    m_samples[n++] = (int16_t)sample;
+  }
+  fclose(p_file);
+  m_conversions = n / BENCH_CHANNELS;
+  return 0;
+}
+
+/**@brief Level changes of a level decision on every sample, at the level boundaries.
+ */
+static uint32_t threshold_changes(int16_t const *p_samples)
+{
+  uint32_t changes = 0;
+
+  for(uint8_t ch = 0; ch < BENCH_CHANNELS; ch++)
+  {
+    int32_t width = POT_INPUT_FULL_SCALE / m_channels[ch].levels;
+    int32_t level = -1;
+
+    for(uint32_t n = 0; n < m_conversions; n++)
+    {
+      int32_t sample = p_samples[(n * BENCH_CHANNELS) + ch];
+      int32_t now = ((sample < 0) ? 0 : sample) / width;
+
+      now = (now >= m_channels[ch].levels) ? (m_channels[ch].levels - 1) : now;
+      changes += (level >= 0) && (now != level);
+      level = now;
+    }
+  }
+  return changes;
+}
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t buffers;
+  double seconds;
+  uint64_t t0;
+  uint64_t ns;
+
+  if(argc > 1)
+  {
+    if(stream_read(argv[1]) != 0)
+    {
+      return 1;
+    }
+  }
+  else
+  {
+    stream_make();
+  }
+  buffers = m_conversions / POT_INPUT_DECIMATION;
+  seconds = (double)m_conversions / POT_INPUT_SAMPLE_HZ;
+
+  printf("%u conversions of %u channels, %.1f s at %u Hz, %u per buffer\n", m_conversions, BENCH_CHANNELS, seconds,
+         POT_INPUT_SAMPLE_HZ, POT_INPUT_DECIMATION);
+  pot_input_init(m_channels, BENCH_CHANNELS, level_handler);
+  for(uint32_t b = 0; b < buffers; b++)
+  {
+    pot_input_feed(&m_samples[b * POT_INPUT_DECIMATION * BENCH_CHANNELS]);
+  }
+  printf("  %-34s %8s %10s\n", "", "changes", "per second");
+  printf("  %-34s %8u %10.2f\n", "pot_input (decimate, IIR, hyst.)", m_events, m_events / seconds);
+  printf("  %-34s %8u %10.2f\n", "threshold on every sample", threshold_changes(m_samples),
+         threshold_changes(m_samples) / seconds);
+  if(m_clean != NULL)
+  {
+    printf("  %-34s %8u %10.2f\n", "clean signal", threshold_changes(m_clean), threshold_changes(m_clean) / seconds);
+  }
+  printf("wakes per second: %.2f per buffer against %u per conversion, clipped samples %u\n",
+         (double)POT_INPUT_SAMPLE_HZ / POT_INPUT_DECIMATION, POT_INPUT_SAMPLE_HZ, pot_input_stats_get()->clipped);
+
+  t0 = host_ns();
+  for(unsigned r = 0; r < BENCH_REPEAT; r++)
+  {
+    for(uint32_t b = 0; b < buffers; b++)
+    {
+      pot_input_feed(&m_samples[b * POT_INPUT_DECIMATION * BENCH_CHANNELS]);
+    }
+  }
+  ns = host_ns() - t0;
+  printf("host time: %.1f ns per buffer, %.2f ns per sample\n", (double)ns / ((double)buffers * BENCH_REPEAT),
+         (double)ns / ((double)buffers * BENCH_REPEAT * POT_INPUT_DECIMATION * BENCH_CHANNELS));
+
+  free(m_samples);
+  free(m_clean);
+  return 0;
+}
+
+#endif /* POT_INPUT_BENCH */
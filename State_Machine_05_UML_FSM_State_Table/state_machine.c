@@ -1,18 +1,83 @@
 
 #include "main.h"
-#include "boards.h"
-#include "nrf_delay.h"
-#include <stdio.h>
+#include "fsm_persist.h"
+#include "led_bank.h"
+#include "fsm_latency.h"
+#include "fsm_transition.h"
+#include "led_blink.h"
+#include "fsm_log.h"
+#include "fsm_event.h"
 
 
 // Function prototypes
 static void display_leds(app_t *const myApp);
-static void display_message(char *msg);
 static void display_clear(app_t *const myApp);
+#if !FSM_BLINK_SCHEDULER
 static void blink_leds(app_t *const myApp);
+#endif
 
 uint8_t LED_GROUP[] = {LED_ONE, LED_TWO, LED_THREE, LED_FOUR};
 
+#define BLINK_PERIOD_MS 200
+
+#if FSM_BLINK_SCHEDULER
+static uint16_t const m_blink_periods[LED_COUNT] = BLINK_PERIODS_MS;
+
+/**@brief Set the blink rate of every LED, once at init.
+ */
+static void create_timers(void)
+{
+    led_blink_init();
+    for(uint8_t i = 0; i < LED_COUNT; i++)
+    {
+      led_blink_set(i, m_blink_periods[i], 0);
+    }
+}
+
+/**@brief Start blinking the LEDs of the current count, lit for their first period.
+ */
+static void start_timers(app_t *const myApp)
+{
+    led_blink_start(myApp->curr_leds);
+}
+
+/**@brief Stop timers.
+ */
+static void stop_timers()
+{
+  led_blink_stop();
+}
+
+#if FSM_HISTORY != FSM_HISTORY_NONE
+/**@brief The scheduler keeps the LED states and the time every LED has left.
+ */
+static void history_save(app_t *const myApp)
+{
+  myApp->blink_history.valid = true;
+  led_blink_suspend();
+}
+
+/**@brief Enter BLINK through its history: the LED states BLINK was left in,
+ * DEEP also the time each LED had left to its next toggle.
+ */
+static event_status_t history_resume(app_t *const myApp)
+{
+  FSM_LOG0(BLINK_RESUME);
+  led_blink_resume(FSM_HISTORY == FSM_HISTORY_DEEP);
+  fsm_latency_mark(FSM_LAT_OUTPUT);
+  return EVENT_TRANSITION;
+}
+#endif
+
+#else
+HAL_TIMER_DEF(m_resume_timer_id);       /**< Single shot timer finishing the blink period BLINK was left in. */
+
+static uint16_t m_blink_period_ms = BLINK_PERIOD_MS;
+
+/* Blink phase, kept for the history of BLINK */
+static bool m_blink_lit;
+static uint32_t m_blink_since;          /* ticks when the current period started */
+
 
 /**@brief Timeout handler for the repeated timer.
  */
@@ -20,25 +85,37 @@ static void repeated_timer_handler(void * p_context)
 {
     app_t * myApp = (app_t *)p_context;
     blink_leds(myApp);
+    m_blink_lit = !m_blink_lit;
+    m_blink_since = hal_ticks();
 }
 
-/**@brief Create timers.
+/**@brief Timeout handler for the resume timer, the rest of the periods run on the repeated timer.
  */
-static void create_timers(app_t *const myApp)
+static void resume_timer_handler(void * p_context)
 {
-    ret_code_t err_code;
+    repeated_timer_handler(p_context);
+    hal_timer_start(m_repeated_timer_id, m_blink_period_ms, p_context);
+}
 
-    // Create timers
-    err_code = app_timer_create(&m_repeated_timer_id,
-                                APP_TIMER_MODE_REPEATED,
-                                repeated_timer_handler);
-    APP_ERROR_CHECK(err_code);
+/**@brief Create timers, once at init.
+ */
+static void create_timers(void)
+{
+    hal_timer_create(&m_repeated_timer_id,
+                     HAL_TIMER_REPEATED,
+                     repeated_timer_handler);
+    hal_timer_create(&m_resume_timer_id,
+                     HAL_TIMER_SINGLE_SHOT,
+                     resume_timer_handler);
+}
 
-    // Start timer
-    err_code = app_timer_start(m_repeated_timer_id,
-                                APP_TIMER_TICKS(200),
-                                (void*)myApp );
-    APP_ERROR_CHECK(err_code);
+/**@brief Start blinking, LEDs lit for the first period.
+ */
+static void start_timers(app_t *const myApp)
+{
+    m_blink_lit = true;
+    m_blink_since = hal_ticks();
+    hal_timer_start(m_repeated_timer_id, m_blink_period_ms, (void*)myApp);
 }
 
 
@@ -47,160 +124,214 @@ static void create_timers(app_t *const myApp)
 static void stop_timers()
 {
   // Stop the repeated timer (stop blinking LED).
-  ret_code_t err_code;
-  err_code = app_timer_stop(m_repeated_timer_id);
-  APP_ERROR_CHECK(err_code);
+  hal_timer_stop(m_repeated_timer_id);
+  hal_timer_stop(m_resume_timer_id);
 }
 
-static void display_leds(app_t *const myApp)
+#if FSM_HISTORY != FSM_HISTORY_NONE
+/**@brief Record the blink phase BLINK is left in.
+ */
+static void history_save(app_t *const myApp)
 {
-  printf("Current LEDs: %d\r\n", myApp->curr_leds);
-  for(uint8_t i = 0; i<myApp->curr_leds; i++)
+  uint32_t elapsed = hal_ticks_diff(hal_ticks(), m_blink_since);
+
+  myApp->blink_history.valid = true;
+  myApp->blink_history.lit = m_blink_lit;
+  myApp->blink_history.elapsed = (elapsed < HAL_TICKS_FROM_MS(m_blink_period_ms)) ? elapsed : HAL_TICKS_FROM_MS(m_blink_period_ms);
+}
+
+/**@brief Enter BLINK through its history: one LED bank write and one timer
+ * start, the entry actions of a cold start are skipped.
+ */
+static event_status_t history_resume(app_t *const myApp)
+{
+  fsm_history_t const *p_history = &myApp->blink_history;
+
+  FSM_LOG0(BLINK_RESUME);
+  m_blink_lit = p_history->lit;
+  led_bank_show_count(m_blink_lit ? myApp->curr_leds : 0);
+  fsm_latency_mark(FSM_LAT_OUTPUT);
+#if FSM_HISTORY == FSM_HISTORY_DEEP
   {
-    nrf_gpio_pin_clear(LED_GROUP[i]);//to turn on the led
-    nrf_delay_ms(50);
+    // the timer takes ms, round the rest of the period to the nearest one
+    uint32_t left = HAL_MS_FROM_TICKS(HAL_TICKS_FROM_MS(m_blink_period_ms) - p_history->elapsed + (HAL_TICKS_FROM_MS(1) / 2));
+
+    // the period start is moved back by the time already spent in it
+    m_blink_since = hal_ticks() - p_history->elapsed;
+    hal_timer_start(m_resume_timer_id, (left > 0) ? left : 1, (void*)myApp);
   }
+#else
+  m_blink_since = hal_ticks();
+  hal_timer_start(m_repeated_timer_id, m_blink_period_ms, (void*)myApp);
+#endif
+  return EVENT_TRANSITION;
 }
+#endif
+#endif /* FSM_BLINK_SCHEDULER */
 
-static void display_message(char *msg)
+static void display_leds(app_t *const myApp)
 {
-    printf("%s\r\n", msg);
+  FSM_LOG1(CURRENT_LEDS, myApp->curr_leds);
+  led_bank_show_count(myApp->curr_leds);
+  fsm_latency_mark(FSM_LAT_OUTPUT);
 }
 
+/* Messages are ids of fsm_log_msgs.h, the text is only known to the host */
+#define display_message(msg)  FSM_LOG0(msg)
+
 static void display_clear(app_t *const myApp)
 {
-  printf("Clear led\r\n");
-  for(uint8_t i = 0; i<4; i++)
-  {
-    nrf_gpio_pin_set(LED_GROUP[i]);//to turn off the led
-    nrf_delay_ms(50);
-  }
+  FSM_LOG0(CLEAR_LED);
+  led_bank_show_count(0);
+  fsm_latency_mark(FSM_LAT_OUTPUT);
 }
 
+#if !FSM_BLINK_SCHEDULER
 void blink_leds(app_t *const myApp)
 {
-  for (int i = 0; i < myApp->curr_leds; i++) 
+  led_bank_toggle_count(myApp->curr_leds);
+}
+#endif
+
+/**@brief Take the blink periods of a START_PAUSE event, 0 keeps the period
+ * of that LED. Without the scheduler all LEDs blink on the first one.
+ */
+static void blink_rate_set(fsm_blink_rate_t const *p_rate)
+{
+#if FSM_BLINK_SCHEDULER
+  for(uint8_t i = 0; i < LED_COUNT; i++)
+  {
+    if(p_rate->period_ms[i] != 0)
+    {
+      led_blink_set(i, p_rate->period_ms[i], 0);
+    }
+  }
+#else
+  if(p_rate->period_ms[0] != 0)
   {
-    nrf_gpio_pin_toggle(LED_GROUP[i]);//to turn on the led
+    m_blink_period_ms = p_rate->period_ms[0];
   }
+#endif
 }
 
 /* IDLE state events and their functions */
 event_status_t IDLE_ENTRY(app_t *const myApp, event_t const *const e)
 {
-  printf("IDLE_ENTRY\r\n");
+  FSM_LOG0(IDLE_ENTRY);
   display_leds(myApp);
-  display_message("IDLE STATE\r\n");
+  display_message(MSG_IDLE_STATE);
   myApp->active_state = IDLE;
   return EVENT_HANDLED;
 }
 
 event_status_t IDLE_EXIT(app_t *const myApp, event_t const *const e)
 {
-  printf("IDLE_EXIT\r\n");
+  FSM_LOG0(IDLE_EXIT);
   display_clear(myApp);
-  display_message("Exit from: IDLE");           
+  display_message(MSG_EXIT_IDLE);           
   return EVENT_HANDLED;
 }
 
 event_status_t IDLE_INC_LED(app_t *const myApp, event_t const *const e)
 {
-  printf("IDLE_INC_LED\r\n");
+  FSM_LOG0(IDLE_INC_LED);
   myApp->active_state = LED_SET;
   return EVENT_TRANSITION;
 }
 
 event_status_t IDLE_DEC_LED(app_t *const myApp, event_t const *const e)
 {
-  printf("IDLE_DEC_LED\r\n");  
+  FSM_LOG0(IDLE_DEC_LED);  
   myApp->active_state = LED_SET;
   return EVENT_TRANSITION;
 }
 
-event_status_t IDLE_START_PAUSE(app_t *const myApp, event_t const *const e)
+FSM_HANDLER(IDLE, START_PAUSE)
 { 
   if(myApp->curr_leds > 0)
   {
-    printf("IDLE_START_PAUSE\r\n"); 
+    FSM_LOG0(IDLE_START_PAUSE); 
+    blink_rate_set(p_payload);
     myApp->active_state = BLINK;
     return EVENT_TRANSITION;  
   }
   else
   {
-    printf("IDLE_START_PAUSE\r\n");
-    display_message("EVENT_IGNORED\r\n");
+    FSM_LOG0(IDLE_START_PAUSE);
+    display_message(MSG_EVENT_IGNORED);
     return EVENT_IGNORED;  
   }
 }
 
 event_status_t IDLE_ABRT(app_t *const myApp, event_t const *const e)
 {
-  printf("IDLE_ABRT\r\n");
-  display_message("EVENT_IGNORED\r\n");
+  FSM_LOG0(IDLE_ABRT);
+  display_message(MSG_EVENT_IGNORED);
   return EVENT_IGNORED;
 }
 
 /* LED_SET state events and their functions */
 event_status_t LED_SET_ENTRY(app_t *const myApp, event_t const *const e)
 {
-  printf("LED_SET_ENTRY\r\n");
+  FSM_LOG0(LED_SET_ENTRY);
   display_leds(myApp);
-  display_message("Set Leds");
+  display_message(MSG_SET_LEDS);
   return EVENT_HANDLED;
 }
 
 event_status_t LED_SET_EXIT(app_t *const myApp, event_t const *const e)
 {
-  printf("LED_SET_EXIT\r\n");
+  FSM_LOG0(LED_SET_EXIT);
   display_clear(myApp);
-  display_message("Exit from: LED_SET");        
+  display_message(MSG_EXIT_LED_SET);        
   return EVENT_HANDLED;
 }
 
-event_status_t LED_SET_INC_LED(app_t *const myApp, event_t const *const e)
+FSM_HANDLER(LED_SET, INC_LED)
 {
-  printf("LED_SET_INC_LED\r\n");
-  if(myApp->curr_leds < 4)
+  FSM_LOG0(LED_SET_INC_LED);
+  if(myApp->curr_leds < LED_COUNT)
   {
-    myApp->curr_leds += 1;
+    myApp->curr_leds += fsm_led_step(p_payload, LED_COUNT - myApp->curr_leds);
     display_clear(myApp);
     display_leds(myApp);
     return EVENT_HANDLED;
   }
   else
   {
-    display_message("EVENT_IGNORED\r\n");
+    display_message(MSG_EVENT_IGNORED);
     return EVENT_IGNORED;
   }
 }
 
-event_status_t LED_SET_DEC_LED(app_t *const myApp, event_t const *const e)
+FSM_HANDLER(LED_SET, DEC_LED)
 { 
-  printf("LED_SET_DEC_LED\r\n");
+  FSM_LOG0(LED_SET_DEC_LED);
   if(myApp->curr_leds > 0)
   {
-    myApp->curr_leds -= 1;
+    myApp->curr_leds -= fsm_led_step(p_payload, myApp->curr_leds);
     display_clear(myApp);
     display_leds(myApp);
     return EVENT_HANDLED;
   }
   else
   {
-    display_message("EVENT_IGNORED\r\n");
+    display_message(MSG_EVENT_IGNORED);
     return EVENT_IGNORED;
   }
 }
 
-event_status_t LED_SET_START_PAUSE(app_t *const myApp, event_t const *const e)
+FSM_HANDLER(LED_SET, START_PAUSE)
 {
-  printf("LED_SET_START_PAUSE\r\n");
+  FSM_LOG0(LED_SET_START_PAUSE);
+  blink_rate_set(p_payload);
   myApp->active_state = BLINK;
   return EVENT_TRANSITION;
 }
 
 event_status_t LED_SET_ABRT(app_t *const myApp, event_t const *const e)
 {
-  printf("LED_SET_ABRT\r\n");
+  FSM_LOG0(LED_SET_ABRT);
   myApp->active_state = IDLE;
   return EVENT_TRANSITION;
 }
@@ -209,47 +340,60 @@ event_status_t LED_SET_ABRT(app_t *const myApp, event_t const *const e)
 /* BLINK state events and their functions */
 event_status_t BLINK_ENTRY(app_t *const myApp, event_t const *const e)
 {
-  printf("BLINK_ENTRY\r\n");
+  FSM_LOG0(BLINK_ENTRY);
+#if FSM_HISTORY != FSM_HISTORY_NONE
+  if(myApp->blink_history.enter)
+  {
+    myApp->blink_history.enter = false;
+    if(myApp->blink_history.valid && (myApp->curr_leds > 0))
+    {
+      return history_resume(myApp);
+    }
+  }
+#endif
   if(myApp->curr_leds > 0)
   { 
     display_leds(myApp);
-    display_message("APPLICATION is blinking LEDs\r\n");
-    create_timers(myApp);
+    display_message(MSG_BLINKING);
+    start_timers(myApp);
     return EVENT_TRANSITION;
   }
   else
   {
-    display_message("EVENT_IGNORED\r\n"); 
+    display_message(MSG_EVENT_IGNORED); 
     return EVENT_IGNORED;
   }
 }
 
 event_status_t BLINK_EXIT(app_t *const myApp, event_t const *const e)
 {
-  printf("BLINK_EXIT\r\n");
+  FSM_LOG0(BLINK_EXIT);
+#if FSM_HISTORY != FSM_HISTORY_NONE
+  history_save(myApp);
+#endif
   display_clear(myApp);        
   myApp->active_state = PAUSE;
-  display_message("Exit from: BLINK");
+  display_message(MSG_EXIT_BLINK);
   return EVENT_HANDLED;
 }
 
 event_status_t BLINK_INC_LED(app_t *const myApp, event_t const *const e)
 { 
-  printf("BLINK_INC_LED\r\n");
-  display_message("EVENT_IGNORED\r\n");
+  FSM_LOG0(BLINK_INC_LED);
+  display_message(MSG_EVENT_IGNORED);
   return EVENT_IGNORED;
 }
 
 event_status_t BLINK_DEC_LED(app_t *const myApp, event_t const *const e)
 { 
-  printf("BLINK_DEC_LED\r\n");
-  display_message("EVENT_IGNORED\r\n");
+  FSM_LOG0(BLINK_DEC_LED);
+  display_message(MSG_EVENT_IGNORED);
   return EVENT_IGNORED;
 }
 
 event_status_t BLINK_START_PAUSE(app_t *const myApp, event_t const *const e)
 {
-  printf("BLINK_START_PAUSE\r\n");
+  FSM_LOG0(BLINK_START_PAUSE);
   myApp->active_state = PAUSE;
   return EVENT_TRANSITION;
 }
@@ -258,14 +402,14 @@ event_status_t BLINK_ABRT(app_t *const myApp, event_t const *const e)
 { 
   if(myApp->curr_leds > 0)
   {
-    printf("BLINK_ABRT\r\n");       
+    FSM_LOG0(BLINK_ABRT);       
     stop_timers();
     myApp->active_state = IDLE;
     return EVENT_TRANSITION; 
   }
   else
   {
-    printf("BLINK_ABRT\r\n"); 
+    FSM_LOG0(BLINK_ABRT); 
     myApp->active_state = IDLE;
     return EVENT_TRANSITION; 
   }
@@ -278,45 +422,47 @@ event_status_t PAUSE_ENTRY(app_t *const myApp, event_t const *const e)
 {
   if(myApp->curr_leds > 0)
   {
-    printf("PAUSE_ENTRY\r\n");
+    FSM_LOG0(PAUSE_ENTRY);
     stop_timers();
     display_leds(myApp);
-    display_message("PAUSE Leds");
+    display_message(MSG_PAUSE_LEDS);
     return EVENT_HANDLED;  
   }
   else
   {
-    printf("PAUSE_ENTRY\r\n");
-    display_message("EVENT_IGNORED\r\n");
+    FSM_LOG0(PAUSE_ENTRY);
+    display_message(MSG_EVENT_IGNORED);
     return EVENT_IGNORED;  
   }
 }
 
 event_status_t PAUSE_EXIT(app_t *const myApp, event_t const *const e)
 {
-  printf("PAUSE_EXIT\r\n");
+  FSM_LOG0(PAUSE_EXIT);
   display_clear(myApp); 
-  display_message("Exit from: PAUSE");
+  display_message(MSG_EXIT_PAUSE);
   return EVENT_HANDLED;
 }
 
 event_status_t PAUSE_INC_LED(app_t *const myApp, event_t const *const e)
 { 
-  printf("PAUSE_INC_LED\r\n");
-  display_message("EVENT_IGNORED\r\n");
+  FSM_LOG0(PAUSE_INC_LED);
+  display_message(MSG_EVENT_IGNORED);
   return EVENT_IGNORED;
 }
 
 event_status_t PAUSE_DEC_LED(app_t *const myApp, event_t const *const e)
 {  
-  printf("PAUSE_DEC_LED\r\n");
-  display_message("EVENT_IGNORED\r\n");
+  FSM_LOG0(PAUSE_DEC_LED);
+  display_message(MSG_EVENT_IGNORED);
   return EVENT_IGNORED;
 }
 
-event_status_t PAUSE_START_PAUSE(app_t *const myApp, event_t const *const e)
+FSM_HANDLER(PAUSE, START_PAUSE)
 { 
-  printf("PAUSE_START_PAUSE\r\n");
+  FSM_LOG0(PAUSE_START_PAUSE);
+  blink_rate_set(p_payload);
+  myApp->blink_history.enter = true;   // target is the history pseudostate of BLINK
   myApp->active_state = BLINK;
   return EVENT_TRANSITION;
 }
@@ -326,20 +472,203 @@ event_status_t PAUSE_ABRT(app_t *const myApp, event_t const *const e)
    
   if(myApp->curr_leds > 0)
   { 
-    printf("PAUSE_ABRT\r\n");        
+    FSM_LOG0(PAUSE_ABRT);        
     stop_timers();
     myApp->active_state = IDLE;
     return EVENT_TRANSITION;
   }
   else
   { 
-    printf("PAUSE_ABRT\r\n");   
+    FSM_LOG0(PAUSE_ABRT);   
     myApp->active_state = IDLE;
     return EVENT_TRANSITION;
   }
 }
 
 
+#if FSM_FUSED_TRANSITIONS
+/* Fused transition routines.
+ * Every (source, signal) cell whose handler can return EVENT_TRANSITION has a
+ * statically known target, so the handler, the source EXIT and the target
+ * ENTRY are called directly from one routine and can be inlined into it.
+ * The order is the one fsm_event_dispatcher used: handler, exit, entry.
+ */
+#define FSM_FUSED_TRANSITION(source, signal, target)                                      \
+static event_status_t source##_##signal##_FUSED(app_t *const myApp, event_t const *const e) \
+{                                                                                         \
+  event_t ee;                                                                             \
+  event_status_t status = source##_##signal(myApp, e);                                    \
+  if(status == EVENT_TRANSITION)                                                          \
+  {                                                                                       \
+    ee.sig = EXIT;                                                                        \
+    source##_EXIT(myApp, &ee);                                                            \
+    ee.sig = ENTRY;                                                                       \
+    target##_ENTRY(myApp, &ee);                                                           \
+  }                                                                                       \
+  return status;                                                                          \
+}
+
+#define FSM_FUSED_CELL(source, signal, target)  [source][signal] = true,
+
+#define FSM_FUSED_TRANSITION_LIST(X)  \
+  X(IDLE, INC_LED, LED_SET)           \
+  X(IDLE, DEC_LED, LED_SET)           \
+  X(IDLE, START_PAUSE, BLINK)         \
+  X(LED_SET, START_PAUSE, BLINK)      \
+  X(LED_SET, ABRT, IDLE)              \
+  X(BLINK, START_PAUSE, PAUSE)        \
+  X(BLINK, ABRT, IDLE)                \
+  X(PAUSE, START_PAUSE, BLINK)        \
+  X(PAUSE, ABRT, IDLE)
+
+FSM_FUSED_TRANSITION_LIST(FSM_FUSED_TRANSITION)
+
+bool const fsm_fused_cell[MAX_STATE][MAX_SIGNALS] = {
+  FSM_FUSED_TRANSITION_LIST(FSM_FUSED_CELL)
+};
+
+e_handler_t fsm_fused_state_table[MAX_STATE][MAX_SIGNALS] = {
+  [IDLE] = {&IDLE_ENTRY, &IDLE_EXIT, &IDLE_INC_LED_FUSED, &IDLE_DEC_LED_FUSED, &IDLE_START_PAUSE_FUSED, &IDLE_ABRT},
+  [LED_SET] = {&LED_SET_ENTRY, &LED_SET_EXIT, &LED_SET_INC_LED, &LED_SET_DEC_LED, &LED_SET_START_PAUSE_FUSED, &LED_SET_ABRT_FUSED},
+  [BLINK] = {&BLINK_ENTRY, &BLINK_EXIT, &BLINK_INC_LED, &BLINK_DEC_LED, &BLINK_START_PAUSE_FUSED, &BLINK_ABRT_FUSED},
+  [PAUSE] = {&PAUSE_ENTRY, &PAUSE_EXIT, &PAUSE_INC_LED, &PAUSE_DEC_LED, &PAUSE_START_PAUSE_FUSED, &PAUSE_ABRT_FUSED}
+};
+#endif
+
+
+#if FSM_TRANSITION_RECORDS
+/* Transition records.
+ * The guards that the handlers above test in their bodies are separate
+ * functions here, each branch of a handler is one record with its target.
+ * Handlers without a guard are used as actions as they are, the state they
+ * set is overwritten by the dispatcher with the record's target.
+ */
+static bool has_leds(app_t const *const myApp, event_t const *const e)
+{
+  return myApp->curr_leds > 0;
+}
+
+static bool below_max(app_t const *const myApp, event_t const *const e)
+{
+  return myApp->curr_leds < LED_COUNT;
+}
+
+static event_status_t IDLE_START_PAUSE_TAKEN(app_t *const myApp, event_t const *const e)
+{
+  FSM_LOG0(IDLE_START_PAUSE);
+  blink_rate_set(FSM_EVENT_PAYLOAD(e, START_PAUSE));
+  return EVENT_TRANSITION;
+}
+
+static event_status_t IDLE_START_PAUSE_IGNORED(app_t *const myApp, event_t const *const e)
+{
+  FSM_LOG0(IDLE_START_PAUSE);
+  display_message(MSG_EVENT_IGNORED);
+  return EVENT_IGNORED;
+}
+
+static event_status_t LED_SET_INC_LED_TAKEN(app_t *const myApp, event_t const *const e)
+{
+  FSM_LOG0(LED_SET_INC_LED);
+  myApp->curr_leds += fsm_led_step(FSM_EVENT_PAYLOAD(e, INC_LED), LED_COUNT - myApp->curr_leds);
+  display_clear(myApp);
+  display_leds(myApp);
+  return EVENT_HANDLED;
+}
+
+static event_status_t LED_SET_DEC_LED_TAKEN(app_t *const myApp, event_t const *const e)
+{
+  FSM_LOG0(LED_SET_DEC_LED);
+  myApp->curr_leds -= fsm_led_step(FSM_EVENT_PAYLOAD(e, DEC_LED), myApp->curr_leds);
+  display_clear(myApp);
+  display_leds(myApp);
+  return EVENT_HANDLED;
+}
+
+static event_status_t LED_SET_INC_LED_IGNORED(app_t *const myApp, event_t const *const e)
+{
+  FSM_LOG0(LED_SET_INC_LED);
+  display_message(MSG_EVENT_IGNORED);
+  return EVENT_IGNORED;
+}
+
+static event_status_t LED_SET_DEC_LED_IGNORED(app_t *const myApp, event_t const *const e)
+{
+  FSM_LOG0(LED_SET_DEC_LED);
+  display_message(MSG_EVENT_IGNORED);
+  return EVENT_IGNORED;
+}
+
+static event_status_t BLINK_ABRT_STOP(app_t *const myApp, event_t const *const e)
+{
+  FSM_LOG0(BLINK_ABRT);
+  stop_timers();
+  return EVENT_TRANSITION;
+}
+
+static event_status_t BLINK_ABRT_TAKEN(app_t *const myApp, event_t const *const e)
+{
+  FSM_LOG0(BLINK_ABRT);
+  return EVENT_TRANSITION;
+}
+
+static event_status_t PAUSE_ABRT_STOP(app_t *const myApp, event_t const *const e)
+{
+  FSM_LOG0(PAUSE_ABRT);
+  stop_timers();
+  return EVENT_TRANSITION;
+}
+
+static event_status_t PAUSE_ABRT_TAKEN(app_t *const myApp, event_t const *const e)
+{
+  FSM_LOG0(PAUSE_ABRT);
+  return EVENT_TRANSITION;
+}
+
+static fsm_cell_t const fsm_transition_cells[MAX_STATE][MAX_SIGNALS] = {
+  [IDLE] = {
+    [INC_LED] = FSM_CELL({NULL, &IDLE_INC_LED, LED_SET}),
+    [DEC_LED] = FSM_CELL({NULL, &IDLE_DEC_LED, LED_SET}),
+    [START_PAUSE] = FSM_CELL({&has_leds, &IDLE_START_PAUSE_TAKEN, BLINK},
+                             {NULL, &IDLE_START_PAUSE_IGNORED, FSM_TARGET_IGNORED}),
+    [ABRT] = FSM_CELL({NULL, &IDLE_ABRT, FSM_TARGET_IGNORED})
+  },
+  [LED_SET] = {
+    [INC_LED] = FSM_CELL({&below_max, &LED_SET_INC_LED_TAKEN, FSM_TARGET_INTERNAL},
+                         {NULL, &LED_SET_INC_LED_IGNORED, FSM_TARGET_IGNORED}),
+    [DEC_LED] = FSM_CELL({&has_leds, &LED_SET_DEC_LED_TAKEN, FSM_TARGET_INTERNAL},
+                         {NULL, &LED_SET_DEC_LED_IGNORED, FSM_TARGET_IGNORED}),
+    [START_PAUSE] = FSM_CELL({NULL, &LED_SET_START_PAUSE, BLINK}),
+    [ABRT] = FSM_CELL({NULL, &LED_SET_ABRT, IDLE})
+  },
+  [BLINK] = {
+    [INC_LED] = FSM_CELL({NULL, &BLINK_INC_LED, FSM_TARGET_IGNORED}),
+    [DEC_LED] = FSM_CELL({NULL, &BLINK_DEC_LED, FSM_TARGET_IGNORED}),
+    [START_PAUSE] = FSM_CELL({NULL, &BLINK_START_PAUSE, PAUSE}),
+    [ABRT] = FSM_CELL({&has_leds, &BLINK_ABRT_STOP, IDLE},
+                      {NULL, &BLINK_ABRT_TAKEN, IDLE})
+  },
+  [PAUSE] = {
+    [INC_LED] = FSM_CELL({NULL, &PAUSE_INC_LED, FSM_TARGET_IGNORED}),
+    [DEC_LED] = FSM_CELL({NULL, &PAUSE_DEC_LED, FSM_TARGET_IGNORED}),
+    [START_PAUSE] = FSM_CELL({NULL, &PAUSE_START_PAUSE, BLINK}),
+    [ABRT] = FSM_CELL({&has_leds, &PAUSE_ABRT_STOP, IDLE},
+                      {NULL, &PAUSE_ABRT_TAKEN, IDLE})
+  }
+};
+
+static e_handler_t const fsm_transition_entry[MAX_STATE] = {&IDLE_ENTRY, &LED_SET_ENTRY, &BLINK_ENTRY, &PAUSE_ENTRY};
+static e_handler_t const fsm_transition_exit[MAX_STATE] = {&IDLE_EXIT, &LED_SET_EXIT, &BLINK_EXIT, &PAUSE_EXIT};
+
+fsm_transition_table_t const fsm_transition_table = {
+  .cells = &fsm_transition_cells[0][0],
+  .entry = fsm_transition_entry,
+  .exit = fsm_transition_exit,
+  .num_states = MAX_STATE
+};
+#endif
+
+
 void fsm_init(app_t *myApp)
 {
   event_t ee;
@@ -347,14 +676,17 @@ void fsm_init(app_t *myApp)
   e_handler_t ehandler;
   myApp->active_state = IDLE;
   myApp->curr_leds = 0;
+  myApp->blink_history = (fsm_history_t){0};
+  fsm_persist_restore(myApp); //Resume from the last committed snapshot, if any
   ehandler = (e_handler_t) myApp->state_table[(myApp->active_state * MAX_SIGNALS) + ee.sig];
 
   for(uint8_t i = 0; i<10; i++)
   {
-    bsp_board_leds_on();
-    nrf_delay_ms(50);
-    bsp_board_leds_off();
-    nrf_delay_ms(50);
+    hal_board_leds_on();
+    hal_delay_ms(50);
+    hal_board_leds_off();
+    hal_delay_ms(50);
   }
+  create_timers();
   (*ehandler)(myApp, &ee); //Jump to the handler
 }
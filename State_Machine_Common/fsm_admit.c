@@ -0,0 +1,155 @@
+
+#include "fsm_admit.h"
+#include <string.h>
+
+
+HAL_TIMER_DEF(m_idle_timer_id);     /**< Single shot timer returning quiet sources to idle. */
+
+typedef struct
+{
+  uint8_t pin;
+  bool active;          /* edges seen within FSM_ADMIT_IDLE_MS */
+  uint8_t tokens;
+  uint32_t last_edge;   /* ticks of the latest edge, admitted or merged */
+  uint32_t refilled;    /* ticks up to which tokens have been credited */
+}admit_source_t;
+
+static admit_source_t m_source[FSM_ADMIT_MAX_SOURCES];
+static uint8_t m_count;
+static bool m_idle_armed;
+static fsm_admit_stats_t m_stats;
+
+
+static void idle_timer_start(void)
+{
+  if(!m_idle_armed)
+  {
+    m_idle_armed = true;
+    hal_timer_start(m_idle_timer_id, FSM_ADMIT_IDLE_MS, NULL);
+  }
+}
+
+/**@brief Forget the sources that went quiet.
+ *
+ * @details The tick counter wraps (512 s on target), so timestamps must not be
+ *          compared once a source has been quiet that long. Sources are reset
+ *          here well before that. The timer runs at most once per
+ *          FSM_ADMIT_IDLE_MS however many edges arrive.
+ */
+static void idle_timer_handler(void * p_context)
+{
+  uint32_t now = hal_ticks();
+  bool busy = false;
+
+  (void)p_context;
+  m_idle_armed = false;
+  for(uint8_t i = 0; i < m_count; i++)
+  {
+    admit_source_t *p_src = &m_source[i];
+
+    if(!p_src->active)
+    {
+      continue;
+    }
+    if(hal_ticks_diff(now, p_src->last_edge) >= HAL_TICKS_FROM_MS(FSM_ADMIT_IDLE_MS))
+    {
+      p_src->active = false;
+    }
+    else
+    {
+      busy = true;
+    }
+  }
+  if(busy)
+  {
+    idle_timer_start();
+  }
+}
+
+void fsm_admit_init(uint8_t const *pins, uint8_t count)
+{
+  if(count > FSM_ADMIT_MAX_SOURCES)
+  {
+    count = FSM_ADMIT_MAX_SOURCES;
+  }
+  memset(m_source, 0, sizeof(m_source));
+  memset(&m_stats, 0, sizeof(m_stats));
+  for(uint8_t i = 0; i < count; i++)
+  {
+    m_source[i].pin = pins[i];
+  }
+  m_count = count;
+  hal_timer_create(&m_idle_timer_id, HAL_TIMER_SINGLE_SHOT, idle_timer_handler);
+}
+
+/**@brief Admission stage in front of the dispatcher, called from the edge interrupt.
+ *
+ * @return true if the edge may become an event, false if it was merged or dropped.
+ */
+bool fsm_admit(hal_pin_t pin)
+{
+  uint32_t now = hal_ticks();
+  admit_source_t *p_src = NULL;
+  uint8_t i;
+
+  for(i = 0; i < m_count; i++)
+  {
+    if(m_source[i].pin == pin)
+    {
+      p_src = &m_source[i];
+      break;
+    }
+  }
+  if(p_src == NULL)
+  {
+    return true;   // not a rate limited source
+  }
+
+  if(!p_src->active)
+  {
+    p_src->active = true;
+    p_src->tokens = FSM_ADMIT_BURST;
+    p_src->refilled = now;
+  }
+  else
+  {
+    if(hal_ticks_diff(now, p_src->last_edge) < HAL_TICKS_FROM_MS(FSM_ADMIT_COALESCE_MS))
+    {
+      p_src->last_edge = now;
+      m_stats.source[i].merged++;
+      m_stats.total.merged++;
+      idle_timer_start();
+      return false;
+    }
+
+    uint32_t credit = hal_ticks_diff(now, p_src->refilled) / HAL_TICKS_FROM_MS(FSM_ADMIT_REFILL_MS);
+    if(p_src->tokens + credit >= FSM_ADMIT_BURST)
+    {
+      p_src->tokens = FSM_ADMIT_BURST;
+      p_src->refilled = now;
+    }
+    else
+    {
+      p_src->tokens += credit;
+      p_src->refilled += credit * HAL_TICKS_FROM_MS(FSM_ADMIT_REFILL_MS);
+    }
+  }
+  p_src->last_edge = now;
+  idle_timer_start();
+
+  if(p_src->tokens == 0)
+  {
+    m_stats.source[i].dropped++;
+    m_stats.total.dropped++;
+    return false;
+  }
+  p_src->tokens--;
+  m_stats.source[i].admitted++;
+  m_stats.total.admitted++;
+  return true;
+}
+
+fsm_admit_stats_t const * fsm_admit_stats_get(void)
+{
+  return &m_stats;
+}
@@ -0,0 +1,40 @@
+#ifndef FSM_ADMIT_H
+#define FSM_ADMIT_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+
+#define FSM_ADMIT_MAX_SOURCES   8
+
+/* Repeated edges of one source closer than this to the previous one are
+ * merged into it, the window slides while the contact keeps bouncing */
+#define FSM_ADMIT_COALESCE_MS   30
+
+/* Token bucket per source: bursts of up to BURST events, then one event per REFILL_MS */
+#define FSM_ADMIT_BURST         3
+#define FSM_ADMIT_REFILL_MS     150
+
+/* A source quiet for this long is back to a full bucket */
+#define FSM_ADMIT_IDLE_MS       (FSM_ADMIT_BURST * FSM_ADMIT_REFILL_MS)
+
+typedef struct
+{
+  uint32_t admitted;
+  uint32_t merged;    /* coalesced into the previous edge */
+  uint32_t dropped;   /* over the rate limit */
+}fsm_admit_counters_t;
+
+typedef struct
+{
+  fsm_admit_counters_t total;
+  fsm_admit_counters_t source[FSM_ADMIT_MAX_SOURCES];
+}fsm_admit_stats_t;
+
+
+void fsm_admit_init(uint8_t const *pins, uint8_t count);
+bool fsm_admit(hal_pin_t pin);
+fsm_admit_stats_t const * fsm_admit_stats_get(void);
+
+
+#endif
@@ -0,0 +1,225 @@
+/* Host replay of edge traces through port_input.c and fsm_admit.c.
+ *
+ *   gcc -std=gnu99 -O2 -DHAL_POSIX -DFSM_ADMIT_BENCH -I. fsm_admit_bench.c fsm_admit.c port_input.c \
+ *       hal_posix.c -o fsm_admit_bench
+ *   ./fsm_admit_bench [trace ...]      (default: the traces in traces/)
+ *
+ * Each trace runs in a child process from virtual time 0, the four buttons
+ * of the boards behind fsm_admit() as in main.c. A trace names the counters
+ * it must end with on a "# expect admitted A merged M dropped D" line. Every
+ * press the handler sees must be counted once, per source and in total, and
+ * no source may get more than FSM_ADMIT_BURST + BENCH_WINDOW_MS /
+ * FSM_ADMIT_REFILL_MS (rounded up) presses through in any BENCH_WINDOW_MS:
+ * the dispatch rate the token buckets promise.
+ */
+#if defined(FSM_ADMIT_BENCH)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "fsm_admit.h"
+#include "port_input.h"
+
+#define BENCH_WINDOW_MS       1000
+#define BENCH_RATE_MAX        (FSM_ADMIT_BURST + ((BENCH_WINDOW_MS + FSM_ADMIT_REFILL_MS - 1) / FSM_ADMIT_REFILL_MS))
+#define BENCH_ADMITTED_MAX    1024
+#define BENCH_TAIL_MS         (2 * FSM_ADMIT_IDLE_MS)
+
+static uint8_t const m_pins[] = {11, 12, 24, 25};
+static char const *const m_traces[] = {"traces/s3.txt", "traces/s4.txt", "traces/storm.txt", "traces/hammer.txt"};
+
+typedef struct
+{
+  fsm_admit_stats_t stats;
+  uint32_t presses[sizeof(m_pins)];
+  uint32_t rate_max;          /**< Most presses of one source admitted in a window. */
+  uint32_t ms;
+}run_result_t;
+
+static uint32_t m_admitted_ms[sizeof(m_pins)][BENCH_ADMITTED_MAX];
+static run_result_t m_result;
+
+
+static void in_pin_handler(hal_pin_t pin, hal_edge_t action)
+{
+  uint32_t now_ms = (uint32_t)(hal_posix_time_us() / 1000);
+
+  (void)action;
+  for(uint8_t i = 0; i < sizeof(m_pins); i++)
+  {
+    uint32_t admitted;
+
+    if(m_pins[i] != pin)
+    {
+      continue;
+    }
+    admitted = fsm_admit_stats_get()->source[i].admitted;
+    if(fsm_admit(pin) && (admitted < BENCH_ADMITTED_MAX))
+    {
+      m_admitted_ms[i][admitted] = now_ms;
+    }
+    m_result.presses[i]++;
+  }
+}
+
+/**@brief Most admitted presses of one source in any BENCH_WINDOW_MS.
+ */
+static uint32_t rate_max(uint32_t const *p_ms, uint32_t count)
+{
+  uint32_t max = 0;
+  uint32_t first = 0;
+
+  for(uint32_t last = 0; last < count; last++)
+  {
+    while((p_ms[last] - p_ms[first]) >= BENCH_WINDOW_MS)
+    {
+      first++;
+    }
+    if((last - first + 1) > max)
+    {
+      max = last - first + 1;
+    }
+  }
+  return max;
+}
+
+/**@brief The expected counters and the last step of a trace.
+ *
+ * @return False if the trace has no "# expect" line.
+ */
+static bool trace_scan(char const *p_path, fsm_admit_counters_t *p_expect, uint32_t *p_end_ms)
+{
+  FILE *fp = fopen(p_path, "r");
+  char line[128];
+  bool found = false;
+
+  *p_end_ms = 0;
+  if(fp == NULL)
+  {
+    return false;
+  }
+  while(fgets(line, sizeof(line), fp) != NULL)
+  {
+    unsigned long ms;
+
+    if(sscanf(line, "# expect admitted %u merged %u dropped %u", &p_expect->admitted, &p_expect->merged,
+              &p_expect->dropped) == 3)
+    {
+      found = true;
+    }
+    else if((line[0] != '#') && (sscanf(line, "%lu", &ms) == 1) && (ms > *p_end_ms))
+    {
+      *p_end_ms = (uint32_t)ms;
+    }
+  }
+  fclose(fp);
+  return found;
+}
+
+/**@brief Replay one trace in a child, from virtual time 0.
+ */
+static bool trace_run(char const *p_path, uint32_t end_ms, run_result_t *p_result)
+{
+  int pipe_fd[2];
+  int status;
+  pid_t pid;
+  bool ok;
+
+  if(pipe(pipe_fd) != 0)
+  {
+    return false;
+  }
+  fflush(stdout);
+  pid = fork();
+  if(pid == 0)
+  {
+    close(pipe_fd[0]);
+    hal_init();
+    if(hal_posix_script_load(p_path) < 0)
+    {
+      _exit(1);
+    }
+    fsm_admit_init(m_pins, sizeof(m_pins));
+    port_input_init(m_pins, sizeof(m_pins), in_pin_handler);
+    hal_posix_run_until((uint64_t)(end_ms + BENCH_TAIL_MS) * 1000);
+    m_result.stats = *fsm_admit_stats_get();
+    m_result.ms = end_ms;
+    for(uint8_t i = 0; i < sizeof(m_pins); i++)
+    {
+      uint32_t n = m_result.stats.source[i].admitted;
+      uint32_t rate = rate_max(m_admitted_ms[i], (n < BENCH_ADMITTED_MAX) ? n : BENCH_ADMITTED_MAX);
+
+      m_result.rate_max = (rate > m_result.rate_max) ? rate : m_result.rate_max;
+    }
+    _exit((write(pipe_fd[1], &m_result, sizeof(m_result)) == sizeof(m_result)) ? 0 : 1);
+  }
+  close(pipe_fd[1]);
+  ok = (read(pipe_fd[0], p_result, sizeof(*p_result)) == sizeof(*p_result));
+  close(pipe_fd[0]);
+  waitpid(pid, &status, 0);
+  return ok && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+}
+
+static bool counters_add_up(run_result_t const *p_result)
+{
+  fsm_admit_counters_t sum = {0};
+  uint32_t presses = 0;
+
+  for(uint8_t i = 0; i < sizeof(m_pins); i++)
+  {
+    fsm_admit_counters_t const *p_src = &p_result->stats.source[i];
+
+    if((p_src->admitted + p_src->merged + p_src->dropped) != p_result->presses[i])
+    {
+      return false;
+    }
+    sum.admitted += p_src->admitted;
+    sum.merged += p_src->merged;
+    sum.dropped += p_src->dropped;
+    presses += p_result->presses[i];
+  }
+  return (memcmp(&sum, &p_result->stats.total, sizeof(sum)) == 0) &&
+         ((sum.admitted + sum.merged + sum.dropped) == presses);
+}
+
+int main(int argc, char **argv)
+{
+  char const *const *p_paths = (argc > 1) ? (char const *const *)&argv[1] : m_traces;
+  int count = (argc > 1) ? (argc - 1) : (int)(sizeof(m_traces) / sizeof(m_traces[0]));
+  bool pass = true;
+
+  printf("coalesce %u ms, burst %u, refill %u ms: at most %u presses of a source in %u ms\n", FSM_ADMIT_COALESCE_MS,
+         FSM_ADMIT_BURST, FSM_ADMIT_REFILL_MS, BENCH_RATE_MAX, BENCH_WINDOW_MS);
+  printf("  %-20s %8s %8s %8s %8s %8s %10s  %s\n", "trace", "ms", "presses", "admitted", "merged", "dropped",
+         "max/window", "expected a/m/d");
+  for(int t = 0; t < count; t++)
+  {
+    fsm_admit_counters_t expect;
+    run_result_t result = {0};
+    uint32_t end_ms;
+    uint32_t presses = 0;
+    bool ok;
+
+    if(!trace_scan(p_paths[t], &expect, &end_ms) || !trace_run(p_paths[t], end_ms, &result))
+    {
+      printf("  %-20s no \"# expect\" line, or it did not run\n", p_paths[t]);
+      pass = false;
+      continue;
+    }
+    for(uint8_t i = 0; i < sizeof(m_pins); i++)
+    {
+      presses += result.presses[i];
+    }
+    ok = (memcmp(&expect, &result.stats.total, sizeof(expect)) == 0) && counters_add_up(&result) &&
+         (result.rate_max <= BENCH_RATE_MAX);
+    printf("  %-20s %8u %8u %8u %8u %8u %10u  %u/%u/%u %s\n", p_paths[t], result.ms, presses,
+           result.stats.total.admitted, result.stats.total.merged, result.stats.total.dropped, result.rate_max,
+           expect.admitted, expect.merged, expect.dropped, ok ? "ok" : "WRONG");
+    pass = pass && ok;
+  }
+  printf("%s\n", pass ? "ok" : "FAIL");
+  return pass ? 0 : 1;
+}
+
+#endif /* FSM_ADMIT_BENCH */
@@ -0,0 +1,425 @@
+#ifndef HAL_H
+#define HAL_H
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Thin hardware layer under the state machines.
+ *
+ * Target build: static inline wrappers of the nRF5 SDK, they compile to the
+ * same code as calling the SDK directly.
+ * Host build (-DHAL_POSIX): hal_posix.c, virtual GPIO and virtual time so
+ * every variant runs as a Linux process. From a project directory:
+ *   gcc -std=gnu99 -DHAL_POSIX -I. -I../State_Machine_Common *.c \
+ *       ../State_Machine_Common/[a-z]*.c -o state_machine
+ *
+ * This directory is shared by all six projects, each one has it on its
+ * include path and lists the files it uses in its SES project.
+ */
+
+typedef uint32_t hal_pin_t;
+
+typedef void (*hal_timer_handler_t)(void *p_context);
+typedef void (*hal_port_event_handler_t)(void);
+typedef void (*hal_compare_handler_t)(void);
+typedef void (*hal_swi_handler_t)(void);
+
+/* Pin level that sets the pin's DETECT/LATCH bit */
+typedef enum
+{
+  HAL_SENSE_NONE,
+  HAL_SENSE_LOW,
+  HAL_SENSE_HIGH
+}hal_sense_t;
+
+typedef enum
+{
+  HAL_TIMER_SINGLE_SHOT,
+  HAL_TIMER_REPEATED
+}hal_timer_mode_t;
+
+
+#if !defined(HAL_POSIX)
+
+#include "sdk_config.h"
+#include "nrf_gpio.h"
+#include "nrf_delay.h"
+#include "boards.h"
+#include "app_error.h"
+
+#if defined(NRF_P1)
+#define HAL_GPIO_PORTS    2
+#else
+#define HAL_GPIO_PORTS    1
+#endif
+
+#if defined(GPIOTE_ENABLED) && GPIOTE_ENABLED
+#define HAL_INPUT_ENABLED 1
+#include "nrf_drv_gpiote.h"
+#else
+#define HAL_INPUT_ENABLED 0
+#endif
+
+#if defined(APP_TIMER_ENABLED) && APP_TIMER_ENABLED
+#define HAL_TIMER_ENABLED 1
+#include "app_timer.h"
+#include "nrf_drv_clock.h"
+#else
+#define HAL_TIMER_ENABLED 0
+#endif
+
+
+static inline void hal_gpio_cfg_output(uint32_t pin)
+{
+  nrf_gpio_cfg_output(pin);
+}
+
+/**@brief Output that drives low and floats when set (S0D1), e.g. a matrix row.
+ */
+static inline void hal_gpio_cfg_output_od(uint32_t pin)
+{
+  nrf_gpio_cfg(pin, NRF_GPIO_PIN_DIR_OUTPUT, NRF_GPIO_PIN_INPUT_DISCONNECT, NRF_GPIO_PIN_NOPULL,
+               NRF_GPIO_PIN_S0D1, NRF_GPIO_PIN_NOSENSE);
+}
+
+static inline void hal_gpio_cfg_input_pullup(uint32_t pin)
+{
+  nrf_gpio_cfg_input(pin, NRF_GPIO_PIN_PULLUP);
+}
+
+static inline void hal_gpio_set(uint32_t pin)
+{
+  nrf_gpio_pin_set(pin);
+}
+
+static inline void hal_gpio_clear(uint32_t pin)
+{
+  nrf_gpio_pin_clear(pin);
+}
+
+static inline void hal_gpio_toggle(uint32_t pin)
+{
+  nrf_gpio_pin_toggle(pin);
+}
+
+static inline bool hal_gpio_read(uint32_t pin)
+{
+  return nrf_gpio_pin_read(pin) != 0;
+}
+
+static inline NRF_GPIO_Type * hal_gpio_port_reg(uint8_t port)
+{
+#if (HAL_GPIO_PORTS > 1)
+  return (port == 0) ? NRF_P0 : NRF_P1;
+#else
+  (void)port;
+  return NRF_P0;
+#endif
+}
+
+static inline void hal_gpio_port_set(uint8_t port, uint32_t mask)
+{
+  nrf_gpio_port_out_set(hal_gpio_port_reg(port), mask);
+}
+
+static inline void hal_gpio_port_clear(uint8_t port, uint32_t mask)
+{
+  nrf_gpio_port_out_clear(hal_gpio_port_reg(port), mask);
+}
+
+static inline uint32_t hal_gpio_port_read(uint8_t port)
+{
+  return nrf_gpio_port_in_read(hal_gpio_port_reg(port));
+}
+
+static inline void hal_gpio_sense_set(uint32_t pin, hal_sense_t sense)
+{
+  nrf_gpio_cfg_sense_set(pin, (sense == HAL_SENSE_LOW)  ? NRF_GPIO_PIN_SENSE_LOW :
+                              (sense == HAL_SENSE_HIGH) ? NRF_GPIO_PIN_SENSE_HIGH :
+                                                          NRF_GPIO_PIN_NOSENSE);
+}
+
+/**@brief DETECT follows LATCH, so no sensed change is lost while pins are serviced.
+ */
+static inline void hal_gpio_detect_latched(uint8_t port)
+{
+  hal_gpio_port_reg(port)->DETECTMODE = GPIO_DETECTMODE_DETECTMODE_LDETECT;
+}
+
+static inline uint32_t hal_gpio_latch_read(uint8_t port)
+{
+  return hal_gpio_port_reg(port)->LATCH;
+}
+
+static inline void hal_gpio_latch_clear(uint8_t port, uint32_t mask)
+{
+  hal_gpio_port_reg(port)->LATCH = mask;
+}
+
+/* Edge capture: GPIOTE IN channel n (both edges) -> PPI channel n ->
+ * TIMER3 CAPTURE[n], the PPI fork disables channel group n = {channel n}.
+ * The CC register keeps the first edge after hal_capture_arm(), later edges
+ * find the channel disabled. TIMER3 runs at 1 MHz, 32 bit, from HFCLK. */
+#define HAL_CAPTURE_CHANNELS    4
+#define HAL_CAPTURE_NOW_CC      5       /* software capture, CC[4] is left free */
+
+static inline void hal_capture_init(void)
+{
+  NRF_TIMER3->MODE = TIMER_MODE_MODE_Timer;
+  NRF_TIMER3->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  NRF_TIMER3->PRESCALER = 4;            // 16 MHz / 2^4
+  NRF_TIMER3->TASKS_CLEAR = 1;
+  NRF_TIMER3->TASKS_START = 1;
+}
+
+static inline void hal_capture_pin(uint8_t channel, hal_pin_t pin)
+{
+  NRF_GPIOTE->CONFIG[channel] = (GPIOTE_CONFIG_MODE_Event << GPIOTE_CONFIG_MODE_Pos) |
+                                (pin << GPIOTE_CONFIG_PSEL_Pos) |   // bit 5 of pin lands on PORT
+                                (GPIOTE_CONFIG_POLARITY_Toggle << GPIOTE_CONFIG_POLARITY_Pos);
+  NRF_PPI->CH[channel].EEP = (uint32_t)&NRF_GPIOTE->EVENTS_IN[channel];
+  NRF_PPI->CH[channel].TEP = (uint32_t)&NRF_TIMER3->TASKS_CAPTURE[channel];
+  NRF_PPI->FORK[channel].TEP = (uint32_t)&NRF_PPI->TASKS_CHG[channel].DIS;
+  NRF_PPI->CHG[channel] = 1UL << channel;
+}
+
+/**@brief Capture the next edge of the channel's pin.
+ */
+static inline void hal_capture_arm(uint8_t channel)
+{
+  NRF_PPI->TASKS_CHG[channel].EN = 1;
+}
+
+/**@brief True once an edge was captured since the channel was armed.
+ */
+static inline bool hal_capture_taken(uint8_t channel)
+{
+  return (NRF_PPI->CHEN & (1UL << channel)) == 0;
+}
+
+static inline uint32_t hal_capture_read(uint8_t channel)
+{
+  return NRF_TIMER3->CC[channel];
+}
+
+/**@brief Capture clock now, same timebase as hal_capture_read().
+ */
+static inline uint32_t hal_capture_now(void)
+{
+  NRF_TIMER3->TASKS_CAPTURE[HAL_CAPTURE_NOW_CC] = 1;
+  return NRF_TIMER3->CC[HAL_CAPTURE_NOW_CC];
+}
+
+static inline void hal_delay_ms(uint32_t ms)
+{
+  nrf_delay_ms(ms);
+}
+
+static inline void hal_delay_us(uint32_t us)
+{
+  nrf_delay_us(us);
+}
+
+static inline void hal_board_leds_on(void)
+{
+  bsp_board_leds_on();
+}
+
+static inline void hal_board_leds_off(void)
+{
+  bsp_board_leds_off();
+}
+
+/**@brief Board LEDs, and the LFCLK plus RTC1 behind the application timer.
+ */
+static inline void hal_init(void)
+{
+  bsp_board_init(BSP_INIT_LEDS);
+#if HAL_TIMER_ENABLED
+  ret_code_t err_code = nrf_drv_clock_init();
+  APP_ERROR_CHECK(err_code);
+  nrf_drv_clock_lfclk_request(NULL);
+  err_code = app_timer_init();
+  APP_ERROR_CHECK(err_code);
+#endif
+}
+
+/**@brief Body of the main loop, everything else runs from interrupts.
+ */
+static inline void hal_idle(void)
+{
+  // Do nothing.
+}
+
+
+#if HAL_INPUT_ENABLED
+typedef nrf_gpiote_polarity_t hal_edge_t;
+typedef void (*hal_input_handler_t)(hal_pin_t pin, hal_edge_t edge);
+
+/**@brief Pulled-up buttons, handler called from the GPIOTE interrupt on a falling edge.
+ */
+static inline void hal_input_init(uint8_t const *pins, uint8_t count, hal_input_handler_t handler)
+{
+  ret_code_t err_code;
+  nrf_drv_gpiote_in_config_t in_config = GPIOTE_CONFIG_IN_SENSE_HITOLO(true);
+
+  in_config.pull = NRF_GPIO_PIN_PULLUP;
+  if(!nrf_drv_gpiote_is_init())
+  {
+    err_code = nrf_drv_gpiote_init();
+    APP_ERROR_CHECK(err_code);
+  }
+  for(uint8_t i = 0; i < count; i++)
+  {
+    err_code = nrf_drv_gpiote_in_init(pins[i], &in_config, handler);
+    APP_ERROR_CHECK(err_code);
+    nrf_drv_gpiote_in_event_enable(pins[i], true);
+  }
+}
+#else
+/* same values as nrf_gpiote_polarity_t */
+typedef enum
+{
+  HAL_EDGE_LOTOHI = 1,
+  HAL_EDGE_HITOLO = 2,
+  HAL_EDGE_TOGGLE = 3
+}hal_edge_t;
+
+typedef void (*hal_input_handler_t)(hal_pin_t pin, hal_edge_t edge);
+#endif
+
+
+#if HAL_TIMER_ENABLED
+typedef app_timer_id_t hal_timer_t;
+
+#define HAL_TIMER_DEF(timer_id) APP_TIMER_DEF(timer_id)
+
+static inline void hal_timer_create(hal_timer_t const *p_timer, hal_timer_mode_t mode, hal_timer_handler_t handler)
+{
+  ret_code_t err_code = app_timer_create(p_timer,
+                                         (mode == HAL_TIMER_REPEATED) ? APP_TIMER_MODE_REPEATED : APP_TIMER_MODE_SINGLE_SHOT,
+                                         handler);
+  APP_ERROR_CHECK(err_code);
+}
+
+static inline void hal_timer_start(hal_timer_t timer, uint32_t ms, void *p_context)
+{
+  ret_code_t err_code = app_timer_start(timer, APP_TIMER_TICKS(ms), p_context);
+  APP_ERROR_CHECK(err_code);
+}
+
+static inline void hal_timer_stop(hal_timer_t timer)
+{
+  ret_code_t err_code = app_timer_stop(timer);
+  APP_ERROR_CHECK(err_code);
+}
+
+/* Free running tick counter, the RTC behind the application timer. It wraps
+ * after 2^24 ticks (512 s), differences are only valid below that. */
+#define HAL_TICKS_FROM_MS(ms)   APP_TIMER_TICKS(ms)
+#define HAL_MS_FROM_TICKS(t)    ((uint32_t)(((uint64_t)(t) * 1000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)) / APP_TIMER_CLOCK_FREQ))
+
+static inline uint32_t hal_ticks(void)
+{
+  return app_timer_cnt_get();
+}
+
+static inline uint32_t hal_ticks_diff(uint32_t now, uint32_t then)
+{
+  return app_timer_cnt_diff_compute(now, then);
+}
+#endif
+
+
+#else /* HAL_POSIX */
+
+#define HAL_GPIO_PORTS      2
+#define HAL_INPUT_ENABLED   1
+#define HAL_TIMER_ENABLED   1
+
+/* same values as nrf_gpiote_polarity_t */
+typedef enum
+{
+  HAL_EDGE_LOTOHI = 1,
+  HAL_EDGE_HITOLO = 2,
+  HAL_EDGE_TOGGLE = 3
+}hal_edge_t;
+
+typedef void (*hal_input_handler_t)(hal_pin_t pin, hal_edge_t edge);
+
+struct hal_timer_s
+{
+  hal_timer_mode_t mode;
+  hal_timer_handler_t handler;
+  void *p_context;
+  uint64_t deadline_us;
+  uint32_t period_us;
+  bool active;
+  bool linked;
+  struct hal_timer_s *p_next;
+};
+
+typedef struct hal_timer_s * hal_timer_t;
+
+#define HAL_TIMER_DEF(timer_id)                                              \
+  static struct hal_timer_s timer_id##_data;                                 \
+  static __attribute__((unused)) hal_timer_t const timer_id = &timer_id##_data
+
+/* capture clock is microseconds of virtual time, like TIMER3 at 1 MHz */
+#define HAL_CAPTURE_CHANNELS    4
+
+/* ticks are microseconds of virtual time */
+#define HAL_TICKS_FROM_MS(ms)   ((uint32_t)(ms) * 1000)
+#define HAL_MS_FROM_TICKS(t)    ((uint32_t)(t) / 1000)
+
+void hal_gpio_cfg_output(uint32_t pin);
+void hal_gpio_cfg_output_od(uint32_t pin);
+void hal_gpio_cfg_input_pullup(uint32_t pin);
+void hal_gpio_set(uint32_t pin);
+void hal_gpio_clear(uint32_t pin);
+void hal_gpio_toggle(uint32_t pin);
+bool hal_gpio_read(uint32_t pin);
+void hal_gpio_port_set(uint8_t port, uint32_t mask);
+void hal_gpio_port_clear(uint8_t port, uint32_t mask);
+uint32_t hal_gpio_port_read(uint8_t port);
+void hal_gpio_sense_set(uint32_t pin, hal_sense_t sense);
+void hal_gpio_detect_latched(uint8_t port);
+uint32_t hal_gpio_latch_read(uint8_t port);
+void hal_gpio_latch_clear(uint8_t port, uint32_t mask);
+void hal_capture_init(void);
+void hal_capture_pin(uint8_t channel, hal_pin_t pin);
+void hal_capture_arm(uint8_t channel);
+bool hal_capture_taken(uint8_t channel);
+uint32_t hal_capture_read(uint8_t channel);
+uint32_t hal_capture_now(void);
+void hal_delay_ms(uint32_t ms);
+void hal_delay_us(uint32_t us);
+void hal_board_leds_on(void);
+void hal_board_leds_off(void);
+void hal_init(void);
+void hal_idle(void);
+void hal_input_init(uint8_t const *pins, uint8_t count, hal_input_handler_t handler);
+void hal_timer_create(hal_timer_t const *p_timer, hal_timer_mode_t mode, hal_timer_handler_t handler);
+void hal_timer_start(hal_timer_t timer, uint32_t ms, void *p_context);
+void hal_timer_stop(hal_timer_t timer);
+uint32_t hal_ticks(void);
+uint32_t hal_ticks_diff(uint32_t now, uint32_t then);
+
+/* Host side controls, used by scripts and regression tests */
+void hal_posix_input_set(uint32_t pin, bool level);
+bool hal_posix_output_get(uint32_t pin);
+void hal_posix_key_set(uint32_t row_pin, uint32_t col_pin, bool pressed);
+uint32_t hal_posix_shorts(void);
+uint64_t hal_posix_time_us(void);
+void hal_posix_run_until(uint64_t time_us);
+void hal_posix_realtime_set(bool realtime);
+int hal_posix_script_load(char const *path);
+void hal_posix_port_event_set(hal_port_event_handler_t handler);
+void hal_posix_compare_set(uint32_t ticks, hal_compare_handler_t handler);
+void hal_posix_compare_stop(void);
+void hal_posix_swi_set(hal_swi_handler_t handler);
+void hal_posix_swi_pend(void);
+
+#endif /* HAL_POSIX */
+
+
+#endif
@@ -0,0 +1,887 @@
+
+/* Host implementation of hal.h, built with -DHAL_POSIX instead of the SDK.
+ *
+ * GPIO is a pair of 64 bit registers (P0 in the low word, P1 in the high word).
+ * Time is virtual: delays and waits jump straight to the next scheduled event,
+ * so a 20 s blink takes microseconds. With HAL_REALTIME=1 time follows the
+ * monotonic clock instead, timers wait on a timerfd and "pin level" lines read
+ * from stdin drive the buttons.
+ *
+ * Environment:
+ *   HAL_SCRIPT=file   input script, one "time_ms pin level" step per line
+ *   HAL_END_MS=n      stop at n ms (default: last step + HAL_POSIX_TAIL_MS)
+ *   HAL_REALTIME=1    follow the wall clock and read stdin
+ *   HAL_TRACE=1       print every output pin change on stderr
+ *
+ * Handlers run one at a time like interrupts of one priority: an edge or a
+ * timer that falls due while a handler is running (blocked in a delay) is
+ * taken once it returns.
+ *
+ * Pin sensing follows the nRF52840 GPIO: a pin whose level matches its sense
+ * setting sets its LATCH bit, writing 1 clears the bit unless the level still
+ * matches. In LDETECT mode DETECT is high while any LATCH bit is set, else it
+ * follows the live sense matches. A rising DETECT, or LATCH bits left over
+ * after a clear, raise the PORT event.
+ */
+#define _GNU_SOURCE
+#include "hal.h"
+
+#if defined(HAL_POSIX)
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+
+#define HAL_POSIX_PINS        64
+#define HAL_POSIX_POLL_US     1       /* virtual time spent by one input read */
+#define HAL_POSIX_TAIL_MS     1000    /* run on after the last scripted step */
+#define HAL_POSIX_LINE_LEN    64
+#define HAL_POSIX_KEYS        64      /* pressed keys of a matrix, see hal_posix_key_set */
+
+/* PCA10056 LEDs, active low */
+static uint8_t const m_board_leds[] = {13, 14, 15, 16};
+
+typedef struct
+{
+  uint64_t time_us;
+  uint8_t pin;
+  bool level;
+}script_step_t;
+
+static uint64_t m_now_us;
+static uint64_t m_end_us = UINT64_MAX;
+
+static uint64_t m_out;
+static uint64_t m_in = UINT64_MAX;    // pulled up, buttons released
+static uint64_t m_dir;                // set: output
+static uint64_t m_od;                 // outputs that float when set (S0D1)
+static uint64_t m_keys[HAL_POSIX_KEYS];   // pressed matrix keys, the two pins each one joins
+static uint8_t m_key_count;
+static uint32_t m_shorts;             // reads with a pin driven high joined to one driven low
+static uint64_t m_sense;              // falling edge detection enabled
+static uint64_t m_pending;            // edges waiting for the handler
+static hal_input_handler_t m_input_handler;
+
+static uint64_t m_sense_low;          // DETECT/LATCH sense, low level
+static uint64_t m_sense_high;         // DETECT/LATCH sense, high level
+static uint64_t m_latch;
+static bool m_ldetect[HAL_GPIO_PORTS];
+static bool m_detect;
+static bool m_port_pending;           // PORT event waiting for the handler
+static hal_port_event_handler_t m_port_handler;
+static bool m_swi_pending;            // software interrupt, runs after the pending edges
+static hal_swi_handler_t m_swi_handler;
+
+static uint8_t m_capture_pin[HAL_CAPTURE_CHANNELS];
+static uint8_t m_capture_armed;       // bit n: channel n takes the next edge
+static uint32_t m_capture_cc[HAL_CAPTURE_CHANNELS];
+
+static struct hal_timer_s *m_timers;
+static struct hal_timer_s m_compare;  // compare channel, a single shot timer on the hal_ticks counter
+static hal_compare_handler_t m_compare_handler;
+static unsigned m_isr_depth;
+
+static script_step_t *m_script;
+static size_t m_script_len;
+static size_t m_script_pos;
+
+static bool m_realtime;
+static bool m_trace;
+static bool m_stdin_open;
+static int m_epoll_fd = -1;
+static int m_timer_fd = -1;
+static struct timespec m_epoch;
+static char m_line[HAL_POSIX_LINE_LEN];
+static size_t m_line_len;
+
+
+static uint64_t bit(uint32_t pin)
+{
+  return 1ULL << (pin & (HAL_POSIX_PINS - 1));
+}
+
+static void pin_write(uint32_t pin, bool level)
+{
+  uint64_t old = m_out;
+
+  m_out = level ? (m_out | bit(pin)) : (m_out & ~bit(pin));
+  if(m_trace && (old != m_out))
+  {
+    fprintf(stderr, "%llu.%06llu P%u.%02u=%d\n",
+            (unsigned long long)(m_now_us / 1000000), (unsigned long long)(m_now_us % 1000000),
+            pin >> 5, pin & 0x1F, level);
+  }
+}
+
+/**@brief Levels the pins read: inputs follow the script, outputs what they
+ *        drive, and a pressed matrix key joins its row and column.
+ *
+ * @details A group of pins joined by pressed keys reads low when one of
+ *          them is driven low. If another one is driven high at the same
+ *          time (a push-pull row set while its neighbour is scanned), the
+ *          outputs fight: the read is counted in hal_posix_shorts().
+ */
+static uint64_t pin_levels(void)
+{
+  uint64_t level = (m_in & ~m_dir) | (m_out & m_dir);
+  uint64_t low = m_dir & ~m_out;
+  uint64_t high = m_dir & m_out & ~m_od;
+  bool shorted = false;
+
+  for(uint8_t i = 0; i < m_key_count; i++)
+  {
+    uint64_t group = m_keys[i];
+    uint64_t grown;
+
+    do
+    {
+      grown = group;
+      for(uint8_t k = 0; k < m_key_count; k++)
+      {
+        group |= (m_keys[k] & group) ? m_keys[k] : 0;
+      }
+    }while(group != grown);
+
+    if(group & low)
+    {
+      level &= ~group;
+      shorted |= (group & high) != 0;
+    }
+  }
+  m_shorts += shorted;
+  return level;
+}
+
+/**@brief Run latched edges, then a pended software interrupt, unless a handler is already running.
+ */
+static void irq_run(void)
+{
+  if(m_isr_depth > 0)
+  {
+    return;
+  }
+  m_isr_depth++;
+  while(m_pending || m_port_pending || m_swi_pending)
+  {
+    if(m_port_pending)
+    {
+      m_port_pending = false;
+      m_port_handler();
+      continue;
+    }
+    if(m_pending == 0)
+    {
+      m_swi_pending = false;
+      m_swi_handler();
+      continue;
+    }
+    uint32_t pin = (uint32_t)__builtin_ctzll(m_pending);
+    m_pending &= ~bit(pin);
+    m_input_handler(pin, HAL_EDGE_HITOLO);
+  }
+  m_isr_depth--;
+}
+
+/**@brief Latch the pins matching their sense level and raise the PORT event on a rising DETECT.
+ */
+static void detect_update(void)
+{
+  uint64_t match = ((m_sense_low & ~m_in) | (m_sense_high & m_in)) & ~m_dir;
+  bool detect = false;
+
+  m_latch |= match;
+  for(uint8_t port = 0; port < HAL_GPIO_PORTS; port++)
+  {
+    uint32_t word = (uint32_t)((m_ldetect[port] ? m_latch : match) >> (port * 32));
+    detect = detect || (word != 0);
+  }
+  if(detect && !m_detect && (m_port_handler != NULL))
+  {
+    m_port_pending = true;
+  }
+  m_detect = detect;
+}
+
+static void input_apply(uint32_t pin, bool level)
+{
+  bool old = (m_in & bit(pin)) != 0;
+
+  m_in = level ? (m_in | bit(pin)) : (m_in & ~bit(pin));
+  for(uint8_t ch = 0; (ch < HAL_CAPTURE_CHANNELS) && (old != level); ch++)
+  {
+    // the PPI path, stamped at the edge whatever the CPU is doing
+    if((m_capture_armed & (1U << ch)) && (m_capture_pin[ch] == pin))
+    {
+      m_capture_cc[ch] = (uint32_t)m_now_us;
+      m_capture_armed &= ~(1U << ch);
+    }
+  }
+  if(old && !level && (m_sense & bit(pin)) && (m_input_handler != NULL))
+  {
+    m_pending |= bit(pin);
+  }
+  detect_update();
+  irq_run();
+}
+
+/**@brief Time of the next thing that can happen, UINT64_MAX if nothing is scheduled.
+ *
+ * @details Inside a handler only scripted inputs count, timers and other
+ *          edges wait for the handler to return.
+ */
+static uint64_t next_event_us(void)
+{
+  uint64_t t = UINT64_MAX;
+
+  if(m_script_pos < m_script_len)
+  {
+    t = m_script[m_script_pos].time_us;
+  }
+  if(m_isr_depth == 0)
+  {
+    if(m_pending || m_port_pending || m_swi_pending)
+    {
+      return m_now_us;
+    }
+    for(struct hal_timer_s *p = m_timers; p != NULL; p = p->p_next)
+    {
+      if(p->active && (p->deadline_us < t))
+      {
+        t = p->deadline_us;
+      }
+    }
+  }
+  return t;
+}
+
+static void events_run(void)
+{
+  while((m_script_pos < m_script_len) && (m_script[m_script_pos].time_us <= m_now_us))
+  {
+    script_step_t const *p_step = &m_script[m_script_pos++];   // handlers may run the script further
+    input_apply(p_step->pin, p_step->level);
+  }
+  if(m_isr_depth > 0)
+  {
+    return;
+  }
+  irq_run();
+
+  while(true)
+  {
+    struct hal_timer_s *p_due = NULL;
+
+    for(struct hal_timer_s *p = m_timers; p != NULL; p = p->p_next)
+    {
+      if(p->active && (p->deadline_us <= m_now_us) &&
+         ((p_due == NULL) || (p->deadline_us < p_due->deadline_us)))
+      {
+        p_due = p;
+      }
+    }
+    if(p_due == NULL)
+    {
+      break;
+    }
+    if(p_due->mode == HAL_TIMER_REPEATED)
+    {
+      p_due->deadline_us += p_due->period_us;
+    }
+    else
+    {
+      p_due->active = false;
+    }
+    m_isr_depth++;
+    p_due->handler(p_due->p_context);
+    m_isr_depth--;
+    irq_run();
+  }
+}
+
+static uint64_t real_now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)(ts.tv_sec - m_epoch.tv_sec) * 1000000) + (ts.tv_nsec - m_epoch.tv_nsec) / 1000;
+}
+
+/**@brief Apply the complete "pin level" lines waiting on stdin.
+ */
+static void stdin_process(void)
+{
+  char c;
+  ssize_t n;
+
+  while((n = read(STDIN_FILENO, &c, 1)) == 1)
+  {
+    if(c != '\n')
+    {
+      if(m_line_len < sizeof(m_line) - 1)
+      {
+        m_line[m_line_len++] = c;
+      }
+      continue;
+    }
+    m_line[m_line_len] = '\0';
+    m_line_len = 0;
+
+    unsigned pin, level;
+    if(sscanf(m_line, "%u %u", &pin, &level) == 2)
+    {
+      uint64_t now = real_now_us();
+      if(now > m_now_us)
+      {
+        m_now_us = now;
+      }
+      input_apply(pin, level != 0);
+    }
+  }
+  if(n == 0)
+  {
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+    m_stdin_open = false;
+  }
+}
+
+/**@brief Sleep until virtual time until_us, serving stdin meanwhile.
+ *
+ * @details With until_us == UINT64_MAX return after the first stdin input.
+ */
+static void realtime_wait(uint64_t until_us)
+{
+  struct itimerspec its;
+
+  memset(&its, 0, sizeof(its));
+  if(until_us != UINT64_MAX)
+  {
+    uint64_t ns = (uint64_t)m_epoch.tv_nsec + ((until_us % 1000000) * 1000);
+    its.it_value.tv_sec = m_epoch.tv_sec + (time_t)(until_us / 1000000) + (time_t)(ns / 1000000000);
+    its.it_value.tv_nsec = (long)(ns % 1000000000);
+  }
+  timerfd_settime(m_timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+
+  while((until_us == UINT64_MAX) || (real_now_us() < until_us))
+  {
+    struct epoll_event ev;
+    int n = epoll_wait(m_epoll_fd, &ev, 1, -1);
+
+    if(n < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      break;
+    }
+    if(ev.data.fd == m_timer_fd)
+    {
+      uint64_t expirations;
+      (void)read(m_timer_fd, &expirations, sizeof(expirations));
+      break;
+    }
+    stdin_process();
+    if(until_us == UINT64_MAX)
+    {
+      break;
+    }
+  }
+}
+
+static void advance(uint64_t target_us)
+{
+  while(true)
+  {
+    uint64_t t = next_event_us();
+
+    if(t > target_us)
+    {
+      t = target_us;
+    }
+    if(m_realtime)
+    {
+      realtime_wait(t);
+    }
+    if(t > m_now_us)
+    {
+      m_now_us = t;
+    }
+    events_run();
+    if(m_now_us >= target_us)
+    {
+      break;
+    }
+  }
+}
+
+/**@brief The run is over once nothing can happen any more, or at the end time.
+ */
+static void exit_if_done(void)
+{
+  if(m_realtime && m_stdin_open)
+  {
+    return;
+  }
+  if((m_now_us >= m_end_us) || (next_event_us() == UINT64_MAX))
+  {
+    fflush(stdout);
+    exit(0);
+  }
+}
+
+static void poll_tick(void)
+{
+  if(m_isr_depth == 0)
+  {
+    exit_if_done();
+  }
+  advance(m_now_us + HAL_POSIX_POLL_US);
+}
+
+
+void hal_gpio_cfg_output(uint32_t pin)
+{
+  m_dir |= bit(pin);
+  m_od &= ~bit(pin);
+}
+
+void hal_gpio_cfg_output_od(uint32_t pin)
+{
+  m_dir |= bit(pin);
+  m_od |= bit(pin);
+}
+
+void hal_gpio_cfg_input_pullup(uint32_t pin)
+{
+  m_dir &= ~bit(pin);
+  m_od &= ~bit(pin);
+}
+
+void hal_gpio_set(uint32_t pin)
+{
+  pin_write(pin, true);
+}
+
+void hal_gpio_clear(uint32_t pin)
+{
+  pin_write(pin, false);
+}
+
+void hal_gpio_toggle(uint32_t pin)
+{
+  pin_write(pin, (m_out & bit(pin)) == 0);
+}
+
+bool hal_gpio_read(uint32_t pin)
+{
+  poll_tick();
+  return (pin_levels() & bit(pin)) != 0;
+}
+
+void hal_gpio_port_set(uint8_t port, uint32_t mask)
+{
+  for(uint32_t pin = 0; pin < 32; pin++)
+  {
+    if(mask & (1UL << pin))
+    {
+      pin_write((port * 32) + pin, true);
+    }
+  }
+}
+
+void hal_gpio_port_clear(uint8_t port, uint32_t mask)
+{
+  for(uint32_t pin = 0; pin < 32; pin++)
+  {
+    if(mask & (1UL << pin))
+    {
+      pin_write((port * 32) + pin, false);
+    }
+  }
+}
+
+uint32_t hal_gpio_port_read(uint8_t port)
+{
+  poll_tick();
+  return (uint32_t)(pin_levels() >> (port * 32));
+}
+
+void hal_gpio_sense_set(uint32_t pin, hal_sense_t sense)
+{
+  m_sense_low &= ~bit(pin);
+  m_sense_high &= ~bit(pin);
+  if(sense == HAL_SENSE_LOW)
+  {
+    m_sense_low |= bit(pin);
+  }
+  else if(sense == HAL_SENSE_HIGH)
+  {
+    m_sense_high |= bit(pin);
+  }
+  detect_update();
+}
+
+void hal_gpio_detect_latched(uint8_t port)
+{
+  m_ldetect[port] = true;
+  detect_update();
+}
+
+uint32_t hal_gpio_latch_read(uint8_t port)
+{
+  return (uint32_t)(m_latch >> (port * 32));
+}
+
+void hal_gpio_latch_clear(uint8_t port, uint32_t mask)
+{
+  m_latch &= ~((uint64_t)mask << (port * 32));
+  m_detect = false;     // bits still set after the clear give a new rising edge
+  detect_update();
+}
+
+void hal_capture_init(void)
+{
+  m_capture_armed = 0;
+}
+
+void hal_capture_pin(uint8_t channel, hal_pin_t pin)
+{
+  m_capture_pin[channel] = (uint8_t)pin;
+}
+
+void hal_capture_arm(uint8_t channel)
+{
+  m_capture_armed |= 1U << channel;
+}
+
+bool hal_capture_taken(uint8_t channel)
+{
+  return (m_capture_armed & (1U << channel)) == 0;
+}
+
+uint32_t hal_capture_read(uint8_t channel)
+{
+  return m_capture_cc[channel];
+}
+
+uint32_t hal_capture_now(void)
+{
+  return (uint32_t)m_now_us;
+}
+
+void hal_delay_ms(uint32_t ms)
+{
+  advance(m_now_us + ((uint64_t)ms * 1000));
+}
+
+void hal_delay_us(uint32_t us)
+{
+  advance(m_now_us + us);
+}
+
+void hal_board_leds_on(void)
+{
+  for(uint8_t i = 0; i < sizeof(m_board_leds); i++)
+  {
+    pin_write(m_board_leds[i], false);
+  }
+}
+
+void hal_board_leds_off(void)
+{
+  for(uint8_t i = 0; i < sizeof(m_board_leds); i++)
+  {
+    pin_write(m_board_leds[i], true);
+  }
+}
+
+void hal_init(void)
+{
+  for(uint8_t i = 0; i < sizeof(m_board_leds); i++)
+  {
+    hal_gpio_cfg_output(m_board_leds[i]);
+  }
+  hal_board_leds_off();
+}
+
+void hal_idle(void)
+{
+  uint64_t t;
+
+  exit_if_done();
+  t = next_event_us();
+  if(t == UINT64_MAX)
+  {
+    realtime_wait(UINT64_MAX);   // only reached in realtime mode with stdin open
+    events_run();
+    return;
+  }
+  advance((t < m_end_us) ? t : m_end_us);
+}
+
+void hal_input_init(uint8_t const *pins, uint8_t count, hal_input_handler_t handler)
+{
+  m_input_handler = handler;
+  for(uint8_t i = 0; i < count; i++)
+  {
+    hal_gpio_cfg_input_pullup(pins[i]);
+    m_sense |= bit(pins[i]);
+  }
+}
+
+void hal_timer_create(hal_timer_t const *p_timer, hal_timer_mode_t mode, hal_timer_handler_t handler)
+{
+  struct hal_timer_s *p = *p_timer;
+
+  p->mode = mode;
+  p->handler = handler;
+  p->active = false;
+  if(!p->linked)
+  {
+    p->p_next = m_timers;
+    m_timers = p;
+    p->linked = true;
+  }
+}
+
+void hal_timer_start(hal_timer_t timer, uint32_t ms, void *p_context)
+{
+  timer->p_context = p_context;
+  timer->period_us = ms * 1000;
+  timer->deadline_us = m_now_us + timer->period_us;
+  timer->active = true;
+}
+
+void hal_timer_stop(hal_timer_t timer)
+{
+  timer->active = false;
+}
+
+uint32_t hal_ticks(void)
+{
+  return (uint32_t)m_now_us;
+}
+
+uint32_t hal_ticks_diff(uint32_t now, uint32_t then)
+{
+  return now - then;
+}
+
+
+void hal_posix_input_set(uint32_t pin, bool level)
+{
+  input_apply(pin, level);
+}
+
+/**@brief Press or release the matrix key between two pins.
+ */
+void hal_posix_key_set(uint32_t row_pin, uint32_t col_pin, bool pressed)
+{
+  uint64_t key = bit(row_pin) | bit(col_pin);
+  uint8_t i = 0;
+
+  while((i < m_key_count) && (m_keys[i] != key))
+  {
+    i++;
+  }
+  if(pressed && (i == m_key_count) && (m_key_count < HAL_POSIX_KEYS))
+  {
+    m_keys[m_key_count++] = key;
+  }
+  else if(!pressed && (i < m_key_count))
+  {
+    m_keys[i] = m_keys[--m_key_count];
+  }
+}
+
+/**@brief Reads that found a high and a low output joined by pressed keys.
+ */
+uint32_t hal_posix_shorts(void)
+{
+  return m_shorts;
+}
+
+bool hal_posix_output_get(uint32_t pin)
+{
+  return (m_out & bit(pin)) != 0;
+}
+
+uint64_t hal_posix_time_us(void)
+{
+  return m_now_us;
+}
+
+void hal_posix_run_until(uint64_t time_us)
+{
+  advance(time_us);
+}
+
+void hal_posix_port_event_set(hal_port_event_handler_t handler)
+{
+  m_port_handler = handler;
+  detect_update();
+}
+
+static void compare_fire(void *p_context)
+{
+  (void)p_context;
+  m_compare_handler();
+}
+
+/**@brief Call handler once when hal_ticks() reaches ticks, like an RTC CC register.
+ *
+ * @details A value up to half the counter range behind hal_ticks() has
+ *          already passed and fires on the next event run.
+ */
+void hal_posix_compare_set(uint32_t ticks, hal_compare_handler_t handler)
+{
+  uint32_t ahead = ticks - (uint32_t)m_now_us;
+
+  if(!m_compare.linked)
+  {
+    hal_timer_t timer = &m_compare;
+    hal_timer_create(&timer, HAL_TIMER_SINGLE_SHOT, compare_fire);
+  }
+  m_compare_handler = handler;
+  m_compare.deadline_us = (ahead <= (UINT32_MAX / 2)) ? (m_now_us + ahead) : m_now_us;
+  m_compare.active = true;
+}
+
+void hal_posix_compare_stop(void)
+{
+  m_compare.active = false;
+}
+
+void hal_posix_swi_set(hal_swi_handler_t handler)
+{
+  m_swi_handler = handler;
+}
+
+/**@brief Pend the software interrupt. It shares the priority of the input
+ *        handlers and has the highest number, so edges pending with it run first.
+ */
+void hal_posix_swi_pend(void)
+{
+  if(m_swi_handler != NULL)
+  {
+    m_swi_pending = true;
+    irq_run();
+  }
+}
+
+void hal_posix_realtime_set(bool realtime)
+{
+  struct epoll_event ev;
+
+  m_realtime = realtime;
+  if(!realtime || (m_epoll_fd >= 0))
+  {
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &m_epoch);
+  m_epoch.tv_sec -= (time_t)(m_now_us / 1000000);   // keep the virtual time already spent
+
+  m_epoll_fd = epoll_create1(0);
+  m_timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+  if((m_epoll_fd < 0) || (m_timer_fd < 0))
+  {
+    perror("hal_posix");
+    exit(1);
+  }
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = m_timer_fd;
+  epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_timer_fd, &ev);
+  ev.data.fd = STDIN_FILENO;
+  m_stdin_open = (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &ev) == 0);
+  if(m_stdin_open)
+  {
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+  }
+}
+
+/**@brief Load "time_ms pin level" steps, '#' starts a comment.
+ *
+ * @return Number of steps, -1 if the file cannot be read.
+ */
+int hal_posix_script_load(char const *path)
+{
+  FILE *fp = fopen(path, "r");
+  char line[HAL_POSIX_LINE_LEN];
+  size_t cap = 0;
+
+  if(fp == NULL)
+  {
+    return -1;
+  }
+  free(m_script);
+  m_script = NULL;
+  m_script_len = 0;
+  m_script_pos = 0;
+
+  while(fgets(line, sizeof(line), fp) != NULL)
+  {
+    unsigned long long time_ms;
+    unsigned pin, level;
+    size_t i;
+
+    if((line[0] == '#') || (sscanf(line, "%llu %u %u", &time_ms, &pin, &level) != 3))
+    {
+      continue;
+    }
+    if(m_script_len == cap)
+    {
+      cap = cap ? (cap * 2) : 64;
+      m_script = realloc(m_script, cap * sizeof(*m_script));
+      if(m_script == NULL)
+      {
+        perror("hal_posix");
+        exit(1);
+      }
+    }
+    // keep the file order for steps at the same time
+    for(i = m_script_len; (i > 0) && (m_script[i - 1].time_us > time_ms * 1000); i--)
+    {
+      m_script[i] = m_script[i - 1];
+    }
+    m_script[i].time_us = time_ms * 1000;
+    m_script[i].pin = (uint8_t)pin;
+    m_script[i].level = (level != 0);
+    m_script_len++;
+  }
+  fclose(fp);
+
+  if(m_script_len > 0)
+  {
+    m_end_us = m_script[m_script_len - 1].time_us + (HAL_POSIX_TAIL_MS * 1000);
+  }
+  return (int)m_script_len;
+}
+
+__attribute__((constructor)) static void hal_posix_setup(void)
+{
+  char const *env;
+
+  if((env = getenv("HAL_SCRIPT")) != NULL)
+  {
+    if(hal_posix_script_load(env) < 0)
+    {
+      perror(env);
+      exit(1);
+    }
+  }
+  if((env = getenv("HAL_END_MS")) != NULL)
+  {
+    m_end_us = strtoull(env, NULL, 0) * 1000;
+  }
+  m_trace = ((env = getenv("HAL_TRACE")) != NULL) && (atoi(env) != 0);
+  hal_posix_realtime_set(((env = getenv("HAL_REALTIME")) != NULL) && (atoi(env) != 0));
+}
+
+#endif /* HAL_POSIX */
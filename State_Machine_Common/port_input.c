@@ -0,0 +1,259 @@
+
+#include "port_input.h"
+#include <stddef.h>
+
+#if !defined(HAL_POSIX)
+#include "nrf.h"
+#endif
+
+
+static hal_input_handler_t m_handler;
+static uint32_t m_mask[HAL_GPIO_PORTS];             /**< Pins owned, per port. */
+static uint32_t m_pressed[HAL_GPIO_PORTS];          /**< Pins sensing for the release. */
+static port_input_stats_t m_stats;
+
+typedef struct
+{
+  hal_pin_t pin;
+  uint8_t channel;      /**< Capture channel, HAL_CAPTURE_CHANNELS if none. */
+  uint32_t edge_time;   /**< Last serviced edge, capture clock. */
+  uint32_t pressed_at;
+  uint32_t duration;    /**< Last complete press. */
+}port_input_pin_t;
+
+static port_input_pin_t m_pins[PORT_INPUT_MAX_PINS];
+static uint8_t m_pin_count;
+
+
+static port_input_pin_t * pin_get(hal_pin_t pin)
+{
+  for(uint8_t i = 0; i < m_pin_count; i++)
+  {
+    if(m_pins[i].pin == pin)
+    {
+      return &m_pins[i];
+    }
+  }
+  return NULL;
+}
+
+/**@brief Timestamp the serviced edge of a latched pin and re-arm its capture channel.
+ *
+ * @details The channel holds the first edge since it was re-armed, which is
+ *          the edge that set the latch. It is re-armed before the latch is
+ *          cleared, so the edge of the next latch is never missed. A repress
+ *          (release hidden by a held off interrupt) has its release captured,
+ *          the press that followed is only known to have happened by now.
+ */
+static void edge_stamp(hal_pin_t pin, uint32_t now, bool release, bool repress)
+{
+  port_input_pin_t *p_pin = pin_get(pin);
+  uint32_t t = now;
+
+  if(p_pin == NULL)
+  {
+    return;
+  }
+#if PORT_INPUT_CAPTURE
+  if((p_pin->channel < HAL_CAPTURE_CHANNELS) && hal_capture_taken(p_pin->channel))
+  {
+    t = hal_capture_read(p_pin->channel);
+    hal_capture_arm(p_pin->channel);
+    m_stats.captured++;
+    if(now - t > m_stats.service_max)
+    {
+      m_stats.service_max = now - t;
+    }
+  }
+  else
+#endif
+  {
+    m_stats.uncaptured++;
+  }
+  if(release)
+  {
+    p_pin->duration = t - p_pin->pressed_at;
+  }
+  if(!release || repress)
+  {
+    p_pin->pressed_at = repress ? now : t;
+  }
+  p_pin->edge_time = repress ? now : t;
+}
+
+
+/**@brief Flip the sense of the latched pins of one port and clear their latches.
+ *
+ * @details A latched pin sensing LOW was pressed and senses HIGH from now on,
+ *          a pin sensing HIGH was released and senses LOW again. The sense
+ *          flips before the latch is cleared: a pin whose level already
+ *          matches the new sense (a press shorter than the service time)
+ *          stays latched and is taken by the next scan, so presses and
+ *          releases always alternate and none is lost.
+ *          A release latched while the interrupt was held off by a long
+ *          handler hides a new press of that pin; if the pin is low again
+ *          by now, it is reported as pressed and keeps sensing HIGH.
+ *
+ * @return The pins that were pressed.
+ */
+static uint32_t port_scan(uint8_t port, uint32_t latch)
+{
+  uint32_t presses = latch & ~m_pressed[port];
+  uint32_t releases = latch & m_pressed[port];
+  uint32_t repressed = releases & ~hal_gpio_port_read(port);
+  uint32_t flip = latch & ~repressed;
+  uint32_t now = hal_capture_now();
+
+  for(uint32_t i = 0; i < 32; i++)
+  {
+    if(latch & (1UL << i))
+    {
+      edge_stamp((port * 32) + i, now, (releases & (1UL << i)) != 0, (repressed & (1UL << i)) != 0);
+    }
+    if(flip & (1UL << i))
+    {
+      hal_gpio_sense_set((port * 32) + i, (presses & (1UL << i)) ? HAL_SENSE_HIGH : HAL_SENSE_LOW);
+    }
+  }
+  m_pressed[port] ^= flip;
+  hal_gpio_latch_clear(port, latch);
+
+  m_stats.presses += __builtin_popcount(presses | repressed);
+  m_stats.releases += __builtin_popcount(releases);
+  return presses | repressed;
+}
+
+/**@brief PORT event: scan the LATCH registers until no owned pin is latched.
+ *
+ * @details The handler is called for each press, after its latch is cleared,
+ *          so pins changing while a handler runs are latched meanwhile.
+ */
+static void port_event_handler(void)
+{
+  bool latched;
+
+  m_stats.events++;
+  do
+  {
+    latched = false;
+    for(uint8_t port = 0; port < HAL_GPIO_PORTS; port++)
+    {
+      uint32_t latch = hal_gpio_latch_read(port) & m_mask[port];
+      uint32_t presses;
+
+      if(latch == 0)
+      {
+        continue;
+      }
+      latched = true;
+      m_stats.passes++;
+      presses = port_scan(port, latch);
+      for(uint32_t i = 0; i < 32; i++)
+      {
+        if(presses & (1UL << i))
+        {
+          m_handler((port * 32) + i, HAL_EDGE_HITOLO);
+        }
+      }
+    }
+  }while(latched);
+}
+
+
+#if !defined(HAL_POSIX)
+void GPIOTE_IRQHandler(void)
+{
+  if(NRF_GPIOTE->EVENTS_PORT)
+  {
+    NRF_GPIOTE->EVENTS_PORT = 0;
+    (void)NRF_GPIOTE->EVENTS_PORT;    // the clear must land before the handler returns
+    port_event_handler();
+  }
+}
+
+static void port_event_enable(void)
+{
+  NRF_GPIOTE->EVENTS_PORT = 0;
+  NRF_GPIOTE->INTENSET = GPIOTE_INTENSET_PORT_Msk;
+  NVIC_SetPriority(GPIOTE_IRQn, PORT_INPUT_IRQ_PRIORITY);
+  NVIC_ClearPendingIRQ(GPIOTE_IRQn);
+  NVIC_EnableIRQ(GPIOTE_IRQn);
+}
+#else
+static void port_event_enable(void)
+{
+  hal_posix_port_event_set(port_event_handler);
+}
+#endif
+
+/**@brief Pulled-up buttons, handler called from the PORT event interrupt on a press.
+ */
+void port_input_init(uint8_t const *pins, uint8_t count, hal_input_handler_t handler)
+{
+  m_handler = handler;
+  hal_capture_init();
+  for(uint8_t i = 0; i < count; i++)
+  {
+    m_mask[pins[i] >> 5] |= 1UL << (pins[i] & 0x1F);
+    if(m_pin_count < PORT_INPUT_MAX_PINS)
+    {
+      port_input_pin_t *p_pin = &m_pins[m_pin_count++];
+
+      p_pin->pin = pins[i];
+      p_pin->channel = HAL_CAPTURE_CHANNELS;
+#if PORT_INPUT_CAPTURE
+      if(i < HAL_CAPTURE_CHANNELS)
+      {
+        p_pin->channel = i;
+        hal_capture_pin(i, pins[i]);
+        hal_capture_arm(i);
+      }
+#endif
+    }
+  }
+  for(uint8_t port = 0; port < HAL_GPIO_PORTS; port++)
+  {
+    if(m_mask[port] != 0)
+    {
+      hal_gpio_detect_latched(port);
+    }
+  }
+  for(uint8_t i = 0; i < count; i++)
+  {
+    hal_gpio_cfg_input_pullup(pins[i]);
+    hal_gpio_sense_set(pins[i], HAL_SENSE_LOW);
+  }
+  for(uint8_t port = 0; port < HAL_GPIO_PORTS; port++)
+  {
+    hal_gpio_latch_clear(port, m_mask[port]);   // stale latches, a held button latches again
+  }
+  port_event_enable();
+}
+
+bool port_input_pressed(hal_pin_t pin)
+{
+  return (m_pressed[pin >> 5] & (1UL << (pin & 0x1F))) != 0;
+}
+
+/**@brief Capture clock time of the pin's last serviced edge, press or release.
+ */
+uint32_t port_input_edge_time(hal_pin_t pin)
+{
+  port_input_pin_t const *p_pin = pin_get(pin);
+
+  return (p_pin != NULL) ? p_pin->edge_time : hal_capture_now();
+}
+
+/**@brief Length of the pin's last complete press, capture clock ticks (us).
+ */
+uint32_t port_input_press_duration(hal_pin_t pin)
+{
+  port_input_pin_t const *p_pin = pin_get(pin);
+
+  return (p_pin != NULL) ? p_pin->duration : 0;
+}
+
+port_input_stats_t const * port_input_stats_get(void)
+{
+  return &m_stats;
+}
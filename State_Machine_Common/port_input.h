@@ -0,0 +1,49 @@
+#ifndef PORT_INPUT_H
+#define PORT_INPUT_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+
+/* Buttons on the GPIO DETECT signal and the one GPIOTE PORT event, instead of
+ * a GPIOTE IN channel per button: any number of pins, and no high accuracy
+ * channel drawing current while idle (PORT_INPUT_CAPTURE adds them back for
+ * timestamps only). The LATCH registers tell which pins changed. Owns the
+ * GPIOTE interrupt, the GPIOTE driver must be disabled. */
+
+#define PORT_INPUT_IRQ_PRIORITY   GPIOTE_CONFIG_IRQ_PRIORITY
+
+/* Edge timestamps from the capture path of hal.h: the first HAL_CAPTURE_CHANNELS
+ * pins also get a GPIOTE IN channel whose edge latches the capture clock
+ * through PPI, whatever the CPU is doing. Sensing stays on DETECT/LATCH.
+ * The channels and TIMER3 keep HFCLK running. 0: edges are timestamped when
+ * the scan reaches them. */
+#ifndef PORT_INPUT_CAPTURE
+#define PORT_INPUT_CAPTURE        1
+#endif
+
+/* pins with timestamps and press durations, further pins only sense */
+#ifndef PORT_INPUT_MAX_PINS
+#define PORT_INPUT_MAX_PINS       8
+#endif
+
+typedef struct
+{
+  uint32_t events;      /* PORT events taken */
+  uint32_t passes;      /* LATCH scans, more than events when pins change while serviced */
+  uint32_t presses;
+  uint32_t releases;
+  uint32_t captured;    /* edges timestamped by the capture path */
+  uint32_t uncaptured;  /* edges timestamped by the scan */
+  uint32_t service_max; /* longest captured edge to scan time, capture clock us */
+}port_input_stats_t;
+
+
+void port_input_init(uint8_t const *pins, uint8_t count, hal_input_handler_t handler);
+bool port_input_pressed(hal_pin_t pin);
+uint32_t port_input_edge_time(hal_pin_t pin);
+uint32_t port_input_press_duration(hal_pin_t pin);
+port_input_stats_t const * port_input_stats_get(void);
+
+
+#endif